@@ -35,7 +35,7 @@
 #define CLI_BUFF_SIZE   128
 #define CLI_WORD_SIZE   32
 #define CLI_WORD_CNT    6
-#define CLI_FUNC_CNT    20
+#define CLI_FUNC_CNT    32
 
 //******************************************************************************
 // Typedefs
@@ -37,7 +37,17 @@
 #include "test_mem.h"
 #include "i2c_bh1750.h"
 #include "dcf77.h"
+#include "dcf_cap.h"
+#ifdef DCF_BENCH
+#include "dcf_rec.h"
+#endif
+#include "dcf_pwr.h"
 #include "rtc_intern.h"
+#include "sched.h"
+#include "dt_arb.h"
+#include "dt_disc.h"
+#include "rtc_trim.h"
+#include "rtc_sqw.h"
 #include DISP_INCLUDE
 
 //******************************************************************************
@@ -64,9 +74,21 @@ bool cli_func_bh1750_init(int argc, char ** args);
 bool cli_func_bh1750_read(int argc, char ** args);
 
 bool cli_func_dcf77(int argc, char ** args);
+bool cli_func_dcf77_stats(int argc, char ** args);
+#ifdef DCF_BENCH
+bool cli_func_dcf77_rec(int argc, char ** args);
+bool cli_func_dcf77_gen(int argc, char ** args);
+#endif
+bool cli_func_dcf77_pwr(int argc, char ** args);
+bool cli_func_dcf77_deglitch(int argc, char ** args);
 
 bool cli_func_intens(int argc, char ** args);
 
+bool cli_func_sched(int argc, char ** args);
+bool cli_func_dt(int argc, char ** args);
+bool cli_func_disc(int argc, char ** args);
+bool cli_func_trim(int argc, char ** args);
+
 //******************************************************************************
 // Global Variables
 //******************************************************************************
@@ -96,7 +118,18 @@ void cli_func_init(void)
     cli_add_func("bh1750", "init",  cli_func_bh1750_init,   "bh1750 init");
     cli_add_func("bh1750", "read",  cli_func_bh1750_read,   "bh1750 read");
     cli_add_func("dcf77",    NULL,  cli_func_dcf77,         "dcf77");
+    cli_add_func("dcf77",  "stats", cli_func_dcf77_stats,   "dcf77 stats [clear|<rx>]");
+#ifdef DCF_BENCH
+    cli_add_func("dcf77",    "rec", cli_func_dcf77_rec,     "dcf77 rec [start|stop|dump|replay]");
+    cli_add_func("dcf77",    "gen", cli_func_dcf77_gen,     "dcf77 gen [scenario] [minutes]");
+#endif
+    cli_add_func("dcf77",    "pwr", cli_func_dcf77_pwr,     "dcf77 pwr [auto|on|off|clear]");
+    cli_add_func("dcf77", "deglitch", cli_func_dcf77_deglitch, "dcf77 deglitch [us]");
     cli_add_func("intens",   NULL,  cli_func_intens,        "intens <value>");
+    cli_add_func("sched",    NULL,  cli_func_sched,         "sched [clear]");
+    cli_add_func("dt",       NULL,  cli_func_dt,            "dt");
+    cli_add_func("disc",     NULL,  cli_func_disc,          "disc [clear]");
+    cli_add_func("trim",     NULL,  cli_func_trim,          "trim [on|off]");
 }
 
 /***************************************************************************//**
@@ -190,6 +223,18 @@ bool cli_func_systime(int argc, char ** args)
     return false;
 }
 
+/***************************************************************************//**
+* @brief Report a rejected I2C request (another request is waiting)
+* @param accepted [in] result of the request function
+* @return true (the arguments were valid)
+*******************************************************************************/
+static bool cli_i2c_req(const bool accepted)
+{
+    if(!accepted)
+        io_puts("Error: i2c busy, try again\r\n");
+    return true;
+}
+
 /***************************************************************************//**
 * @brief RTC read
 *           rtc read
@@ -213,6 +258,11 @@ void cli_func_rtc_read_callback(int result)
             //io_printf("(%i)\r\n", dt_ptr->dotw);
             DATETIME_PRINTF_TIME(io_printf, "", *dt_ptr, " ");
             DATETIME_PRINTF_DATE(io_printf, "", *dt_ptr, "\r\n");
+            ustime_t edge_ustime;
+            unsigned long edges = (unsigned long) rtc_sqw_get_edge(&edge_ustime);
+            io_printf("sqw: %s edges=%lu glitches=%lu\r\n",
+                (rtc_sqw_is_active(ustime_now()) ? "active" : "inactive"),
+                edges, (unsigned long) rtc_sqw_get_glitches());
         }
         else{
             io_puts("Error: null\r\n");
@@ -226,7 +276,7 @@ void cli_func_rtc_read_callback(int result)
 bool cli_func_rtc_read(int argc, char ** args)
 {
     io_printf("cli_func_rtc_read\r\n");
-    return i2c_man_req_rtc_read(cli_func_rtc_read_callback);
+    return cli_i2c_req(i2c_man_req_rtc_read(cli_func_rtc_read_callback));
 }
 
 /***************************************************************************//**
@@ -285,7 +335,7 @@ bool cli_func_rtc_set(int argc, char ** args)
     DATETIME_PRINTF_TIME(io_printf, "", dt, " ");
     DATETIME_PRINTF_DATE(io_printf, "", dt, "\r\n");
 
-    return i2c_man_req_rtc_set(&dt, cli_func_rtc_set_callback);
+    return cli_i2c_req(i2c_man_req_rtc_set(&dt, cli_func_rtc_set_callback));
 }
 
 /***************************************************************************//**
@@ -487,7 +537,7 @@ bool cli_func_test_mem(int argc, char ** args)
     }
 
     io_printf("cli_func_test_mem: req.op=%i\r\n", (int) req.op);
-    return i2c_man_req_mem_test(&req, cli_func_test_mem_callback);
+    return cli_i2c_req(i2c_man_req_mem_test(&req, cli_func_test_mem_callback));
 }
 
 /***************************************************************************//**
@@ -513,7 +563,7 @@ void cli_func_bh1750_init_callback(int result)
 bool cli_func_bh1750_init(int argc, char ** args)
 {
     io_printf("cli_func_bh1750_init\r\n");
-    return i2c_man_req_bh1750_init(cli_func_bh1750_init_callback);
+    return cli_i2c_req(i2c_man_req_bh1750_init(cli_func_bh1750_init_callback));
 }
 
 /***************************************************************************//**
@@ -539,7 +589,7 @@ void cli_func_bh1750_read_callback(int result)
 bool cli_func_bh1750_read(int argc, char ** args)
 {
     io_printf("cli_func_bh1750_read\r\n");
-    return i2c_man_req_bh1750_read(cli_func_bh1750_read_callback);
+    return cli_i2c_req(i2c_man_req_bh1750_read(cli_func_bh1750_read_callback));
 }
 
 /***************************************************************************//**
@@ -552,7 +602,274 @@ bool cli_func_bh1750_read(int argc, char ** args)
 *******************************************************************************/
 bool cli_func_dcf77(int argc, char ** args)
 {
-    io_printf("dcf77 quality: %i\r\n", dcf_get_quality());
+    // The decoders run on core1 (multicore): read them under the lock
+    dcf_lock();
+    const dcf_ctx_t * ctx0 = dcf_get_ctx(0);
+    io_printf("dcf77 quality: %i%% (score %i: phase %i, margin %i, decode %i)\r\n", dcf_get_quality(),
+            ctx0->q_raw, ema_int_get(&ctx0->q_phase), ema_int_get(&ctx0->q_margin), ema_int_get(&ctx0->q_decode));
+    io_printf("dcf77 lost edges: %lu\r\n", (unsigned long) dcf_cap_get_lost(0));
+    io_printf("dcf77 pll second: %i, period: %li us\r\n", dcf_get_second(), (long) dcf_get_period());
+    io_printf("dcf77 confidence: %i\r\n", dcf_get_confidence());
+
+    uint8_t flags = dcf_get_flags();
+    io_printf("dcf77 flags: %s%s%s%s\r\n",
+            (flags & DCF_FLAG_CEST) ? "CEST" : ((flags & DCF_FLAG_CET) ? "CET" : "zone?"),
+            (flags & DCF_FLAG_A1) ? " A1(dst change)" : "",
+            (flags & DCF_FLAG_A2) ? " A2(leap second)" : "",
+            (flags & DCF_FLAG_CALL) ? " R(call)" : "");
+
+    int32_t nom0, nom1, thr, min0, max1;
+    dcf_get_classifier(&nom0, &nom1, &thr, &min0, &max1);
+    io_printf("dcf77 bits [ms]: 0=%li 1=%li threshold=%li limits=%li..%li\r\n", (long)(nom0 / 1000L),
+            (long)(nom1 / 1000L), (long)(thr / 1000L), (long)(min0 / 1000L), (long)(max1 / 1000L));
+    io_printf("dcf77 time-to-sync: %li s\r\n", (long) dcf_get_sync_time());
+
+    for(int rx = 1; rx < DCF_RX_CNT; rx++)
+    {
+        const dcf_ctx_t * ctx = dcf_get_ctx(rx);
+        io_printf("dcf77 rx%i quality: %i, pll second: %i, lost edges: %lu\r\n", rx, ctx->q_quality,
+                ctx->pll_sec, (unsigned long) dcf_cap_get_lost(rx));
+    }
+    dcf_unlock();
+    return true;
+}
+
+/***************************************************************************//**
+* @brief Display dcf77 statistics (or clear them):
+*
+*           args[0] | args[1] | args[2]
+*           dcf77     stats     [clear|<rx>]
+*
+*        Where <rx> is the receiver index (default 0), "clear" clears all receivers.
+*
+* @param argc [in] count of arguments in args array
+* @param args [in] array of arguments, every element is a pointer to a string
+* @return true - if the request successfully processed
+*         false - error converting arguments to request
+*******************************************************************************/
+bool cli_func_dcf77_stats(int argc, char ** args)
+{
+    int rx = 0;
+
+    if((argc >= 3) && !strncmp(args[2], "clear", CLI_WORD_SIZE))
+    {
+        for(rx = 0; rx < DCF_RX_CNT; rx++)
+            dcf_clear_stats(rx);
+        io_puts("dcf77 stats cleared\r\n");
+        return true;
+    }
+
+    if((argc >= 3) && !utils_get_int(&rx, args[2], CLI_WORD_SIZE))
+        return false;
+    if((rx < 0) || (rx >= DCF_RX_CNT))
+        return false;
+
+    dcf_stats_t stats;
+    const dcf_stats_t * st = &stats;
+    if(!dcf_get_stats(rx, &stats))
+        return false;
+
+    io_printf("pulses: ok=%lu spurious=%lu short=%lu long=%lu\r\n", (unsigned long) st->pulse_ok,
+            (unsigned long) st->pulse_spur, (unsigned long) st->pulse_short, (unsigned long) st->pulse_long);
+    io_printf("glitches: %lu\r\n", (unsigned long) st->glitch);
+
+    io_puts("pulse width [ms]:");
+    for(int i = 0; i <= DCF_STAT_BINS; i++)
+    {
+        if(st->pulse_hist[i] != 0)
+            io_printf(" %li:%lu", (long)((i * DCF_STAT_BIN) / 1000L), (unsigned long) st->pulse_hist[i]);
+    }
+    io_puts("\r\n");
+
+    io_printf("sync loss: %lu, realign: %lu\r\n", (unsigned long) st->sync_loss, (unsigned long) st->realign);
+    io_printf("minutes: %lu, bits last: %u, bits avg: %lu\r\n", (unsigned long) st->minutes,
+            (unsigned int) st->bits_last, (unsigned long)(st->minutes ? (st->bits_sum / st->minutes) : 0));
+    io_printf("parity err/miss: min=%lu/%lu hour=%lu/%lu date=%lu/%lu\r\n",
+            (unsigned long) st->par_err[dcf_field_min], (unsigned long) st->par_miss[dcf_field_min],
+            (unsigned long) st->par_err[dcf_field_hour], (unsigned long) st->par_miss[dcf_field_hour],
+            (unsigned long) st->par_err[dcf_field_date], (unsigned long) st->par_miss[dcf_field_date]);
+    io_printf("decode fail: bits=%lu marker=%lu time=%lu date=%lu conf=%lu\r\n",
+            (unsigned long) st->fail_bits, (unsigned long) st->fail_marker, (unsigned long) st->fail_time,
+            (unsigned long) st->fail_date, (unsigned long) st->fail_conf);
+    io_printf("decode ok: confirmed=%lu predicted=%lu\r\n", (unsigned long) st->dec_conf,
+            (unsigned long) st->dec_pred);
+    io_printf("combined minutes: %lu\r\n", (unsigned long) st->comb_minutes);
+    io_printf("bit errors: %lu of %lu\r\n", (unsigned long) st->ber_err, (unsigned long) st->ber_bits);
+
+    io_puts("good per hour:");
+    for(int i = 0; i < 24; i++)
+        io_printf(" %u", (unsigned int) st->good_hour[i]);
+    io_puts("\r\n");
+
+    if(st->last_ok_age == UINT32_MAX)
+        io_puts("last success: never\r\n");
+    else
+        io_printf("last success: %lu s ago\r\n", (unsigned long) st->last_ok_age);
+
+    io_printf("cpu: %lu us/minute, max: %lu us\r\n", (unsigned long) st->cpu_minute_us,
+            (unsigned long) st->cpu_max_us);
+#ifdef DCF_BENCH
+    io_printf("sim check: ok=%lu false=%lu\r\n", (unsigned long) st->check_ok,
+            (unsigned long) st->check_false);
+#endif
+    return true;
+}
+
+#ifdef DCF_BENCH
+/***************************************************************************//**
+* @brief Record the raw dcf77 edges, dump or replay them:
+*
+*           args[0] | args[1] | args[2]
+*           dcf77     rec       [start|stop|dump|replay]
+*
+*        Without args[2] the state of the recorder is displayed.
+*        The replay result (decoded datetimes, time-to-sync, cpu) is displayed
+*        by "dcf77 stats" and "dcf77".
+* @param argc [in] count of arguments in args array
+* @param args [in] array of arguments, every element is a pointer to a string
+* @return true - if the request successfully processed
+*         false - error converting arguments to request
+*******************************************************************************/
+bool cli_func_dcf77_rec(int argc, char ** args)
+{
+    if(argc >= 3)
+    {
+        if(!strncmp(args[2], "start", CLI_WORD_SIZE))
+        {
+            dcf_lock();
+            dcf_rec_start();
+            dcf_unlock();
+        }
+        else if(!strncmp(args[2], "stop", CLI_WORD_SIZE))
+        {
+            dcf_lock();
+            dcf_rec_stop();
+            dcf_unlock();
+        }
+        else if(!strncmp(args[2], "dump", CLI_WORD_SIZE))
+        {
+            dcf_rec_dump();
+            return true;
+        }
+        else if(!strncmp(args[2], "replay", CLI_WORD_SIZE))
+        {
+            if(!dcf_replay_start(ustime_now()))
+                return false;
+        }
+        else {
+            return false;
+        }
+    }
+
+    io_printf("dcf77 rec: %s, %lu edges%s\r\n", (dcf_rec_is_recording() ? "recording" : "stopped"),
+            (unsigned long) dcf_rec_get_cnt(), (dcf_rec_is_replaying() ? ", replaying" : ""));
+    return true;
+}
+
+/***************************************************************************//**
+* @brief Feed a synthetic dcf77 signal (scenario) through the decoder:
+*
+*           args[0] | args[1] | args[2]    | args[3]
+*           dcf77     gen       [scenario]   [minutes]
+*
+*        Without args[2] the list of scenarios is displayed.
+*        The result (false accepts, time-to-sync, cpu) is displayed
+*        by "dcf77 stats" and "dcf77".
+* @param argc [in] count of arguments in args array
+* @param args [in] array of arguments, every element is a pointer to a string
+* @return true - if the request successfully processed
+*         false - error converting arguments to request
+*******************************************************************************/
+bool cli_func_dcf77_gen(int argc, char ** args)
+{
+    if(argc < 3)
+    {
+        dcf_gen_list();
+        return true;
+    }
+
+    const dcf_gen_cfg_t * cfg_ptr = dcf_gen_find(args[2]);
+    if(cfg_ptr == NULL)
+        return false;
+
+    int minutes = 0;
+    if((argc >= 4) && !utils_get_int(&minutes, args[3], CLI_WORD_SIZE))
+        return false;
+
+    dcf_sim_start(cfg_ptr, minutes, ustime_now());
+    io_printf("dcf77 gen: %s started\r\n", cfg_ptr->name);
+    return true;
+}
+#endif
+
+/***************************************************************************//**
+* @brief Set the power mode of the dcf77 receiver or clear the learned profile:
+*
+*           args[0] | args[1] | args[2]
+*           dcf77     pwr       [auto|on|off|clear]
+*
+*        Without args[2] the power state and the reception profile are displayed.
+*
+* @param argc [in] count of arguments in args array
+* @param args [in] array of arguments, every element is a pointer to a string
+* @return true - if the request successfully processed
+*         false - error converting arguments to request
+*******************************************************************************/
+bool cli_func_dcf77_pwr(int argc, char ** args)
+{
+    static const char * reason_txt[] = { "off", "forced", "learn", "no time", "holdover", "window", "probe" };
+
+    if(argc >= 3)
+    {
+        if(!strncmp(args[2], "auto", CLI_WORD_SIZE))
+            dcf_pwr_set_mode(dcf_pwr_mode_auto);
+        else if(!strncmp(args[2], "on", CLI_WORD_SIZE))
+            dcf_pwr_set_mode(dcf_pwr_mode_on);
+        else if(!strncmp(args[2], "off", CLI_WORD_SIZE))
+            dcf_pwr_set_mode(dcf_pwr_mode_off);
+        else if(!strncmp(args[2], "clear", CLI_WORD_SIZE))
+            dcf_pwr_clear();
+        else
+            return false;
+    }
+
+    const dcf_pwr_prof_t * prof = dcf_pwr_get_profile();
+    io_printf("dcf77 pwr: %s (%s), duty: %i%%, holdover: %li ms\r\n", (dcf_is_enabled() ? "on" : "off"),
+            reason_txt[dcf_pwr_get_reason()], dcf_pwr_get_duty(), (long) dcf_pwr_get_holdover());
+    io_printf("dcf77 pwr: learned days: %u, probe hour: %u\r\n", (unsigned int) prof->days,
+            (unsigned int) prof->probe);
+    io_puts("score per hour:");
+    for(int i = 0; i < 24; i++)
+        io_printf(" %u", (unsigned int) prof->score[i]);
+    io_puts("\r\n");
+    return true;
+}
+
+/***************************************************************************//**
+* @brief Set the minimal stable time of the dcf77 input level (deglitch):
+*
+*           args[0] | args[1]  | args[2]
+*           dcf77     deglitch   [us]
+*
+*        Where [us] is the stable time in us (0: deglitch off). Without args[2]
+*        the actual stable time is displayed.
+*
+* @param argc [in] count of arguments in args array
+* @param args [in] array of arguments, every element is a pointer to a string
+* @return true - if the request successfully processed
+*         false - error converting arguments to request
+*******************************************************************************/
+bool cli_func_dcf77_deglitch(int argc, char ** args)
+{
+    if(argc >= 3)
+    {
+        int stable_us;
+        if(!utils_get_int(&stable_us, args[2], CLI_WORD_SIZE))
+            return false;
+        dcf_set_stable_time((int32_t) stable_us);
+    }
+
+    io_printf("dcf77 deglitch: %li us\r\n", (long) dcf_get_stable_time());
     return true;
 }
 
@@ -586,3 +903,197 @@ bool cli_func_intens(int argc, char ** args)
     io_printf("intensity override to %i\r\n", cli_intens);
     return true;
 }
+
+/***************************************************************************//**
+* @brief Display the scheduler statistics (per task and idle time)
+*
+*           args[0] | args[1]
+*           sched     [clear]
+*
+* @param argc [in] count of arguments in args array
+* @param args [in] array of arguments, every element is a pointer to a string
+* @return true - if the request successfully processed
+*         false - error converting arguments to request
+*******************************************************************************/
+bool cli_func_sched(int argc, char ** args)
+{
+    if(argc >= 2)
+    {
+        if(strcmp(args[1], "clear") != 0)
+            return false;
+        sched_clear_stats();
+        io_puts("sched: statistics cleared\r\n");
+        return true;
+    }
+
+    ustime_t total_us;
+    ustime_t idle_us = sched_get_idle(&total_us);
+    io_printf("sched: idle %lu%% of %lus\r\n",
+        (unsigned long)((total_us > 0) ? ((idle_us * 100) / total_us) : 0),
+        (unsigned long)(total_us / 1000000));
+    io_puts("task      period[us]       runs avg[us] max[us] late[us]\r\n");
+
+    const sched_task_t * task;
+    for(int id = 0; (task = sched_get_task(id)) != NULL; id++)
+    {
+        io_printf("%-9s %10lu %10lu %7lu %7lu %8lu\r\n", task->name,
+            (unsigned long) task->period, (unsigned long) task->run_cnt,
+            (unsigned long)((task->run_cnt > 0) ? (task->run_us / task->run_cnt) : 0),
+            (unsigned long) task->run_max_us, (unsigned long) task->late_max_us);
+    }
+    return true;
+}
+
+/***************************************************************************//**
+* @brief Display the time sources (error bounds) and the selected source
+*
+*           args[0]
+*           dt
+*
+* @param argc [in] count of arguments in args array
+* @param args [in] array of arguments, every element is a pointer to a string
+* @return true - if the request successfully processed
+*         false - error converting arguments to request
+*******************************************************************************/
+bool cli_func_dt(int argc, char ** args)
+{
+    ustime_t now = ustime_now();
+    io_puts("source    err[ms]  rejected\r\n");
+
+    const dt_arb_src_t * src;
+    for(int id = 0; (src = dt_arb_get_src(id)) != NULL; id++)
+    {
+        uint32_t err = dt_arb_get_err(id, now);
+        if(err == DT_ARB_ERR_UNKNOWN)
+            io_printf("%-9s %7s  %8lu\r\n", src->cfg->name, "unknown", (unsigned long) src->rejected);
+        else
+            io_printf("%-9s %7lu  %8lu\r\n", src->cfg->name, (unsigned long) err, (unsigned long) src->rejected);
+    }
+
+    uint32_t err;
+    int id = dt_arb_select(now, &err);
+    if(id < 0)
+    {
+        io_puts("selected: none\r\n");
+    }
+    else
+    {
+        datetime_t dt;
+        dt_arb_get_dt(id, now, &dt);
+        io_printf("selected: %s +-%lums %s ", dt_arb_get_src(id)->cfg->name, (unsigned long) err,
+            ((err <= DT_ARB_TRUST_MS) ? "(trusted)" : "(not trusted)"));
+        io_printf("%02d:%02d:%02d %02d.%02d.%04d\r\n", dt.hour, dt.min, dt.sec, dt.day, dt.month, dt.year);
+    }
+    return true;
+}
+
+/***************************************************************************//**
+* @brief Display the drift estimation of the RTCs (frequency error, actual
+*        fit, predicted offset and holdover error over a day)
+*
+*           args[0] | args[1]
+*           disc      [clear]
+*
+* @param argc [in] count of arguments in args array
+* @param args [in] array of arguments, every element is a pointer to a string
+* @return true - if the request successfully processed
+*         false - error converting arguments to request
+*******************************************************************************/
+bool cli_func_disc(int argc, char ** args)
+{
+    if(argc >= 2)
+    {
+        if(strcmp(args[1], "clear") != 0)
+            return false;
+        dt_disc_clear();
+        io_puts("disc: estimates cleared\r\n");
+        return true;
+    }
+
+    ustime_t now = ustime_now();
+    io_puts("source    drift[ppb]  +-[ppb] fits offsets span[h] offset[ms] hold24h[ms] rejected\r\n");
+
+    const dt_disc_src_t * src;
+    for(int id = 0; (src = dt_disc_get_src(id)) != NULL; id++)
+    {
+        io_printf("%-9s ", src->name);
+
+        int32_t ppb;
+        uint32_t sigma;
+        if(dt_disc_get_ppb(id, &ppb, &sigma))
+            io_printf("%10li %8lu ", (long) ppb, (unsigned long) sigma);
+        else
+            io_printf("%10s %8s ", "unknown", "-");
+
+        io_printf("%4u %7lu %7lu ", (unsigned) src->est.fits, (unsigned long) src->cnt,
+            (unsigned long)((src->cnt > 0) ? (get_diff_ustime(src->offset_ustime, src->fit_ustime) / 3600000000ULL) : 0));
+
+        int32_t offset_us;
+        if(dt_disc_get_offset(id, now, &offset_us))
+            io_printf("%10li ", (long)(offset_us / 1000));
+        else
+            io_printf("%10s ", "-");
+
+        int32_t hold_ms = dt_disc_get_holdover(id, 86400UL);
+        if(hold_ms >= 0)
+            io_printf("%11li ", (long) hold_ms);
+        else
+            io_printf("%11s ", "-");
+
+        io_printf("%8lu\r\n", (unsigned long) src->outliers);
+    }
+    return true;
+}
+
+/***************************************************************************//**
+* @brief Enable/disable the trim of the DS3231 aging offset or display its
+*        state and the history of the trims
+*
+*           args[0] | args[1]
+*           trim      [on|off]
+*
+* @param argc [in] count of arguments in args array
+* @param args [in] array of arguments, every element is a pointer to a string
+* @return true - if the request successfully processed
+*         false - error converting arguments to request
+*******************************************************************************/
+bool cli_func_trim(int argc, char ** args)
+{
+    static const char * const state_str[] = { "off", "idle", "write", "eval", "hold" };
+    static const char * const res_str[] = { "pending", "kept", "rollback", "failed" };
+
+    if(argc >= 2)
+    {
+        if(strcmp(args[1], "on") == 0)
+            rtc_trim_set_enabled(true);
+        else if(strcmp(args[1], "off") == 0)
+            rtc_trim_set_enabled(false);
+        else
+            return false;
+    }
+
+    io_printf("trim: %s", state_str[rtc_trim_get_state()]);
+    int8_t aging;
+    if(i2c_rtc_get_aging(&aging))
+        io_printf(" aging=%i\r\n", aging);
+    else
+        io_puts(" aging=unknown\r\n");
+
+    const rtc_trim_hist_t * hist = rtc_trim_get_hist(0);
+    if(hist == NULL)
+        return true;
+
+    ustime_t now = ustime_now();
+    io_puts("age[h] aging  before[ppb] after[ppb] result\r\n");
+    for(int idx = 0; (hist = rtc_trim_get_hist(idx)) != NULL; idx++)
+    {
+        io_printf("%6lu %3i->%-3i %11li ", (unsigned long)(get_diff_ustime(now, hist->ustime) / 3600000000ULL),
+            hist->aging_old, hist->aging_new, (long) hist->ppb_before);
+        if(hist->res == rtc_trim_res_pending)
+            io_printf("%10s ", "-");
+        else
+            io_printf("%10li ", (long) hist->ppb_after);
+        io_printf("%s\r\n", res_str[hist->res]);
+    }
+    return true;
+}
@@ -197,12 +197,12 @@ bool datetime_is_valid_date(const datetime_t * in_date)
 {
     if(!in_date)
         return false;
-    if((in_date->day < 1) || (in_date->day > 31))
-        return false;
     if((in_date->month < 1) || (in_date->month > 12))
         return false;
     if((in_date->year < 0) || (in_date->year > 4095))
         return false;
+    if((in_date->day < 1) || (in_date->day > datetime_days_in_month(in_date->year, in_date->month)))
+        return false;
     if((in_date->dotw < 0) || (in_date->dotw > 6))
         return false;
     return true;
@@ -302,26 +302,115 @@ void datetime_copy(datetime_t * out_dt, const datetime_t * in_dt)
 }
 
 /***************************************************************************//**
-* @brief Add seconds to time (doesn't work with negative values for sec)
-* @param time [in/out] pointer to time variable to add seconds to
-* @param sec [in] secnds to add to time (only positive values)
-* @return days
+* @brief Get the count of days in a month
+* @param year [in] year
+* @param month [in] month 1..12
+* @return count of days
 *******************************************************************************/
-int datetime_add_sec(datetime_t * time, int sec)
+int datetime_days_in_month(const int year, const int month)
 {
-    if(!time)
-        return 0;
+    static const uint8_t days[12] = { 31, 28, 31, 30, 31, 30, 31, 31, 30, 31, 30, 31 };
+    if((month == 2) && ((year % 4) == 0) && (((year % 100) != 0) || ((year % 400) == 0)))
+        return 29;
+    return days[month - 1];
+}
+
+/***************************************************************************//**
+* @brief Get the count of days since 01.01.1970 of a date. The year is shifted
+*        to start in March, so the leap day is the last day of the year and
+*        the days before a month follow from (153 * m + 2) / 5.
+* @param year [in] year
+* @param month [in] month 1..12
+* @param day [in] day 1..31
+* @return days since 01.01.1970 (negative before)
+*******************************************************************************/
+int32_t datetime_days_from_civil(const int year, const int month, const int day)
+{
+    int32_t y = (int32_t) year - ((month <= 2) ? 1 : 0);
+    int32_t era = ((y >= 0) ? y : (y - 399)) / 400;
+    int32_t yoe = y - (era * 400);                                     // 0..399
+    int32_t doy = ((153 * (month + ((month > 2) ? -3 : 9))) + 2) / 5 + day - 1;  // 0..365
+    int32_t doe = (yoe * 365) + (yoe / 4) - (yoe / 100) + doy;         // 0..146096
+    return (era * 146097) + doe - 719468;
+}
 
-    int sec_new = sec + (int) time->sec;
-    time->sec = (int8_t)(sec_new % 60);
+/***************************************************************************//**
+* @brief Convert a day count since 01.01.1970 to a date (inverse of
+*        datetime_days_from_civil)
+* @param dt [out] pointer to datetime where the date is stored
+* @param days [in] days since 01.01.1970
+*******************************************************************************/
+static void datetime_civil_from_days(datetime_t * dt, int32_t days)
+{
+    days += 719468;
+    int32_t era = ((days >= 0) ? days : (days - 146096)) / 146097;
+    int32_t doe = days - (era * 146097);                                        // 0..146096
+    int32_t yoe = (doe - (doe / 1460) + (doe / 36524) - (doe / 146096)) / 365;  // 0..399
+    int32_t doy = doe - ((365 * yoe) + (yoe / 4) - (yoe / 100));                // 0..365
+    int32_t mp = ((5 * doy) + 2) / 153;                                         // 0..11, 0 is March
+    int32_t month = mp + ((mp < 10) ? 3 : -9);
+
+    dt->year = (int16_t)(yoe + (era * 400) + ((month <= 2) ? 1 : 0));
+    dt->month = (int8_t) month;
+    dt->day = (int8_t)(doy - (((153 * mp) + 2) / 5) + 1);
+}
+
+/***************************************************************************//**
+* @brief Convert datetime to epoch seconds (the day of the week is ignored)
+* @param dt [in] pointer to datetime variable
+* @return seconds since 01.01.1970 00:00:00
+*******************************************************************************/
+epoch_t datetime_to_epoch(const datetime_t * dt)
+{
+    epoch_t days = (epoch_t) datetime_days_from_civil(dt->year, dt->month, dt->day);
+    return (days * 86400) + (epoch_t) datetime_time_to_sec(dt);
+}
+
+/***************************************************************************//**
+* @brief Convert epoch seconds to datetime (including the day of the week)
+* @param dt [out] pointer to datetime variable
+* @param epoch [in] seconds since 01.01.1970 00:00:00
+*******************************************************************************/
+void datetime_from_epoch(datetime_t * dt, const epoch_t epoch)
+{
+    if(!dt)
+        return;
+
+    int32_t days = (int32_t)(epoch / 86400);
+    int32_t sec = (int32_t)(epoch % 86400);
+    if(sec < 0)
+    {
+        sec += 86400;
+        days--;
+    }
 
-    int min_new = ((int) time->min) + (sec_new / 60);
-    time->min = (int8_t)(min_new % 60);
+    datetime_civil_from_days(dt, days);
 
-    int hr_new = ((int) time->hour) + (min_new / 60);
-    time->hour = (int8_t)(hr_new % 24);
+    // 01.01.1970 was a Thursday (Sun=0 ... Sat=6)
+    int32_t dotw = (days + 4) % 7;
+    dt->dotw = (int8_t)((dotw < 0) ? (dotw + 7) : dotw);
 
-    return (hr_new / 24);
+    dt->hour = (int8_t)(sec / 3600);
+    dt->min = (int8_t)((sec / 60) % 60);
+    dt->sec = (int8_t)(sec % 60);
+}
+
+/***************************************************************************//**
+* @brief Add seconds to datetime, the date (and day of the week) follows
+*        the rollover of the time
+* @param time [in/out] pointer to datetime variable to add seconds to
+* @param sec [in] seconds to add to datetime (positive or negative)
+* @return count of day changes (negative if moved back)
+*******************************************************************************/
+int datetime_add_sec(datetime_t * time, int sec)
+{
+    if(!time)
+        return 0;
+
+    int32_t days = datetime_days_from_civil(time->year, time->month, time->day);
+    epoch_t epoch = datetime_to_epoch(time) + sec;
+    datetime_from_epoch(time, epoch);
+    return (int)(datetime_days_from_civil(time->year, time->month, time->day) - days);
 }
 
 /***************************************************************************//**
@@ -334,22 +423,8 @@ int datetime_add_sec(datetime_t * time, int sec)
 *******************************************************************************/
 int datetime_time_compare(const datetime_t * time1, const datetime_t * time2)
 {
-    if(time1->hour < time2->hour)
-        return -1;
-    else if(time1->hour > time2->hour)
-        return 1;
-
-    if(time1->min < time2->min)
-        return -1;
-    else if(time1->min > time2->min)
-        return 1;
-
-    if(time1->sec < time2->sec)
-        return -1;
-    else if(time1->sec > time2->sec)
-        return 1;
-
-    return 0;
+    int diff = datetime_time_diff(time1, time2);
+    return (diff > 0) - (diff < 0);
 }
 
 /***************************************************************************//**
@@ -362,22 +437,9 @@ int datetime_time_compare(const datetime_t * time1, const datetime_t * time2)
 *******************************************************************************/
 int datetime_date_compare(const datetime_t * date1, const datetime_t * date2)
 {
-    if(date1->year < date2->year)
-        return -1;
-    else if(date1->year > date2->year)
-        return 1;
-
-    if(date1->month < date2->month)
-        return -1;
-    else if(date1->month > date2->month)
-        return 1;
-
-    if(date1->day < date2->day)
-        return -1;
-    else if(date1->day > date2->day)
-        return 1;
-
-    return 0;
+    int32_t diff = datetime_days_from_civil(date1->year, date1->month, date1->day)
+                 - datetime_days_from_civil(date2->year, date2->month, date2->day);
+    return (diff > 0) - (diff < 0);
 }
 
 /***************************************************************************//**
@@ -390,10 +452,8 @@ int datetime_date_compare(const datetime_t * date1, const datetime_t * date2)
 *******************************************************************************/
 int datetime_compare(const datetime_t * dt1, const datetime_t * dt2)
 {
-    int res = datetime_date_compare(dt1, dt2);
-    if(!res)
-        return datetime_time_compare(dt1, dt2);
-    return res;
+    epoch_t diff = datetime_diff(dt1, dt2);
+    return (diff > 0) - (diff < 0);
 }
 
 /***************************************************************************//**
@@ -421,7 +481,8 @@ int datetime_time_to_sec(const datetime_t * time)
 }
 
 /***************************************************************************//**
-* @brief Get difference in seconds between time1 and time2
+* @brief Get difference in seconds between time1 and time2 (time of the day
+*        only, the date is ignored, see datetime_diff)
 * @param time1 [in] time variable 1
 * @param time2 [in] time variable 2
 * @return difference in seconds: time1 - time2
@@ -430,3 +491,14 @@ int datetime_time_diff(const datetime_t * time1, const datetime_t * time2)
 {
     return (datetime_time_to_sec(time1) - datetime_time_to_sec(time2));
 }
+
+/***************************************************************************//**
+* @brief Get difference in seconds between dt1 and dt2 (date and time)
+* @param dt1 [in] datetime variable 1
+* @param dt2 [in] datetime variable 2
+* @return difference in seconds: dt1 - dt2
+*******************************************************************************/
+epoch_t datetime_diff(const datetime_t * dt1, const datetime_t * dt2)
+{
+    return (datetime_to_epoch(dt1) - datetime_to_epoch(dt2));
+}
@@ -17,6 +17,10 @@
 /*******************************************************************************
  * datetime_utils - the module implements useful functions to work with the
  * datetime_t data structure.
+ *
+ * Comparisons, differences and additions are done on epoch seconds (seconds
+ * since 01.01.1970 00:00:00, proleptic Gregorian calendar, no leap seconds),
+ * the conversion date <-> day number is done without loops.
  ******************************************************************************/
 #ifndef DATETIME_UTILS_H
 #define DATETIME_UTILS_H
@@ -43,6 +47,9 @@ typedef struct {
 } datetime_t;
 */
 
+// Seconds since 01.01.1970 00:00:00 (negative before)
+typedef int64_t epoch_t;
+
 #define DATETIME_PRINTF_TIME(func,prefix,dt,suffix) \
         (func)(prefix "%2.2i:%2.2i:%2.2i" suffix, (dt).hour, (dt).min, (dt).sec)
 #define DATETIME_PRINTF_DATE(func,prefix,dt,suffix) \
@@ -85,7 +92,19 @@ void datetime_clear(datetime_t * dt);
 // Copy source datetime to destination datetime
 void datetime_copy(datetime_t * out_dt, const datetime_t * in_dt);
 
-// Add seconds to time
+// Get the count of days in a month
+int datetime_days_in_month(const int year, const int month);
+
+// Get the count of days since 01.01.1970 of a date
+int32_t datetime_days_from_civil(const int year, const int month, const int day);
+
+// Convert datetime to epoch seconds
+epoch_t datetime_to_epoch(const datetime_t * dt);
+
+// Convert epoch seconds to datetime (including the day of the week)
+void datetime_from_epoch(datetime_t * dt, const epoch_t epoch);
+
+// Add seconds to datetime (with date rollover)
 int datetime_add_sec(datetime_t * time, int sec);
 
 // Compare two time variables
@@ -103,8 +122,11 @@ bool datetime_is_equal(const datetime_t * dt1, const datetime_t * dt2);
 // Convert a time variable to seconds
 int datetime_time_to_sec(const datetime_t * time);
 
-// Get difference in seconds between time1 and time2
+// Get difference in seconds between time1 and time2 (time of the day only)
 int datetime_time_diff(const datetime_t * time1, const datetime_t * time2);
 
+// Get difference in seconds between dt1 and dt2 (date and time)
+epoch_t datetime_diff(const datetime_t * dt1, const datetime_t * dt2);
+
 //******************************************************************************
 #endif /* DATETIME_UTILS_H */
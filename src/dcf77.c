@@ -24,277 +24,804 @@
 #include <stdint.h>
 #include <string.h> // memcpy
 #include <stdio.h>
-#include <limits.h> // INT_MAX
+#include <stdlib.h> // abs
+#include <limits.h> // INT_MIN
 
 #include "pico/stdlib.h"
+#ifdef MULTICORE
+#include "pico/mutex.h"
+#endif
 
 #include "dcf77.h"
+#include "dcf_cap.h"
+#ifdef DCF_BENCH
+#include "dcf_rec.h"
+#include "dcf_gen.h"
+#endif
+#include "in_out.h"
 #include "gpio_drv.h"
 #include "utils.h"
 
 //******************************************************************************
 // Function Prototypes
 //******************************************************************************
-void dcf_sig_quality(const ustime_t sys_ustime);
+static void dcf_sig_quality(dcf_ctx_t * ctx, const ustime_t sys_ustime);
+static void cls_reset(dcf_ctx_t * ctx);
 
 //******************************************************************************
 // Global Variables
 //******************************************************************************
-static bool pin_old = false;    // Previous state of input signal
+// Decoder contexts of the receivers
+static dcf_ctx_t dcf_rx[DCF_RX_CNT];
+static dcf_ctx_t * dcf_out = &dcf_rx[0];    // Context of the published datetime
+static bool dcf_enabled = true;             // Receivers powered on (see dcf_set_enabled)
+static int32_t dcf_stable_us = DCF_STABLE_MIN;  // Minimal stable time of the input level (deglitch)
+
+// Published state: written by dcf_poll, read by dcf_get_snapshot (sequence
+// lock: the sequence is odd while the state is written)
+static dcf_snap_t dcf_snap;
+static volatile uint32_t dcf_snap_seq = 0;
+
+#ifdef MULTICORE
+// The decoders run on core1, the control functions are called from core0
+static mutex_t dcf_mutex;
+#endif
+
+// Value fields of the telegram (BCD coded, flags bit coded)
+static const dcf_tg_field_t tg_val[dcf_val_cnt] = {
+    { 21, 7 },  // dcf_val_min
+    { 29, 6 },  // dcf_val_hour
+    { 36, 6 },  // dcf_val_day
+    { 42, 3 },  // dcf_val_dotw
+    { 45, 5 },  // dcf_val_month
+    { 50, 8 },  // dcf_val_year
+    { 15, 5 }   // dcf_val_flags
+};
+
+// Parity groups of the telegram (data bits followed by the even parity bit)
+static const dcf_tg_field_t tg_par[dcf_field_cnt] = {
+    { 21, 8 },  // dcf_field_min:  21..27 + 28
+    { 29, 7 },  // dcf_field_hour: 29..34 + 35
+    { 36, 23 }  // dcf_field_date: 36..57 + 58
+};
+
+// Calibration of the signal quality: probability [%] of a good telegram within
+// DCF_Q_HORIZON minutes for the raw score 0, 10, .., 100 (linear in between).
+// Fitted with the synthetic scenarios (dcf_gen) over the impairment levels.
+static const uint8_t q_calib[11] = { 0, 0, 0, 0, 2, 6, 21, 75, 99, 99, 100 };
 
-static dcf_bit_t pulse;     // Currently analized pulse
-static dcf_bit_t bit_s;     // Last detected valid bit
-static dcf_bit_t bit_c;     // Copy of the last detected valid bit
+/***************************************************************************//**
+* @brief Reset the software PLL (lost lock), start a new lock acquisition
+* @param ctx [in/out] decoder context
+*******************************************************************************/
+static void pll_reset(dcf_ctx_t * ctx)
+{
+    ctx->pll_locked = false;
+    ctx->pll_period = DCF_T_1SEC;
+    ctx->pll_hits = 0;
+    ctx->pll_miss = 0;
+    ctx->pll_sec = -1;
+    ctx->pll_leap = false;
+    ctx->rx_valid = false;
+    ctx->hist_cnt = 0;
+    ctx->dt_last_pred = false;
+    ctx->dt_pend_valid = false;
+}
+
+/***************************************************************************//**
+* @brief Start measuring the time-to-sync (if not already started)
+* @param ctx [in/out] decoder context
+* @param sys_ustime [in] system time in us
+*******************************************************************************/
+static void sync_time_start(dcf_ctx_t * ctx, const ustime_t sys_ustime)
+{
+    if(!ctx->sync_pending)
+    {
+        ctx->sync_pending = true;
+        ctx->sync_start = sys_ustime;
+    }
+}
 
-static bool sync_detected = false;  // Set when a new sync condiftion detected
-static bool sync_valid = false;     // Set indicates the sync is valid
-static ustime_t sync_time;          // Time in us when last sync was detected
+/***************************************************************************//**
+* @brief Reset the decoder: PLL, received minutes, decoded datetime and the
+*        learned bit classification (start from scratch, e.g. for a replay).
+* @param ctx [in/out] decoder context
+* @param sys_ustime [in] system time in us
+*******************************************************************************/
+static void dcf_reset(dcf_ctx_t * ctx, const ustime_t sys_ustime)
+{
+    ctx->pin_old = false;
+    ctx->dg_pending = false;
+    DCF_CLEAR_BIT(ctx->pulse);
+    pll_reset(ctx);
+    ctx->rx_ready = false;
+    ctx->dt_publish = false;
+    ctx->dt_last_valid = false;
+    cls_reset(ctx);
+
+    ctx->sync_pending = false;
+    ctx->sync_time_s = -1;
+    sync_time_start(ctx, sys_ustime);
+}
 
-static int8_t rx_bits_val[60];  // Received bits values
-static int    rx_bits_len[60];  // Received bits length
+/***************************************************************************//**
+* @brief Clear the statistics of a decoder context
+* @param ctx [in/out] decoder context
+*******************************************************************************/
+static void stats_clear(dcf_ctx_t * ctx)
+{
+    memset(&ctx->stats, 0, sizeof(ctx->stats));
+    ctx->stats.good_hour_last = -1;
+    ctx->stats.last_ok_age = UINT32_MAX;
+}
 
-// Variables used to store valid time/date
-static datetime_t dt_last;              // Last detected datetime
-static bool dt_last_valid = false;      // Flag indicates last detected datetime is valid
-static int cnt_dt_valid = 0;            // Counter for consecutive valid datatimes
+/***************************************************************************//**
+* @brief Init a decoder context: capture the input pin of the receiver
+* @param ctx [out] decoder context
+* @param rx [in] index of the receiver (capture channel 0..DCF_CAP_CH_CNT-1)
+* @param pin [in] index of the pin where the receiver is connected
+*******************************************************************************/
+void dcf_ctx_init(dcf_ctx_t * ctx, const unsigned int rx, const unsigned int pin)
+{
+    memset(ctx, 0, sizeof(dcf_ctx_t));
+    ctx->rx = rx;
+    ctx->edge_src = dcf_src_cap;
+    ctx->peer = NULL;
+
+    dcf_cap_init(rx, pin);
+    dcf_reset(ctx, ustime_now());
+    ctx->pin_old = !dcf_cap_get_level(rx);
+    stats_clear(ctx);
+
+    ema_int_init(&ctx->q_phase, DCF_Q_PHASE_SHIFT);
+    ema_int_init(&ctx->q_margin, DCF_Q_MARGIN_SHIFT);
+    ema_int_init(&ctx->q_decode, DCF_Q_DECODE_SHIFT);
+}
 
-// Variables used to measure signal quality
-static int q_good_cnt = 0;  // Count of good detected pulses
-static int q_bad_cnt = 0;   // Count of bad pulses
-static ustime_t q_time;     // Time in us for statistics period
-static int q_filter_buff[DCF_Q_FILTER];
-static m_filter_int_t q_filter;
-static int q_quality = 0;   // Quality value in %, 0%-bad signal, 100%-good signal
+/***************************************************************************//**
+* @brief Combine the minutes received by the peer receiver with the minutes of
+*        the decoder context (diversity): the soft values of both receivers
+*        are summed up before the telegram is decoded.
+* @param ctx [in/out] decoder context
+* @param peer [in] decoder context of the peer receiver, NULL: no combination
+*******************************************************************************/
+void dcf_ctx_set_peer(dcf_ctx_t * ctx, const dcf_ctx_t * peer)
+{
+    ctx->peer = peer;
+}
 
 /***************************************************************************//**
-* @brief Init DCF77 Module. Must be called in main in init phase
+* @brief Init DCF77 Module. Must be called in main in init phase.
+*        With DCF_DUAL the first receiver combines the minutes of the second
+*        receiver, the second receiver is decoded alone (fallback).
 *******************************************************************************/
 void dcf_init(void)
 {
-    gpio_init(DCF_IN_PIN);
-    gpio_set_dir(DCF_IN_PIN, GPIO_IN);
-    gpio_set_pulls(DCF_IN_PIN, /*pull-up*/ false, /*pull-down*/ false);
+#ifdef MULTICORE
+    mutex_init(&dcf_mutex);
+#endif
+    memset(&dcf_snap, 0, sizeof(dcf_snap));
+    dcf_ctx_init(&dcf_rx[0], 0, DCF_IN_PIN);
+#ifdef DCF_DUAL
+    dcf_ctx_init(&dcf_rx[1], 1, DCF_IN2_PIN);
+    dcf_ctx_set_peer(&dcf_rx[0], &dcf_rx[1]);
+#endif
+    dcf_out = &dcf_rx[0];
+}
 
-    DCF_CLEAR_BIT(pulse);
-    DCF_CLEAR_BIT(bit_s);
-    DCF_CLEAR_BIT(bit_c);
+/***************************************************************************//**
+* @brief Publish the pending decoded datetime. Called at the tick of second 0,
+*        when the minute described by the telegram begins.
+* @param ctx [in/out] decoder context
+* @param tick_time [in] time in us of the second-0 tick
+*******************************************************************************/
+static void dt_publish_pending(dcf_ctx_t * ctx, const ustime_t tick_time)
+{
+    datetime_copy(&ctx->dt_last, &ctx->dt_pend);
+    ctx->dt_last_flags = ctx->dt_pend_flags;
+    ctx->dt_last_ustime = tick_time;
+    ctx->dt_last_valid = true;
+    ctx->dt_last_pred = true;
+    ctx->dt_last_min = ctx->rx_min_cnt;
+    ctx->dt_pend_valid = false;
+    ctx->dt_publish = true;
+
+#ifdef DCF_BENCH
+    // Not captured edges: print the datetime, check the synthetic one
+    if(ctx->edge_src != dcf_src_cap)
+    {
+        bool ok = true;
+        if(ctx->edge_src == dcf_src_gen)
+        {
+            ok = datetime_is_equal(&ctx->dt_last, dcf_gen_get_datetime(&ctx->gen));
+            if(ok)
+                ctx->stats.check_ok++;
+            else
+                ctx->stats.check_false++;
+        }
+        io_printf("dcf77 sim %u: ", ctx->rx);
+        DATETIME_PRINTF_TIME(io_printf, "", ctx->dt_last, "  ");
+        DATETIME_PRINTF_DATE(io_printf, "", ctx->dt_last, "");
+        io_puts(ok ? "\r\n" : " FALSE\r\n");
+    }
+#endif
 
-    m_filter_int_init(&q_filter, q_filter_buff, DCF_Q_FILTER);
+    if(ctx->sync_pending)
+    {
+        ctx->sync_pending = false;
+        ctx->sync_time_s = (int32_t)(get_diff_ustime(tick_time, ctx->sync_start) / DCF_T_1SEC);
+        DCF_LOG("time-to-sync=%lis\r\n", (long) ctx->sync_time_s);
+    }
 }
 
 /***************************************************************************//**
-* @brief Analyze input signal. Check if the pulse is a valid bit (0 or 1) or 
-*        if a sync condition occurs.
-*        The function must be called when the input signal state has changed.
-* @param sys_ustime [in] System time in us
-* @param pin_val [in] the input signal state
+* @brief Statistics of a completely received minute: count the received bits,
+*        check the parity of the fields of this single minute (hard decision,
+*        sign of the soft values).
+* @param ctx [in/out] decoder context
 *******************************************************************************/
-static void analyze_pulse(const ustime_t sys_ustime, bool pin_val)
+static void stats_minute(dcf_ctx_t * ctx)
 {
-    if(pin_val)
+    int cnt = 0;
+
+    for(int i = 0; i < 60; i++)
     {
-        // Pulse start ___|---
+        if(ctx->rx_soft[i] != 0)
+            cnt++;
+    }
+    ctx->stats.bits_last = (uint8_t) cnt;
+    ctx->stats.bits_sum += cnt;
+    ctx->stats.minutes++;
 
-        // Detect sync (if the falling edge was detected)
-        if((pulse.edge & DCF_EDGE_FALLING) != 0)
+    for(int f = 0; f < dcf_field_cnt; f++)
+    {
+        const int par_idx = tg_par[f].start + tg_par[f].cnt - 1;
+        int parity = 0;
+        int i;
+        for(i = tg_par[f].start; i <= par_idx; i++)
         {
-            ustime_t len = get_diff_ustime(sys_ustime, pulse.end);
-            if(len > DCF_SYNC_MIN)
-            {
-                sync_detected = true;
-                sync_time = sys_ustime;
-                DCF_LOG("sync\r\n");
-                //TP_TGL(LOG_CH6);
-            }
+            if(ctx->rx_soft[i] == 0)
+                break;
+            parity ^= (ctx->rx_soft[i] > 0);
         }
+        if(i <= par_idx)
+            ctx->stats.par_miss[f]++;
+        else if(parity)
+            ctx->stats.par_err[f]++;
+    }
+}
 
-        DCF_CLEAR_BIT(pulse);
-        pulse.edge = DCF_EDGE_RAISING;
-        pulse.start = sys_ustime;
+/***************************************************************************//**
+* @brief Statistics of a good (accepted) telegram: count the bits of the newest
+*        minute (of this receiver) which differ from the decoded telegram (bit
+*        error rate) and the
+*        good telegrams per hour of the day.
+* @param ctx [in/out] decoder context
+* @param dt_ptr [in] decoded datetime
+*******************************************************************************/
+static void stats_good(dcf_ctx_t * ctx, const datetime_t * dt_ptr)
+{
+    for(int i = 0; i < 59; i++)
+    {
+        if((ctx->rx_last[i] == 0) || !((ctx->rx_tg_def >> i) & 1))
+            continue;
+        ctx->stats.ber_bits++;
+        if((ctx->rx_last[i] > 0) != ((ctx->rx_tg_val >> i) & 1))
+            ctx->stats.ber_err++;
     }
-    else {
-        // Pulse end ---|___
-        pulse.edge |= DCF_EDGE_FALLING;
-        pulse.end = sys_ustime;
-        ustime_t len = get_diff_ustime(pulse.end, pulse.start);
-        pulse.len = len;
-
-        // Both edges detected? ___|---|___
-        if(pulse.edge == (DCF_EDGE_RAISING | DCF_EDGE_FALLING))
-        {
-            if((len > DCF_BIT0_MIN) && (len < DCF_BIT0_MAX))
-            {
-                pulse.val = dcf_bitval_false;
-            }
-            else if((len > DCF_BIT1_MIN) && (len < DCF_BIT1_MAX))
-            {
-                pulse.val = dcf_bitval_true;
-            }
-            else if(len > DCF_BIT1_MAX)
-            {
-                sync_valid = false;   
-            }
 
-            // Valid bit detected, copy it
-            if(pulse.val != dcf_bitval_none)
-            {
-                DCF_COPY_BIT(bit_s, pulse);
-                DCF_COPY_BIT(bit_c, pulse);
-                q_good_cnt++;
-            }
-            else {
-                // Not a valid bit, restore last valid detected bit as pulse
-                // this will help to detect new sync
-                DCF_COPY_BIT(pulse, bit_c);
-                q_bad_cnt++;
-            }
+    // New hour? Clear the hours since the last good telegram (no telegrams)
+    int hour = dt_ptr->hour;
+    if(hour != ctx->stats.good_hour_last)
+    {
+        int h = (ctx->stats.good_hour_last < 0) ? hour : ((ctx->stats.good_hour_last + 1) % 24);
+        for(;;)
+        {
+            ctx->stats.good_hour[h] = 0;
+            if(h == hour)
+                break;
+            h = (h + 1) % 24;
         }
+        ctx->stats.good_hour_last = (int8_t) hour;
     }
+    ctx->stats.good_hour[hour]++;
+    ctx->stats.last_ok_age = 0;
 }
 
 /***************************************************************************//**
-* @brief Store bit_s (if valid) in the buffer of received bits
+* @brief Process a second tick of the locked PLL. Advance the second index and
+*        detect the minute marker (the tick of the second 59 has no pulse).
+*        In the minute with an announced leap second (A2 set, last minute of
+*        the hour) the second 59 has a 0-bit and the marker is the second 60.
+* @param ctx [in/out] decoder context
+* @param tick_time [in] time in us of the tick (measured or predicted)
+* @param hit [in] true if a pulse started at this tick, false if the tick is missing
 *******************************************************************************/
-static void store_bit_s(void)
+static void pll_tick_event(dcf_ctx_t * ctx, const ustime_t tick_time, const bool hit)
 {
-    ustime_t del_time;
-    int32_t bit_idx;
-    int32_t rest;
+    ctx->pll_tick = tick_time;
+
+    if(hit)
+    {
+        ctx->pll_miss = 0;
+    }
+    else if(++ctx->pll_miss > DCF_PLL_MISS_MAX)
+    {
+        DCF_LOG("pll unlock\r\n");
+        ctx->stats.sync_loss++;
+        pll_reset(ctx);
+        sync_time_start(ctx, tick_time);
+        return;
+    }
 
-    // Calculate bit index based on delay between sync and detected bit
-    del_time = get_diff_ustime(bit_s.start, sync_time);
-    
-    bit_idx = (int32_t) del_time / DCF_T_1SEC;
-    rest = ((int32_t) del_time) - (bit_idx * DCF_T_1SEC);
-    if(rest > 500000L)
-        bit_idx++;
+    // Second not known? A missing tick is the minute marker candidate
+    if(ctx->pll_sec < 0)
+    {
+        if(!hit)
+            ctx->pll_sec = 59;
+        return;
+    }
 
-    DCF_LOG("%5i | %2i | %3i | %i \r\n", del_time / 1000L, bit_idx, bit_s.len / 1000L, (bit_s.val < 0) ? 0 : 1);
+    const int sec_marker = ctx->pll_leap ? 60 : 59;
+    ctx->pll_sec = (ctx->pll_sec >= sec_marker) ? 0 : (ctx->pll_sec + 1);
 
-    if((bit_idx >= 0L) && (bit_idx < sizeof(rx_bits_val)))
+    // Missing tick (not the minute marker): phase score 0
+    if(!hit && (ctx->pll_sec != sec_marker))
+        ema_int_add_val(&ctx->q_phase, 0);
+    if(ctx->pll_sec == 0)
     {
-        // Bit already has a value? Keep the old value only if the new bit is shorter
-        if((rx_bits_val[bit_idx] != 0) && ((rx_bits_len[bit_idx] > bit_s.len)))
-            return;
+        // The minute of the decoded telegram begins now
+        if(ctx->dt_pend_valid)
+            dt_publish_pending(ctx, tick_time);
+
+        // Leap second at the end of this minute? Predicted from the last
+        // telegram (announced within the last hour)
+        ctx->pll_leap = false;
+        if(ctx->dt_last_pred && (ctx->dt_last_flags & DCF_FLAG_A2))
+        {
+            uint32_t age = ctx->rx_min_cnt - ctx->dt_last_min;
+            ctx->pll_leap = (age < 60) && (((ctx->dt_last.min + (int) age) % 60) == 59);
+            if(ctx->pll_leap)
+                DCF_LOG("leap second expected\r\n");
+        }
 
-        rx_bits_val[bit_idx] = bit_s.val;
-        rx_bits_len[bit_idx] = bit_s.len;
+        // Start receiving a new minute
+        memset(ctx->rx_soft, 0, sizeof(ctx->rx_soft));
+        ctx->rx_valid = true;
+    }
+    else if(ctx->pll_sec == sec_marker)
+    {
+        // There must be no pulse at the marker, the alignment is wrong
+        if(hit)
+        {
+            DCF_LOG("pulse at sec %i, realign\r\n", ctx->pll_sec);
+            ctx->stats.realign++;
+            ctx->pll_sec = -1;
+            ctx->pll_leap = false;
+            ctx->rx_valid = false;
+            ctx->hist_cnt = 0;
+            ctx->dt_last_pred = false;
+            ctx->dt_pend_valid = false;
+            return;
+        }
+        // Minute completely received, store it in history and
+        // interpret it in the next cycle (combined with the peer)
+        if(ctx->rx_valid)
+        {
+            memcpy(ctx->rx_last, ctx->rx_soft, sizeof(ctx->rx_soft));
+            ctx->rx_last_tick = tick_time;
+            ctx->hist_idx = (ctx->hist_idx + 1) % DCF_SOFT_MINUTES;
+            for(int i = 0; i < 60; i++)
+                ctx->hist_soft[ctx->hist_idx][i] = ctx->rx_soft[i];
+            if(ctx->hist_cnt < DCF_SOFT_MINUTES)
+                ctx->hist_cnt++;
+            ctx->rx_min_cnt++;
+            ctx->rx_ready = true;
+            stats_minute(ctx);
+        }
+        ctx->rx_valid = false;
     }
 }
 
 /***************************************************************************//**
-* @brief Extract a cnt number of bits from received bits buffer (rx_bits) 
-*        starting from position start_idx and convert them to uint8 value  
-* @param ptr_out [out] pointer to uint8 where the extracted value is stored
-* @param start_idx [in] index of the start position to extract bits
-* @param end_idx [in] index of the end position to extract bits
-* @return true - uint8 successfully extracted or false in case the value 
-*         cannot be extracted (there are undefined bits)
+* @brief Analyze the start of a pulse. When the PLL is locked, accept the pulse
+*        only if it starts inside the window of the predicted second tick and
+*        use the phase error to correct the PLL phase and period.
+*        When not locked, try to acquire the lock: the pulse must start ~1 second
+*        after the previous pulse.
+* @param ctx [in/out] decoder context
+* @param sys_ustime [in] time in us when the pulse started
+* @return true if the pulse is accepted, false if it is a spurious pulse
 *******************************************************************************/
-static bool rx_bits_to_uint8(uint8_t * ptr_out, int start_idx, int end_idx)
+static bool analyze_pulse_start(dcf_ctx_t * ctx, const ustime_t sys_ustime)
 {
-    if((start_idx < 0) || (end_idx >= sizeof(rx_bits_val)))
-        return false;
+    ustime_t pred = ctx->pll_tick + (ustime_t) ctx->pll_period;
+    int32_t err = get_diff_ustime_signed(sys_ustime, pred);
 
-    uint8_t val = 0;
-    uint8_t mask = 1;
-    while(start_idx <= end_idx)
+    if(ctx->pll_locked)
     {
-        if(rx_bits_val[start_idx] == dcf_bitval_none)
+        if((err < -DCF_PLL_WINDOW) || (err > DCF_PLL_WINDOW))
+        {
+            DCF_LOG("spurious pulse (err=%li)\r\n", (long) err);
+            ema_int_add_val(&ctx->q_phase, 0);
             return false;
-        if(rx_bits_val[start_idx] == dcf_bitval_true)
-            val |= mask;
+        }
+        ema_int_add_val(&ctx->q_phase, (int)(100L - (((err < 0) ? -err : err) * 100L) / DCF_PLL_WINDOW));
+
+        // Correct period and phase with a fraction of the phase error
+        ctx->pll_period += err / DCF_PLL_KI_DIV;
+        if(ctx->pll_period > (DCF_T_1SEC + DCF_PLL_PERIOD_DEV))
+            ctx->pll_period = DCF_T_1SEC + DCF_PLL_PERIOD_DEV;
+        else if(ctx->pll_period < (DCF_T_1SEC - DCF_PLL_PERIOD_DEV))
+            ctx->pll_period = DCF_T_1SEC - DCF_PLL_PERIOD_DEV;
+
+        pll_tick_event(ctx, pred + (ustime_t)(err / DCF_PLL_KP_DIV), true);
+        return true;
+    }
+
+    // Lock acquisition
+    if((err >= -DCF_PLL_ACQ_WINDOW) && (err <= DCF_PLL_ACQ_WINDOW))
+        ctx->pll_hits++;
+    else
+        ctx->pll_hits = 0;
 
-        mask <<= 1;
-        start_idx++;
+    ctx->pll_tick = sys_ustime;
+    ctx->pll_period = DCF_T_1SEC;
+    if(ctx->pll_hits >= DCF_PLL_LOCK_CNT)
+    {
+        DCF_LOG("pll locked\r\n");
+        ctx->pll_locked = true;
+        ctx->pll_miss = 0;
+        ctx->pll_sec = -1;
     }
-    *ptr_out = val;
     return true;
 }
 
 /***************************************************************************//**
-* @brief Calculate the parity sum of a byte. The parity is calculated by counting
-*        the ones in a byte. Example: 0x49 -> parity=3, 0x50 -> parity=2
-* @param par_val [in] initial value of the parity sum (used when the parity over more
-*        than one byte must be calculated, otherwise must be 0)
-* @param val [in] input byte which parity sum must be calculated
-* @return return the parity sum = new_parity + par_val
+* @brief Reset the bit classification to the initial values
+* @param ctx [in/out] decoder context
+*******************************************************************************/
+static void cls_reset(dcf_ctx_t * ctx)
+{
+    memset(ctx->cls_hist, 0, sizeof(ctx->cls_hist));
+    ctx->cls_cnt = 0;
+    ctx->cls_changed = false;
+    ctx->cls_nom0 = DCF_BIT0_NOM;
+    ctx->cls_nom1 = DCF_BIT1_NOM;
+    ctx->cls_thr = DCF_BIT_THR;
+    ctx->cls_min0 = DCF_BIT0_MIN;
+    ctx->cls_max1 = DCF_BIT1_MAX;
+}
+
+/***************************************************************************//**
+* @brief Add the length of a pulse (started at a second tick) to the histogram.
+*        When the histogram is full, all bins are halved, so that the old
+*        pulses lose their weight (the classifier follows slow changes).
+* @param ctx [in/out] decoder context
+* @param len [in] pulse length in us
 *******************************************************************************/
-static int calc_parity(int par_sum, uint8_t val)
+static void cls_add(dcf_ctx_t * ctx, const ustime_t len)
 {
-    while(val > 0)
+    if((len < DCF_CLS_LEN_MIN) || (len >= DCF_CLS_LEN_MAX))
+        return;
+
+    if(ctx->cls_cnt >= DCF_CLS_MAX_CNT)
     {
-        if((val & 1) != 0)
-            par_sum++;
-        val >>= 1;
+        ctx->cls_cnt = 0;
+        for(int i = 0; i < DCF_CLS_BINS; i++)
+        {
+            ctx->cls_hist[i] >>= 1;
+            ctx->cls_cnt += ctx->cls_hist[i];
+        }
     }
-    return par_sum;
+
+    ctx->cls_hist[len / DCF_CLS_BIN]++;
+    ctx->cls_cnt++;
+    ctx->cls_changed = true;
 }
 
 /***************************************************************************//**
-* @brief Check if a parity sum (calculated using calc_parity) satisfies a given
-*        parity (defined as dcf_bitval_t)
-* @param par_val [in] parity sum, calculated using calc_parity
-* @param parity [in] parity (defined as dcf_bitval_t)
-* @return true - the parity sum satisfies the parity
-*         false - the parity sum doesn't satisfy the parity, 
-*                 or the parity is not defined
+* @brief Update the bit classification from the histogram. The pulses are split
+*        in two clusters (0-bits and 1-bits), the decision threshold is placed
+*        in the middle between the cluster means (iterated a few times, 2-means).
+*        The limits of valid bits are derived from the distance mean-threshold:
+*           min0 = nom0 - (thr - nom0)        (nominal: 50ms)
+*           max1 = nom1 + 3 * (nom1 - thr)    (nominal: 350ms)
+*        The result is discarded if it is outside the sane bounds.
+*        Called at second 0 (between two received minutes), if the threshold
+*        jumps the history of soft values (hist_soft) is cleared.
+* @param ctx [in/out] decoder context
 *******************************************************************************/
-static bool check_parity(int par_sum, dcf_bitval_t parity)
+static void cls_update(dcf_ctx_t * ctx)
 {
-    if((parity == dcf_bitval_true) && (par_sum & 1))
-        return true;
-    if((parity == dcf_bitval_false) && !(par_sum & 1))
-        return true;
+    if(!ctx->cls_changed || (ctx->cls_cnt < DCF_CLS_MIN_CNT))
+        return;
+    ctx->cls_changed = false;
+
+    // Initial threshold: middle between the 10% and 90% percentiles
+    // (independent from the actual threshold, which can be far off)
+    int32_t p10 = -1, p90 = -1;
+    int32_t acc = 0;
+    for(int i = 0; i < DCF_CLS_BINS; i++)
+    {
+        acc += ctx->cls_hist[i];
+        if((p10 < 0) && ((acc * 10) >= ctx->cls_cnt))
+            p10 = i;
+        if((p90 < 0) && ((acc * 10) >= (ctx->cls_cnt * 9)))
+            p90 = i;
+    }
 
-    return false;
+    int32_t thr = ((p10 + p90 + 1) * DCF_CLS_BIN) / 2;
+    int32_t nom0 = 0;
+    int32_t nom1 = 0;
+
+    for(int iter = 0; iter < 4; iter++)
+    {
+        int32_t sum0 = 0, sum1 = 0;
+        int32_t cnt0 = 0, cnt1 = 0;
+
+        for(int i = 0; i < DCF_CLS_BINS; i++)
+        {
+            int32_t center = (i * DCF_CLS_BIN) + (DCF_CLS_BIN / 2);
+            if(center < thr)
+            {
+                sum0 += (center / 1000L) * ctx->cls_hist[i];
+                cnt0 += ctx->cls_hist[i];
+            }
+            else {
+                sum1 += (center / 1000L) * ctx->cls_hist[i];
+                cnt1 += ctx->cls_hist[i];
+            }
+        }
+
+        // Both clusters must exist (every telegram has 0 and 1 bits)
+        if((cnt0 == 0) || (cnt1 == 0))
+            return;
+
+        nom0 = (sum0 * 1000L) / cnt0;
+        nom1 = (sum1 * 1000L) / cnt1;
+        thr = (nom0 + nom1) / 2;
+    }
+
+    if((thr < DCF_CLS_THR_MIN) || (thr > DCF_CLS_THR_MAX) || ((nom1 - nom0) < DCF_CLS_SEP_MIN))
+    {
+        DCF_LOG("classifier out of bounds (%li/%li/%li)\r\n", (long) nom0, (long) thr, (long) nom1);
+        return;
+    }
+
+    DCF_LOG("classifier: 0=%li thr=%li 1=%li\r\n", (long) nom0, (long) thr, (long) nom1);
+
+    // The soft values in history were calculated with a much different
+    // threshold, they would only disturb the new ones
+    if((thr > (ctx->cls_thr + DCF_CLS_THR_JUMP)) || (thr < (ctx->cls_thr - DCF_CLS_THR_JUMP)))
+        ctx->hist_cnt = 0;
+
+    ctx->cls_nom0 = nom0;
+    ctx->cls_nom1 = nom1;
+    ctx->cls_thr = thr;
+    ctx->cls_min0 = nom0 - (thr - nom0);
+    if(ctx->cls_min0 < DCF_CLS_LEN_MIN)
+        ctx->cls_min0 = DCF_CLS_LEN_MIN;
+    ctx->cls_max1 = nom1 + 3 * (nom1 - thr);
+    if(ctx->cls_max1 > DCF_CLS_LEN_MAX)
+        ctx->cls_max1 = DCF_CLS_LEN_MAX;
+}
+
+/***************************************************************************//**
+* @brief Calculate the soft value of a valid bit from the pulse length. 
+*        The soft value is the distance to the decision threshold, scaled to
+*        the distance between the threshold and the learned mean of the bit:
+*           cls_nom0 (~100ms) -> -DCF_SOFT_MAX ... cls_thr (~150ms) -> 0 ... 
+*           cls_nom1 (~200ms) -> +DCF_SOFT_MAX
+* @param ctx [in/out] decoder context
+* @param len [in] pulse length in us
+* @param val [in] bit value (hard decision) of the pulse
+* @return soft value -DCF_SOFT_MAX (sure 0-bit) ... +DCF_SOFT_MAX (sure 1-bit)
+*******************************************************************************/
+static int8_t bit_soft_val(dcf_ctx_t * ctx, const ustime_t len, const dcf_bitval_t val)
+{
+    int32_t dist = (int32_t) len - ctx->cls_thr;
+    int32_t soft;
+
+    if(dist < 0)
+        soft = (dist * DCF_SOFT_MAX) / (ctx->cls_thr - ctx->cls_nom0);
+    else
+        soft = (dist * DCF_SOFT_MAX) / (ctx->cls_nom1 - ctx->cls_thr);
+
+    if(soft > DCF_SOFT_MAX)
+        soft = DCF_SOFT_MAX;
+    else if(soft < -DCF_SOFT_MAX)
+        soft = -DCF_SOFT_MAX;
+
+    // Keep at least the sign of the hard decision
+    if(soft == 0)
+        soft = (int32_t) val;
+    return (int8_t) soft;
+}
+
+/***************************************************************************//**
+* @brief Width margin score of a valid pulse: the distance of the pulse width
+*        to the decision threshold and to the limit of its bit value, relative
+*        to the distance of the nominal width to the threshold.
+* @param ctx [in] decoder context
+* @param len [in] pulse length [us]
+* @param val [in] bit value of the pulse
+* @return margin score 0 (at threshold/limit)..100 (nominal width or better)
+*******************************************************************************/
+static int pulse_margin(const dcf_ctx_t * ctx, const ustime_t len, const dcf_bitval_t val)
+{
+    int32_t l = (int32_t) len;
+    int32_t dist, ref;
+
+    if(val == dcf_bitval_true)
+    {
+        dist = l - ctx->cls_thr;
+        if((ctx->cls_max1 - l) < dist)
+            dist = ctx->cls_max1 - l;
+        ref = ctx->cls_nom1 - ctx->cls_thr;
+    }
+    else {
+        dist = ctx->cls_thr - l;
+        if((l - ctx->cls_min0) < dist)
+            dist = l - ctx->cls_min0;
+        ref = ctx->cls_thr - ctx->cls_nom0;
+    }
+
+    if((dist <= 0) || (ref <= 0))
+        return 0;
+    if(dist >= ref)
+        return 100;
+    return (int)((dist * 100L) / ref);
+}
+
+/***************************************************************************//**
+* @brief Analyze input signal. Check if the pulse is a valid bit (0 or 1).
+*        The function must be called when the input signal state has changed.
+*        A pulse end is evaluated only for an accepted pulse start. A too short
+*        pulse (glitch) keeps the pulse open, the next falling edge ends it.
+* @param ctx [in/out] decoder context
+* @param sys_ustime [in] System time in us
+* @param pin_val [in] the input signal state
+*******************************************************************************/
+static void analyze_pulse(dcf_ctx_t * ctx, const ustime_t sys_ustime, bool pin_val)
+{
+    if(pin_val)
+    {
+        // Pulse start ___|---
+        if(!analyze_pulse_start(ctx, sys_ustime))
+        {
+            ctx->stats.pulse_spur++;
+            return;
+        }
+
+        DCF_CLEAR_BIT(ctx->pulse);
+        ctx->pulse.edge = DCF_EDGE_RAISING;
+        ctx->pulse.start = sys_ustime;
+        return;
+    }
+
+    // Pulse end ---|___ (only if there is an open accepted pulse)
+    if(ctx->pulse.edge != DCF_EDGE_RAISING)
+        return;
+
+    ustime_t len = get_diff_ustime(sys_ustime, ctx->pulse.start);
+    ctx->stats.pulse_hist[(len < (DCF_STAT_BIN * DCF_STAT_BINS)) ? (len / DCF_STAT_BIN) : DCF_STAT_BINS]++;
+    if((len > (ustime_t) ctx->cls_min0) && (len < (ustime_t) ctx->cls_thr))
+    {
+        ctx->pulse.val = dcf_bitval_false;
+    }
+    else if((len >= (ustime_t) ctx->cls_thr) && (len < (ustime_t) ctx->cls_max1))
+    {
+        ctx->pulse.val = dcf_bitval_true;
+    }
+    else
+    {
+        ema_int_add_val(&ctx->q_margin, 0);
+        // Too long pulse, close it. Too short pulse (glitch), keep it open.
+        if(len >= (ustime_t) ctx->cls_max1)
+        {
+            ctx->stats.pulse_long++;
+            ctx->pulse.edge |= DCF_EDGE_FALLING;
+            if(ctx->pll_locked)
+                cls_add(ctx, len);
+        }
+        else {
+            ctx->stats.pulse_short++;
+        }
+        return;
+    }
+
+    ctx->pulse.edge |= DCF_EDGE_FALLING;
+    ctx->pulse.end = sys_ustime;
+    ctx->pulse.len = len;
+    ctx->stats.pulse_ok++;
+    ema_int_add_val(&ctx->q_margin, pulse_margin(ctx, len, ctx->pulse.val));
+
+    // Learn the pulse lengths only from the pulses at the tracked second ticks
+    if(ctx->pll_locked)
+        cls_add(ctx, len);
+
+    // Store the bit at the actual second
+    if(ctx->pll_locked && ctx->rx_valid && (ctx->pll_sec >= 0) && (ctx->pll_sec < 60))
+    {
+        ctx->rx_soft[ctx->pll_sec] = bit_soft_val(ctx, len, ctx->pulse.val);
+        DCF_LOG("%2i | %3i | %4i \r\n", ctx->pll_sec, (int)(len / 1000UL), (int) ctx->rx_soft[ctx->pll_sec]);
+    }
+}
+
+/***************************************************************************//**
+* @brief Extract a value field from the combined telegram (rx_tg_val/rx_tg_def)
+* @param ctx [in/out] decoder context
+* @param ptr_out [out] pointer to uint8 where the extracted value is stored
+* @param f [in] field to extract (index in tg_val)
+* @return true - value successfully extracted or false in case the value
+*         cannot be extracted (there are undefined bits)
+*******************************************************************************/
+static bool tg_get_val(dcf_ctx_t * ctx, uint8_t * ptr_out, const dcf_val_t f)
+{
+    const uint64_t mask = DCF_TG_MASK(tg_val[f].start, tg_val[f].cnt);
+
+    if((ctx->rx_tg_def & mask) != mask)
+        return false;
+
+    *ptr_out = (uint8_t)((ctx->rx_tg_val & mask) >> tg_val[f].start);
+    return true;
+}
+
+/***************************************************************************//**
+* @brief Check the even parity of a parity group of the combined telegram
+*        (the ones of the data bits and of the parity bit must be even)
+* @param ctx [in/out] decoder context
+* @param f [in] parity group (index in tg_par)
+* @return true - all bits are defined and the parity is correct
+*         false - parity error or there are undefined bits
+*******************************************************************************/
+static bool tg_check_parity(dcf_ctx_t * ctx, const dcf_field_t f)
+{
+    const uint64_t mask = DCF_TG_MASK(tg_par[f].start, tg_par[f].cnt);
+
+    if((ctx->rx_tg_def & mask) != mask)
+        return false;
+
+    return !(__builtin_popcountll(ctx->rx_tg_val & mask) & 1);
 }
 
 /***************************************************************************//**
 * @brief Extract time from received DCF77 telegram
+* @param ctx [in/out] decoder context
 * @param ptr_datetime [out] pointer to datetime variable where extracted time is stored
 *        in case it contains a valid value
 * @return true - time successfully extracted and copied to ptr_datetime
 *         false - could not extract time, received DCF77 telegram has invalid time
 *******************************************************************************/
-static bool rx_bits_extract_time(datetime_t * ptr_datetime)
+static bool rx_bits_extract_time(dcf_ctx_t * ctx, datetime_t * ptr_datetime)
 {
     uint8_t val;
     datetime_t dt;
     dt.sec = 0;
 
     // Extract Minutes
-    if(rx_bits_val[28] == dcf_bitval_none)
-    {
-        DCF_LOG("Error: min parity[28] undefined\r\n");
-        return false;
-    }
-    if(!rx_bits_to_uint8(&val, 21, 27))
+    if(!tg_get_val(ctx, &val, dcf_val_min))
     {
         DCF_LOG("Error: min[21..27] undefined\r\n");
         return false;
     }
-    if(!check_parity(calc_parity(0, val), rx_bits_val[28]))
+    if(!tg_check_parity(ctx, dcf_field_min))
     {
-        DCF_LOG("Error: min parity value: %i\r\n", (int) rx_bits_val[28]);
+        DCF_LOG("Error: min parity[28]\r\n");
         return false;
     }
     dt.min = bcd_to_int8(val);
 
     // Extract hour
-    if(rx_bits_val[35] == dcf_bitval_none)
-    {
-        DCF_LOG("Error: hr parity[35] undefined\r\n");
-        return false;
-    }
-    if(!rx_bits_to_uint8(&val, 29, 34))
+    if(!tg_get_val(ctx, &val, dcf_val_hour))
     {
         DCF_LOG("Error: hr[29..34] undefined\r\n");
         return false;
     }
-    if(!check_parity(calc_parity(0, val), rx_bits_val[35]))
+    if(!tg_check_parity(ctx, dcf_field_hour))
     {
-        DCF_LOG("Error: hr parity value: %i\r\n", (int) rx_bits_val[35]);
+        DCF_LOG("Error: hr parity[35]\r\n");
         return false;
     }
     dt.hour = bcd_to_int8(val);
@@ -314,69 +841,43 @@ static bool rx_bits_extract_time(datetime_t * ptr_datetime)
 
 /***************************************************************************//**
 * @brief Extract date from received DCF77 telegram
+* @param ctx [in/out] decoder context
 * @param ptr_datetime [out] pointer to datetime variable where extracted date is stored
 *        in case it contains a valid value
 * @return true - date successfully extracted and copied to ptr_datetime
 *         false - could not extract date, received DCF77 telegram has invalid date
 *******************************************************************************/
-static bool rx_bits_extract_date(datetime_t * ptr_datetime)
+static bool rx_bits_extract_date(dcf_ctx_t * ctx, datetime_t * ptr_datetime)
 {
-    int parity = 0;
     uint8_t val;
     datetime_t dt;
 
-    if(rx_bits_val[58] == dcf_bitval_none)
+    if(!tg_check_parity(ctx, dcf_field_date))
     {
-        DCF_LOG("Error: date parity[58] undefined\r\n");
+        DCF_LOG("Error: date[36..58] undefined or parity\r\n");
         return false;
     }
 
     // Day of month
-    if(!rx_bits_to_uint8(&val, 36, 41))
-    {
-        DCF_LOG("Error: dd[36..41] undefined\r\n");
-        return false;
-    }
+    tg_get_val(ctx, &val, dcf_val_day);
     dt.day = bcd_to_int8(val);
-    parity = calc_parity(parity, val);
 
     // Day of week
-    if(!rx_bits_to_uint8(&val, 42, 44))
-    {
-        DCF_LOG("Error: day[42..22] undefined\r\n");
-        return false;
-    }
+    tg_get_val(ctx, &val, dcf_val_dotw);
     dt.dotw = bcd_to_int8(val);
     // Convert RTC (Mon=1... Sun=7) to datetime_t (Sun=0, Mon=1..Sat=6)
     if(dt.dotw == 7)
         dt.dotw = 0;
-    parity = calc_parity(parity, val);
 
     // Month
-    if(!rx_bits_to_uint8(&val, 45, 49))
-    {
-        DCF_LOG("Error: month[45..49] undefined\r\n");
-        return false;
-    }
+    tg_get_val(ctx, &val, dcf_val_month);
     dt.month = bcd_to_int8(val);
-    parity = calc_parity(parity, val);
 
     // Year
-    if(!rx_bits_to_uint8(&val, 50, 57))
-    {
-        DCF_LOG("Error: year[50..57] undefined\r\n");
-        return false;
-    }
+    tg_get_val(ctx, &val, dcf_val_year);
     dt.year = (int16_t) bcd_to_int8(val);
     dt.year += 2000;
-    parity = calc_parity(parity, val);
 
-    if(!check_parity(parity, rx_bits_val[58]))
-    {
-        DCF_LOG("Error: date parity value: %i\r\n", (int) rx_bits_val[58]);
-        return false;
-    }
-    
     if(!datetime_is_valid_date(&dt))
     {
         //DCF_LOG("Error: date invalid: %i.%i.%i (%i)\r\n", dt.day, dt.month, dt.year, dt.dotw);
@@ -391,196 +892,927 @@ static bool rx_bits_extract_date(datetime_t * ptr_datetime)
 }
 
 /***************************************************************************//**
-* @brief Interpret received data bits. Try to decode the information.
-*        Profiling: the function takes 96..216us with logs, 10..100us without logs.
-* @param sys_ustime [in] system time in us
-* @return true if dcf telegram successfully decoded and both time and date are
-*         considered valid.
+* @brief Extract the flags (bits 15..19) from received DCF77 telegram. Only the
+*        defined bits are set in the flags, a flag with undefined bit is cleared.
+* @param ctx [in/out] decoder context
+* @param ptr_flags [out] pointer where the extracted flags (DCF_FLAG_...) are stored
+* @return true - flags successfully extracted
+*         false - both time zone bits are defined but not exactly one is set
 *******************************************************************************/
-static bool interpret_rx_bits(const ustime_t sys_ustime)
+static bool rx_bits_extract_flags(dcf_ctx_t * ctx, uint8_t * ptr_flags)
 {
-    DCF_LOG("interpret_rx_bits\r\n");
+    const uint64_t mask = DCF_TG_MASK(tg_val[dcf_val_flags].start, tg_val[dcf_val_flags].cnt);
+    const uint8_t zone = DCF_FLAG_CEST | DCF_FLAG_CET;
+    uint8_t flags = (uint8_t)((ctx->rx_tg_val & ctx->rx_tg_def & mask) >> tg_val[dcf_val_flags].start);
+    uint8_t def = (uint8_t)((ctx->rx_tg_def & mask) >> tg_val[dcf_val_flags].start);
 
-    if(rx_bits_val[0] != dcf_bitval_false)
+    if(((def & zone) == zone) && ((flags & zone) != DCF_FLAG_CEST) && ((flags & zone) != DCF_FLAG_CET))
     {
-        DCF_LOG("Error: bit[0] != 0\r\n");
+        DCF_LOG("Error: time zone[17..18] invalid\r\n");
         return false;
     }
 
-    if(rx_bits_val[20] != dcf_bitval_true)
-    {
-        DCF_LOG("Error: bit[20] != 1\r\n");
-        return false;
-    }
+    *ptr_flags = flags;
+    DCF_LOG("flags=0x%02x\r\n", flags);
+    return true;
+}
 
-    datetime_t dt;
-    bool valid_time = rx_bits_extract_time(&dt);
-    if(valid_time)
-    {
-        // If the last datetime valid, check if the difference 
-        // between new and last time is ~1 minute (30 sec ... 90 sec)
-        if(dt_last_valid)
-        {
-            int diff = datetime_time_diff(&dt, &dt_last);
-            DCF_LOG("diff = %i\r\n", diff);
+/***************************************************************************//**
+* @brief Get the soft values of a minute from history
+* @param ctx [in] decoder context
+* @param k [in] age of the minute: 0 - newest, 1 - one minute before, ...
+* @return pointer to the soft values of the minute
+*******************************************************************************/
+static const int16_t * hist_get(const dcf_ctx_t * ctx, const int k)
+{
+    return ctx->hist_soft[(ctx->hist_idx + DCF_SOFT_MINUTES - k) % DCF_SOFT_MINUTES];
+}
 
-            if((diff < 30) || (diff > 90))
-            {
-                // Something went wrong, too big difference
-                // probably we lost a sync signal
-                cnt_dt_valid = 1;
-            }
-        }
-    }
+/***************************************************************************//**
+* @brief Score a BCD coded field (followed by its even parity bit) against the
+*        soft values of a received minute. The score is positive when the soft
+*        values agree with the encoded value.
+* @param soft [in] soft values of the received minute
+* @param val [in] value of the field to score
+* @param start_idx [in] index of the first bit of the field
+* @param cnt [in] count of bits of the field (without parity)
+* @return score of the value
+*******************************************************************************/
+static int soft_score_field(const int16_t * soft, const int val, const int start_idx, const int cnt)
+{
+    uint8_t bcd = int8_to_bcd((uint8_t) val);
+    int score = 0;
+    int parity = 0;
 
-    bool valid_date = rx_bits_extract_date(&dt);
-    if(valid_date)
+    for(int i = 0; i < cnt; i++)
     {
-        // If the last date is valid, check if it is the same
-        // like the new date. If yes increment validity counter
-        if(dt_last_valid)
+        if((bcd >> i) & 1)
         {
-            if(datetime_date_compare(&dt, &dt_last) != 0)
-            {
-                // Something went wrong, there is a date difference
-                // probably day change
-                cnt_dt_valid = 1;
-            }
+            score += soft[start_idx + i];
+            parity ^= 1;
         }
-    }
-
-    dt_last_valid = (valid_time && valid_date);
-    if(dt_last_valid)
-    {
-        datetime_copy(&dt_last, &dt);
-        if(cnt_dt_valid < INT_MAX)
-            cnt_dt_valid++;
-        if(cnt_dt_valid >= DCF_VALID_DATETIME_CNT)
-        {
-            DCF_LOG("confirmed valid datetime (cnt=%i)\r\n", cnt_dt_valid);
+        else {
+            score -= soft[start_idx + i];
         }
     }
-    else {
-        cnt_dt_valid = 0;
-    }
-
-    return (dt_last_valid && (cnt_dt_valid >= DCF_VALID_DATETIME_CNT));
+    score += parity ? soft[start_idx + cnt] : -soft[start_idx + cnt];
+    return score;
 }
 
 /***************************************************************************//**
-* @brief DCF77 polling function. Must be called every program cycle
-* @param sys_ustime [in] System time in us
-* @return true if dcf telegram successfully decoded and both time and date are
-*         considered valid.
+* @brief Set the bits of a BCD coded field (followed by its even parity bit)
+*        in the combined telegram
+* @param ctx [in/out] decoder context
+* @param val [in] value of the field
+* @param start_idx [in] index of the first bit of the field
+* @param cnt [in] count of bits of the field (without parity)
+* @param defined [in] true - set the bits, false - set the bits as undefined
 *******************************************************************************/
-bool dcf_poll(const ustime_t sys_ustime)
+static void rx_bits_set_field(dcf_ctx_t * ctx, const int val, const int start_idx, const int cnt, const bool defined)
 {
-    bool pin_val = !gpio_get(DCF_IN_PIN);
+    uint8_t bcd = int8_to_bcd((uint8_t) val);
+    const uint64_t mask = DCF_TG_MASK(start_idx, cnt + 1);
 
-    // Input signal state changed? Analyze it
-    if(pin_val != pin_old)
-    {
-        analyze_pulse(sys_ustime, pin_val);
+    uint64_t bits = (uint64_t)(bcd & ((1U << cnt) - 1U));
+    bits |= (uint64_t)(__builtin_popcount(bits) & 1) << cnt;
 
-        pin_old = pin_val;
+    ctx->rx_tg_val &= ~mask;
+    ctx->rx_tg_def &= ~mask;
+    if(defined)
+    {
+        ctx->rx_tg_val |= bits << start_idx;
+        ctx->rx_tg_def |= mask;
+    }
+}
+
+/***************************************************************************//**
+* @brief Score a candidate hour of the newest minute against the minutes in
+*        history. The minutes older than the first minute of the hour (age > min)
+*        are shifted by the time zone change (if any).
+* @param ctx [in/out] decoder context
+* @param score [out] array where the scores of the 24 candidate hours are stored
+* @param min [in] minute of the newest telegram
+* @param jump [in] change of the time zone: 0 none, +1 CET->CEST, -1 CEST->CET
+*******************************************************************************/
+static void soft_score_hours(dcf_ctx_t * ctx, int * score, const int min, const int jump)
+{
+    for(int hour = 0; hour < 24; hour++)
+    {
+        score[hour] = 0;
+        for(int k = 0; k < ctx->hist_cnt; k++)
+        {
+            int day_min = (hour * 60) + min - k;
+            if(k > min)
+                day_min -= jump * 60;
+            if(day_min < 0)
+                day_min += 24 * 60;
+            score[hour] += soft_score_field(hist_get(ctx, k), (day_min / 60) % 24, 29, 6);
+        }
+    }
+}
+
+/***************************************************************************//**
+* @brief Score the time zone bits (17: CEST, 18: CET) of the minutes in history
+*        against a change of the time zone at the first minute of the hour
+* @param ctx [in/out] decoder context
+* @param min [in] minute of the newest telegram
+* @param jump [in] change of the time zone: 0 none, +1 CET->CEST, -1 CEST->CET
+* @return score of the time zone bits
+*******************************************************************************/
+static int soft_score_zone(dcf_ctx_t * ctx, const int min, const int jump)
+{
+    int before = 0;     // CEST score of the minutes before the change
+    int after = 0;      // CEST score of the minutes after the change
+
+    for(int k = 0; k < ctx->hist_cnt; k++)
+    {
+        int z = hist_get(ctx, k)[17] - hist_get(ctx, k)[18];
+        if(k > min)
+            before += z;
+        else
+            after += z;
+    }
+
+    if(jump == 0)
+        return abs(before + after);
+    return (jump > 0) ? (after - before) : (before - after);
+}
+
+/***************************************************************************//**
+* @brief Find the best candidate value of a field
+* @param score [in] array with scores of all candidate values
+* @param cnt [in] count of candidate values
+* @param best_ptr [out] best candidate value
+* @return confidence of the best value: (best - second best score) / 4,
+*         the minimal distance between two candidates is 2 bits (value + parity),
+*         so that one clean minute gives a confidence of DCF_SOFT_MAX
+*******************************************************************************/
+static int soft_best(const int * score, const int cnt, int * best_ptr)
+{
+    int best = 0;
+    int second = INT_MIN;
+
+    for(int i = 1; i < cnt; i++)
+    {
+        if(score[i] > score[best])
+        {
+            second = score[best];
+            best = i;
+        }
+        else if(score[i] > second)
+        {
+            second = score[i];
+        }
+    }
+    *best_ptr = best;
+    return (score[best] - second) / 4;
+}
+
+/***************************************************************************//**
+* @brief Combine the soft values of the minutes in history into one telegram
+*        (rx_tg_val/rx_tg_def) of the newest minute. The bits are defined only if their
+*        confidence reaches conf_req.
+*           Minute, hour: the values advance predictably, every candidate value
+*               is scored against all minutes in history (shifted by the age
+*               of the minute) and the best candidate is taken.
+*           Time zone change: if announced (A1) in the minutes before the
+*               first minute of the hour, the hour is also scored with the
+*               older minutes shifted by -1h/+1h, the hypothesis with the best
+*               score (hour and time zone bits) is taken.
+*           Date: the values don't change over the day, the soft values of
+*               the minutes of the same day are summed up.
+*           Bit 0, flags 15..20: the soft values of all minutes are summed up.
+*           Bits 1..14 (weather info) are not used.
+* @param ctx [in/out] decoder context
+* @param conf_req [in] minimal confidence of a defined bit
+* @return the minimal confidence of the combined fields
+*******************************************************************************/
+static int soft_combine(dcf_ctx_t * ctx, const int conf_req)
+{
+    int score[60];
+    int conf, conf_min;
+    int min, hour, k, i;
+    int jump = 0;
+
+    ctx->rx_tg_val = 0;
+    ctx->rx_tg_def = 0;
+
+    // Minute: candidate value of the newest minute, older minutes are (min - k)
+    for(min = 0; min < 60; min++)
+    {
+        score[min] = 0;
+        for(k = 0; k < ctx->hist_cnt; k++)
+            score[min] += soft_score_field(hist_get(ctx, k), (min + 60 - (k % 60)) % 60, 21, 7);
+    }
+    conf = soft_best(score, 60, &min);
+    rx_bits_set_field(ctx, min, 21, 7, (conf >= conf_req));
+    conf_min = conf;
+
+    // Hour: candidate value of the newest minute, older minutes can belong to
+    // the previous hour (based on the best candidate minute)
+    soft_score_hours(ctx, score, min, 0);
+    conf = soft_best(score, 24, &hour);
+
+    // Announced time zone change: the minutes before the first minute of the
+    // hour have the announcement bit A1 set
+    int a1 = 0;
+    for(k = min + 1; k < ctx->hist_cnt; k++)
+        a1 += hist_get(ctx, k)[16];
+    if(a1 > 0)
+    {
+        int best = score[hour] + soft_score_zone(ctx, min, 0);
+        for(int j = -1; j <= 1; j += 2)
+        {
+            int score_j[24];
+            int hour_j;
+            soft_score_hours(ctx, score_j, min, j);
+            int conf_j = soft_best(score_j, 24, &hour_j);
+            if((score_j[hour_j] + soft_score_zone(ctx, min, j)) > best)
+            {
+                best = score_j[hour_j] + soft_score_zone(ctx, min, j);
+                hour = hour_j;
+                conf = conf_j;
+                jump = j;
+            }
+        }
+        if(jump != 0)
+            DCF_LOG("time zone change %+i\r\n", jump);
+    }
+    rx_bits_set_field(ctx, hour, 29, 6, (conf >= conf_req));
+    if(conf < conf_min)
+        conf_min = conf;
+
+    // Date: only the minutes of the same day (the minutes after midnight)
+    for(i = 36; i <= 58; i++)
+    {
+        int sum = 0;
+        for(k = 0; (k < ctx->hist_cnt) && (k <= ((hour * 60) + min)); k++)
+            sum += hist_get(ctx, k)[i];
+        score[i] = sum;
+    }
+
+    // Bit 0 and flags: all minutes, A1 and time zone only the minutes after
+    // the time zone change
+    for(i = 0; i <= 20; i++)
+    {
+        int sum = 0;
+        if((i == 0) || (i >= 15))
+        {
+            int k_max = ((jump != 0) && (i >= 16) && (i <= 18)) ? (min + 1) : ctx->hist_cnt;
+            for(k = 0; k < k_max; k++)
+                sum += hist_get(ctx, k)[i];
+        }
+        score[i] = sum;
+    }
+
+    for(i = 0; i <= 58; i++)
+    {
+        if((i > 0) && (i < 15))
+            continue;
+        if((i >= 21) && (i <= 35))
+            continue;
+
+        if(score[i] >= conf_req)
+            ctx->rx_tg_val |= (1ULL << i);
+        if(abs(score[i]) >= conf_req)
+            ctx->rx_tg_def |= (1ULL << i);
+
+        // The weakest date bit defines the confidence of the date
+        if((i >= 36) && (abs(score[i]) < conf_min))
+            conf_min = abs(score[i]);
+    }
+
+    return conf_min;
+}
+
+/***************************************************************************//**
+* @brief Check if the decoded datetime matches a prediction. A time zone change
+*        announced by the previous telegram (A1) is applied to its prediction.
+* @param ctx [in/out] decoder context
+* @param dt_ptr [in] decoded datetime (start of the minute)
+* @param flags [in] decoded flags (DCF_FLAG_...)
+* @param start_ustime [in] system time in us of the start of the minute
+* @return true if the decoded datetime matches the prediction from the previous
+*         telegram or from the reference datetime
+*******************************************************************************/
+static bool dt_match_prediction(dcf_ctx_t * ctx, const datetime_t * dt_ptr, const uint8_t flags, const ustime_t start_ustime)
+{
+    const uint8_t zone = DCF_FLAG_CEST | DCF_FLAG_CET;
+    datetime_t pred;
+
+    // Previous telegram: advanced by the count of received minutes
+    if(ctx->dt_last_pred)
+    {
+        int sec = (int)(ctx->rx_min_cnt - ctx->dt_last_min) * 60;
+        if((ctx->dt_last_flags & DCF_FLAG_A1) && (ctx->dt_last_flags & zone) && (flags & zone)
+            && ((ctx->dt_last_flags ^ flags) & zone))
+        {
+            sec += (flags & DCF_FLAG_CEST) ? 3600 : -3600;
+            DCF_LOG("announced time zone change\r\n");
+        }
+
+        datetime_copy(&pred, &ctx->dt_last);
+        datetime_add_sec(&pred, sec);
+        if(datetime_is_equal(&pred, dt_ptr))
+        {
+            DCF_LOG("matches previous telegram\r\n");
+            return true;
+        }
+    }
+
+    // Reference datetime: advanced by the time elapsed since it was valid
+    // (not related to the replayed or synthetic edges)
+    if(ctx->ref_valid && (ctx->edge_src == dcf_src_cap))
+    {
+        int32_t elapsed_us = get_diff_ustime_signed(start_ustime, ctx->ref_ustime);
+        if((elapsed_us < 0) || (elapsed_us > (DCF_PRED_REF_MAX_S * DCF_T_1SEC)))
+            return false;
+
+        int diff = (int)(datetime_diff(dt_ptr, &ctx->ref_dt) - ((elapsed_us + (DCF_T_1SEC / 2)) / DCF_T_1SEC));
+        if((diff >= -DCF_PRED_TOL_S) && (diff <= DCF_PRED_TOL_S))
+        {
+            DCF_LOG("matches reference (diff=%is)\r\n", diff);
+            return true;
+        }
+    }
+    return false;
+}
+
+/***************************************************************************//**
+* @brief Interpret received data bits. Combine the received minutes and try 
+*        to decode the information.
+*        If a prediction is available (previous telegram or reference datetime)
+*        a telegram matching it is accepted with the lower confidence
+*        DCF_PRED_CONF, otherwise all fields must reach DCF_SOFT_CONF.
+*        Profiling: the function takes 96..216us with logs, 10..100us without logs.
+*        The decoded datetime is held (dt_pend) and published at the second-0
+*        tick, when the described minute begins.
+* @param ctx [in/out] decoder context
+* @param sys_ustime [in] system time in us
+* @return true if dcf telegram successfully decoded and both time and date are
+*         considered valid.
+*******************************************************************************/
+static bool interpret_rx_bits(dcf_ctx_t * ctx, const ustime_t sys_ustime)
+{
+    DCF_LOG("interpret_rx_bits\r\n");
+
+    // Enough bits received in the newest minute (combined with the peer)?
+    const int16_t * soft = hist_get(ctx, 0);
+    int cnt = 0;
+    for(int i = 0; i < 60; i++)
+    {
+        if(soft[i] != 0)
+            cnt++;
+    }
+    if(cnt < DCF_SOFT_MIN_BITS)
+    {
+        DCF_LOG("Error: only %i bits received\r\n", cnt);
+        ctx->stats.fail_bits++;
+        return false;
+    }
+
+    bool pred_avail = ctx->dt_last_pred || ctx->ref_valid;
+    ctx->soft_conf = soft_combine(ctx, pred_avail ? DCF_PRED_CONF : DCF_SOFT_CONF);
+    DCF_LOG("confidence=%i (minutes=%i)\r\n", ctx->soft_conf, ctx->hist_cnt);
+
+    const uint64_t marker = (1ULL << 0) | (1ULL << 20);
+    if(((ctx->rx_tg_def & marker) != marker) || ((ctx->rx_tg_val & marker) != (1ULL << 20)))
+    {
+        DCF_LOG("Error: bit[0] != 0 or bit[20] != 1\r\n");
+        ctx->stats.fail_marker++;
+        return false;
+    }
+
+    datetime_t dt;
+    uint8_t flags;
+    if(!rx_bits_extract_time(ctx, &dt) || !rx_bits_extract_flags(ctx, &flags))
+    {
+        ctx->stats.fail_time++;
+        return false;
+    }
+    if(!rx_bits_extract_date(ctx, &dt))
+    {
+        ctx->stats.fail_date++;
+        return false;
+    }
+
+    // The decoded minute starts with the next second tick
+    if(ctx->soft_conf >= DCF_SOFT_CONF)
+    {
+        ctx->stats.dec_conf++;
+        DCF_LOG("confirmed valid datetime\r\n");
+    }
+    else if(dt_match_prediction(ctx, &dt, flags, ctx->pll_tick + (ustime_t) ctx->pll_period))
+    {
+        ctx->stats.dec_pred++;
+        DCF_LOG("predicted valid datetime\r\n");
+    }
+    else {
+        DCF_LOG("Error: confidence too low, no matching prediction\r\n");
+        ctx->stats.fail_conf++;
+        return false;
+    }
+    stats_good(ctx, &dt);
+
+    // Hold the result until the minute begins (next second-0 tick)
+    datetime_copy(&ctx->dt_pend, &dt);
+    ctx->dt_pend_flags = flags;
+    ctx->dt_pend_valid = true;
+    return true;
+}
+
+/***************************************************************************//**
+* @brief Combine the newest minute in history with the same minute received by
+*        the peer receiver (sum of the soft values). Both receivers see the
+*        same minute marker (at most DCF_COMB_TOL apart), the peer can complete
+*        its minute some cycles later: wait for it at most DCF_COMB_WAIT.
+* @param ctx [in/out] decoder context
+* @param sys_ustime [in] system time in us
+* @return true if the minute can be interpreted (combined or no peer minute),
+*         false if still waiting for the minute of the peer
+*******************************************************************************/
+static bool comb_peer_minute(dcf_ctx_t * ctx, const ustime_t sys_ustime)
+{
+    const dcf_ctx_t * peer = ctx->peer;
+
+    // Peer not aligned to the minutes or analyzing other edges
+    if((peer == NULL) || !peer->pll_locked || (peer->pll_sec < 0) || (peer->edge_src != ctx->edge_src))
+        return true;
+
+    int32_t diff = get_diff_ustime_signed(peer->rx_last_tick, ctx->rx_last_tick);
+    if((diff < -DCF_COMB_TOL) || (diff > DCF_COMB_TOL))
+    {
+        if(!ustime_timeout(sys_ustime, ctx->rx_last_tick, DCF_COMB_WAIT))
+            return false;
+        DCF_LOG("rx%u: no minute of peer\r\n", ctx->rx);
+        return true;
+    }
+
+    int16_t * soft = ctx->hist_soft[ctx->hist_idx];
+    for(int i = 0; i < 60; i++)
+        soft[i] += peer->rx_last[i];
+    ctx->stats.comb_minutes++;
+    DCF_LOG("rx%u: combined with peer (diff=%lius)\r\n", ctx->rx, (long) diff);
+    return true;
+}
+
+/***************************************************************************//**
+* @brief Get the next edge to analyze: captured edge or (while replaying or
+*        simulating) recorded/synthetic edge. The captured edges of the first
+*        receiver are recorded (if dcf_rec records). When the replay/simulation ends, the decoder is
+*        reset to continue with the captured edges.
+* @param ctx [in/out] decoder context
+* @param edge_ptr [out] pointer to edge where the next edge is copied
+* @param sys_ustime [in] system time in us
+* @return true if an edge was copied or false if there is no edge
+*******************************************************************************/
+static bool dcf_get_edge(dcf_ctx_t * ctx, dcf_edge_t * edge_ptr, const ustime_t sys_ustime)
+{
+#ifdef DCF_BENCH
+    if(ctx->edge_src != dcf_src_cap)
+    {
+        // The captured edges are discarded while replaying/simulating
+        dcf_edge_t edge;
+        while(dcf_cap_get_edge(ctx->rx, &edge))
+            ;
+
+        bool running;
+        if(ctx->edge_src == dcf_src_rec)
+        {
+            if(dcf_rec_replay_get(edge_ptr, sys_ustime))
+                return true;
+            running = dcf_rec_is_replaying();
+        }
+        else {
+            if(dcf_gen_get(&ctx->gen, edge_ptr, sys_ustime))
+                return true;
+            running = dcf_gen_is_running(&ctx->gen);
+        }
+
+        if(!running)
+        {
+            io_printf("dcf77 sim %u: finished\r\n", ctx->rx);
+            ctx->edge_src = dcf_src_cap;
+            dcf_reset(ctx, sys_ustime);
+            ctx->pin_old = !dcf_cap_get_level(ctx->rx);
+        }
+        return false;
+    }
+#endif
+
+    if(!dcf_cap_get_edge(ctx->rx, edge_ptr))
+        return false;
+
+#ifdef DCF_BENCH
+    // Only the edges of the first receiver are recorded
+    if(ctx->rx == 0)
+        dcf_rec_add(edge_ptr);
+#endif
+    return true;
+}
+
+/***************************************************************************//**
+* @brief Analyze an edge (after the deglitch stage) using the edge timestamp
+* @param ctx [in/out] decoder context
+* @param edge_ptr [in] pointer to edge
+*******************************************************************************/
+static void analyze_edge(dcf_ctx_t * ctx, const dcf_edge_t * edge_ptr)
+{
+    bool pin_val = !edge_ptr->level;
+    if(pin_val != ctx->pin_old)
+    {
+        analyze_pulse(ctx, edge_ptr->ustime, pin_val);
+        ctx->pin_old = pin_val;
+    }
+}
+
+/***************************************************************************//**
+* @brief Deglitch stage: the edge is kept pending until the new level is stable
+*        (see dcf_poll_cycle). If the level changes back earlier, the pending
+*        and the new edge are dropped (glitch): the enclosing pulse or pause
+*        continues as if there was no glitch.
+* @param ctx [in/out] decoder context
+* @param edge_ptr [in] pointer to the captured edge
+*******************************************************************************/
+static void deglitch_edge(dcf_ctx_t * ctx, const dcf_edge_t * edge_ptr)
+{
+    if(ctx->dg_pending)
+    {
+        // Same level again, keep the first edge
+        if(edge_ptr->level == ctx->dg_edge.level)
+            return;
+
+        // Level changed back before it was stable: glitch
+        if(!ustime_timeout(edge_ptr->ustime, ctx->dg_edge.ustime, (ustime_t) dcf_stable_us))
+        {
+            ctx->dg_pending = false;
+            ctx->stats.glitch++;
+            return;
+        }
+
+        // The pending level was stable (not yet analyzed)
+        ctx->dg_pending = false;
+        analyze_edge(ctx, &ctx->dg_edge);
+    }
+
+    if((!edge_ptr->level) != ctx->pin_old)
+    {
+        ctx->dg_edge = *edge_ptr;
+        ctx->dg_pending = true;
+    }
+}
+
+/***************************************************************************//**
+* @brief DCF77 polling function (one cycle)
+* @param ctx [in/out] decoder context
+* @param sys_ustime [in] System time in us
+* @return true if a decoded datetime was published
+*******************************************************************************/
+static bool dcf_poll_cycle(dcf_ctx_t * ctx, const ustime_t sys_ustime)
+{
+    dcf_edge_t edge;
+
+    // Decoded datetime published at the second-0 tick (in the previous cycle)?
+    // (the datetimes decoded from replayed/synthetic edges are not published)
+    if(ctx->dt_publish)
+    {
+        ctx->dt_publish = false;
+        return (ctx->edge_src == dcf_src_cap);
+    }
+
+    // New edge captured? Pass it through the deglitch stage
+    if(dcf_get_edge(ctx, &edge, sys_ustime))
+    {
+        deglitch_edge(ctx, &edge);
         // Check the results in another cycle
         // to split the calculation time
         return false;
     }
 
-    // Measuring signal quality
-    dcf_sig_quality(sys_ustime);
-
-    // Sync detected?
-    if(sync_detected)
+    // Pending edge stable? Analyze it using the edge timestamp
+    if(ctx->dg_pending && ustime_timeout(sys_ustime, ctx->dg_edge.ustime, (ustime_t) dcf_stable_us))
     {
-        sync_detected = false;
-        sync_valid = true;
-        DCF_CLEAR_BIT(bit_s);
-        memset(rx_bits_val, 0, sizeof(rx_bits_val));
-        memset(rx_bits_len, 0, sizeof(rx_bits_len));
+        ctx->dg_pending = false;
+        analyze_edge(ctx, &ctx->dg_edge);
         return false;
     }
 
-    // Do not check pulse if there is no valid sync
-    if(!sync_valid)
+    // Measuring signal quality
+    dcf_sig_quality(ctx, sys_ustime);
+
+    // Minute completely received? Combine it with the peer and interpret it
+    if(ctx->rx_ready)
+    {
+        if(!comb_peer_minute(ctx, sys_ustime))
+            return false;
+        ctx->rx_ready = false;
+        ema_int_add_val(&ctx->q_decode, (interpret_rx_bits(ctx, sys_ustime) ? 100 : 0));
+        ctx->q_decode_sec = 0;
         return false;
+    }
 
-    // Check if sync timeout
-    if(get_diff_ustime(sys_ustime, sync_time) > DCF_T_59SEC)
+    // Re-center the bit classification at second 0 (no other work scheduled)
+    if(ctx->pll_sec == 0)
     {
-        sync_valid = false;
-        DCF_LOG("sync timeout\r\n");
-        return interpret_rx_bits(sys_ustime); 
+        cls_update(ctx);
     }
 
-    // New valid bit detected? Store it
-    if(bit_s.val != dcf_bitval_none)
+    // Predicted second tick expired without a pulse?
+    // (checked only when there are no captured or pending edges left to analyze)
+    if(ctx->pll_locked && !ctx->dg_pending
+        && (get_diff_ustime(sys_ustime, ctx->pll_tick + (ustime_t) ctx->pll_period) > DCF_PLL_WINDOW))
     {
-        store_bit_s();
-        DCF_CLEAR_BIT(bit_s);
+        pll_tick_event(ctx, ctx->pll_tick + (ustime_t) ctx->pll_period, false);
     }
     return false;
 }
 
 /***************************************************************************//**
-* @brief Measuring signal quality
-*        Profiling: the function takes 36us with logs, 1.5us without logs.
+* @brief Polling function of a decoder context. The time spent in the function
+*        is measured (statistics).
+* @param ctx [in/out] decoder context
+* @param sys_ustime [in] System time in us
+* @return true if a decoded datetime was published at the beginning of its
+*         minute
+*******************************************************************************/
+bool dcf_ctx_poll(dcf_ctx_t * ctx, const ustime_t sys_ustime)
+{
+    ustime_t start = ustime_now();
+    bool res = dcf_poll_cycle(ctx, sys_ustime);
+    ustime_t cpu_us = ustime_now() - start;
+
+    ctx->cpu_acc_us += cpu_us;
+    if(cpu_us > ctx->stats.cpu_max_us)
+        ctx->stats.cpu_max_us = cpu_us;
+    return res;
+}
+
+/***************************************************************************//**
+* @brief DCF77 polling function. Must be called every program cycle.
+*        Polls all receivers. The datetime of the first receiver (combined
+*        with the second one) is published, the datetime of the second
+*        receiver only if the first one has no lock.
+* @param sys_ustime [in] System time in us
+* @return true if a decoded datetime was published at the beginning of its
+*         minute (see dcf_get_datetime and dcf_get_ustime).
+*******************************************************************************/
+bool dcf_poll(const ustime_t sys_ustime)
+{
+    bool res = false;
+
+    dcf_lock();
+    for(int rx = 0; rx < DCF_RX_CNT; rx++)
+    {
+        // Receiver powered off: discard the captured edges (noise)
+        if(!dcf_enabled && (dcf_rx[rx].edge_src == dcf_src_cap))
+        {
+            dcf_edge_t edge;
+            while(dcf_cap_get_edge(dcf_rx[rx].rx, &edge))
+                ;
+            continue;
+        }
+
+        if(dcf_ctx_poll(&dcf_rx[rx], sys_ustime) && ((rx == 0) || !dcf_rx[0].pll_locked))
+        {
+            dcf_out = &dcf_rx[rx];
+            res = true;
+        }
+    }
+
+    // Publish the state
+    dcf_snap_seq++;
+    __dmb();
+    if(res)
+    {
+        dcf_snap.pub_cnt++;
+        dcf_snap.valid = dcf_out->dt_last_valid;
+        datetime_copy(&dcf_snap.dt, &dcf_out->dt_last);
+        dcf_snap.ustime = dcf_out->dt_last_ustime;
+        dcf_snap.flags = dcf_out->dt_last_flags;
+    }
+    dcf_snap.quality = dcf_rx[0].q_quality;
+    __dmb();
+    dcf_snap_seq++;
+
+    dcf_unlock();
+    return res;
+}
+
+/***************************************************************************//**
+* @brief Get a consistent copy of the published state. Lock-free: the copy is
+*        repeated if dcf_poll published (on the other core) meanwhile.
+* @param snap_ptr [out] pointer to the copy
+*******************************************************************************/
+void dcf_get_snapshot(dcf_snap_t * snap_ptr)
+{
+    uint32_t seq;
+    do {
+        while((seq = dcf_snap_seq) & 1UL)
+            tight_loop_contents();
+        __dmb();
+        memcpy(snap_ptr, &dcf_snap, sizeof(dcf_snap_t));
+        __dmb();
+    } while(seq != dcf_snap_seq);
+}
+
+/***************************************************************************//**
+* @brief Lock the decoders. In the multicore mode the decoders are polled on
+*        core1, the functions changing their state (called from core0) hold
+*        the lock. Without multicore the function does nothing.
+*******************************************************************************/
+void dcf_lock(void)
+{
+#ifdef MULTICORE
+    mutex_enter_blocking(&dcf_mutex);
+#endif
+}
+
+/***************************************************************************//**
+* @brief Unlock the decoders (see dcf_lock)
+*******************************************************************************/
+void dcf_unlock(void)
+{
+#ifdef MULTICORE
+    mutex_exit(&dcf_mutex);
+#endif
+}
+
+/***************************************************************************//**
+* @brief Set the minimal stable time of the input level (deglitch stage) of
+*        all receivers. Shorter levels are glitches.
+* @param stable_us [in] stable time [us] 0 (deglitch off)..DCF_STABLE_MAX
+*******************************************************************************/
+void dcf_set_stable_time(int32_t stable_us)
+{
+    if(stable_us < 0)
+        stable_us = 0;
+    else if(stable_us > DCF_STABLE_MAX)
+        stable_us = DCF_STABLE_MAX;
+    dcf_stable_us = stable_us;
+}
+
+/***************************************************************************//**
+* @brief Get the minimal stable time of the input level (deglitch stage)
+* @return stable time [us]
+*******************************************************************************/
+int32_t dcf_get_stable_time(void)
+{
+    return dcf_stable_us;
+}
+
+/***************************************************************************//**
+* @brief Enable/disable the decoders (the receivers are powered on/off).
+*        While disabled the captured edges are discarded. When enabled again
+*        the PLL starts a new lock acquisition, the learned bit classification
+*        is kept. The replay/simulation is not affected.
+* @param enabled [in] true: enable, false: disable the decoders
+* @param sys_ustime [in] System time in us
+*******************************************************************************/
+void dcf_set_enabled(const bool enabled, const ustime_t sys_ustime)
+{
+    if(enabled == dcf_enabled)
+        return;
+
+    dcf_lock();
+    dcf_enabled = enabled;
+    for(int rx = 0; rx < DCF_RX_CNT; rx++)
+    {
+        dcf_ctx_t * ctx = &dcf_rx[rx];
+        if(ctx->edge_src != dcf_src_cap)
+            continue;
+
+        pll_reset(ctx);
+        ctx->rx_ready = false;
+        ctx->dg_pending = false;
+        ctx->pin_old = !dcf_cap_get_level(ctx->rx);
+        if(enabled)
+            sync_time_start(ctx, sys_ustime);
+    }
+    dcf_unlock();
+}
+
+/***************************************************************************//**
+* @brief Check if the decoders are enabled (receivers powered on)
+* @return true if enabled
+*******************************************************************************/
+bool dcf_is_enabled(void)
+{
+    return dcf_enabled;
+}
+
+#ifdef DCF_BENCH
+/***************************************************************************//**
+* @brief Start replaying the recorded edges (dcf_rec) through the decoder of
+*        the first receiver. The decoder and the statistics are reset, the
+*        captured edges are ignored until the replay ends. The decoded
+*        datetimes are printed but not published (dcf_poll doesn't return true).
+* @param sys_ustime [in] System time in us
+* @return true if the replay started, false if there are no recorded edges
+*******************************************************************************/
+bool dcf_replay_start(const ustime_t sys_ustime)
+{
+    dcf_lock();
+    bool res = dcf_rec_replay_start(sys_ustime);
+    if(res)
+    {
+        dcf_ctx_t * ctx = &dcf_rx[0];
+        ctx->edge_src = dcf_src_rec;
+        dcf_reset(ctx, sys_ustime);
+        stats_clear(ctx);
+    }
+    dcf_unlock();
+    return res;
+}
+
+/***************************************************************************//**
+* @brief Start feeding synthetic edges (dcf_gen scenario) through the decoders
+*        (benchmark). Every receiver gets its own stream (same telegrams,
+*        independent noise). The decoders and the statistics are reset, the
+*        captured edges are ignored until the generator stops. Every decoded
+*        datetime is compared with the generated one (stats check_ok/check_false),
+*        time-to-sync and cpu time are in the statistics.
+* @param cfg_ptr [in] pointer to scenario
+* @param minutes [in] count of minutes to generate, <= 0: scenario default
+* @param sys_ustime [in] System time in us
+*******************************************************************************/
+void dcf_sim_start(const dcf_gen_cfg_t * cfg_ptr, int minutes, const ustime_t sys_ustime)
+{
+    dcf_lock();
+    dcf_rec_stop();
+    for(int rx = 0; rx < DCF_RX_CNT; rx++)
+    {
+        dcf_ctx_t * ctx = &dcf_rx[rx];
+        dcf_gen_start(&ctx->gen, cfg_ptr, minutes, rx, sys_ustime);
+        ctx->edge_src = dcf_src_gen;
+        dcf_reset(ctx, sys_ustime);
+        stats_clear(ctx);
+    }
+    dcf_unlock();
+}
+#endif
+
+/***************************************************************************//**
+* @brief Map the raw quality score to the calibrated probability (q_calib)
+* @param raw [in] raw score 0..100
+* @return probability [%] of a good telegram within DCF_Q_HORIZON minutes
+*******************************************************************************/
+static int q_calibrate(const int raw)
+{
+    if(raw <= 0)
+        return q_calib[0];
+    if(raw >= 100)
+        return q_calib[10];
+
+    int i = raw / 10;
+    return q_calib[i] + ((q_calib[i + 1] - q_calib[i]) * (raw - i * 10)) / 10;
+}
+
+/***************************************************************************//**
+* @brief Measuring signal quality (once a second): the smoothed scores are
+*        updated by the pulses (O(1) per event), here they are combined.
+* @param ctx [in/out] decoder context
 * @param sys_ustime [in] System time in us
 *******************************************************************************/
-void dcf_sig_quality(const ustime_t sys_ustime)
+static void dcf_sig_quality(dcf_ctx_t * ctx, const ustime_t sys_ustime)
 {
-    if(get_diff_ustime(sys_ustime, q_time) > DCF_T_1SEC)
+    if(ustime_period(sys_ustime, &ctx->q_time, DCF_T_1SEC))
     {
-        q_time = sys_ustime;
 
-        //DCF_LOG("g=%2i, b=%2i", q_good_cnt, q_bad_cnt);
-        int quality = 0;
+        if(ctx->stats.last_ok_age < UINT32_MAX)
+            ctx->stats.last_ok_age++;
 
-        // Perfect signal: 1 good pulse pro secunde, no bad pulses
-        if((q_good_cnt == 1) && (q_bad_cnt == 0))
+        // CPU time spent in dcf_poll per minute
+        if(++ctx->cpu_sec_cnt >= 60)
         {
-            quality = 100;
-        }
-        else{
-            // If there are > 1 good pulses pro secunde,
-            // the difference is the amount of bad pulses
-            // Add them to the bad pulses
-            if(q_good_cnt > 1)
-                q_bad_cnt += (q_good_cnt - 1);
-
-            // Based on count of bad pulses we analyse signal quality:
-            // more bad pulses -> worst signal
-            if(q_bad_cnt > 0)
-            {
-                if(q_bad_cnt >= 5)
-                    quality = 0;
-                else
-                    quality = (5 - q_bad_cnt) * 20;
-            }
-            else {
-                // In case there are no pulse detected
-                // the signal is missing
-                quality = 0;
-            }
+            ctx->stats.cpu_minute_us = ctx->cpu_acc_us;
+            ctx->cpu_acc_us = 0;
+            ctx->cpu_sec_cnt = 0;
         }
 
-        // Apply a median filter on quality variable
-        q_quality = m_filter_int_add_val(&q_filter, quality);
+        // No pulses at the tracked ticks (no lock): phase score 0
+        if(!ctx->pll_locked)
+            ema_int_add_val(&ctx->q_phase, 0);
+
+        // No minute interpreted for more than a minute: decode score 0
+        if(++ctx->q_decode_sec > 60)
+        {
+            ema_int_add_val(&ctx->q_decode, 0);
+            ctx->q_decode_sec = 0;
+        }
 
-        //DCF_LOG(" | g=%2i, b=%2i, q=%3i | %i \r\n", q_good_cnt, q_bad_cnt, quality, q_quality);
-        q_good_cnt = 0;
-        q_bad_cnt = 0;
+        ctx->q_raw = (ema_int_get(&ctx->q_phase) * DCF_Q_W_PHASE + ema_int_get(&ctx->q_margin) * DCF_Q_W_MARGIN
+                + ema_int_get(&ctx->q_decode) * DCF_Q_W_DECODE) / 100;
+        ctx->q_quality = q_calibrate(ctx->q_raw);
     }
 }
 
 /***************************************************************************//**
-* @brief Get signal quality 0..100%
+* @brief Get signal quality 0..100% of the first receiver
 * @return signal quality 0..100%
 *******************************************************************************/
 int dcf_get_quality(void)
 {
-    return q_quality;
+    return dcf_rx[0].q_quality;
 }
 
 /***************************************************************************//**
@@ -591,9 +1823,160 @@ int dcf_get_quality(void)
 *******************************************************************************/
 datetime_t *  dcf_get_datetime(void)
 {
-    if(dt_last_valid)
+    if(dcf_out->dt_last_valid)
     {
-        return &dt_last;
+        return &dcf_out->dt_last;
     }
     return NULL;
 }
+
+/***************************************************************************//**
+* @brief Get the learned bit classification of the first receiver
+* @param nom0 [out] mean length of 0-bits in us
+* @param nom1 [out] mean length of 1-bits in us
+* @param thr [out] decision threshold in us (shorter: 0-bit, longer: 1-bit)
+* @param min0 [out] minimal length of a valid 0-bit in us
+* @param max1 [out] maximal length of a valid 1-bit in us
+*******************************************************************************/
+void dcf_get_classifier(int32_t * nom0, int32_t * nom1, int32_t * thr, int32_t * min0, int32_t * max1)
+{
+    *nom0 = dcf_rx[0].cls_nom0;
+    *nom1 = dcf_rx[0].cls_nom1;
+    *thr = dcf_rx[0].cls_thr;
+    *min0 = dcf_rx[0].cls_min0;
+    *max1 = dcf_rx[0].cls_max1;
+}
+
+/***************************************************************************//**
+* @brief Get the time of the second-0 tick of the last detected datetime. This
+*        is the start of the pulse at second 0 as tracked by the PLL (filtered
+*        from the edge jitter, predicted if the pulse is missing).
+* @return time in us when the last detected datetime began
+*******************************************************************************/
+ustime_t dcf_get_ustime(void)
+{
+    return dcf_out->dt_last_ustime;
+}
+
+/***************************************************************************//**
+* @brief Get the flags of the last detected datetime: call bit, announcements
+*        and time zone (CEST or CET, none if the time zone bits were undefined)
+* @return flags (DCF_FLAG_...)
+*******************************************************************************/
+uint8_t dcf_get_flags(void)
+{
+    return dcf_out->dt_last_flags;
+}
+
+/***************************************************************************//**
+* @brief Get the second (0..59, 60 leap second) of the last tick tracked by the
+*        PLL of the first receiver
+* @return second of the last tick or -1 if the PLL is not locked or the
+*         minute marker was not yet detected
+*******************************************************************************/
+int dcf_get_second(void)
+{
+    return dcf_rx[0].pll_locked ? dcf_rx[0].pll_sec : -1;
+}
+
+/***************************************************************************//**
+* @brief Get the period of the second ticks tracked by the PLL of the first receiver
+* @return period in us or 0 if the PLL is not locked
+*******************************************************************************/
+int32_t dcf_get_period(void)
+{
+    return dcf_rx[0].pll_locked ? dcf_rx[0].pll_period : 0;
+}
+
+/***************************************************************************//**
+* @brief Get the confidence of the last decoded telegram (combined minutes)
+* @return confidence (DCF_SOFT_MAX for one clean minute)
+*******************************************************************************/
+int dcf_get_confidence(void)
+{
+    return dcf_out->soft_conf;
+}
+
+/***************************************************************************//**
+* @brief Set the reference datetime (trusted running time, e.g. RTC) used to
+*        predict the telegrams. A telegram matching the prediction is accepted
+*        without the multi-minute confirmation. The reference is set for
+*        all receivers.
+* @param dt_ptr [in] pointer to reference datetime, NULL to invalidate it
+* @param ustime [in] system time in us when the reference datetime was valid
+*******************************************************************************/
+void dcf_set_reference(const datetime_t * dt_ptr, const ustime_t ustime)
+{
+    dcf_lock();
+    for(int rx = 0; rx < DCF_RX_CNT; rx++)
+    {
+        dcf_ctx_t * ctx = &dcf_rx[rx];
+        if(dt_ptr)
+        {
+            datetime_copy(&ctx->ref_dt, dt_ptr);
+            ctx->ref_ustime = ustime;
+            ctx->ref_valid = true;
+        }
+        else {
+            ctx->ref_valid = false;
+        }
+    }
+    dcf_unlock();
+}
+
+/***************************************************************************//**
+* @brief Get the time-to-sync: time from init (or lost PLL lock) until the
+*        first telegram was decoded (first receiver)
+* @return last time-to-sync in seconds, -1 if not yet synced
+*******************************************************************************/
+int32_t dcf_get_sync_time(void)
+{
+    return dcf_rx[0].sync_time_s;
+}
+
+/***************************************************************************//**
+* @brief Get the decoder context of a receiver (multicore: read it under
+*        dcf_lock, the decoders run on core1)
+* @param rx [in] index of the receiver 0..DCF_RX_CNT-1
+* @return pointer to the decoder context or NULL if the receiver is not available
+*******************************************************************************/
+dcf_ctx_t * dcf_get_ctx(const int rx)
+{
+    if((rx < 0) || (rx >= DCF_RX_CNT))
+        return NULL;
+    return &dcf_rx[rx];
+}
+
+/***************************************************************************//**
+* @brief Get a copy of the statistics of a receiver (taken under the lock,
+*        multicore: the decoders update them on core1)
+* @param rx [in] index of the receiver 0..DCF_RX_CNT-1
+* @param stats_ptr [out] pointer to the copy
+* @return true if copied, false if the receiver is not available
+*******************************************************************************/
+bool dcf_get_stats(const int rx, dcf_stats_t * stats_ptr)
+{
+    dcf_ctx_t * ctx = dcf_get_ctx(rx);
+    if(ctx == NULL)
+        return false;
+
+    dcf_lock();
+    memcpy(stats_ptr, &ctx->stats, sizeof(dcf_stats_t));
+    dcf_unlock();
+    return true;
+}
+
+/***************************************************************************//**
+* @brief Clear the statistics of a receiver
+* @param rx [in] index of the receiver 0..DCF_RX_CNT-1
+*******************************************************************************/
+void dcf_clear_stats(const int rx)
+{
+    dcf_ctx_t * ctx = dcf_get_ctx(rx);
+    if(ctx)
+    {
+        dcf_lock();
+        stats_clear(ctx);
+        dcf_unlock();
+    }
+}
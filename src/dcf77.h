@@ -25,6 +25,11 @@
 //******************************************************************************
 #include "ustime.h"
 #include "datetime_utils.h"
+#include "utils.h"
+#include "dcf_cap.h"
+#ifdef DCF_BENCH
+#include "dcf_gen.h"
+#endif
 
 #ifdef DCF77_DEBUG
 #include DEBUG_INCLUDE
@@ -44,25 +49,91 @@
 #endif
 
 #define DCF_IN_PIN      13          // Pin index where input DCF77 signal is connected
+#define DCF_IN2_PIN     12          // Pin index of the second receiver (DCF_DUAL)
+
+// Count of receivers (decoder contexts): with DCF_DUAL the soft bits of the
+// second receiver are combined with the first one (diversity)
+#ifdef DCF_DUAL
+#define DCF_RX_CNT      2
+#else
+#define DCF_RX_CNT      1
+#endif
 
+// Initial bit classification, replaced by the learned values (see DCF_CLS_...)
+#define DCF_BIT0_NOM    100000L     // Nominal time [us] of signal for 0-bit
+#define DCF_BIT1_NOM    200000L     // Nominal time [us] of signal for 1-bit
+#define DCF_BIT_THR     150000L     // Decision threshold [us]: shorter 0-bit, longer 1-bit
 #define DCF_BIT0_MIN    50000L      // Minimal time [us] of signal for valid 0-bit
-#define DCF_BIT0_MAX    175000L     // Maximal time [us] of signal for valid 0-bit
-#define DCF_BIT1_MIN    175001L     // Minimal time [us] of signal for valid 1-bit
 #define DCF_BIT1_MAX    350000L     // Maximal time [us] of signal for valid 1-bit
-#define DCF_SYNC_MIN    1500000L    // Minimal time [us] of sync-signal
 
-#define DCF_T_59SEC     59000000L
-#define DCF_T_1SEC      1000000L
+// Adaptive bit classification: histogram of the pulse lengths, the 0/1 decision
+// threshold is re-centered between the means of the two clusters (0 and 1 bits)
+#define DCF_CLS_BIN         5000L   // Histogram bin width [us]
+#define DCF_CLS_BINS        80      // Count of bins (covers 0..400ms)
+#define DCF_CLS_LEN_MIN     30000L  // Pulses shorter than this [us] are never valid bits
+#define DCF_CLS_LEN_MAX     (DCF_CLS_BIN * DCF_CLS_BINS)    // Longer pulses are never valid bits
+#define DCF_CLS_MIN_CNT     120     // Minimal count of pulses in histogram to adapt
+#define DCF_CLS_MAX_CNT     1200    // Count of pulses when the histogram is halved (aging)
+#define DCF_CLS_THR_MIN     90000L  // Minimal decision threshold [us]
+#define DCF_CLS_THR_MAX     240000L // Maximal decision threshold [us]
+#define DCF_CLS_SEP_MIN     50000L  // Minimal distance [us] between 0-bit and 1-bit means
+#define DCF_CLS_THR_JUMP    10000L  // Threshold change [us] invalidating the soft history
+
+#define DCF_T_1SEC      1000000L    // Nominal period [us] of the second ticks
+
+// Deglitch: an input level must be stable for DCF_STABLE_MIN, shorter levels are
+// glitches and are merged back into the enclosing pulse/pause (both edges dropped).
+// The analysis of every edge is delayed by the stable time.
+#define DCF_STABLE_MIN      25000L  // Default minimal stable time [us] (0: deglitch off)
+#define DCF_STABLE_MAX      40000L  // Maximal configurable stable time [us] (< DCF_BIT0_MIN)
+
+// Software PLL tracking the second ticks
+#define DCF_PLL_WINDOW      40000L  // Window [us] around the predicted tick where a pulse start is accepted
+#define DCF_PLL_ACQ_WINDOW  100000L // Window [us] used to acquire the lock (pulses ~1 second apart)
+#define DCF_PLL_LOCK_CNT    3       // Count of consecutive pulses ~1 second apart to lock
+#define DCF_PLL_MISS_MAX    10      // Count of consecutive ticks without pulse to lose the lock
+#define DCF_PLL_KP_DIV      4       // Phase correction: 1/4 of the phase error
+#define DCF_PLL_KI_DIV      64      // Period correction: 1/64 of the phase error
+#define DCF_PLL_PERIOD_DEV  500L    // Maximal deviation [us] of the tracked period from 1 second
+
+// Soft decision: every received bit gets a soft value -DCF_SOFT_MAX..+DCF_SOFT_MAX
+// (sure 0-bit .. sure 1-bit) from its pulse length. The soft values of the last
+// DCF_SOFT_MINUTES minutes are combined. A decoded value is considered valid when
+// its confidence reaches DCF_SOFT_CONF (one clean minute gives DCF_SOFT_MAX).
+#define DCF_SOFT_MAX        100
+#define DCF_SOFT_MINUTES    10      // Count of minutes kept in history
+#define DCF_SOFT_CONF       250     // Minimal confidence of a valid value
+#define DCF_SOFT_MIN_BITS   40      // Minimal count of bits received in the newest minute
 
-// After how many consecutive successful time/date decodes, the value is considered valid
-#define DCF_VALID_DATETIME_CNT  3
+// Predictive verification: if a trusted reference exists (running RTC time or
+// the previous telegram), a telegram matching the prediction is accepted with
+// the lower confidence DCF_PRED_CONF (a single clean minute)
+#define DCF_PRED_CONF       50      // Minimal confidence of a value matching the prediction
+#define DCF_PRED_TOL_S      2       // Tolerance [s] between predicted and decoded time
+#define DCF_PRED_REF_MAX_S  10      // Maximal age [s] of the reference time
+
+// Combining the minutes of two receivers
+#define DCF_COMB_TOL        100000L // Maximal distance [us] between the minute markers of the receivers
+#define DCF_COMB_WAIT       250000L // Maximal time [us] to wait for the minute of the peer
 
 // Signal edges
 #define DCF_EDGE_RAISING    0x01    // __|-- Raising Edge detected 
 #define DCF_EDGE_FALLING    0x02    // --|__ Falling Edge detected
 
-// Measure signal quality
-#define DCF_Q_FILTER        10      // Median filter size (window size)
+// Signal quality estimator: three exponentially smoothed scores 0..100
+//  - phase: the pulse start vs. the tracked tick (jitter), a missing tick or
+//    a spurious pulse scores 0
+//  - margin: distance of the pulse width to the decision threshold/limits
+//  - decode: ratio of the successfully decoded minutes
+// are weighted to a raw score, then mapped by a calibration table (q_calib)
+// to the probability [%] of a good telegram within DCF_Q_HORIZON minutes.
+#define DCF_Q_PHASE_SHIFT   4       // Smoothing of the phase score (~16 ticks)
+#define DCF_Q_MARGIN_SHIFT  4       // Smoothing of the margin score (~16 pulses)
+#define DCF_Q_DECODE_SHIFT  2       // Smoothing of the decode score (~4 minutes)
+#define DCF_Q_W_PHASE       40      // Weight [%] of the phase score
+#define DCF_Q_W_MARGIN      30      // Weight [%] of the margin score
+#define DCF_Q_W_DECODE      30      // Weight [%] of the decode score
+#define DCF_Q_HORIZON       3       // Horizon [minutes] of the predicted probability
 
 // Bit Values
 typedef enum {
@@ -80,23 +151,265 @@ typedef struct {
 } dcf_bit_t;
 
 #define DCF_CLEAR_BIT(b)    memset(&(b), 0, sizeof(b))
-#define DCF_COPY_BIT(b, c)  memcpy(&(b), &(c), sizeof(b));
+
+// Pulse-width histogram of the statistics
+#define DCF_STAT_BIN        20000L  // Bin width [us]
+#define DCF_STAT_BINS       20      // Count of bins (0..400ms), one more for longer pulses
+
+// Telegram fields checked by the statistics
+typedef enum {
+    dcf_field_min = 0,
+    dcf_field_hour,
+    dcf_field_date,
+    dcf_field_cnt
+} dcf_field_t;
+
+// Value fields of the telegram
+typedef enum {
+    dcf_val_min = 0,
+    dcf_val_hour,
+    dcf_val_day,
+    dcf_val_dotw,
+    dcf_val_month,
+    dcf_val_year,
+    dcf_val_flags,
+    dcf_val_cnt
+} dcf_val_t;
+
+// Position of a field in the telegram (bit index = second)
+typedef struct {
+    uint8_t start;      // Index of the first bit
+    uint8_t cnt;        // Count of bits
+} dcf_tg_field_t;
+
+// Flags of the telegram (bits 15..19, see dcf_val_flags)
+#define DCF_FLAG_CALL       0x01    // R:  call bit, irregularity of the transmitter
+#define DCF_FLAG_A1         0x02    // A1: change CET <-> CEST announced at the end of the hour
+#define DCF_FLAG_CEST       0x04    // Z1: summer time (CEST, UTC+2)
+#define DCF_FLAG_CET        0x08    // Z2: standard time (CET, UTC+1)
+#define DCF_FLAG_A2         0x10    // A2: leap second announced at the end of the hour
+
+// Mask of cnt bits starting with bit start in a 64-bit telegram
+#define DCF_TG_MASK(start,cnt)  (((1ULL << (cnt)) - 1ULL) << (start))
+
+// Always-on statistics (diagnose reception without a debug build)
+typedef struct {
+    uint32_t pulse_hist[DCF_STAT_BINS + 1]; // Pulse-width histogram (all pulse ends)
+    uint32_t pulse_ok;          // Pulses accepted as valid bits
+    uint32_t pulse_spur;        // Pulses started outside the tick window
+    uint32_t pulse_short;       // Pulses too short (longer than a glitch)
+    uint32_t pulse_long;        // Pulses too long
+    uint32_t glitch;            // Glitches removed by the deglitch stage
+    uint32_t sync_loss;         // PLL lost the lock
+    uint32_t realign;           // Pulse at second 59, second index realigned
+    uint32_t minutes;           // Count of received minutes
+    uint32_t bits_sum;          // Sum of the bits received in all minutes
+    uint8_t bits_last;          // Bits received in the last minute
+    uint32_t par_err[dcf_field_cnt];    // Parity errors of the single minutes (by field)
+    uint32_t par_miss[dcf_field_cnt];   // Fields with missing bits in the single minutes
+    uint32_t fail_bits;         // Decode failed: too few bits in the minute
+    uint32_t fail_marker;       // Decode failed: bit 0 or bit 20 wrong
+    uint32_t fail_time;         // Decode failed: time (minute/hour) undefined or invalid
+    uint32_t fail_date;         // Decode failed: date undefined or invalid
+    uint32_t fail_conf;         // Decode failed: confidence too low, no matching prediction
+    uint32_t dec_conf;          // Telegrams accepted with full confidence
+    uint32_t dec_pred;          // Telegrams accepted matching the prediction
+    uint32_t ber_bits;          // Bits compared with the decoded telegrams
+    uint32_t ber_err;           // Bits different from the decoded telegrams
+    uint16_t good_hour[24];     // Good telegrams per hour of the day (last 24 hours)
+    int8_t good_hour_last;      // Hour of the last good telegram, -1 none
+    uint32_t last_ok_age;       // Seconds since the last good telegram (UINT32_MAX never)
+    uint32_t cpu_minute_us;     // Time [us] spent in dcf_poll in the last minute
+    uint32_t cpu_max_us;        // Maximal time [us] of one dcf_poll call
+    uint32_t check_ok;          // Synthetic signal: decoded datetimes equal to generated ones
+    uint32_t check_false;       // Synthetic signal: decoded datetimes different (false accept)
+    uint32_t comb_minutes;      // Minutes combined with the peer receiver
+} dcf_stats_t;
+
+// Source of the analyzed edges
+typedef enum {
+    dcf_src_cap = 0,    // Captured edges of the input pin (dcf_cap)
+    dcf_src_rec,        // Replay of the recorded edges (dcf_rec)
+    dcf_src_gen         // Synthetic edges (dcf_gen)
+} dcf_src_t;
+
+// Decoder context of one receiver (input pin)
+typedef struct dcf_ctx_s {
+    unsigned int rx;            // Index of the receiver (capture channel)
+    dcf_src_t edge_src;         // Source of the analyzed edges
+#ifdef DCF_BENCH
+    dcf_gen_t gen;              // Generator of the synthetic edges (dcf_src_gen)
+#endif
+    const struct dcf_ctx_s * peer;  // Receiver whose minutes are combined with ours, or NULL
+
+    bool pin_old;               // Previous state of input signal
+    bool dg_pending;            // An edge waits to be stable (deglitch)
+    dcf_edge_t dg_edge;         // The pending edge
+    dcf_bit_t pulse;            // Currently analized pulse
+
+    // Software PLL tracking the phase and the period of the second ticks
+    bool pll_locked;            // Set when the PLL is locked to the second ticks
+    ustime_t pll_tick;          // Time in us of the last second tick (measured or predicted)
+    int32_t pll_period;         // Tracked period of the second ticks in us
+    int pll_hits;               // Count of consecutive pulses ~1 second apart (lock acquisition)
+    int pll_miss;               // Count of consecutive second ticks without pulse
+    int pll_sec;                // Second (0..59, 60) of the last tick, -1 if not known
+    bool pll_leap;              // Leap second announced: second 59 is a bit, 60 the marker
+
+    bool rx_valid;              // Set when the reception of a minute started at second 0
+    bool rx_ready;              // Set when a minute is completely received (second 59)
+    int8_t rx_soft[60];         // Soft values of the bits of the minute being received
+    int8_t rx_last[60];         // Soft values of the last completely received minute
+    ustime_t rx_last_tick;      // Time in us of the minute marker of rx_last
+    uint32_t rx_min_cnt;        // Count of received minutes
+
+    // Soft values of the last received (consecutive) minutes, combined with the peer
+    int16_t hist_soft[DCF_SOFT_MINUTES][60];
+    int hist_idx;               // Index in hist_soft of the newest minute
+    int hist_cnt;               // Count of minutes in hist_soft
+    int soft_conf;              // Confidence of the last combined telegram
+
+    // Combined telegram decided from history, bit i of the masks is the second i
+    uint64_t rx_tg_val;         // Values of the bits
+    uint64_t rx_tg_def;         // Set if the bit is defined (enough confidence)
+
+    // Decoded time/date
+    datetime_t dt_pend;         // Decoded datetime waiting for the start of its minute
+    bool dt_pend_valid;         // Flag indicates dt_pend must be published at second 0
+    uint8_t dt_pend_flags;      // Flags (DCF_FLAG_...) of dt_pend
+    bool dt_publish;            // Flag indicates dt_last was just published
+    datetime_t dt_last;         // Last detected datetime
+    bool dt_last_valid;         // Flag indicates last detected datetime is valid
+    ustime_t dt_last_ustime;    // Time in us of the second-0 edge of dt_last
+    uint8_t dt_last_flags;      // Flags (DCF_FLAG_...) of dt_last
+    bool dt_last_pred;          // Flag indicates dt_last can be used for prediction
+    uint32_t dt_last_min;       // Value of rx_min_cnt when dt_last was decoded
+
+    // Reference datetime (running RTC time) used to predict the telegrams
+    datetime_t ref_dt;
+    ustime_t ref_ustime;        // System time in us when ref_dt was valid
+    bool ref_valid;
+
+    // Time-to-sync: from init/lost lock to the first decoded telegram
+    bool sync_pending;
+    ustime_t sync_start;
+    int32_t sync_time_s;        // Last time-to-sync in seconds, -1 if not yet synced
+
+    // Adaptive bit classification
+    uint16_t cls_hist[DCF_CLS_BINS];    // Histogram of the pulse lengths
+    int cls_cnt;                // Count of pulses in histogram
+    bool cls_changed;           // Histogram changed since last update
+    int32_t cls_nom0;           // Mean length [us] of 0-bits
+    int32_t cls_nom1;           // Mean length [us] of 1-bits
+    int32_t cls_thr;            // Decision threshold [us]: < 0-bit, >= 1-bit
+    int32_t cls_min0;           // Minimal length [us] of a valid 0-bit
+    int32_t cls_max1;           // Maximal length [us] of a valid 1-bit
+
+    // Statistics
+    dcf_stats_t stats;
+    uint32_t cpu_acc_us;        // Time spent in dcf_poll in the actual minute
+    int cpu_sec_cnt;            // Seconds of the actual minute
+
+    // Signal quality
+    // Signal quality estimator (see DCF_Q_...)
+    ustime_t q_time;            // Time in us for statistics period
+    ema_int_t q_phase;          // Phase score of the second ticks 0..100
+    ema_int_t q_margin;         // Width margin score of the pulses 0..100
+    ema_int_t q_decode;         // Decode score of the minutes 0..100
+    int q_decode_sec;           // Seconds since the last interpreted minute
+    int q_raw;                  // Weighted score 0..100 (not calibrated)
+    int q_quality;              // Probability [%] of a good telegram within DCF_Q_HORIZON minutes
+} dcf_ctx_t;
+
+// Published state of the decoder, read as a consistent copy (from the other
+// core in the multicore mode, see dcf_get_snapshot)
+typedef struct {
+    uint32_t pub_cnt;           // Count of published datetimes (changes with every publish)
+    bool valid;                 // dt is valid
+    datetime_t dt;              // Last published datetime (start of the minute)
+    ustime_t ustime;            // System time in us of its second-0 tick
+    uint8_t flags;              // Flags (DCF_FLAG_...) of dt
+    int quality;                // Signal quality 0..100%
+} dcf_snap_t;
 
 //******************************************************************************
 // Exported Functions
 //******************************************************************************
 
+// Init a decoder context of the receiver rx connected to pin
+void dcf_ctx_init(dcf_ctx_t * ctx, const unsigned int rx, const unsigned int pin);
+
+// Combine the minutes of the peer receiver with the minutes of ctx (NULL: none)
+void dcf_ctx_set_peer(dcf_ctx_t * ctx, const dcf_ctx_t * peer);
+
+// Polling function of a decoder context
+bool dcf_ctx_poll(dcf_ctx_t * ctx, const ustime_t sys_ustime);
+
+// Get the decoder context of a receiver (NULL if not available, multicore: read under dcf_lock)
+dcf_ctx_t * dcf_get_ctx(const int rx);
+
 // Init DCF77 Module. Must be called in main in init phase
 void dcf_init(void);
 
 // DCF77 polling function. Must be called every program cycle
 bool dcf_poll(const ustime_t sys_ustime);
 
+// Get a consistent copy of the published state (lock-free, safe on the other core)
+void dcf_get_snapshot(dcf_snap_t * snap_ptr);
+
+// Lock/unlock the decoders (multicore: the decoders run on core1)
+void dcf_lock(void);
+void dcf_unlock(void);
+
 // Get signal quality 0..100%
 int dcf_get_quality(void);
 
 // Return last detected datetime if valid
 datetime_t * dcf_get_datetime(void);
 
+// Get the time in us when the last detected datetime began (second-0 tick)
+ustime_t dcf_get_ustime(void);
+
+// Get the flags (DCF_FLAG_...) of the last detected datetime
+uint8_t dcf_get_flags(void);
+
+// Get the second (0..59, 60 leap second) of the last tick tracked by the PLL
+int dcf_get_second(void);
+
+// Get the period of the second ticks tracked by the PLL
+int32_t dcf_get_period(void);
+
+// Get the confidence of the last decoded telegram
+int dcf_get_confidence(void);
+
+// Get the learned bit classification: 0/1 means, decision threshold and limits [us]
+void dcf_get_classifier(int32_t * nom0, int32_t * nom1, int32_t * thr, int32_t * min0, int32_t * max1);
+
+// Set the reference datetime (trusted running time) used to predict telegrams
+void dcf_set_reference(const datetime_t * dt_ptr, const ustime_t ustime);
+
+// Get the time-to-sync [s]
+int32_t dcf_get_sync_time(void);
+
+// Set/get the minimal stable time [us] of the input level (deglitch)
+void dcf_set_stable_time(int32_t stable_us);
+int32_t dcf_get_stable_time(void);
+
+// Enable/disable the decoders (receivers powered on/off)
+void dcf_set_enabled(const bool enabled, const ustime_t sys_ustime);
+bool dcf_is_enabled(void);
+
+#ifdef DCF_BENCH
+// Replay the recorded edges (dcf_rec) through the decoder
+bool dcf_replay_start(const ustime_t sys_ustime);
+
+// Feed synthetic edges (dcf_gen scenario) through the decoder
+void dcf_sim_start(const dcf_gen_cfg_t * cfg_ptr, int minutes, const ustime_t sys_ustime);
+#endif
+
+// Get a copy/clear the statistics of a receiver
+bool dcf_get_stats(const int rx, dcf_stats_t * stats_ptr);
+void dcf_clear_stats(const int rx);
+
 //******************************************************************************
 #endif /* DCF77_H */
@@ -0,0 +1,185 @@
+/*******************************************************************************
+ * This file is part of the MstHora distribution.
+ * Copyright (c) 2024 Igor Marinescu (igor.marinescu@gmail.com).
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, version 3.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see <http://www.gnu.org/licenses/>.
+ ******************************************************************************/
+/*******************************************************************************
+ * dcf_cap - captures the edges of the DCF77 input signal. Every edge is
+ * timestamped in the GPIO interrupt and stored in a lock-free single-producer
+ * (interrupt) / single-consumer (dcf77 module) ring buffer of its channel.
+ ******************************************************************************/
+
+//******************************************************************************
+// Includes
+//******************************************************************************
+#include <stdint.h>
+#include <stdio.h>
+
+#include "pico/stdlib.h"
+
+#include "dcf_cap.h"
+#include "gpio_drv.h"
+#include "sched.h"
+
+//******************************************************************************
+// Function Prototypes
+//******************************************************************************
+static void dcf_cap_gpio_irq(unsigned int gpio, uint32_t events);
+
+//******************************************************************************
+// Global Variables
+//******************************************************************************
+
+// Ring buffer of a channel (edges):
+//
+//       ... free space --->|<-- captured edges -->|<--- free space...
+//  +-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+
+//  | | | | | | | | | | | | |X|X|X|X|X|X|X|X|X|X|X| | | | | | | | | |
+//  +-+-+-+-+-+-+-+-+-+-+-+-+^+-+-+-+-+-+-+-+-+-+-+^+-+-+-+-+-+-+-+-+
+//   :                       |                     |                :
+//   0                     rd_idx                wr_idx       DCF_CAP_BUFF
+//                   dcf_cap_get_edge()    dcf_cap_gpio_irq()
+//
+// The indexes are free running counters, only the producer (interrupt) writes
+// wr_idx and only the consumer writes rd_idx, no lock is required.
+typedef struct {
+    dcf_edge_t edges[DCF_CAP_BUFF];
+    volatile uint32_t wr_idx;
+    volatile uint32_t rd_idx;
+    volatile uint32_t lost;
+    unsigned int pin;               // Input pin
+    bool active;                    // Channel initialized
+} cap_ch_t;
+
+static cap_ch_t cap_ch[DCF_CAP_CH_CNT];
+
+/***************************************************************************//**
+* @brief Init the capture of the DCF77 input signal of a channel. Configure the
+*        pin as input and enable the interrupt on both (rising and falling) edges.
+* @param ch [in] capture channel 0..DCF_CAP_CH_CNT-1
+* @param pin [in] index of the pin where the DCF77 signal is connected
+*******************************************************************************/
+void dcf_cap_init(unsigned int ch, unsigned int pin)
+{
+    if(ch >= DCF_CAP_CH_CNT)
+        return;
+
+    cap_ch_t * ch_ptr = &cap_ch[ch];
+    ch_ptr->pin = pin;
+    ch_ptr->wr_idx = 0;
+    ch_ptr->rd_idx = 0;
+    ch_ptr->lost = 0;
+    ch_ptr->active = true;
+
+    gpio_init(pin);
+    gpio_set_dir(pin, GPIO_IN);
+    gpio_set_pulls(pin, /*pull-up*/ false, /*pull-down*/ false);
+
+    // The same callback for all channels (dispatched by gpio_drv)
+    gpio_drv_set_irq(pin, GPIO_IRQ_EDGE_RISE | GPIO_IRQ_EDGE_FALL, dcf_cap_gpio_irq);
+}
+
+/***************************************************************************//**
+* @brief GPIO interrupt callback. Timestamp the edge and store it in ring buffer
+*        of the channel of the pin.
+*        The raw 64-bit timer is read (ustime_now), safe in the interrupt.
+*        The level is taken from the event (a later edge may already have
+*        changed the pin). If both edges are signaled (a glitch shorter than
+*        the interrupt latency) their order is unknown and only the actual
+*        level is stored.
+* @param gpio [in] pin which triggered the interrupt
+* @param events [in] mask of the events which triggered the interrupt
+*******************************************************************************/
+static void dcf_cap_gpio_irq(unsigned int gpio, uint32_t events)
+{
+    ustime_t ustime = ustime_now();
+
+    cap_ch_t * ch_ptr = NULL;
+    for(unsigned int ch = 0; ch < DCF_CAP_CH_CNT; ch++)
+    {
+        if(cap_ch[ch].active && (cap_ch[ch].pin == gpio))
+            ch_ptr = &cap_ch[ch];
+    }
+    if(ch_ptr == NULL)
+        return;
+
+    uint32_t wr_idx = ch_ptr->wr_idx;
+    if((wr_idx - ch_ptr->rd_idx) >= DCF_CAP_BUFF)
+    {
+        ch_ptr->lost++;
+        return;
+    }
+
+    dcf_edge_t * edge_ptr = &ch_ptr->edges[wr_idx & (DCF_CAP_BUFF - 1)];
+    edge_ptr->ustime = ustime;
+    if((events & (GPIO_IRQ_EDGE_RISE | GPIO_IRQ_EDGE_FALL)) == GPIO_IRQ_EDGE_RISE)
+        edge_ptr->level = true;
+    else if((events & (GPIO_IRQ_EDGE_RISE | GPIO_IRQ_EDGE_FALL)) == GPIO_IRQ_EDGE_FALL)
+        edge_ptr->level = false;
+    else
+        edge_ptr->level = gpio_get(gpio);
+
+    // Make sure the edge is stored before it is published to the consumer
+    __compiler_memory_barrier();
+    ch_ptr->wr_idx = wr_idx + 1;
+    sched_post(sched_ev_dcf);
+}
+
+/***************************************************************************//**
+* @brief Get the next captured edge of a channel (if there is any)
+* @param ch [in] capture channel
+* @param edge_ptr [out] pointer to edge where the captured edge is copied
+* @return true if an edge was copied or false if there is no captured edge
+*******************************************************************************/
+bool dcf_cap_get_edge(unsigned int ch, dcf_edge_t * edge_ptr)
+{
+    if(ch >= DCF_CAP_CH_CNT)
+        return false;
+
+    cap_ch_t * ch_ptr = &cap_ch[ch];
+    uint32_t rd_idx = ch_ptr->rd_idx;
+    if(rd_idx == ch_ptr->wr_idx)
+        return false;
+
+    *edge_ptr = ch_ptr->edges[rd_idx & (DCF_CAP_BUFF - 1)];
+
+    // Make sure the edge is copied before the slot is released to the producer
+    __compiler_memory_barrier();
+    ch_ptr->rd_idx = rd_idx + 1;
+    return true;
+}
+
+/***************************************************************************//**
+* @brief Get the actual input pin level of a channel
+* @param ch [in] capture channel
+* @return input pin level
+*******************************************************************************/
+bool dcf_cap_get_level(unsigned int ch)
+{
+    if(ch >= DCF_CAP_CH_CNT)
+        return false;
+    return gpio_get(cap_ch[ch].pin);
+}
+
+/***************************************************************************//**
+* @brief Get the count of edges of a channel lost because the ring buffer was full
+* @param ch [in] capture channel
+* @return count of lost edges
+*******************************************************************************/
+uint32_t dcf_cap_get_lost(unsigned int ch)
+{
+    if(ch >= DCF_CAP_CH_CNT)
+        return 0;
+    return cap_ch[ch].lost;
+}
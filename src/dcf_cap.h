@@ -0,0 +1,73 @@
+/*******************************************************************************
+ * This file is part of the MstHora distribution.
+ * Copyright (c) 2024 Igor Marinescu (igor.marinescu@gmail.com).
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, version 3.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see <http://www.gnu.org/licenses/>.
+ ******************************************************************************/
+/*******************************************************************************
+ * dcf_cap - captures the edges of the DCF77 input signal. Every edge is
+ * timestamped and stored in a lock-free single-producer (interrupt/DMA) /
+ * single-consumer (dcf77 module) ring buffer. Up to DCF_CAP_CH_CNT input pins
+ * (receivers) are captured, every channel has its own ring buffer.
+ * The interface is implemented by two backends (selected with USE_DCF_PIO):
+ *      dcf_cap.c     - GPIO interrupt timestamps the edges
+ *      dcf_cap_pio.c - PIO state machine measures the phases, DMA stores them
+ ******************************************************************************/
+#ifndef DCF_CAP_H
+#define DCF_CAP_H
+
+//******************************************************************************
+// Includes
+//******************************************************************************
+#include "ustime.h"
+
+//******************************************************************************
+// Defines
+//******************************************************************************
+
+// Count of capture channels (input pins captured independently)
+#define DCF_CAP_CH_CNT  2
+
+// Size of the edges ring buffer (in edges) of a channel, must be a power of 2.
+// The DCF77 signal has 2 edges per second, the buffer covers > 10 seconds.
+// Note: dcf_cap_pio.c uses DCF_CAP_RING_BITS which must match this value.
+#define DCF_CAP_BUFF    32
+
+//******************************************************************************
+// Typedefs
+//******************************************************************************
+
+// Captured edge
+typedef struct {
+    ustime_t ustime;    // System time in us when the edge occurred
+    bool level;         // Input pin level after the edge
+} dcf_edge_t;
+
+//******************************************************************************
+// Exported Functions
+//******************************************************************************
+
+// Init the capture of the DCF77 input signal of a channel
+void dcf_cap_init(unsigned int ch, unsigned int pin);
+
+// Get the next captured edge of a channel (if there is any)
+bool dcf_cap_get_edge(unsigned int ch, dcf_edge_t * edge_ptr);
+
+// Get the actual input pin level of a channel
+bool dcf_cap_get_level(unsigned int ch);
+
+// Get the count of edges of a channel lost because the ring buffer was full
+uint32_t dcf_cap_get_lost(unsigned int ch);
+
+//******************************************************************************
+#endif /* DCF_CAP_H */
@@ -0,0 +1,199 @@
+/*******************************************************************************
+ * This file is part of the MstHora distribution.
+ * Copyright (c) 2024 Igor Marinescu (igor.marinescu@gmail.com).
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, version 3.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see <http://www.gnu.org/licenses/>.
+ ******************************************************************************/
+/*******************************************************************************
+ * dcf_cap_pio - captures the edges of the DCF77 input signal using a PIO
+ * state machine (see dcf_cap.pio). The state machine measures the duration of
+ * every high and low phase, the DMA streams the measured durations into a ring
+ * buffer. The CPU is not involved in the measurement. Every channel (input pin)
+ * has its own state machine, DMA channel and ring buffer. The module implements
+ * the same interface (dcf_cap.h) as the interrupt based capture (dcf_cap.c).
+ ******************************************************************************/
+
+//******************************************************************************
+// Includes
+//******************************************************************************
+#include <stdint.h>
+#include <stdio.h>
+
+#include "pico/stdlib.h"
+#include "hardware/pio.h"
+#include "hardware/dma.h"
+#include "hardware/clocks.h"
+
+#include "dcf_cap.h"
+#include "dcf_cap.pio.h"
+
+//******************************************************************************
+// Defines
+//******************************************************************************
+#define DCF_CAP_PIO             pio0
+
+// Frequency of the state machine: 1 loop iteration (2 cycles) = 1us
+#define DCF_CAP_PIO_FREQ        2000000UL
+
+// Time added by the state machine to every measured phase (see dcf_cap.pio)
+#define DCF_CAP_PIO_EXTRA_US    3UL
+
+// DMA transfer count (the DMA runs "forever": 2 words/sec -> ~68 years)
+#define DCF_CAP_DMA_CNT         0xFFFFFFFFUL
+
+// Ring buffer size in bytes as power of 2 (used by DMA address wrapping)
+#define DCF_CAP_RING_BITS       7
+#if ((1 << DCF_CAP_RING_BITS) != (DCF_CAP_BUFF * 4))
+#error "DCF_CAP_RING_BITS doesn't match DCF_CAP_BUFF"
+#endif
+
+//******************************************************************************
+// Global Variables
+//******************************************************************************
+
+// Capture channel: ring buffer written by DMA (must be aligned to its size for
+// address wrapping). The count of written words is derived from the DMA
+// transfer counter, only the consumer (dcf_cap_get_edge) modifies rd_cnt,
+// no lock is required.
+typedef struct {
+    volatile uint32_t buff[DCF_CAP_BUFF] __attribute__((aligned(1 << DCF_CAP_RING_BITS)));
+    uint32_t rd_cnt;        // Count of words read from ring buffer
+    uint32_t lost;          // Count of lost edges (words overwritten by DMA)
+    unsigned int pin;       // Input pin
+    unsigned int sm;        // State machine
+    unsigned int dma;       // DMA channel
+    ustime_t ustime;        // Timestamp of the last reconstructed edge
+} cap_ch_t;
+
+static cap_ch_t cap_ch[DCF_CAP_CH_CNT];
+
+static bool cap_prog_loaded = false;    // PIO program loaded (shared by all channels)
+static unsigned int cap_prog_offset = 0;
+
+/***************************************************************************//**
+* @brief Get the count of words written by DMA into the ring buffer
+* @param ch_ptr [in] capture channel
+* @return count of written words (free running counter)
+*******************************************************************************/
+static inline uint32_t get_wr_cnt(const cap_ch_t * ch_ptr)
+{
+    return (DCF_CAP_DMA_CNT - dma_channel_hw_addr(ch_ptr->dma)->transfer_count);
+}
+
+/***************************************************************************//**
+* @brief Init the capture of the DCF77 input signal of a channel. Load the PIO
+*        program (once), configure a state machine and a DMA channel.
+* @param ch [in] capture channel 0..DCF_CAP_CH_CNT-1
+* @param pin [in] index of the pin where the DCF77 signal is connected
+*******************************************************************************/
+void dcf_cap_init(unsigned int ch, unsigned int pin)
+{
+    if(ch >= DCF_CAP_CH_CNT)
+        return;
+
+    cap_ch_t * ch_ptr = &cap_ch[ch];
+    ch_ptr->pin = pin;
+    ch_ptr->rd_cnt = 0;
+    ch_ptr->lost = 0;
+
+    gpio_init(pin);
+    gpio_set_dir(pin, GPIO_IN);
+    gpio_set_pulls(pin, /*pull-up*/ false, /*pull-down*/ false);
+
+    if(!cap_prog_loaded)
+    {
+        cap_prog_offset = pio_add_program(DCF_CAP_PIO, &dcf_cap_program);
+        cap_prog_loaded = true;
+    }
+    ch_ptr->sm = (unsigned int) pio_claim_unused_sm(DCF_CAP_PIO, true);
+    float div = (float) clock_get_hz(clk_sys) / (float) DCF_CAP_PIO_FREQ;
+    dcf_cap_program_init(DCF_CAP_PIO, ch_ptr->sm, cap_prog_offset, pin, div);
+
+    // DMA: PIO RX FIFO -> ring buffer
+    ch_ptr->dma = (unsigned int) dma_claim_unused_channel(true);
+    dma_channel_config c = dma_channel_get_default_config(ch_ptr->dma);
+    channel_config_set_transfer_data_size(&c, DMA_SIZE_32);
+    channel_config_set_read_increment(&c, false);
+    channel_config_set_write_increment(&c, true);
+    channel_config_set_ring(&c, /*write*/ true, DCF_CAP_RING_BITS);
+    channel_config_set_dreq(&c, pio_get_dreq(DCF_CAP_PIO, ch_ptr->sm, /*is_tx*/ false));
+    dma_channel_configure(ch_ptr->dma, &c, ch_ptr->buff, &DCF_CAP_PIO->rxf[ch_ptr->sm],
+            DCF_CAP_DMA_CNT, /*start*/ true);
+
+    // The first measured phase starts now
+    ch_ptr->ustime = ustime_now();
+    pio_sm_set_enabled(DCF_CAP_PIO, ch_ptr->sm, true);
+}
+
+/***************************************************************************//**
+* @brief Get the next captured edge of a channel (if there is any). The edge
+*        timestamp is reconstructed by adding the measured phase duration to
+*        the timestamp of the previous edge.
+* @param ch [in] capture channel
+* @param edge_ptr [out] pointer to edge where the captured edge is copied
+* @return true if an edge was copied or false if there is no captured edge
+*******************************************************************************/
+bool dcf_cap_get_edge(unsigned int ch, dcf_edge_t * edge_ptr)
+{
+    if(ch >= DCF_CAP_CH_CNT)
+        return false;
+
+    cap_ch_t * ch_ptr = &cap_ch[ch];
+    uint32_t wr_cnt = get_wr_cnt(ch_ptr);
+    if(wr_cnt == ch_ptr->rd_cnt)
+        return false;
+
+    // Words overwritten by DMA? Skip them and re-sync the timestamp
+    if((wr_cnt - ch_ptr->rd_cnt) > DCF_CAP_BUFF)
+    {
+        ch_ptr->lost += (wr_cnt - ch_ptr->rd_cnt) - DCF_CAP_BUFF;
+        ch_ptr->rd_cnt = wr_cnt - DCF_CAP_BUFF;
+        ch_ptr->ustime = ustime_now();
+    }
+
+    uint32_t word = ch_ptr->buff[ch_ptr->rd_cnt & (DCF_CAP_BUFF - 1)];
+    ch_ptr->rd_cnt++;
+
+    // Bits 31..1: 0x7FFFFFFF - loop iterations, bit 0: 0 - high phase, 1 - low phase
+    ustime_t len = (ustime_t)(0x7FFFFFFFUL - (word >> 1)) + DCF_CAP_PIO_EXTRA_US;
+    ch_ptr->ustime += len;
+
+    edge_ptr->ustime = ch_ptr->ustime;
+    edge_ptr->level = ((word & 1UL) != 0);  // after a low phase the pin is high
+    return true;
+}
+
+/***************************************************************************//**
+* @brief Get the actual input pin level of a channel
+* @param ch [in] capture channel
+* @return input pin level
+*******************************************************************************/
+bool dcf_cap_get_level(unsigned int ch)
+{
+    if(ch >= DCF_CAP_CH_CNT)
+        return false;
+    return gpio_get(cap_ch[ch].pin);
+}
+
+/***************************************************************************//**
+* @brief Get the count of edges of a channel lost because the ring buffer was
+*        overwritten
+* @param ch [in] capture channel
+* @return count of lost edges
+*******************************************************************************/
+uint32_t dcf_cap_get_lost(unsigned int ch)
+{
+    if(ch >= DCF_CAP_CH_CNT)
+        return 0;
+    return cap_ch[ch].lost;
+}
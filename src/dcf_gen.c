@@ -0,0 +1,338 @@
+/*******************************************************************************
+ * This file is part of the MstHora distribution.
+ * Copyright (c) 2024 Igor Marinescu (igor.marinescu@gmail.com).
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, version 3.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see <http://www.gnu.org/licenses/>.
+ ******************************************************************************/
+/*******************************************************************************
+ * dcf_gen - synthetic DCF77 signal generator. The edges of every second are
+ * generated in advance (pulse start/end and an optional spike) and returned
+ * when they are due. Every minute transmits the telegram of the next minute.
+ * Every instance (dcf_gen_t) generates one stream, the streams of the same
+ * scenario carry the same telegrams with independent noise (two receivers).
+ *
+ *  second:  0     1 ...  15  16  17  18  19  20  21..27 28  29..34 35  36..57 58  59
+ *  bit:     0  weather   R   A1  Z1  Z2  A2  1   min    P1  hour   P2  date   P3  -
+ ******************************************************************************/
+
+//******************************************************************************
+// Includes
+//******************************************************************************
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+
+#include "pico/stdlib.h"
+
+#include "dcf_gen.h"
+#include "datetime_utils.h"
+#include "utils.h"
+#include "in_out.h"
+
+//******************************************************************************
+// Defines
+//******************************************************************************
+#define GEN_SEC         1000000L    // 1 second in us
+#define GEN_BIT0_LEN    100000L     // Length [us] of a 0-bit pulse
+#define GEN_BIT1_LEN    200000L     // Length [us] of a 1-bit pulse
+#define GEN_SPIKE_LEN   20000L      // Length [us] of a spike
+#define GEN_GLITCH_LEN  3000L       // Length [us] of a glitch (signal dropout) inside a pulse
+#define GEN_STREAM_SEED 7919        // Seed difference between the streams
+
+//******************************************************************************
+// Global Variables
+//******************************************************************************
+
+// Predefined scenarios
+//   name    | start: year, month, day, dotw, hour, min, sec | cest | minutes | jitter | drop | spike | glitch | fade | dst | leap | seed
+static const dcf_gen_cfg_t gen_scenarios[] = {
+    { "clean",    { 2024,  5, 14, 2, 10,  0, 0 }, true,  30,  2000,   0,   0,   0,   0,  0, -1, -1, 1 },
+    { "jitter",   { 2024,  5, 14, 2, 10,  0, 0 }, true,  30, 25000,   0,   0,   0,   0,  0, -1, -1, 2 },
+    { "drop",     { 2024,  5, 14, 2, 10,  0, 0 }, true,  30, 10000, 100,   0,   0,   0,  0, -1, -1, 3 },
+    { "spike",    { 2024,  5, 14, 2, 10,  0, 0 }, true,  30, 10000,   0, 300,   0,   0,  0, -1, -1, 4 },
+    { "fade",     { 2024,  5, 14, 2, 10,  0, 0 }, true,  30, 10000,  50,   0,   0, 180, 30, -1, -1, 5 },
+    { "midnight", { 2024, 12, 31, 2, 23, 50, 0 }, false, 30,  5000,   0,   0,   0,   0,  0, -1, -1, 6 },
+    { "dst",      { 2024,  3, 31, 0,  1, 45, 0 }, false, 30,  5000,   0,   0,   0,   0,  0, 15, -1, 7 },
+    { "dst_back", { 2024, 10, 27, 0,  2, 45, 0 }, true,  30,  5000,   0,   0,   0,   0,  0, 15, -1, 8 },
+    { "leap",     { 2017,  1,  1, 0,  0, 45, 0 }, false, 30,  5000,   0,   0,   0,   0,  0, -1, 14, 9 },
+    { "glitch",   { 2024,  5, 14, 2, 10,  0, 0 }, true,  30, 10000,   0, 300, 500,   0,  0, -1, -1, 10 },
+};
+static const int gen_scenarios_cnt = sizeof(gen_scenarios) / sizeof(dcf_gen_cfg_t);
+
+/***************************************************************************//**
+* @brief Get a pseudo-random number (xorshift32, reproducible with the seed)
+* @param gen [in/out] generator instance
+* @return random number
+*******************************************************************************/
+static uint32_t gen_random(dcf_gen_t * gen)
+{
+    gen->rnd ^= gen->rnd << 13;
+    gen->rnd ^= gen->rnd >> 17;
+    gen->rnd ^= gen->rnd << 5;
+    return gen->rnd;
+}
+
+/***************************************************************************//**
+* @brief Get a random jitter
+* @param gen [in/out] generator instance
+* @return random jitter in us: -jitter_us..+jitter_us
+*******************************************************************************/
+static int32_t gen_jitter(dcf_gen_t * gen)
+{
+    if(gen->cfg.jitter_us <= 0)
+        return 0;
+    return (int32_t)(gen_random(gen) % (uint32_t)(2 * gen->cfg.jitter_us + 1)) - gen->cfg.jitter_us;
+}
+
+/***************************************************************************//**
+* @brief Set a BCD coded field followed by its even parity bit
+* @param gen [in/out] generator instance
+* @param val [in] value of the field
+* @param start_idx [in] index of the first bit of the field
+* @param cnt [in] count of bits of the field
+* @param parity_idx [in] index of the parity bit, -1: no parity bit
+* @return parity of the field
+*******************************************************************************/
+static int gen_set_field(dcf_gen_t * gen, const int val, const int start_idx, const int cnt, const int parity_idx)
+{
+    uint8_t bcd = int8_to_bcd((uint8_t) val);
+    int parity = 0;
+
+    for(int i = 0; i < cnt; i++)
+    {
+        gen->bits[start_idx + i] = (bcd >> i) & 1;
+        parity ^= gen->bits[start_idx + i];
+    }
+    if(parity_idx >= 0)
+        gen->bits[parity_idx] = (uint8_t) parity;
+    return parity;
+}
+
+/***************************************************************************//**
+* @brief Build the telegram transmitted in the actual minute (it describes the
+*        next minute), apply the DST change and the leap second.
+* @param gen [in/out] generator instance
+*******************************************************************************/
+static void gen_minute(dcf_gen_t * gen)
+{
+    datetime_copy(&gen->dt_next, &gen->dt);
+    datetime_add_sec(&gen->dt_next, 60);
+    gen->cest_next = gen->cest;
+
+    // DST change at the beginning of minute dst_min: CET->CEST +1h, CEST->CET -1h
+    if((gen->min_idx + 1) == gen->cfg.dst_min)
+    {
+        gen->cest_next = !gen->cest;
+        datetime_add_sec(&gen->dt_next, gen->cest_next ? 3600 : -3600);
+    }
+
+    memset(gen->bits, 0, sizeof(gen->bits));
+    for(int i = 1; i <= 14; i++)
+        gen->bits[i] = gen_random(gen) & 1;
+
+    int dst_dist = gen->cfg.dst_min - gen->min_idx;
+    int leap_dist = gen->cfg.leap_min - gen->min_idx;
+    gen->bits[16] = ((gen->cfg.dst_min >= 0) && (dst_dist > 0) && (dst_dist <= 60));
+    gen->bits[17] = gen->cest_next;
+    gen->bits[18] = !gen->cest_next;
+    // A2 only in the hour before the leap second, not in the minute that contains it
+    gen->bits[19] = ((gen->cfg.leap_min >= 0) && (leap_dist > 0) && (leap_dist <= 60));
+    gen->bits[20] = 1;
+
+    gen_set_field(gen, gen->dt_next.min, 21, 7, 28);
+    gen_set_field(gen, gen->dt_next.hour, 29, 6, 35);
+    int parity = gen_set_field(gen, gen->dt_next.day, 36, 6, -1);
+    parity ^= gen_set_field(gen, (gen->dt_next.dotw == 0) ? 7 : gen->dt_next.dotw, 42, 3, -1);
+    parity ^= gen_set_field(gen, gen->dt_next.month, 45, 5, -1);
+    parity ^= gen_set_field(gen, gen->dt_next.year % 100, 50, 8, -1);
+    gen->bits[58] = (uint8_t) parity;
+
+    // Leap second: second 59 has a 0-bit pulse, second 60 is the marker
+    gen->sec_cnt = (gen->min_idx == gen->cfg.leap_min) ? 61 : 60;
+}
+
+/***************************************************************************//**
+* @brief Add an edge to the edges of the actual second
+* @param gen [in/out] generator instance
+* @param ustime [in] time of the edge
+* @param level [in] pin level after the edge
+*******************************************************************************/
+static void gen_add_edge(dcf_gen_t * gen, const ustime_t ustime, const bool level)
+{
+    if(gen->edges_cnt < DCF_GEN_EDGES)
+    {
+        gen->edges[gen->edges_cnt].ustime = ustime;
+        gen->edges[gen->edges_cnt].level = level;
+        gen->edges_cnt++;
+    }
+}
+
+/***************************************************************************//**
+* @brief Generate the edges of the next second. The pulse is active low
+*        (pin level low during the pulse).
+* @param gen [in/out] generator instance
+* @return true if generated, false if all minutes are generated
+*******************************************************************************/
+static bool gen_second(dcf_gen_t * gen)
+{
+    if(gen->sec >= gen->sec_cnt)
+    {
+        gen->min_time += (ustime_t)(gen->sec_cnt * GEN_SEC);
+        gen->sec = 0;
+        if(++gen->min_idx >= gen->cfg.minutes)
+            return false;
+        datetime_copy(&gen->dt, &gen->dt_next);
+        gen->cest = gen->cest_next;
+        gen_minute(gen);
+    }
+
+    ustime_t sec_time = gen->min_time + (ustime_t)(gen->sec * GEN_SEC);
+    gen->edges_cnt = 0;
+    gen->edges_idx = 0;
+
+    bool fading = (gen->cfg.fade_period_s > 0)
+            && ((gen->sec_total % (uint32_t) gen->cfg.fade_period_s) < (uint32_t) gen->cfg.fade_len_s);
+
+    if(!fading)
+    {
+        // Pulse (no pulse at the marker second, dropped pulses)
+        if((gen->sec < (gen->sec_cnt - 1)) && ((int)(gen_random(gen) % 1000) >= gen->cfg.drop_pm))
+        {
+            int32_t len = gen->bits[gen->sec] ? GEN_BIT1_LEN : GEN_BIT0_LEN;
+            gen_add_edge(gen, sec_time + (ustime_t) gen_jitter(gen), false);
+
+            // Glitch (short signal dropout) between 30ms and len-30ms of the pulse
+            if((gen->cfg.glitch_pm > 0) && ((int)(gen_random(gen) % 1000) < gen->cfg.glitch_pm))
+            {
+                ustime_t glitch_time = sec_time + (ustime_t)(30000UL + (gen_random(gen) % (uint32_t)(len - 60000L)));
+                gen_add_edge(gen, glitch_time, true);
+                gen_add_edge(gen, glitch_time + GEN_GLITCH_LEN, false);
+            }
+            gen_add_edge(gen, sec_time + (ustime_t)(len + gen_jitter(gen)), true);
+        }
+
+        // Spike between 300ms and 800ms
+        if((int)(gen_random(gen) % 1000) < gen->cfg.spike_pm)
+        {
+            ustime_t spike_time = sec_time + (ustime_t)(300000UL + (gen_random(gen) % 500000UL));
+            gen_add_edge(gen, spike_time, false);
+            gen_add_edge(gen, spike_time + GEN_SPIKE_LEN, true);
+        }
+    }
+
+    gen->sec++;
+    gen->sec_total++;
+    return true;
+}
+
+/***************************************************************************//**
+* @brief Find a predefined scenario by name
+* @param name [in] scenario name
+* @return pointer to the scenario or NULL if not found
+*******************************************************************************/
+const dcf_gen_cfg_t * dcf_gen_find(const char * name)
+{
+    for(int i = 0; i < gen_scenarios_cnt; i++)
+    {
+        if(!strcmp(name, gen_scenarios[i].name))
+            return &gen_scenarios[i];
+    }
+    return NULL;
+}
+
+/***************************************************************************//**
+* @brief Print the names of the predefined scenarios
+*******************************************************************************/
+void dcf_gen_list(void)
+{
+    io_puts("dcf77 gen scenarios:");
+    for(int i = 0; i < gen_scenarios_cnt; i++)
+        io_printf(" %s", gen_scenarios[i].name);
+    io_puts("\r\n");
+}
+
+/***************************************************************************//**
+* @brief Start generating the edges of a scenario
+* @param gen [out] generator instance
+* @param cfg_ptr [in] pointer to scenario
+* @param minutes [in] count of minutes to generate, <= 0: scenario default
+* @param stream [in] index of the stream (several receivers of the same signal)
+* @param sys_ustime [in] system time in us
+*******************************************************************************/
+void dcf_gen_start(dcf_gen_t * gen, const dcf_gen_cfg_t * cfg_ptr, int minutes, const int stream, const ustime_t sys_ustime)
+{
+    memcpy(&gen->cfg, cfg_ptr, sizeof(gen->cfg));
+    if(minutes > 0)
+        gen->cfg.minutes = minutes;
+
+    // The streams differ only in the seed (noise), the telegrams are the same
+    gen->cfg.seed += (uint32_t) stream * GEN_STREAM_SEED;
+    gen->rnd = (gen->cfg.seed != 0) ? gen->cfg.seed : 1;
+    gen->min_idx = 0;
+    gen->sec = 0;
+    gen->sec_total = 0;
+    gen->min_time = sys_ustime + DCF_GEN_START_DELAY;
+    datetime_copy(&gen->dt, &gen->cfg.start);
+    gen->cest = gen->cfg.cest;
+    gen_minute(gen);
+
+    gen->edges_cnt = 0;
+    gen->edges_idx = 0;
+    gen->running = true;
+}
+
+/***************************************************************************//**
+* @brief Check if the generator is running (stops after the last minute)
+* @param gen [in] generator instance
+* @return true if running
+*******************************************************************************/
+bool dcf_gen_is_running(const dcf_gen_t * gen)
+{
+    return gen->running;
+}
+
+/***************************************************************************//**
+* @brief Get the next generated edge which is due at sys_ustime
+* @param gen [in/out] generator instance
+* @param edge_ptr [out] pointer to edge where the generated edge is copied
+* @param sys_ustime [in] system time in us
+* @return true if an edge was copied or false if there is no edge due
+*******************************************************************************/
+bool dcf_gen_get(dcf_gen_t * gen, dcf_edge_t * edge_ptr, const ustime_t sys_ustime)
+{
+    while(gen->running && (gen->edges_idx >= gen->edges_cnt))
+    {
+        // Generate the next second only when the actual one is over
+        ustime_t next_time = gen->min_time + (ustime_t)(gen->sec * GEN_SEC);
+        if(sys_ustime < (next_time - (GEN_SEC / 2)))
+            return false;
+        if(!gen_second(gen))
+            gen->running = false;
+    }
+
+    if(!gen->running || (sys_ustime < gen->edges[gen->edges_idx].ustime))
+        return false;
+
+    *edge_ptr = gen->edges[gen->edges_idx++];
+    return true;
+}
+
+/***************************************************************************//**
+* @brief Get the datetime of the minute being generated
+* @param gen [in] generator instance
+* @return pointer to datetime of the actual minute
+*******************************************************************************/
+const datetime_t * dcf_gen_get_datetime(const dcf_gen_t * gen)
+{
+    return &gen->dt;
+}
@@ -0,0 +1,106 @@
+/*******************************************************************************
+ * This file is part of the MstHora distribution.
+ * Copyright (c) 2024 Igor Marinescu (igor.marinescu@gmail.com).
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, version 3.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see <http://www.gnu.org/licenses/>.
+ ******************************************************************************/
+/*******************************************************************************
+ * dcf_gen - synthetic DCF77 signal generator. Generates the edges of the
+ * DCF77 signal for a given start datetime (in real time, as the edges are due)
+ * with configurable impairments: pulse-width jitter, dropped pulses, spurious
+ * spikes, glitches inside the pulses, fading periods, DST change and leap second.
+ ******************************************************************************/
+#ifndef DCF_GEN_H
+#define DCF_GEN_H
+
+//******************************************************************************
+// Includes
+//******************************************************************************
+#include "pico/types.h"
+#include "dcf_cap.h"
+
+//******************************************************************************
+// Defines
+//******************************************************************************
+
+// Delay [us] from the generator start until the first generated pulse
+#define DCF_GEN_START_DELAY     1000000UL
+
+// Maximal count of edges in a second
+#define DCF_GEN_EDGES           6
+
+//******************************************************************************
+// Typedefs
+//******************************************************************************
+
+// Generator configuration (scenario)
+typedef struct {
+    const char * name;      // Scenario name
+    datetime_t start;       // Datetime of the first generated minute (local time)
+    bool cest;              // The start datetime is summer time (CEST)
+    int minutes;            // Count of generated minutes
+    int32_t jitter_us;      // Maximal jitter [us] of every edge
+    int drop_pm;            // Probability [1/1000] of a dropped pulse
+    int spike_pm;           // Probability [1/1000] of a spike in a second
+    int glitch_pm;          // Probability [1/1000] of a glitch (dropout) inside a pulse
+    int fade_period_s;      // Period [s] of the fading (0: no fading)
+    int fade_len_s;         // Length [s] of the fading (no signal)
+    int dst_min;            // Minute index when the DST changes (-1: no change)
+    int leap_min;           // Minute index with the leap second (-1: no leap second)
+    uint32_t seed;          // Seed of the random generator
+} dcf_gen_cfg_t;
+
+// Generator instance (one synthetic stream)
+typedef struct {
+    dcf_gen_cfg_t cfg;
+    bool running;
+    uint32_t rnd;               // State of the random generator
+
+    int min_idx;                // Index of the actual minute
+    int sec;                    // Actual second in minute
+    int sec_cnt;                // Count of seconds in the actual minute (61: leap second)
+    uint32_t sec_total;         // Seconds since start
+    ustime_t min_time;          // Time in us of the second 0 of the actual minute
+    datetime_t dt;              // Datetime of the actual minute
+    bool cest;                  // Actual minute is summer time
+    datetime_t dt_next;         // Datetime of the next minute (transmitted)
+    bool cest_next;             // Next minute is summer time
+    uint8_t bits[61];           // Transmitted telegram
+
+    dcf_edge_t edges[DCF_GEN_EDGES];    // Edges of the actual second
+    int edges_cnt;
+    int edges_idx;
+} dcf_gen_t;
+
+//******************************************************************************
+// Exported Functions
+//******************************************************************************
+
+// Find a predefined scenario by name (NULL if not found)
+const dcf_gen_cfg_t * dcf_gen_find(const char * name);
+
+// Print the names of the predefined scenarios
+void dcf_gen_list(void);
+
+// Start generating the edges of a scenario (stream: index of the receiver)
+void dcf_gen_start(dcf_gen_t * gen, const dcf_gen_cfg_t * cfg_ptr, int minutes, const int stream, const ustime_t sys_ustime);
+bool dcf_gen_is_running(const dcf_gen_t * gen);
+
+// Get the next generated edge which is due at sys_ustime (if there is any)
+bool dcf_gen_get(dcf_gen_t * gen, dcf_edge_t * edge_ptr, const ustime_t sys_ustime);
+
+// Get the datetime of the minute being generated (the truth for the decoder)
+const datetime_t * dcf_gen_get_datetime(const dcf_gen_t * gen);
+
+//******************************************************************************
+#endif /* DCF_GEN_H */
@@ -0,0 +1,405 @@
+/*******************************************************************************
+ * This file is part of the MstHora distribution.
+ * Copyright (c) 2024 Igor Marinescu (igor.marinescu@gmail.com).
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, version 3.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see <http://www.gnu.org/licenses/>.
+ ******************************************************************************/
+/*******************************************************************************
+ * dcf_pwr - duty-cycles the DCF77 receiver using a learned per-hour
+ * reception profile (stored in the EEPROM).
+ *
+ * Every hour the receiver was on for at least DCF_PWR_OBS_MIN_S is rated:
+ *
+ *      obs = (average quality + decoded minutes per on-minute) / 2  [0..255]
+ *      score[hour] += (obs - score[hour]) / 2^DCF_PWR_EMA_SHIFT
+ *
+ * The DCF_PWR_WIN_HOURS hours with the best score are the reception windows.
+ * Once a day the probe hour moves to the next hour outside the windows and
+ * the profile is saved.
+ ******************************************************************************/
+
+//******************************************************************************
+// Includes
+//******************************************************************************
+#include <stdint.h>
+#include <string.h>
+
+#include "pico/stdlib.h"
+
+#include "dcf_pwr.h"
+#include "dcf77.h"
+#include "i2c_drv.h"
+#include "i2c_manager.h"
+
+//******************************************************************************
+// Global Variables
+//******************************************************************************
+static dcf_pwr_prof_t pwr_prof;         // Reception profile
+static dcf_pwr_prof_t pwr_prof_mem;     // Copy of the profile being read/written
+static bool pwr_load_req = false;       // The read of the profile is accepted by the I2C manager
+static bool pwr_loaded = false;         // The profile read from the EEPROM (or failed)
+static bool pwr_save = false;           // The profile must be saved
+static uint32_t pwr_win = 0;            // Bit mask of the reception windows (hours)
+
+static dcf_pwr_mode_t pwr_mode = dcf_pwr_mode_auto;
+static dcf_pwr_reason_t pwr_reason = dcf_pwr_learn;
+static bool pwr_on = false;             // Receiver powered on
+
+// Observation of the current hour
+static int pwr_hour = -1;               // Current hour, -1: not known
+static int pwr_day = -1;                // Current day of month, -1: not known
+static uint32_t obs_on_s = 0;           // Seconds the receiver was on
+static uint32_t obs_q_sum = 0;          // Sum of the quality samples
+static uint32_t obs_dec = 0;            // Count of decoded minutes
+
+// Holdover and duty cycle
+static bool dec_valid = false;          // A minute was decoded since power-on
+static s_time_t dec_s_time = 0;         // Time of the last decoded minute
+static s_time_t pwr_s_time = 0;         // Time of the last poll
+static int32_t pwr_hold_ms = -1;        // Estimated holdover error of the last poll
+static uint32_t duty_on_s = 0;          // Seconds on since power-on
+static uint32_t duty_total_s = 0;       // Seconds since power-on
+
+/***************************************************************************//**
+* @brief Calculate the checksum of a profile
+* @param prof_ptr [in] pointer to profile
+* @return the value of the check byte so that the sum of all bytes is 0
+*******************************************************************************/
+static uint8_t prof_check(const dcf_pwr_prof_t * prof_ptr)
+{
+    const uint8_t * ptr = (const uint8_t *) prof_ptr;
+    uint8_t sum = 0;
+    for(unsigned i = 0; i < (sizeof(dcf_pwr_prof_t) - 1); i++)
+        sum += ptr[i];
+    return (uint8_t)(0 - sum);
+}
+
+/***************************************************************************//**
+* @brief Calculate the reception windows: the DCF_PWR_WIN_HOURS hours with
+*        the best score (equal scores: the earlier hour wins)
+*******************************************************************************/
+static void prof_update_win(void)
+{
+    pwr_win = 0;
+    for(int h = 0; h < 24; h++)
+    {
+        int rank = 0;
+        for(int g = 0; g < 24; g++)
+        {
+            if((pwr_prof.score[g] > pwr_prof.score[h]) || 
+               ((pwr_prof.score[g] == pwr_prof.score[h]) && (g < h)))
+                rank++;
+        }
+        if(rank < DCF_PWR_WIN_HOURS)
+            pwr_win |= (1UL << h);
+    }
+}
+
+/***************************************************************************//**
+* @brief Init the profile (nothing learned)
+*******************************************************************************/
+static void prof_init(void)
+{
+    memset(&pwr_prof, 0, sizeof(pwr_prof));
+    pwr_prof.magic = DCF_PWR_MAGIC;
+    memset(pwr_prof.score, 128, sizeof(pwr_prof.score));
+    pwr_prof.check = prof_check(&pwr_prof);
+    prof_update_win();
+}
+
+/***************************************************************************//**
+* @brief Callback when the profile is read from the EEPROM
+* @param result [in] read result (i2c_err_t converted to int)
+*******************************************************************************/
+static void prof_read_callback(int result)
+{
+    // Cleared while reading
+    if(pwr_loaded)
+        return;
+
+    if((((i2c_err_t) result) == i2c_success) && (pwr_prof_mem.magic == DCF_PWR_MAGIC) &&
+       (pwr_prof_mem.check == prof_check(&pwr_prof_mem)))
+    {
+        memcpy(&pwr_prof, &pwr_prof_mem, sizeof(pwr_prof));
+        prof_update_win();
+        DCF_PWR_LOG("dcf_pwr: profile loaded, days=%u\r\n", pwr_prof.days);
+    }
+    else {
+        DCF_PWR_LOG("dcf_pwr: no profile (%i)\r\n", result);
+    }
+    pwr_loaded = true;
+}
+
+/***************************************************************************//**
+* @brief Callback when the profile is written to the EEPROM
+* @param result [in] write result (i2c_err_t converted to int)
+*******************************************************************************/
+static void prof_write_callback(int result)
+{
+    DCF_PWR_LOG("dcf_pwr: profile saved (%i)\r\n", result);
+}
+
+/***************************************************************************//**
+* @brief Request to read the profile (retried every second until the request
+*        is accepted by the I2C manager, an accepted request always calls back)
+*******************************************************************************/
+static void prof_load_poll(void)
+{
+    if(pwr_load_req)
+        return;
+
+    pwr_load_req = i2c_man_req_mem_read((uint8_t *) &pwr_prof_mem, DCF_PWR_MEM_ADDR, sizeof(pwr_prof_mem),
+        prof_read_callback);
+}
+
+/***************************************************************************//**
+* @brief Save the profile if needed (retried every second until the request
+*        is accepted by the I2C manager, not before the profile is loaded)
+*******************************************************************************/
+static void prof_save_poll(void)
+{
+    if(!pwr_save || !pwr_loaded)
+        return;
+
+    pwr_prof.check = prof_check(&pwr_prof);
+    memcpy(&pwr_prof_mem, &pwr_prof, sizeof(pwr_prof));
+    if(i2c_man_req_mem_write(DCF_PWR_MEM_ADDR, (const uint8_t *) &pwr_prof_mem, sizeof(pwr_prof_mem), 
+            prof_write_callback))
+        pwr_save = false;
+}
+
+/***************************************************************************//**
+* @brief Rate the finished hour (if observed long enough) and clear the 
+*        observation
+* @param hour [in] the finished hour 0..23, -1: not known (not rated)
+*******************************************************************************/
+static void obs_hour_end(const int hour)
+{
+    if((hour >= 0) && (obs_on_s >= DCF_PWR_OBS_MIN_S))
+    {
+        int q = (int)((obs_q_sum * 255UL) / (obs_on_s * 100UL));
+        int dec = (int)((obs_dec * 60UL * 255UL) / obs_on_s);
+        if(dec > 255)
+            dec = 255;
+        int obs = (q + dec) / 2;
+        int score = pwr_prof.score[hour];
+        score += (obs - score) / (1 << DCF_PWR_EMA_SHIFT);
+        pwr_prof.score[hour] = (uint8_t) score;
+        prof_update_win();
+        DCF_PWR_LOG("dcf_pwr: hour %i q=%i dec=%i score=%i\r\n", hour, q, dec, score);
+    }
+
+    obs_on_s = 0;
+    obs_q_sum = 0;
+    obs_dec = 0;
+}
+
+/***************************************************************************//**
+* @brief A day finished: count the learned days, move the probe hour to the
+*        next hour outside the reception windows and save the profile
+*******************************************************************************/
+static void obs_day_end(void)
+{
+    if(pwr_prof.days < 255)
+        pwr_prof.days++;
+
+    for(int i = 1; i <= 24; i++)
+    {
+        int h = (pwr_prof.probe + i) % 24;
+        if(!(pwr_win & (1UL << h)))
+        {
+            pwr_prof.probe = (uint8_t) h;
+            break;
+        }
+    }
+    pwr_save = true;
+}
+
+/***************************************************************************//**
+* @brief Decide if the receiver must be on
+* @return reason of the power state
+*******************************************************************************/
+static dcf_pwr_reason_t pwr_decide(void)
+{
+    if(pwr_mode != dcf_pwr_mode_auto)
+        return dcf_pwr_forced;
+    if(!pwr_loaded || (pwr_prof.days < DCF_PWR_LEARN_DAYS))
+        return dcf_pwr_learn;
+    if(pwr_hour < 0)
+        return dcf_pwr_no_time;
+    if(!dec_valid || (dcf_pwr_get_holdover() > DCF_PWR_HOLD_MAX_MS))
+        return dcf_pwr_holdover;
+    if(pwr_win & (1UL << pwr_hour))
+        return dcf_pwr_window;
+    if(pwr_hour == pwr_prof.probe)
+        return dcf_pwr_probe;
+    return dcf_pwr_off;
+}
+
+/***************************************************************************//**
+* @brief Power on/off the receiver and the decoder
+* @param on [in] true: power on, false: power off
+* @param sys_ustime [in] system time in us
+*******************************************************************************/
+static void pwr_set(const bool on, const ustime_t sys_ustime)
+{
+    if(on == pwr_on)
+        return;
+
+    pwr_on = on;
+    gpio_put(DCF_PWR_PIN, (on ? DCF_PWR_ON_LEVEL : !DCF_PWR_ON_LEVEL));
+    dcf_set_enabled(on, sys_ustime);
+    DCF_PWR_LOG("dcf_pwr: receiver %s (%i)\r\n", (on ? "on" : "off"), (int) pwr_reason);
+}
+
+/***************************************************************************//**
+* @brief Init the module: power on the receiver and request the profile from
+*        the EEPROM (the receiver stays on until the profile is loaded).
+*        Must be called in main in init phase (after i2c_man_init).
+*******************************************************************************/
+void dcf_pwr_init(void)
+{
+    gpio_init(DCF_PWR_PIN);
+    gpio_set_dir(DCF_PWR_PIN, GPIO_OUT);
+    gpio_put(DCF_PWR_PIN, DCF_PWR_ON_LEVEL);
+    pwr_on = true;
+
+    prof_init();
+    pwr_loaded = false;
+    pwr_load_req = false;
+    prof_load_poll();
+}
+
+/***************************************************************************//**
+* @brief Poll the module. Must be called every second.
+* @param dt_ptr [in] pointer to the local datetime, NULL if not known
+* @param quality [in] signal quality 0..100% (dcf_get_quality)
+* @param hold_ms [in] holdover error [ms] of the RTC since the last decoded
+*        minute estimated from its measured drift, -1 if not estimated yet
+*        (DCF_PWR_DRIFT_PPM is used)
+* @param s_time [in] system time in seconds
+* @param sys_ustime [in] system time in us
+* @return true if the receiver is on
+*******************************************************************************/
+bool dcf_pwr_poll(const datetime_t * dt_ptr, const int quality, const int32_t hold_ms,
+    const s_time_t s_time, const ustime_t sys_ustime)
+{
+    pwr_s_time = s_time;
+    pwr_hold_ms = hold_ms;
+    duty_total_s++;
+    if(pwr_on)
+    {
+        duty_on_s++;
+        obs_on_s++;
+        obs_q_sum += (uint32_t) quality;
+    }
+
+    if(dt_ptr == NULL)
+    {
+        pwr_hour = -1;
+    }
+    else {
+        if(dt_ptr->hour != pwr_hour)
+            obs_hour_end(pwr_hour);
+        if((pwr_day >= 0) && (dt_ptr->day != pwr_day))
+            obs_day_end();
+        pwr_hour = dt_ptr->hour;
+        pwr_day = dt_ptr->day;
+    }
+
+    prof_load_poll();
+    prof_save_poll();
+
+    pwr_reason = pwr_decide();
+    if(pwr_reason == dcf_pwr_forced)
+        pwr_set((pwr_mode == dcf_pwr_mode_on), sys_ustime);
+    else
+        pwr_set((pwr_reason != dcf_pwr_off), sys_ustime);
+    return pwr_on;
+}
+
+/***************************************************************************//**
+* @brief Notify a successfully decoded minute
+* @param s_time [in] system time in seconds
+*******************************************************************************/
+void dcf_pwr_received(const s_time_t s_time)
+{
+    dec_valid = true;
+    dec_s_time = s_time;
+    obs_dec++;
+}
+
+/***************************************************************************//**
+* @brief Set the power mode
+* @param mode [in] auto (duty-cycled), always on or always off
+*******************************************************************************/
+void dcf_pwr_set_mode(const dcf_pwr_mode_t mode)
+{
+    pwr_mode = mode;
+}
+
+/***************************************************************************//**
+* @brief Clear the profile, the receiver is on while the profile is learned
+*        again (the cleared profile is saved)
+*******************************************************************************/
+void dcf_pwr_clear(void)
+{
+    prof_init();
+    pwr_load_req = true;
+    pwr_loaded = true;
+    pwr_save = true;
+}
+
+/***************************************************************************//**
+* @brief Get the reason of the actual power state
+* @return reason
+*******************************************************************************/
+dcf_pwr_reason_t dcf_pwr_get_reason(void)
+{
+    return pwr_reason;
+}
+
+/***************************************************************************//**
+* @brief Get the reception profile
+* @return pointer to profile
+*******************************************************************************/
+const dcf_pwr_prof_t * dcf_pwr_get_profile(void)
+{
+    return &pwr_prof;
+}
+
+/***************************************************************************//**
+* @brief Get the duty cycle of the receiver since power-on
+* @return duty cycle 0..100%
+*******************************************************************************/
+int dcf_pwr_get_duty(void)
+{
+    if(duty_total_s == 0)
+        return 100;
+    return (int)(((uint64_t) duty_on_s * 100UL) / duty_total_s);
+}
+
+/***************************************************************************//**
+* @brief Get the estimated holdover error of the RTC since the last decoded
+*        minute at the last poll (measured drift, DCF_PWR_DRIFT_PPM while
+*        the drift is not estimated)
+* @return estimated error [ms], -1 if no minute was decoded since power-on
+*******************************************************************************/
+int32_t dcf_pwr_get_holdover(void)
+{
+    if(!dec_valid)
+        return -1;
+    if(pwr_hold_ms >= 0)
+        return pwr_hold_ms;
+    return (int32_t)((get_diff_s_time(pwr_s_time, dec_s_time) * DCF_PWR_DRIFT_PPM) / 1000UL);
+}
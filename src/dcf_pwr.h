@@ -0,0 +1,129 @@
+/*******************************************************************************
+ * This file is part of the MstHora distribution.
+ * Copyright (c) 2024 Igor Marinescu (igor.marinescu@gmail.com).
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, version 3.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see <http://www.gnu.org/licenses/>.
+ ******************************************************************************/
+/*******************************************************************************
+ * dcf_pwr - duty-cycles the DCF77 receiver. A per-hour reception profile is
+ * learned from the signal quality and the successfully decoded minutes and
+ * stored in the EEPROM. The receiver (power-on pin) and the decoder are
+ * switched on only in the best hours of the day, in a daily probe hour (to
+ * keep learning the other hours) or when the estimated holdover error of the
+ * RTC exceeds a limit. The module gets the time from its caller (no clock
+ * is read), the scheduling can be simulated with a virtual clock.
+ ******************************************************************************/
+#ifndef DCF_PWR_H
+#define DCF_PWR_H
+
+//******************************************************************************
+// Includes
+//******************************************************************************
+#include "pico/types.h"
+#include "ustime.h"
+
+#ifdef DCF_PWR_DEBUG
+#include DEBUG_INCLUDE
+#endif
+
+//******************************************************************************
+// Defines
+//******************************************************************************
+#ifdef DCF_PWR_DEBUG
+#define DCF_PWR_LOG(...)    DEBUG_PRINTF(__VA_ARGS__)
+#else
+#define DCF_PWR_LOG(...)    
+#endif
+
+// Power-on pin (PON) of the receiver(s), active low. Without the PON line
+// the receiver is always on, but the decoder is still disabled outside the
+// on-windows: use "dcf77 pwr on" on such a board (not stored, after every
+// power-on).
+#define DCF_PWR_PIN         11          // Power-on pin of the receiver(s)
+#define DCF_PWR_ON_LEVEL    0           // Level of the power-on pin to power on the receiver
+
+// The profile is stored in the last page of the EEPROM (AT24C32).
+// Note: the memory test overwrites it, the profile is learned again.
+#define DCF_PWR_MEM_ADDR    0x0FE0
+#define DCF_PWR_MAGIC       0xD7C1
+
+#define DCF_PWR_WIN_HOURS   6           // Count of the best hours when the receiver is on
+#define DCF_PWR_LEARN_DAYS  2           // Days the receiver is always on (learning)
+#define DCF_PWR_OBS_MIN_S   600         // Minimal on-time [s] in an hour to rate the hour
+#define DCF_PWR_EMA_SHIFT   2           // Profile filter: score += (obs - score) / 2^shift
+
+// Holdover: estimated error of the RTC since the last decoded minute, from
+// the drift measured by the caller (dt_disc). Until it is estimated the
+// DS3231 specification is used: +-2ppm (0..40 C). The receiver is switched
+// on when the error exceeds the limit: 100ms / 2ppm = 50000s ~ 14h.
+#define DCF_PWR_DRIFT_PPM   2
+#define DCF_PWR_HOLD_MAX_MS 100
+
+//******************************************************************************
+// Typedefs
+//******************************************************************************
+
+// Reception profile (stored in EEPROM, one page)
+typedef struct {
+    uint16_t magic;             // DCF_PWR_MAGIC
+    uint8_t days;               // Count of learned days (saturated)
+    uint8_t probe;              // Probe hour of the day
+    uint8_t score[24];          // Reception score per hour 0 (bad)..255 (good)
+    uint8_t reserved[3];
+    uint8_t check;              // Checksum: the sum of all bytes is 0
+} dcf_pwr_prof_t;
+
+// Power mode
+typedef enum {
+    dcf_pwr_mode_auto = 0,      // Duty-cycled by the profile
+    dcf_pwr_mode_on,            // Always on
+    dcf_pwr_mode_off            // Always off
+} dcf_pwr_mode_t;
+
+// Reason of the actual power state
+typedef enum {
+    dcf_pwr_off = 0,            // Off (outside the reception windows)
+    dcf_pwr_forced,             // On/off forced (mode on/off)
+    dcf_pwr_learn,              // On: learning the profile (or the profile is not loaded)
+    dcf_pwr_no_time,            // On: the time of day is not known
+    dcf_pwr_holdover,           // On: the holdover error exceeds the limit
+    dcf_pwr_window,             // On: one of the best hours
+    dcf_pwr_probe               // On: probe hour
+} dcf_pwr_reason_t;
+
+//******************************************************************************
+// Exported Functions
+//******************************************************************************
+
+// Init the module (receiver on) and request the profile from the EEPROM
+void dcf_pwr_init(void);
+
+// Poll the module every second: dt_ptr local time (NULL if not known), quality 0..100%
+bool dcf_pwr_poll(const datetime_t * dt_ptr, const int quality, const int32_t hold_ms,
+    const s_time_t s_time, const ustime_t sys_ustime);
+
+// Notify a successfully decoded minute
+void dcf_pwr_received(const s_time_t s_time);
+
+// Set the power mode / clear the profile (learn again)
+void dcf_pwr_set_mode(const dcf_pwr_mode_t mode);
+void dcf_pwr_clear(void);
+
+// Get the state: reason, profile, duty cycle [%] and estimated holdover error [ms] (-1: unknown)
+dcf_pwr_reason_t dcf_pwr_get_reason(void);
+const dcf_pwr_prof_t * dcf_pwr_get_profile(void);
+int dcf_pwr_get_duty(void);
+int32_t dcf_pwr_get_holdover(void);
+
+//******************************************************************************
+#endif /* DCF_PWR_H */
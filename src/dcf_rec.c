@@ -0,0 +1,187 @@
+/*******************************************************************************
+ * This file is part of the MstHora distribution.
+ * Copyright (c) 2024 Igor Marinescu (igor.marinescu@gmail.com).
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, version 3.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see <http://www.gnu.org/licenses/>.
+ ******************************************************************************/
+/*******************************************************************************
+ * dcf_rec - records the raw edges of the DCF77 input signal in a RAM ring,
+ * dumps them over UART and replays them through the decoder.
+ *
+ * Record format: every edge is one 32-bit word, the lower 32 bits of the system
+ * time in us of the edge with the bit 0 replaced by the pin level after the
+ * edge (2us resolution). The replay uses only the differences of the words, so
+ * a recording may span the 32-bit wrap (but not more than 71 minutes).
+ *
+ * Dump format (one line per edge, oldest first):
+ *
+ *      dcf77 rec: <count> edges
+ *      <ustime> <level>
+ *      ...
+ ******************************************************************************/
+
+//******************************************************************************
+// Includes
+//******************************************************************************
+#include <stdint.h>
+#include <stdio.h>
+
+#include "pico/stdlib.h"
+
+#include "dcf_rec.h"
+#include "in_out.h"
+
+//******************************************************************************
+// Global Variables
+//******************************************************************************
+
+// Record ring, rec_wr_idx is a free running counter: only the newest
+// DCF_REC_BUFF edges are kept. All accesses from the main loop, no lock needed.
+static uint32_t rec_buff[DCF_REC_BUFF];
+static uint32_t rec_wr_idx = 0;
+static bool rec_active = false;
+
+// Replay
+static bool replay_active = false;
+static uint32_t replay_idx = 0;         // Index of the next edge to replay
+static uint32_t replay_first = 0;      // Recorded time of the first replayed edge
+static ustime_t replay_start = 0;       // System time of the first replayed edge
+
+/***************************************************************************//**
+* @brief Get the index of the oldest recorded edge
+* @return index (free running) of the oldest edge
+*******************************************************************************/
+static uint32_t rec_get_first(void)
+{
+    return (rec_wr_idx > DCF_REC_BUFF) ? (rec_wr_idx - DCF_REC_BUFF) : 0;
+}
+
+/***************************************************************************//**
+* @brief Start recording, the previous record is cleared
+*******************************************************************************/
+void dcf_rec_start(void)
+{
+    replay_active = false;
+    rec_wr_idx = 0;
+    rec_active = true;
+}
+
+/***************************************************************************//**
+* @brief Stop recording, the record is kept
+*******************************************************************************/
+void dcf_rec_stop(void)
+{
+    rec_active = false;
+}
+
+/***************************************************************************//**
+* @brief Check if recording
+* @return true if recording
+*******************************************************************************/
+bool dcf_rec_is_recording(void)
+{
+    return rec_active;
+}
+
+/***************************************************************************//**
+* @brief Add a captured edge to the record (if recording)
+* @param edge_ptr [in] pointer to captured edge
+*******************************************************************************/
+void dcf_rec_add(const dcf_edge_t * edge_ptr)
+{
+    if(!rec_active)
+        return;
+
+    rec_buff[rec_wr_idx & (DCF_REC_BUFF - 1)] = 
+            ((uint32_t) edge_ptr->ustime & ~1UL) | (edge_ptr->level ? 1UL : 0UL);
+    rec_wr_idx++;
+}
+
+/***************************************************************************//**
+* @brief Get the count of recorded edges
+* @return count of recorded edges
+*******************************************************************************/
+uint32_t dcf_rec_get_cnt(void)
+{
+    return rec_wr_idx - rec_get_first();
+}
+
+/***************************************************************************//**
+* @brief Dump the recorded edges over UART (oldest first)
+*******************************************************************************/
+void dcf_rec_dump(void)
+{
+    io_printf("dcf77 rec: %lu edges\r\n", (unsigned long) dcf_rec_get_cnt());
+    for(uint32_t i = rec_get_first(); i != rec_wr_idx; i++)
+    {
+        uint32_t word = rec_buff[i & (DCF_REC_BUFF - 1)];
+        io_printf("%lu %u\r\n", (unsigned long)(word & ~1UL), (unsigned int)(word & 1UL));
+    }
+}
+
+/***************************************************************************//**
+* @brief Start replaying the recorded edges. The recording is stopped. The edges
+*        are shifted in time, the first one is replayed DCF_REC_REPLAY_DELAY
+*        after the start.
+* @param sys_ustime [in] system time in us
+* @return true if the replay started, false if there are no recorded edges
+*******************************************************************************/
+bool dcf_rec_replay_start(const ustime_t sys_ustime)
+{
+    rec_active = false;
+    if(rec_wr_idx == 0)
+        return false;
+
+    replay_idx = rec_get_first();
+    replay_first = rec_buff[replay_idx & (DCF_REC_BUFF - 1)] & ~1UL;
+    replay_start = sys_ustime + DCF_REC_REPLAY_DELAY;
+    replay_active = true;
+    return true;
+}
+
+/***************************************************************************//**
+* @brief Check if replaying (the replay stops after the last recorded edge)
+* @return true if replaying
+*******************************************************************************/
+bool dcf_rec_is_replaying(void)
+{
+    return replay_active;
+}
+
+/***************************************************************************//**
+* @brief Get the next replayed edge which is due at sys_ustime (if there is any)
+* @param edge_ptr [out] pointer to edge where the replayed edge is copied
+* @param sys_ustime [in] system time in us
+* @return true if an edge was copied or false if there is no edge due
+*******************************************************************************/
+bool dcf_rec_replay_get(dcf_edge_t * edge_ptr, const ustime_t sys_ustime)
+{
+    if(!replay_active)
+        return false;
+
+    if(replay_idx == rec_wr_idx)
+    {
+        replay_active = false;
+        return false;
+    }
+
+    uint32_t word = rec_buff[replay_idx & (DCF_REC_BUFF - 1)];
+    ustime_t ustime = replay_start + (ustime_t)((word & ~1UL) - replay_first);
+    if(sys_ustime < ustime)
+        return false;
+
+    edge_ptr->ustime = ustime;
+    edge_ptr->level = ((word & 1UL) != 0);
+    replay_idx++;
+    return true;
+}
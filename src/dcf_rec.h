@@ -0,0 +1,67 @@
+/*******************************************************************************
+ * This file is part of the MstHora distribution.
+ * Copyright (c) 2024 Igor Marinescu (igor.marinescu@gmail.com).
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, version 3.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see <http://www.gnu.org/licenses/>.
+ ******************************************************************************/
+/*******************************************************************************
+ * dcf_rec - records the raw edges of the DCF77 input signal in a RAM ring
+ * (the newest DCF_REC_BUFF edges are kept), dumps them over UART and replays
+ * them through the decoder (time shifted to the actual system time).
+ ******************************************************************************/
+#ifndef DCF_REC_H
+#define DCF_REC_H
+
+//******************************************************************************
+// Includes
+//******************************************************************************
+#include "dcf_cap.h"
+
+//******************************************************************************
+// Defines
+//******************************************************************************
+
+// Size of the record ring (in edges), must be a power of 2.
+// 2 edges per second: 4096 edges = 34 minutes, 16KB RAM.
+#define DCF_REC_BUFF    4096
+
+// Delay [us] from the replay start until the first recorded edge is replayed
+#define DCF_REC_REPLAY_DELAY    1000000UL
+
+//******************************************************************************
+// Exported Functions
+//******************************************************************************
+
+// Start recording (clears the previous record) / stop recording
+void dcf_rec_start(void);
+void dcf_rec_stop(void);
+bool dcf_rec_is_recording(void);
+
+// Add a captured edge to the record (if recording)
+void dcf_rec_add(const dcf_edge_t * edge_ptr);
+
+// Get the count of recorded edges
+uint32_t dcf_rec_get_cnt(void);
+
+// Dump the recorded edges over UART
+void dcf_rec_dump(void);
+
+// Start replaying the recorded edges (stops recording)
+bool dcf_rec_replay_start(const ustime_t sys_ustime);
+bool dcf_rec_is_replaying(void);
+
+// Get the next replayed edge which is due at sys_ustime (if there is any)
+bool dcf_rec_replay_get(dcf_edge_t * edge_ptr, const ustime_t sys_ustime);
+
+//******************************************************************************
+#endif /* DCF_REC_H */
@@ -60,8 +60,8 @@ static char frame_buffer[8];
 static uint8_t raw_buffer[4];
 static uint8_t dot_buffer[4];
 
-static ustime_t sys_ustime_old = 0L;    // Tracking time to control display refresh
-static ustime_t page_sw_ustime = 0L;    // Page switch time (in us)
+static ustime_t refresh_ustime = 0L;    // Time of the next display refresh (in us)
+static ustime_t page_sw_ustime = 0L;    // Time of the next page switch (in us)
 
 static bool page_disp_2nd = false;      // Flag indicates the 2nd page is displayed
 
@@ -233,30 +233,30 @@ void disp7seg_intensity(int intensity)
 }
 
 /***************************************************************************//**
-* @brief Display polling function. Must be called every program cycle
+* @brief Display polling function. Must be called at the returned time (the
+*        data is sent at every refresh)
+* @param sys_ustime [in] system time in us
+* @return system time in us of the next refresh
 *******************************************************************************/
-void disp7seg_poll(const ustime_t sys_ustime)
+ustime_t disp7seg_poll(const ustime_t sys_ustime)
 {
     uint8_t digit;
     int idx, frame_off;
 
-    if(get_diff_ustime(sys_ustime, sys_ustime_old) < DISP7SEG_REFRESH_TIME)
-        return;
-
-    sys_ustime_old = sys_ustime;
+    if(!ustime_period(sys_ustime, &refresh_ustime, DISP7SEG_REFRESH_TIME))
+        return refresh_ustime;
 
     if(spi_drv_is_busy())
-        return;
+        return refresh_ustime;
 
     // Are there 2 pages to display? 
     if(frame_buffer[3] != 0)
     {
         // Display every page DISP7SEG_PAGE_TIME [us] long
-        if(get_diff_ustime(sys_ustime, page_sw_ustime) > DISP7SEG_PAGE_TIME)
+        if(ustime_period(sys_ustime, &page_sw_ustime, DISP7SEG_PAGE_TIME))
         {
             // Switch the page
             page_disp_2nd = !page_disp_2nd;
-            page_sw_ustime = sys_ustime;
         }
     }
     else{
@@ -276,4 +276,5 @@ void disp7seg_poll(const ustime_t sys_ustime)
     }
 
     spi_drv_send(raw_buffer, 4);
+    return refresh_ustime;
 }
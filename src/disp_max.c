@@ -28,6 +28,7 @@
 #include "pico/stdlib.h"
 #include "disp_max.h"
 #include "spi_drv.h"
+#include "sched.h"
 
 //******************************************************************************
 // Defines
@@ -65,8 +66,8 @@ static int tx_cnt = 0;
 static char frame_buffer[8];
 static uint8_t dot_buffer[4];
 
-static ustime_t sys_ustime_old = 0L;    // Tracking time to control display refresh
-static ustime_t page_sw_ustime = 0L;    // Page switch time (in us)
+static ustime_t refresh_ustime = 0L;    // Time of the next display refresh (in us)
+static ustime_t page_sw_ustime = 0L;    // Time of the next page switch (in us)
 
 static bool page_disp_2nd = false;      // Flag indicates the 2nd page is displayed
 
@@ -305,43 +306,30 @@ void dispmax_intensity(int intensity)
     intensity_h = (uint8_t) intensity;
 
     prepare_control_tx();
+    sched_post(sched_ev_spi);   // Send now, not at the next refresh
 }
 
 /***************************************************************************//**
-* @brief Display polling function. Must be called every program cycle
+* @brief Display polling function. Must be called at the returned time and
+*        when an SPI transfer finishes (sched_ev_spi): every poll sends the
+*        next register (2 bytes)
+* @param sys_ustime [in] system time in us
+* @return system time in us of the next refresh
 *******************************************************************************/
-void dispmax_poll(const ustime_t sys_ustime)
+ustime_t dispmax_poll(const ustime_t sys_ustime)
 {
-    // Data to send?
-    int tx_len = tx_cnt - tx_idx;
-    if((tx_len > 0) && !spi_drv_is_busy())
-    {
-        if(tx_len > 2)
-            tx_len = 2;
-        if((tx_idx + tx_len) <= sizeof(tx_data))
-        {
-            if(spi_drv_send(&tx_data[tx_idx], tx_len))
-                tx_idx += tx_len;
-        }
-        else{
-            tx_cnt = tx_idx = 0;
-        }
-    }
-
     // Refresh display?
-    if(get_diff_ustime(sys_ustime, sys_ustime_old) >= DISPMAX_REFRESH_TIME)
+    if(ustime_period(sys_ustime, &refresh_ustime, DISPMAX_REFRESH_TIME))
     {
-        sys_ustime_old = sys_ustime;
 
         // Are there 2 pages to display? 
         if(frame_buffer[3] != 0)
         {
             // Display every page DISPMAX_PAGE_TIME [us] long
-            if(get_diff_ustime(sys_ustime, page_sw_ustime) > DISPMAX_PAGE_TIME)
+            if(ustime_period(sys_ustime, &page_sw_ustime, DISPMAX_PAGE_TIME))
             {
                 // Switch the page
                 page_disp_2nd = !page_disp_2nd;
-                page_sw_ustime = sys_ustime;
             }
         }
         else{
@@ -351,4 +339,22 @@ void dispmax_poll(const ustime_t sys_ustime)
 
         prepare_digit_tx();
     }
+
+    // Data to send?
+    int tx_len = tx_cnt - tx_idx;
+    if((tx_len > 0) && !spi_drv_is_busy())
+    {
+        if(tx_len > 2)
+            tx_len = 2;
+        if((tx_idx + tx_len) <= sizeof(tx_data))
+        {
+            if(spi_drv_send(&tx_data[tx_idx], tx_len))
+                tx_idx += tx_len;
+        }
+        else{
+            tx_cnt = tx_idx = 0;
+        }
+    }
+
+    return refresh_ustime;
 }
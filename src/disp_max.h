@@ -83,8 +83,9 @@ void dispmax_time(const datetime_t * ptr_datetime);
 // Set display intensity (0...15)
 void dispmax_intensity(int intensity);
 
-// Display polling function. Must be called every program cycle
-void dispmax_poll(const ustime_t sys_ustime);
+// Display polling function. Must be called at the returned time (next refresh)
+// and when an SPI transfer finishes (sched_ev_spi)
+ustime_t dispmax_poll(const ustime_t sys_ustime);
 
 //******************************************************************************
 #endif /* DISP_MAX_H */
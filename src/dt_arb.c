@@ -0,0 +1,279 @@
+/*******************************************************************************
+ * This file is part of the MstHora distribution.
+ * Copyright (c) 2024 Igor Marinescu (igor.marinescu@gmail.com).
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, version 3.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see <http://www.gnu.org/licenses/>.
+ ******************************************************************************/
+/*******************************************************************************
+ * dt_arb - time source arbitration.
+ *
+ * Error bound of a source at the system time t (ms):
+ *
+ *      err(t) = disc_err + drift_ppm * (t - disc_ustime)       source drift
+ *                        + DT_ARB_SYS_PPM * (t - ustime)       extrapolation
+ *
+ * A reference source (DCF77) disciplines itself with every accepted report
+ * (disc_err = ref_err_ms), the other sources are disciplined by the caller
+ * when they are set (dt_arb_discipline).
+ *
+ * A report is compared with the best other trusted source. If they differ by
+ * more than 1s plus both error bounds the report is rejected:
+ *  - a reference source is accepted again after two consecutive reports
+ *    consistent with each other (a single bad minute doesn't overwrite a
+ *    good RTC, a real time step is followed after one minute),
+ *  - another source contradicting a better source loses its discipline
+ *    (not usable until it is set again).
+ ******************************************************************************/
+
+//******************************************************************************
+// Includes
+//******************************************************************************
+#include <stdint.h>
+#include <string.h>
+
+#include "dt_arb.h"
+
+//******************************************************************************
+// Global Variables
+//******************************************************************************
+static dt_arb_src_t arb_src[DT_ARB_SRC_CNT];
+static int arb_src_cnt = 0;
+
+/***************************************************************************//**
+* @brief Init the module (no sources)
+*******************************************************************************/
+void dt_arb_init(void)
+{
+    memset(arb_src, 0, sizeof(arb_src));
+    arb_src_cnt = 0;
+}
+
+/***************************************************************************//**
+* @brief Add a source. It is not disciplined, its error bound is
+*        cfg->init_err_ms growing with its drift since power-on.
+* @param cfg [in] pointer to configuration of the source (must stay valid)
+* @return source id or -1 if there is no free slot
+*******************************************************************************/
+int dt_arb_add(const dt_arb_cfg_t * cfg)
+{
+    if((arb_src_cnt >= DT_ARB_SRC_CNT) || (cfg == NULL))
+        return -1;
+
+    dt_arb_src_t * src = &arb_src[arb_src_cnt];
+    memset(src, 0, sizeof(dt_arb_src_t));
+    src->cfg = cfg;
+    src->disc_err_ms = cfg->init_err_ms;
+    return arb_src_cnt++;
+}
+
+/***************************************************************************//**
+* @brief Get a source
+* @param id [in] source id
+* @return pointer to source or NULL if the id is not used
+*******************************************************************************/
+static dt_arb_src_t * arb_get(const int id)
+{
+    if((id < 0) || (id >= arb_src_cnt))
+        return NULL;
+    return &arb_src[id];
+}
+
+/***************************************************************************//**
+* @brief Get the error [ms] accumulated with a drift over a time interval
+* @param ppm [in] drift in ppm
+* @param start [in] start of the interval (system time in us)
+* @param end [in] end of the interval (system time in us)
+* @return error in ms
+*******************************************************************************/
+static uint64_t arb_drift_ms(const uint32_t ppm, const ustime_t start, const ustime_t end)
+{
+    return (get_diff_ustime(end, start) * ppm) / 1000000000ULL;
+}
+
+/***************************************************************************//**
+* @brief Get the error bound [ms] of a source at sys_ustime
+* @param id [in] source id
+* @param sys_ustime [in] system time in us
+* @return error bound in ms, DT_ARB_ERR_UNKNOWN if the source is not usable
+*******************************************************************************/
+uint32_t dt_arb_get_err(const int id, const ustime_t sys_ustime)
+{
+    const dt_arb_src_t * src = arb_get(id);
+    if((src == NULL) || !src->valid || (src->disc_err_ms == DT_ARB_ERR_UNKNOWN))
+        return DT_ARB_ERR_UNKNOWN;
+
+    uint64_t err = src->disc_err_ms;
+    err += arb_drift_ms(src->cfg->drift_ppm, src->disc_ustime, sys_ustime);
+    err += arb_drift_ms(DT_ARB_SYS_PPM, src->ustime, sys_ustime);
+    return (err < DT_ARB_ERR_UNKNOWN) ? (uint32_t) err : (DT_ARB_ERR_UNKNOWN - 1);
+}
+
+/***************************************************************************//**
+* @brief Check if the error bound of a source is within DT_ARB_TRUST_MS
+* @param id [in] source id
+* @param sys_ustime [in] system time in us
+* @return true if trusted
+*******************************************************************************/
+bool dt_arb_is_trusted(const int id, const ustime_t sys_ustime)
+{
+    return (dt_arb_get_err(id, sys_ustime) <= DT_ARB_TRUST_MS);
+}
+
+/***************************************************************************//**
+* @brief Get the time of a source (epoch seconds) extrapolated to sys_ustime
+* @param src [in] source
+* @param sys_ustime [in] system time in us
+* @return epoch seconds
+*******************************************************************************/
+static epoch_t arb_epoch(const dt_arb_src_t * src, const ustime_t sys_ustime)
+{
+    return src->epoch + (epoch_t)(get_diff_ustime(sys_ustime, src->ustime) / 1000000ULL);
+}
+
+/***************************************************************************//**
+* @brief Get the date/time of a source extrapolated to sys_ustime
+* @param id [in] source id
+* @param sys_ustime [in] system time in us
+* @param dt_ptr [out] pointer to datetime
+* @return true if the source has a valid report, false if not (dt_ptr unchanged)
+*******************************************************************************/
+bool dt_arb_get_dt(const int id, const ustime_t sys_ustime, datetime_t * dt_ptr)
+{
+    const dt_arb_src_t * src = arb_get(id);
+    if((src == NULL) || !src->valid)
+        return false;
+
+    datetime_from_epoch(dt_ptr, arb_epoch(src, sys_ustime));
+    return true;
+}
+
+/***************************************************************************//**
+* @brief Select the source with the smallest error bound at sys_ustime (the
+*        first added source wins if the bounds are equal)
+* @param sys_ustime [in] system time in us
+* @param err_ptr [out] error bound of the selected source (NULL: not used)
+* @return source id or -1 if no source is usable
+*******************************************************************************/
+int dt_arb_select(const ustime_t sys_ustime, uint32_t * err_ptr)
+{
+    int best = -1;
+    uint32_t best_err = DT_ARB_ERR_UNKNOWN;
+    for(int id = 0; id < arb_src_cnt; id++)
+    {
+        uint32_t err = dt_arb_get_err(id, sys_ustime);
+        if(err < best_err)
+        {
+            best = id;
+            best_err = err;
+        }
+    }
+
+    if(err_ptr != NULL)
+        *err_ptr = best_err;
+    return best;
+}
+
+/***************************************************************************//**
+* @brief Report the date/time of a source
+* @param id [in] source id
+* @param dt_ptr [in] reported datetime
+* @param ustime [in] system time in us when dt_ptr was valid
+* @return true if the report was accepted, false if it contradicts a better
+*         trusted source
+*******************************************************************************/
+bool dt_arb_report(const int id, const datetime_t * dt_ptr, const ustime_t ustime)
+{
+    dt_arb_src_t * src = arb_get(id);
+    if((src == NULL) || (dt_ptr == NULL))
+        return false;
+
+    epoch_t epoch = datetime_to_epoch(dt_ptr);
+    bool ref = (src->cfg->ref_err_ms > 0);
+    uint32_t err = ref ? src->cfg->ref_err_ms : dt_arb_get_err(id, ustime);
+    if(err == DT_ARB_ERR_UNKNOWN)
+        err = 0;
+
+    // Compare with the best other trusted source
+    int best = -1;
+    uint32_t best_err = DT_ARB_TRUST_MS + 1;
+    for(int other = 0; other < arb_src_cnt; other++)
+    {
+        uint32_t other_err = dt_arb_get_err(other, ustime);
+        if((other != id) && (other_err < best_err))
+        {
+            best = other;
+            best_err = other_err;
+        }
+    }
+
+    if(best >= 0)
+    {
+        epoch_t diff = epoch - arb_epoch(&arb_src[best], ustime);
+        epoch_t tol = 1 + (epoch_t)((best_err + err) / 1000);
+        if((diff > tol) || (diff < -tol))
+        {
+            // Reference: accept after two consecutive consistent reports
+            epoch_t cand_diff = epoch - src->cand_epoch
+                - (epoch_t)((get_diff_ustime(ustime, src->cand_ustime) + 500000ULL) / 1000000ULL);
+            if(!ref || !src->cand_valid || (cand_diff > 1) || (cand_diff < -1))
+            {
+                src->cand_valid = true;
+                src->cand_epoch = epoch;
+                src->cand_ustime = ustime;
+                src->rejected++;
+
+                // Contradicts a better source: the discipline is lost
+                if(!ref && (best_err < err))
+                    src->disc_err_ms = DT_ARB_ERR_UNKNOWN;
+                return false;
+            }
+        }
+    }
+
+    src->cand_valid = false;
+    src->valid = true;
+    src->epoch = epoch;
+    src->ustime = ustime;
+    if(ref)
+        dt_arb_discipline(id, src->cfg->ref_err_ms, ustime);
+    return true;
+}
+
+/***************************************************************************//**
+* @brief The source was disciplined (set). Its last report is invalid, the
+*        next report starts with the error bound err_ms.
+* @param id [in] source id
+* @param err_ms [in] error bound [ms] of the source after it was set
+* @param ustime [in] system time in us when the source was set
+*******************************************************************************/
+void dt_arb_discipline(const int id, const uint32_t err_ms, const ustime_t ustime)
+{
+    dt_arb_src_t * src = arb_get(id);
+    if(src == NULL)
+        return;
+
+    if(src->cfg->ref_err_ms == 0)
+        src->valid = false;
+    src->disc_err_ms = err_ms;
+    src->disc_ustime = ustime;
+}
+
+/***************************************************************************//**
+* @brief Get the state of a source
+* @param id [in] source id
+* @return pointer to source or NULL if the id is not used
+*******************************************************************************/
+const dt_arb_src_t * dt_arb_get_src(const int id)
+{
+    return arb_get(id);
+}
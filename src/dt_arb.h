@@ -0,0 +1,103 @@
+/*******************************************************************************
+ * This file is part of the MstHora distribution.
+ * Copyright (c) 2024 Igor Marinescu (igor.marinescu@gmail.com).
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, version 3.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see <http://www.gnu.org/licenses/>.
+ ******************************************************************************/
+/*******************************************************************************
+ * dt_arb - time source arbitration. Every source (DCF77, RTC, internal RTC,
+ * ...) reports its date/time with the system time of the report. The engine
+ * estimates the error bound of every source (the error at its last
+ * discipline growing with its drift, the report extrapolated with the system
+ * clock), selects the source with the smallest bound and rejects reports
+ * which contradict a better source. The module gets the time from its
+ * caller (no clock is read) and can be tested on the host.
+ ******************************************************************************/
+#ifndef DT_ARB_H
+#define DT_ARB_H
+
+//******************************************************************************
+// Includes
+//******************************************************************************
+#include "pico/types.h"
+#include "ustime.h"
+#include "datetime_utils.h"
+
+//******************************************************************************
+// Defines
+//******************************************************************************
+#define DT_ARB_SRC_CNT      4           // Maximal count of sources
+#define DT_ARB_ERR_UNKNOWN  UINT32_MAX  // Error bound of a source without a valid report/discipline
+
+#define DT_ARB_TRUST_MS     1000        // Maximal error bound [ms] of a trusted time
+#define DT_ARB_SYS_PPM      50          // Drift of the system clock (extrapolation of a report)
+
+//******************************************************************************
+// Typedefs
+//******************************************************************************
+
+// Configuration of a source
+typedef struct {
+    const char * name;
+    uint32_t drift_ppm;         // Drift of the source since its discipline
+    uint32_t init_err_ms;       // Error bound if the source was not disciplined (DT_ARB_ERR_UNKNOWN: not usable)
+    uint32_t ref_err_ms;        // Reference source: error of every report (disciplines itself), 0: no reference
+} dt_arb_cfg_t;
+
+// State of a source
+typedef struct {
+    const dt_arb_cfg_t * cfg;
+    bool valid;                 // A report was accepted
+    epoch_t epoch;              // Last accepted report
+    ustime_t ustime;            // System time of the last accepted report
+    uint32_t disc_err_ms;       // Error bound at the last discipline (DT_ARB_ERR_UNKNOWN: none)
+    ustime_t disc_ustime;       // System time of the last discipline
+    bool cand_valid;            // A rejected report (candidate to confirm a reference source)
+    epoch_t cand_epoch;
+    ustime_t cand_ustime;
+    uint32_t rejected;          // Count of rejected reports
+} dt_arb_src_t;
+
+//******************************************************************************
+// Exported Functions
+//******************************************************************************
+
+// Init the module (no sources)
+void dt_arb_init(void);
+
+// Add a source, returns the source id or -1 if there is no free slot
+int dt_arb_add(const dt_arb_cfg_t * cfg);
+
+// Report the date/time of a source valid at ustime, returns true if accepted
+bool dt_arb_report(const int id, const datetime_t * dt_ptr, const ustime_t ustime);
+
+// The source was disciplined (set) at ustime with the error bound err_ms
+void dt_arb_discipline(const int id, const uint32_t err_ms, const ustime_t ustime);
+
+// Get the error bound [ms] of a source at sys_ustime (DT_ARB_ERR_UNKNOWN if not usable)
+uint32_t dt_arb_get_err(const int id, const ustime_t sys_ustime);
+
+// Check if the error bound of a source is within DT_ARB_TRUST_MS
+bool dt_arb_is_trusted(const int id, const ustime_t sys_ustime);
+
+// Get the date/time of a source extrapolated to sys_ustime, returns false if not valid
+bool dt_arb_get_dt(const int id, const ustime_t sys_ustime, datetime_t * dt_ptr);
+
+// Select the source with the smallest error bound at sys_ustime (-1: none)
+int dt_arb_select(const ustime_t sys_ustime, uint32_t * err_ptr);
+
+// Get the state of a source (NULL if not used)
+const dt_arb_src_t * dt_arb_get_src(const int id);
+
+//******************************************************************************
+#endif /* DT_ARB_H */
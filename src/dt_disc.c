@@ -0,0 +1,581 @@
+/*******************************************************************************
+ * This file is part of the MstHora distribution.
+ * Copyright (c) 2024 Igor Marinescu (igor.marinescu@gmail.com).
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, version 3.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see <http://www.gnu.org/licenses/>.
+ ******************************************************************************/
+/*******************************************************************************
+ * dt_disc - clock discipline model.
+ *
+ * The sources report whole seconds. The second tick of a source is detected
+ * when two consecutive reads (not more than DT_DISC_TICK_MAX_US apart) differ
+ * by one second, the tick is in the middle of the reads (+-50ms for a read
+ * every 100ms). The offset of every tick against the last DCF77 minute
+ * (second 0 edge) is:
+ *
+ *      offset = (tick_epoch - dcf_epoch) * 1s - (tick_ustime - dcf_ustime)
+ *
+ * The offsets are averaged until the next accepted minute confirms the
+ * reference, the mean is one offset of the fit (the phase of the reads
+ * moves against the ticks, the average removes most of the read interval).
+ * The offsets since the source was set are fitted (least squares, updated
+ * per offset): offset = a + ppm * t. The slope in us/s is the frequency
+ * error in ppm, its variance is sigma^2 / stt (sigma: residuals).
+ *
+ * When the source is set the fit is combined with the previous estimate
+ * (weighted by the inverse variances, the previous estimate wanders by
+ * DT_DISC_WANDER_PPB) and stored in the EEPROM. Between the sets the actual
+ * fit is combined the same way.
+ ******************************************************************************/
+
+//******************************************************************************
+// Includes
+//******************************************************************************
+#include <stdint.h>
+#include <string.h>
+#include <math.h>
+
+#include "dt_disc.h"
+#include "i2c_drv.h"
+#include "i2c_manager.h"
+
+//******************************************************************************
+// Global Variables
+//******************************************************************************
+static dt_disc_src_t disc_src[DT_DISC_SRC_CNT];
+static int disc_src_cnt = 0;
+
+static dt_disc_mem_t disc_mem;          // Copy of the estimates being read/written
+static bool disc_loaded = false;        // The estimates read from the EEPROM (or failed)
+static bool disc_load_req = false;      // The read is requested
+static bool disc_save = false;          // The estimates must be saved
+
+static bool ref_valid = false;          // Last reference (accepted DCF77 minute)
+static epoch_t ref_epoch;
+static ustime_t ref_ustime;
+
+/***************************************************************************//**
+* @brief Get a source
+* @param id [in] source id
+* @return pointer to source or NULL if the id is not used
+*******************************************************************************/
+static dt_disc_src_t * disc_get(const int id)
+{
+    if((id < 0) || (id >= disc_src_cnt))
+        return NULL;
+    return &disc_src[id];
+}
+
+/***************************************************************************//**
+* @brief Calculate the checksum of the stored estimates
+* @param mem_ptr [in] pointer to stored estimates
+* @return the value of the check byte so that the sum of all bytes is 0
+*******************************************************************************/
+static uint8_t mem_check(const dt_disc_mem_t * mem_ptr)
+{
+    const uint8_t * ptr = (const uint8_t *) mem_ptr;
+    uint8_t sum = 0;
+    for(unsigned i = 0; i < (sizeof(dt_disc_mem_t) - 1); i++)
+        sum += ptr[i];
+    return (uint8_t)(0 - sum);
+}
+
+/***************************************************************************//**
+* @brief Callback when the estimates are read from the EEPROM
+* @param result [in] read result (i2c_err_t converted to int)
+*******************************************************************************/
+static void mem_read_callback(int result)
+{
+    if((((i2c_err_t) result) == i2c_success) && (disc_mem.magic == DT_DISC_MAGIC) &&
+       (disc_mem.check == mem_check(&disc_mem)))
+    {
+        // Keep an estimate which was updated in the meantime
+        for(int id = 0; id < disc_src_cnt; id++)
+        {
+            if(disc_src[id].est.fits == 0)
+                memcpy(&disc_src[id].est, &disc_mem.est[id], sizeof(dt_disc_est_t));
+        }
+        DT_DISC_LOG("dt_disc: estimates loaded\r\n");
+    }
+    else {
+        DT_DISC_LOG("dt_disc: no estimates (%i)\r\n", result);
+    }
+    disc_loaded = true;
+}
+
+/***************************************************************************//**
+* @brief Callback when the estimates are written to the EEPROM
+* @param result [in] write result (i2c_err_t converted to int)
+*******************************************************************************/
+static void mem_write_callback(int result)
+{
+    DT_DISC_LOG("dt_disc: estimates saved (%i)\r\n", result);
+}
+
+/***************************************************************************//**
+* @brief Clear the fit of a source
+* @param src [in/out] source
+*******************************************************************************/
+static void fit_clear(dt_disc_src_t * src)
+{
+    src->outlier_run = 0;
+    src->cnt = 0;
+    src->mean_t = 0.0;
+    src->mean_x = 0.0;
+    src->stt = 0.0;
+    src->stx = 0.0;
+    src->sxx = 0.0;
+}
+
+/***************************************************************************//**
+* @brief Get the slope of the fit and its variance
+* @param src [in] source
+* @param ppm_ptr [out] slope [ppm]
+* @param var_ptr [out] variance of the slope [ppm^2]
+* @return true if the fit is valid (DT_DISC_MIN_CNT offsets over DT_DISC_MIN_SPAN_S)
+*******************************************************************************/
+static bool fit_get(const dt_disc_src_t * src, double * ppm_ptr, double * var_ptr)
+{
+    if((src->cnt < DT_DISC_MIN_CNT) || (src->stt <= 0.0) ||
+       (get_diff_ustime(src->offset_ustime, src->fit_ustime) < (DT_DISC_MIN_SPAN_S * 1000000ULL)))
+        return false;
+
+    double ppm = src->stx / src->stt;
+    double sse = src->sxx - (ppm * src->stx);
+    double var = ((sse > 0.0) ? (sse / (double)(src->cnt - 2)) : 0.0) / src->stt;
+    double var_min = (DT_DISC_SIGMA_MIN * 1e-3) * (DT_DISC_SIGMA_MIN * 1e-3);
+
+    *ppm_ptr = ppm;
+    *var_ptr = (var > var_min) ? var : var_min;
+    return true;
+}
+
+/***************************************************************************//**
+* @brief Combine the previous estimate of a source with its actual fit
+* @param src [in] source
+* @param ppm_ptr [out] frequency error [ppm]
+* @param var_ptr [out] variance [ppm^2]
+* @return true if there is an estimate
+*******************************************************************************/
+static bool est_get(const dt_disc_src_t * src, double * ppm_ptr, double * var_ptr)
+{
+    double fit_ppm, fit_var;
+    bool fit_ok = fit_get(src, &fit_ppm, &fit_var);
+    if(src->est.fits == 0)
+    {
+        if(fit_ok)
+        {
+            *ppm_ptr = fit_ppm;
+            *var_ptr = fit_var;
+        }
+        return fit_ok;
+    }
+
+    double est_ppm = src->est.ppb * 1e-3;
+    double est_sigma = src->est.sigma_ppb * 1e-3;
+    double est_var = (est_sigma * est_sigma) + ((DT_DISC_WANDER_PPB * 1e-3) * (DT_DISC_WANDER_PPB * 1e-3));
+    if(!fit_ok)
+    {
+        *ppm_ptr = est_ppm;
+        *var_ptr = est_var;
+        return true;
+    }
+
+    double w_est = 1.0 / est_var;
+    double w_fit = 1.0 / fit_var;
+    *ppm_ptr = ((est_ppm * w_est) + (fit_ppm * w_fit)) / (w_est + w_fit);
+    *var_ptr = 1.0 / (w_est + w_fit);
+    return true;
+}
+
+/***************************************************************************//**
+* @brief Round to the nearest integer
+* @param val [in] value
+* @return rounded value
+*******************************************************************************/
+static int32_t disc_round(const double val)
+{
+    return (int32_t)((val >= 0.0) ? (val + 0.5) : (val - 0.5));
+}
+
+/***************************************************************************//**
+* @brief Init the module (no sources). The estimates are read from the
+*        EEPROM in dt_disc_poll (retried until the I2C manager accepts the
+*        request).
+*******************************************************************************/
+void dt_disc_init(void)
+{
+    memset(disc_src, 0, sizeof(disc_src));
+    disc_src_cnt = 0;
+    disc_loaded = false;
+    disc_load_req = false;
+    disc_save = false;
+    ref_valid = false;
+}
+
+/***************************************************************************//**
+* @brief Add a source
+* @param name [in] name of the source (must stay valid)
+* @return source id or -1 if there is no free slot
+*******************************************************************************/
+int dt_disc_add(const char * name)
+{
+    if(disc_src_cnt >= DT_DISC_SRC_CNT)
+        return -1;
+
+    dt_disc_src_t * src = &disc_src[disc_src_cnt];
+    memset(src, 0, sizeof(dt_disc_src_t));
+    src->name = name;
+    return disc_src_cnt++;
+}
+
+/***************************************************************************//**
+* @brief Add a second tick of a source: measures its offset against the last
+*        reference
+* @param src [in/out] source
+* @param epoch [in] datetime of the source (epoch) started at the tick
+* @param tick_ustime [in] system time in us of the tick
+*******************************************************************************/
+static void tick_add(dt_disc_src_t * src, const epoch_t epoch, const ustime_t tick_ustime)
+{
+    if(!ref_valid || (get_diff_ustime(tick_ustime, ref_ustime) > DT_DISC_REF_MAX_US))
+        return;
+
+    int64_t offset = ((epoch - ref_epoch) * 1000000LL) - (int64_t) get_diff_ustime(tick_ustime, ref_ustime);
+    if((offset <= DT_DISC_OFF_MAX_US) && (offset >= -DT_DISC_OFF_MAX_US))
+    {
+        src->tick_cnt++;
+        src->tick_sum_us += offset;
+    }
+}
+
+/***************************************************************************//**
+* @brief Report the date/time read from a source: detects the second tick
+*        (between two reads) and measures its offset against the last reference
+* @param id [in] source id
+* @param dt_ptr [in] read datetime
+* @param ustime [in] system time in us of the read
+*******************************************************************************/
+void dt_disc_report(const int id, const datetime_t * dt_ptr, const ustime_t ustime)
+{
+    dt_disc_src_t * src = disc_get(id);
+    if((src == NULL) || (dt_ptr == NULL))
+        return;
+
+    epoch_t epoch = datetime_to_epoch(dt_ptr);
+    if(src->last_valid && (epoch == (src->last_epoch + 1)))
+    {
+        ustime_t interval = get_diff_ustime(ustime, src->last_ustime);
+        if(interval <= DT_DISC_TICK_MAX_US)
+            tick_add(src, epoch, src->last_ustime + (interval / 2));
+    }
+
+    src->last_valid = true;
+    src->last_epoch = epoch;
+    src->last_ustime = ustime;
+}
+
+/***************************************************************************//**
+* @brief Report the second tick of a source (the DS3231 square wave): the
+*        date/time started exactly at tick_ustime
+* @param id [in] source id
+* @param dt_ptr [in] datetime started at the tick
+* @param tick_ustime [in] system time in us of the tick
+*******************************************************************************/
+void dt_disc_tick(const int id, const datetime_t * dt_ptr, const ustime_t tick_ustime)
+{
+    dt_disc_src_t * src = disc_get(id);
+    if((src == NULL) || (dt_ptr == NULL))
+        return;
+
+    epoch_t epoch = datetime_to_epoch(dt_ptr);
+    tick_add(src, epoch, tick_ustime);
+
+    src->last_valid = true;
+    src->last_epoch = epoch;
+    src->last_ustime = tick_ustime;
+}
+
+/***************************************************************************//**
+* @brief Add an offset to the fit of a source (rejects an offset far from
+*        the fit, restarts the fit after DT_DISC_OUTLIER_RUN rejected offsets)
+* @param src [in/out] source
+* @param offset [in] offset [us]
+* @param ustime [in] system time in us of the offset
+*******************************************************************************/
+static void fit_add(dt_disc_src_t * src, const int64_t offset, const ustime_t ustime)
+{
+    if(src->cnt == 0)
+        src->fit_ustime = ustime;
+    double t = (double) get_diff_ustime(ustime, src->fit_ustime) * 1e-6;
+    double x = (double) offset;
+
+    // Reject an offset far from the fit (wrong tick, disturbed minute)
+    if(src->cnt >= 3)
+    {
+        double pred = src->mean_x + ((src->stt > 0.0) ? ((src->stx / src->stt) * (t - src->mean_t)) : 0.0);
+        double res = x - pred;
+        if((res > DT_DISC_OUTLIER_US) || (res < -DT_DISC_OUTLIER_US))
+        {
+            src->outliers++;
+            DT_DISC_LOG("dt_disc: %s offset %lius rejected\r\n", src->name, (long) offset);
+
+            // The source was set by someone else (CLI): restart the fit
+            if(++src->outlier_run < DT_DISC_OUTLIER_RUN)
+                return;
+            fit_clear(src);
+            src->fit_ustime = ustime;
+            t = 0.0;
+        }
+    }
+
+    src->outlier_run = 0;
+    src->cnt++;
+    double dt = t - src->mean_t;
+    double dx = x - src->mean_x;
+    src->mean_t += dt / src->cnt;
+    src->mean_x += dx / src->cnt;
+    src->stt += dt * (t - src->mean_t);
+    src->stx += dt * (x - src->mean_x);
+    src->sxx += dx * (x - src->mean_x);
+    src->offset_us = (int32_t) offset;
+    src->offset_ustime = ustime;
+}
+
+/***************************************************************************//**
+* @brief Reference: an accepted DCF77 minute. If it confirms the previous
+*        reference (consistent, not more than DT_DISC_REF_MAX_US apart) the
+*        mean offset of the ticks between them is added to the fit of every
+*        source.
+* @param dt_ptr [in] DCF77 datetime
+* @param ustime [in] system time in us of the second 0 edge
+*******************************************************************************/
+void dt_disc_reference(const datetime_t * dt_ptr, const ustime_t ustime)
+{
+    if(dt_ptr == NULL)
+        return;
+
+    epoch_t epoch = datetime_to_epoch(dt_ptr);
+    ustime_t elapsed = get_diff_ustime(ustime, ref_ustime);
+    bool confirmed = ref_valid && (elapsed <= DT_DISC_REF_MAX_US) &&
+        ((epoch - ref_epoch) == (epoch_t)((elapsed + 500000ULL) / 1000000ULL));
+
+    for(int id = 0; id < disc_src_cnt; id++)
+    {
+        dt_disc_src_t * src = &disc_src[id];
+        if(confirmed && (src->tick_cnt >= DT_DISC_TICK_MIN))
+            fit_add(src, (src->tick_sum_us / (int64_t) src->tick_cnt), ref_ustime + (elapsed / 2));
+        src->tick_cnt = 0;
+        src->tick_sum_us = 0;
+    }
+
+    ref_valid = true;
+    ref_epoch = epoch;
+    ref_ustime = ustime;
+}
+
+/***************************************************************************//**
+* @brief Include a valid fit of a source in its estimate (stored) and start
+*        the next fit
+* @param src [in/out] source
+*******************************************************************************/
+static void est_update(dt_disc_src_t * src)
+{
+    double fit_ppm, fit_var, ppm, var;
+    if(fit_get(src, &fit_ppm, &fit_var) && est_get(src, &ppm, &var))
+    {
+        src->est.ppb = disc_round(ppm * 1e3);
+        src->est.sigma_ppb = (uint32_t) disc_round(sqrt(var) * 1e3);
+        if(src->est.fits < UINT16_MAX)
+            src->est.fits++;
+        disc_save = true;
+        DT_DISC_LOG("dt_disc: %s fit %lippb (%lu offsets), estimate %lippb +-%luppb\r\n", src->name,
+            (long) disc_round(fit_ppm * 1e3), (unsigned long) src->cnt,
+            (long) src->est.ppb, (unsigned long) src->est.sigma_ppb);
+    }
+    fit_clear(src);
+}
+
+/***************************************************************************//**
+* @brief The source was set: a valid fit is included in the estimate (and
+*        stored), the next fit starts
+* @param id [in] source id
+*******************************************************************************/
+void dt_disc_set(const int id)
+{
+    dt_disc_src_t * src = disc_get(id);
+    if(src == NULL)
+        return;
+
+    est_update(src);
+    src->last_valid = false;
+    src->tick_cnt = 0;
+    src->tick_sum_us = 0;
+}
+
+/***************************************************************************//**
+* @brief The frequency of the source was trimmed: a valid fit is included in
+*        the estimate, the estimate is moved by the expected change (its
+*        uncertainty grows by DT_DISC_TRIM_PCT of the change) and the next
+*        fit starts (the time of the source didn't change)
+* @param id [in] source id
+* @param delta_ppb [in] expected change of the frequency error [ppb]
+*******************************************************************************/
+void dt_disc_trim(const int id, const int32_t delta_ppb)
+{
+    dt_disc_src_t * src = disc_get(id);
+    if(src == NULL)
+        return;
+
+    est_update(src);
+    if(src->est.fits > 0)
+    {
+        double sigma = src->est.sigma_ppb;
+        double trim_err = ((double) delta_ppb * DT_DISC_TRIM_PCT) / 100.0;
+        src->est.ppb += delta_ppb;
+        src->est.sigma_ppb = (uint32_t) disc_round(sqrt((sigma * sigma) + (trim_err * trim_err)));
+        disc_save = true;
+    }
+}
+
+/***************************************************************************//**
+* @brief Poll the module: read the estimates from the EEPROM (once) and
+*        write them if changed (retried every call until the I2C manager
+*        accepts the request). Must be called every second.
+*******************************************************************************/
+void dt_disc_poll(void)
+{
+    if(!disc_load_req)
+    {
+        disc_load_req = i2c_man_req_mem_read((uint8_t *) &disc_mem, DT_DISC_MEM_ADDR, sizeof(disc_mem),
+            mem_read_callback);
+        return;
+    }
+
+    if(!disc_loaded || !disc_save)
+        return;
+
+    memset(&disc_mem, 0, sizeof(disc_mem));
+    disc_mem.magic = DT_DISC_MAGIC;
+    for(int id = 0; id < disc_src_cnt; id++)
+        memcpy(&disc_mem.est[id], &disc_src[id].est, sizeof(dt_disc_est_t));
+    disc_mem.check = mem_check(&disc_mem);
+    if(i2c_man_req_mem_write(DT_DISC_MEM_ADDR, (const uint8_t *) &disc_mem, sizeof(disc_mem),
+            mem_write_callback))
+        disc_save = false;
+}
+
+/***************************************************************************//**
+* @brief Clear the estimates of all sources (and store them)
+*******************************************************************************/
+void dt_disc_clear(void)
+{
+    for(int id = 0; id < disc_src_cnt; id++)
+        memset(&disc_src[id].est, 0, sizeof(dt_disc_est_t));
+    disc_save = true;
+}
+
+/***************************************************************************//**
+* @brief Get the frequency error of a source: the previous estimate combined
+*        with the actual fit
+* @param id [in] source id
+* @param ppb_ptr [out] frequency error [ppb], positive: the clock is fast
+* @param sigma_ptr [out] uncertainty [ppb] (NULL: not used)
+* @return true if estimated, false if not (outputs unchanged)
+*******************************************************************************/
+bool dt_disc_get_ppb(const int id, int32_t * ppb_ptr, uint32_t * sigma_ptr)
+{
+    const dt_disc_src_t * src = disc_get(id);
+    double ppm, var;
+    if((src == NULL) || !est_get(src, &ppm, &var))
+        return false;
+
+    *ppb_ptr = disc_round(ppm * 1e3);
+    if(sigma_ptr != NULL)
+        *sigma_ptr = (uint32_t) disc_round(sqrt(var) * 1e3);
+    return true;
+}
+
+/***************************************************************************//**
+* @brief Get the frequency error of the actual fit of a source alone (the
+*        offsets since the last set or trim, without the previous estimate)
+* @param id [in] source id
+* @param ppb_ptr [out] frequency error [ppb], positive: the clock is fast
+* @param sigma_ptr [out] uncertainty [ppb] (NULL: not used)
+* @return true if the fit is valid, false if not (outputs unchanged)
+*******************************************************************************/
+bool dt_disc_get_fit_ppb(const int id, int32_t * ppb_ptr, uint32_t * sigma_ptr)
+{
+    const dt_disc_src_t * src = disc_get(id);
+    double ppm, var;
+    if((src == NULL) || !fit_get(src, &ppm, &var))
+        return false;
+
+    *ppb_ptr = disc_round(ppm * 1e3);
+    if(sigma_ptr != NULL)
+        *sigma_ptr = (uint32_t) disc_round(sqrt(var) * 1e3);
+    return true;
+}
+
+/***************************************************************************//**
+* @brief Get the predicted offset of a source (actual fit extrapolated)
+* @param id [in] source id
+* @param sys_ustime [in] system time in us
+* @param offset_ptr [out] offset [us], positive: the clock is ahead
+* @return true if there is a valid fit, false if not (output unchanged)
+*******************************************************************************/
+bool dt_disc_get_offset(const int id, const ustime_t sys_ustime, int32_t * offset_ptr)
+{
+    const dt_disc_src_t * src = disc_get(id);
+    double ppm, var;
+    if((src == NULL) || (src->cnt < DT_DISC_MIN_CNT) || !est_get(src, &ppm, &var))
+        return false;
+
+    double t = (double) get_diff_ustime(sys_ustime, src->fit_ustime) * 1e-6;
+    double offset = src->mean_x + (ppm * (t - src->mean_t));
+    if(offset > INT32_MAX)
+        offset = INT32_MAX;
+    if(offset < INT32_MIN)
+        offset = INT32_MIN;
+    *offset_ptr = disc_round(offset);
+    return true;
+}
+
+/***************************************************************************//**
+* @brief Get the predicted holdover error of a source: the offset accumulated
+*        by the frequency error (plus 3 sigma) over hold_s seconds
+* @param id [in] source id
+* @param hold_s [in] holdover time in seconds
+* @return error [ms] or -1 if the frequency error is not estimated
+*******************************************************************************/
+int32_t dt_disc_get_holdover(const int id, const uint32_t hold_s)
+{
+    int32_t ppb;
+    uint32_t sigma;
+    if(!dt_disc_get_ppb(id, &ppb, &sigma))
+        return -1;
+
+    int64_t err_ns = ((int64_t)((ppb < 0) ? -ppb : ppb) + (3 * (int64_t) sigma)) * hold_s;
+    int64_t err_ms = err_ns / 1000000LL;
+    return (err_ms < INT32_MAX) ? (int32_t) err_ms : INT32_MAX;
+}
+
+/***************************************************************************//**
+* @brief Get the state of a source
+* @param id [in] source id
+* @return pointer to source or NULL if the id is not used
+*******************************************************************************/
+const dt_disc_src_t * dt_disc_get_src(const int id)
+{
+    return disc_get(id);
+}
@@ -0,0 +1,154 @@
+/*******************************************************************************
+ * This file is part of the MstHora distribution.
+ * Copyright (c) 2024 Igor Marinescu (igor.marinescu@gmail.com).
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, version 3.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see <http://www.gnu.org/licenses/>.
+ ******************************************************************************/
+/*******************************************************************************
+ * dt_disc - clock discipline model. Measures the offset of the local clocks
+ * (DS3231, internal RTC) against every accepted DCF77 minute and estimates
+ * their frequency error (ppm) with a least-squares fit. The estimates are
+ * stored in the EEPROM and improve with every set of the clock.
+ ******************************************************************************/
+#ifndef DT_DISC_H
+#define DT_DISC_H
+
+//******************************************************************************
+// Includes
+//******************************************************************************
+#include "pico/types.h"
+#include "ustime.h"
+#include "datetime_utils.h"
+
+#ifdef DT_DISC_DEBUG
+#include DEBUG_INCLUDE
+#endif
+
+//******************************************************************************
+// Defines
+//******************************************************************************
+#ifdef DT_DISC_DEBUG
+#define DT_DISC_LOG(...)    DEBUG_PRINTF(__VA_ARGS__)
+#else
+#define DT_DISC_LOG(...)
+#endif
+
+#define DT_DISC_SRC_CNT     2           // Maximal count of sources (stored in the EEPROM)
+
+// The estimates are stored in the page before the DCF power profile (AT24C32)
+#define DT_DISC_MEM_ADDR    0x0FC0
+#define DT_DISC_MAGIC       0xD15C
+
+#define DT_DISC_TICK_MAX_US 300000      // Maximal interval of two reads to detect the second tick
+#define DT_DISC_REF_MAX_US  120000000   // Maximal interval of two references (a minute may be lost)
+#define DT_DISC_TICK_MIN    10          // Minimal count of ticks between two references (one offset)
+#define DT_DISC_OFF_MAX_US  2000000     // Maximal offset measured (source not set)
+#define DT_DISC_OUTLIER_US  200000      // Maximal residual of an offset (from the 3rd offset)
+#define DT_DISC_OUTLIER_RUN 5           // Consecutive rejected offsets restart the fit
+#define DT_DISC_MIN_CNT     10          // Minimal count of offsets of a valid fit
+#define DT_DISC_MIN_SPAN_S  3600        // Minimal span [s] of a valid fit
+#define DT_DISC_SIGMA_MIN   10          // Minimal uncertainty [ppb] of a fit
+#define DT_DISC_WANDER_PPB  100         // Frequency wander [ppb] between two fits (temperature, aging)
+#define DT_DISC_TRIM_PCT    20          // Uncertainty [%] of the frequency change by a trim
+
+//******************************************************************************
+// Typedefs
+//******************************************************************************
+
+// Frequency estimate of a source (stored in the EEPROM)
+typedef struct {
+    int32_t ppb;                // Frequency error [ppb], positive: the clock is fast
+    uint32_t sigma_ppb;         // Uncertainty (standard deviation) [ppb]
+    uint16_t fits;              // Count of fits included (0: no estimate)
+    uint16_t reserved;
+} dt_disc_est_t;
+
+// Estimates of all sources (stored in the EEPROM, one page)
+typedef struct {
+    uint16_t magic;             // DT_DISC_MAGIC
+    uint16_t reserved0;
+    dt_disc_est_t est[DT_DISC_SRC_CNT];
+    uint8_t reserved[3];
+    uint8_t check;              // Checksum: the sum of all bytes is 0
+} dt_disc_mem_t;
+
+// State of a source
+typedef struct {
+    const char * name;
+    bool last_valid;            // Last report (to detect the second tick)
+    epoch_t last_epoch;
+    ustime_t last_ustime;
+    uint32_t tick_cnt;          // Ticks since the last reference and the sum of their offsets
+    int64_t tick_sum_us;
+    uint32_t cnt;               // Fit of the offsets since the source was set (cnt, means and sums of the
+    ustime_t fit_ustime;        //   squared deviations, t in s since fit_ustime, offset x in us)
+    double mean_t;
+    double mean_x;
+    double stt;
+    double stx;
+    double sxx;
+    int32_t offset_us;          // Last offset (mean of a minute), positive: the clock is ahead
+    ustime_t offset_ustime;     // System time of the last offset
+    uint32_t outliers;          // Count of rejected offsets
+    uint32_t outlier_run;       // Count of consecutive rejected offsets
+    dt_disc_est_t est;          // Estimate of the previous fits
+} dt_disc_src_t;
+
+//******************************************************************************
+// Exported Functions
+//******************************************************************************
+
+// Init the module (no sources), the estimates are read in dt_disc_poll
+void dt_disc_init(void);
+
+// Add a source (the order defines the place in the EEPROM), returns the id (-1: no free slot)
+int dt_disc_add(const char * name);
+
+// Report the date/time read from a source at system time ustime
+void dt_disc_report(const int id, const datetime_t * dt_ptr, const ustime_t ustime);
+
+// Report the second tick of a source: dt_ptr started at system time tick_ustime
+void dt_disc_tick(const int id, const datetime_t * dt_ptr, const ustime_t tick_ustime);
+
+// Reference: an accepted DCF77 minute at system time ustime (second 0 edge)
+void dt_disc_reference(const datetime_t * dt_ptr, const ustime_t ustime);
+
+// The source was set: the actual fit is included in the estimate (stored)
+void dt_disc_set(const int id);
+
+// The frequency of the source was trimmed by delta_ppb (expected): the estimate is moved
+void dt_disc_trim(const int id, const int32_t delta_ppb);
+
+// Poll the module every second: read/write the estimates from/to the EEPROM
+void dt_disc_poll(void);
+
+// Clear the estimates of all sources
+void dt_disc_clear(void);
+
+// Get the frequency error [ppb] and its uncertainty, false if not estimated
+bool dt_disc_get_ppb(const int id, int32_t * ppb_ptr, uint32_t * sigma_ptr);
+
+// Get the frequency error [ppb] of the actual fit alone (since the last set/trim), false if not valid
+bool dt_disc_get_fit_ppb(const int id, int32_t * ppb_ptr, uint32_t * sigma_ptr);
+
+// Get the predicted offset [us] at sys_ustime, false if there is no valid fit
+bool dt_disc_get_offset(const int id, const ustime_t sys_ustime, int32_t * offset_ptr);
+
+// Get the predicted holdover error [ms] after hold_s seconds (-1: not estimated)
+int32_t dt_disc_get_holdover(const int id, const uint32_t hold_s);
+
+// Get the state of a source (NULL if not used)
+const dt_disc_src_t * dt_disc_get_src(const int id);
+
+//******************************************************************************
+#endif /* DT_DISC_H */
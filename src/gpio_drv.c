@@ -28,11 +28,15 @@
 //******************************************************************************
 // Function Prototypes
 //******************************************************************************
+static void gpio_drv_irq(unsigned int gpio, uint32_t events);
 
 //******************************************************************************
 // Global Variables
 //******************************************************************************
 
+// Interrupt callbacks of the pins (the pico SDK has one GPIO callback per core)
+static volatile gpio_drv_irq_func_t irq_func[GPIO_DRV_PIN_CNT];
+
 /***************************************************************************//**
 * @brief Init GPIO pins
 *******************************************************************************/
@@ -73,6 +77,38 @@ void gpio_drv_init()
     gpio_set_dir(LOG_CH6, GPIO_OUT);
 }
 
+/***************************************************************************//**
+* @brief Set the interrupt callback of a pin and enable its interrupt on the
+*        calling core. The GPIO interrupt is shared by all pins and dispatched
+*        to the callback of the pin which triggered it.
+* @param pin [in] pin index
+* @param events [in] events which trigger the interrupt (GPIO_IRQ_EDGE_...)
+* @param func [in] callback
+*******************************************************************************/
+void gpio_drv_set_irq(unsigned int pin, uint32_t events, gpio_drv_irq_func_t func)
+{
+    if(pin >= GPIO_DRV_PIN_CNT)
+        return;
+
+    irq_func[pin] = func;
+    gpio_set_irq_enabled_with_callback(pin, events, true, gpio_drv_irq);
+}
+
+/***************************************************************************//**
+* @brief GPIO interrupt callback: calls the callback of the pin
+* @param gpio [in] pin which triggered the interrupt
+* @param events [in] mask of the events which triggered the interrupt
+*******************************************************************************/
+static void gpio_drv_irq(unsigned int gpio, uint32_t events)
+{
+    if(gpio >= GPIO_DRV_PIN_CNT)
+        return;
+
+    gpio_drv_irq_func_t func = irq_func[gpio];
+    if(func != NULL)
+        func(gpio, events);
+}
+
 /***************************************************************************//**
 * @brief Init input filter
 * @param ptr_in [in/out] pointer to filter structure to init.
@@ -44,10 +44,10 @@
 #define GPIO_P_ENCA 8
 #define GPIO_P_ENCB 9
 //              GND
-//                  10
-//                  11
-//                  12
-//                  13
+#define GPIO_P_SQW  10      // DS3231 INT/SQW (see rtc_sqw)
+//      DCF_PWR_PIN 11      // DCF77 receiver power-on, PON (see dcf_pwr)
+//      DCF_IN2_PIN 12      // Second DCF77 receiver, DCF_DUAL (see dcf77)
+//       DCF_IN_PIN 13      // DCF77 receiver (see dcf77)
 //              GND
 
 #define LOG_CH2     26
@@ -77,6 +77,11 @@
 // GP14->|19       22|<- GP17
 // GP15->|20       21|<- GP16
 
+#define GPIO_DRV_PIN_CNT    30  // Count of GPIO pins (bank 0)
+
+// Interrupt callback of a pin
+typedef void (*gpio_drv_irq_func_t)(unsigned int gpio, uint32_t events);
+
 // Filter defines
 #define InputFilterMax  2000
 
@@ -114,6 +119,9 @@ typedef struct {
 // Init GPIO pins
 void gpio_drv_init();
 
+// Set the interrupt callback of a pin (the GPIO interrupt is shared by all pins)
+void gpio_drv_set_irq(unsigned int pin, uint32_t events, gpio_drv_irq_func_t func);
+
 // Init input filter
 void input_filter_init(InputFilter * ptr_in);
 
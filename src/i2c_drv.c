@@ -71,6 +71,7 @@
 #include "hardware/i2c.h"
 
 #include "i2c_drv.h"
+#include "sched.h"
 
 //******************************************************************************
 // Function Prototypes
@@ -150,6 +151,7 @@ void i2c_drv_irq(void)
         // Clear TX_ABORT bit and source
         hw->clr_tx_abrt;
         state_int = i2c_state_abort;
+        sched_post(sched_ev_i2c);
         return;
     }
 
@@ -159,6 +161,7 @@ void i2c_drv_irq(void)
         hw->clr_stop_det;
         state = (state_int == i2c_state_busy) ? i2c_state_idle : state_int;
         hw->intr_mask = 0;
+        sched_post(sched_ev_i2c);
     }
 
     // Something received?
@@ -299,7 +302,7 @@ i2c_state_t i2c_drv_poll_state(void)
     if((state == i2c_state_busy) && (utime_func != NULL))
     {
         ustime_t utime_new = utime_func();
-        if(get_diff_ustime(utime_new, utime_start) >= utime_txall)
+        if(ustime_timeout(utime_new, utime_start, utime_txall))
         {
             // Timeout occured, stop transfer
             i2c_hw_t *hw = i2c_get_hw(I2C_DRV_ID);
@@ -312,6 +315,23 @@ i2c_state_t i2c_drv_poll_state(void)
     return state;
 }
 
+/***************************************************************************//**
+* @brief Get the timeout of the running transfer: the end of the transfer is
+*        posted as sched_ev_i2c, only the timeout must be polled
+*        (i2c_drv_poll_state)
+* @param tout_ptr [out] system time in us of the timeout (without time
+*        function: the transfer start, poll now)
+* @return true if a transfer is running, false if not (output unchanged)
+*******************************************************************************/
+bool i2c_drv_get_tout(ustime_t * tout_ptr)
+{
+    if(state != i2c_state_busy)
+        return false;
+
+    *tout_ptr = utime_start + utime_txall;
+    return true;
+}
+
 /***************************************************************************//**
 * @brief Returns the last read i2c data (if there is any received)
 * @param ptr_dst [out] pointer to buffer where the received data is copied
@@ -136,6 +136,9 @@ bool i2c_drv_transfer_start(const uint8_t sl_addr, const uint8_t * tx_ptr, int t
 // Polls and returns the state of the i2c interface
 i2c_state_t i2c_drv_poll_state(void);
 
+// Get the timeout of the running transfer (its end is posted as sched_ev_i2c)
+bool i2c_drv_get_tout(ustime_t * tout_ptr);
+
 // Returns the last read i2c data (if there is any received)
 int i2c_drv_get_rx_data(uint8_t * ptr_dst, int dst_max);
 
@@ -32,6 +32,9 @@
 #include "i2c_manager.h"
 #include "i2c_rtc.h"
 #include "i2c_bh1750.h"
+#include "i2c_mem.h"
+#include "rtc_sqw.h"
+#include "sched.h"
 #include "gpio_drv.h"   //!!! to be deleted
 
 //******************************************************************************
@@ -47,9 +50,14 @@ typedef enum {
     cmd_no = 0,         // No command
     cmd_rtc_read,       // Read RTC
     cmd_rtc_set,        // Set RTC
+    cmd_rtc_set_at,     // Set RTC at an instant (aligned to the second)
+    cmd_rtc_aging,      // Write RTC aging offset
+    cmd_rtc_sqw,        // Enable RTC square wave (1Hz)
     cmd_bh1750_init,    // Init BH1750
     cmd_bh1750_read,    // Read BH1750 value
-    cmd_mem_test        // Memory Test
+    cmd_mem_test,       // Memory Test
+    cmd_mem_read,       // Read memory
+    cmd_mem_write       // Write memory
 } cmd_t;
 
 // Request
@@ -57,6 +65,13 @@ typedef struct {
     cmd_t cmd;                      // Command to be executed
     i2c_man_callback_t callback;    // Callback when command finishes
     int idx;                        // Index, variable used to identify different steps
+    // Parameters, kept with the request (a new request can be accepted while
+    // this one waits in req_exe to be started)
+    uint8_t * mem_rd_ptr;           // Memory read: destination of the data
+    const uint8_t * mem_wr_ptr;     // Memory write: source of the data
+    uint16_t mem_addr;              // Memory address
+    int mem_len;                    // Length of data to read/write
+    int8_t aging;                   // RTC aging offset to write
 } req_t;
 
 //******************************************************************************
@@ -64,19 +79,24 @@ typedef struct {
 //******************************************************************************
 static req_t req_new;       // New request to be executed
 static req_t req_exe;       // Request being currently executed
-
-static ustime_t ms1_ustime; // Detect 1ms change
+static req_t req_at;        // Request waiting for its instant (aligned RTC set)
 
 static i2c_man_update_t updated_val = i2c_man_update_none;
 
 // RTC read/set variables
 static datetime_t rtc_dt;
-static int rtc_poll_tout = 0;
+static ustime_t rtc_poll_ustime = 0;   // Next cyclic read (without the square wave)
+static datetime_t rtc_at_dt;            // Aligned set: datetime valid at rtc_at_ustime
+static ustime_t rtc_at_ustime;          // Aligned set: instant of the seconds register write
+static int rtc_sqw_cfg_cnt = 0;         // Count of square wave configurations
+static uint32_t rtc_edge_cnt = 0;       // Square wave edge of the last read
+static bool rtc_edge_read = false;      // The last read followed a square wave edge
+static ustime_t rtc_edge_ustime;        // System time of the edge
 
 // BH1750 sensor variables
 static bool bh1750_init_flag = false;   // True if BH1750 successfuly initialised
-static int bh1750_init_tout = 0;        // Timeout for re-init in case if failed to init BH1750
-static int bh1750_read_tout = 0;        // Timeout for cyclically reading BH1750 value
+static ustime_t bh1750_init_ustime = 0; // Re-init in case if failed to init BH1750
+static ustime_t bh1750_read_ustime = 0; // Next cyclic read of the BH1750 value
 
 /***************************************************************************//**
 * @brief Init request
@@ -89,6 +109,9 @@ static void init_req(req_t * req_ptr, const cmd_t cmd, const i2c_man_callback_t
     req_ptr->cmd = cmd;
     req_ptr->callback = callback;
     req_ptr->idx = 0;
+    // Wake the manager task (the request may come from another task)
+    if(cmd != cmd_no)
+        sched_post(sched_ev_i2c);
 }
 
 /***************************************************************************//**
@@ -108,6 +131,7 @@ void i2c_man_init(void)
 {
     req_new.cmd = cmd_no;
     req_exe.cmd = cmd_no;
+    req_at.cmd = cmd_no;
 }
 
 /***************************************************************************//**
@@ -170,6 +194,59 @@ static void poll_cmd_rtc_set(void)
     }
 }
 
+/***************************************************************************//**
+* @brief Poll RTC set at an instant command. The request is started
+*        I2C_MAN_RTC_SET_GUARD_US before the instant (no other transfer can
+*        delay it), the write is staged and fired by busy-waiting the last
+*        I2C_MAN_RTC_SET_SPIN_US. If it is too late, it waits for the next second.
+*******************************************************************************/
+static void poll_cmd_rtc_set_at(void)
+{
+    i2c_err_t res = i2c_err_unknown;
+    bool finish = false;
+
+    if(req_exe.idx == 0)
+    {
+        ustime_t fire_ustime = rtc_at_ustime - I2C_RTC_SET_LEAD_US;
+        int32_t lead = get_diff_ustime_signed(fire_ustime, ustime_now());
+        if(lead < -I2C_MAN_RTC_SET_LATE_US)
+        {
+            uint32_t late_s = (uint32_t)(get_diff_ustime(ustime_now(), fire_ustime) / 1000000ULL) + 1;
+            I2C_MAN_LOG("i2c_man: RTC set %lius late, +%lus\r\n", (long) -lead, (unsigned long) late_s);
+            rtc_at_ustime += late_s * 1000000ULL;
+            datetime_from_epoch(&rtc_at_dt, datetime_to_epoch(&rtc_at_dt) + late_s);
+            copy_req(&req_at, &req_exe);
+            req_exe.cmd = cmd_no;
+            return;
+        }
+        if(lead > I2C_MAN_RTC_SET_SPIN_US)
+            return;
+
+        // Stage and fire the request
+        req_exe.idx = 1;
+        res = i2c_rtc_write_stage(&rtc_at_dt, rtc_at_ustime);
+        if(res == i2c_success)
+        {
+            while(get_diff_ustime_signed(fire_ustime, ustime_now()) > 0)
+                tight_loop_contents();
+            res = i2c_rtc_write_fire();
+        }
+        finish = (res != i2c_success);
+    }
+    else {
+        // Poll request
+        res = i2c_rtc_write_poll();
+        finish = (res != i2c_err_busy);
+    }
+
+    if(finish)
+    {
+        if(req_exe.callback != NULL)
+            req_exe.callback((int) res);
+        req_exe.cmd = cmd_no;
+    }
+}
+
 /***************************************************************************//**
 * @brief Poll BH1750 init command
 *******************************************************************************/
@@ -263,6 +340,140 @@ static void poll_cmd_mem_test(void)
     }
 }
 
+/***************************************************************************//**
+* @brief Poll memory read/write command
+*******************************************************************************/
+static void poll_cmd_mem_rw(void)
+{
+    i2c_err_t res = i2c_err_unknown;
+    bool finish = false;
+    bool wr = (req_exe.cmd == cmd_mem_write);
+
+    if(req_exe.idx == 0)
+    {
+        // Start request
+        req_exe.idx = 1;
+        if(wr)
+            res = i2c_mem_write_start(req_exe.mem_addr, req_exe.mem_wr_ptr, req_exe.mem_len);
+        else
+            res = i2c_mem_read_start(req_exe.mem_rd_ptr, req_exe.mem_addr, req_exe.mem_len);
+        finish = (res != i2c_success);
+    }
+    else {
+        // Poll request
+        res = (wr ? i2c_mem_write_poll() : i2c_mem_read_poll());
+        finish = (res != i2c_err_busy);
+    }
+
+    if(finish)
+    {
+        if(req_exe.callback != NULL)
+            req_exe.callback((int) res);
+        req_exe.cmd = cmd_no;
+    }
+}
+
+/***************************************************************************//**
+* @brief Poll RTC aging offset write command
+*******************************************************************************/
+static void poll_cmd_rtc_aging(void)
+{
+    i2c_err_t res = i2c_err_unknown;
+    bool finish = false;
+
+    if(req_exe.idx == 0)
+    {
+        // Start request
+        req_exe.idx = 1;
+        res = i2c_rtc_aging_write_start(req_exe.aging);
+        finish = (res != i2c_success);
+    }
+    else {
+        // Poll request
+        res = i2c_rtc_aging_write_poll();
+        finish = (res != i2c_err_busy);
+    }
+
+    if(finish)
+    {
+        if(req_exe.callback != NULL)
+            req_exe.callback((int) res);
+        req_exe.cmd = cmd_no;
+    }
+}
+
+/***************************************************************************//**
+* @brief Poll RTC square wave configuration command
+*******************************************************************************/
+static void poll_cmd_rtc_sqw(void)
+{
+    i2c_err_t res = i2c_err_unknown;
+    bool finish = false;
+
+    if(req_exe.idx == 0)
+    {
+        // Start request
+        req_exe.idx = 1;
+        res = i2c_rtc_sqw_write_start();
+        finish = (res != i2c_success);
+    }
+    else {
+        // Poll request
+        res = i2c_rtc_sqw_write_poll();
+        finish = (res != i2c_err_busy);
+    }
+
+    if(finish)
+    {
+        I2C_MAN_LOG("i2c_man: RTC square wave 1Hz (%i)\r\n", (int) res);
+        if(req_exe.callback != NULL)
+            req_exe.callback((int) res);
+        req_exe.cmd = cmd_no;
+    }
+}
+
+/***************************************************************************//**
+* @brief Check if the square wave of RTC must be configured (1Hz): the
+*        control register is read and differs (at most I2C_MAN_RTC_SQW_CFG_MAX
+*        times, the output may be used otherwise)
+* @return true if the configuration is needed
+*******************************************************************************/
+static bool rtc_sqw_cfg_needed(void)
+{
+    uint16_t ctrl = i2c_rtc_get_ctrl();
+    return (ctrl != I2C_RTC_CTL_INVALID)
+        && ((ctrl & I2C_RTC_CTL_SQW_MASK) != I2C_RTC_CTL_SQW_1HZ)
+        && (rtc_sqw_cfg_cnt < I2C_MAN_RTC_SQW_CFG_MAX);
+}
+
+/***************************************************************************//**
+* @brief Request to read RTC if due: once after every edge of the square wave
+*        (second tick) or cyclically (I2C_MAN_RTC_POLL_TOUT) without it
+* @param sys_ustime [in] system time in us
+* @return true if the read is requested
+*******************************************************************************/
+static bool rtc_read_request(const ustime_t sys_ustime)
+{
+    ustime_t edge_ustime;
+    uint32_t edge_cnt = rtc_sqw_get_edge(&edge_ustime);
+    bool edge = false;
+    if(rtc_sqw_is_active(sys_ustime))
+    {
+        if(edge_cnt == rtc_edge_cnt)
+            return false;
+        // The second read started at the edge (read within the same second)
+        edge = (get_diff_ustime(sys_ustime, edge_ustime) < I2C_MAN_RTC_EDGE_MAX_US);
+    }
+    else if(sys_ustime < rtc_poll_ustime)
+        return false;
+
+    rtc_edge_cnt = edge_cnt;
+    i2c_man_req_rtc_read(NULL);
+    rtc_edge_read = edge;
+    rtc_edge_ustime = edge_ustime;
+    return true;
+}
+
 /***************************************************************************//**
 * @brief BH1750 init callback. Function called when BH1750 init finishes
 * @param result [in] return status of the BH1750 init function
@@ -274,7 +485,8 @@ void i2c_man_bh1750_init_callback(int result)
 }
 
 /***************************************************************************//**
-* @brief Poll i2c Manager Module. Must be called every program cycle
+* @brief Poll i2c Manager Module. Must be called at the time returned by
+*        i2c_man_get_next and on the events sched_ev_i2c and sched_ev_sqw
 * @param sys_ustime [in] system time in us
 * @return the type of data that has been updated
 *******************************************************************************/
@@ -292,10 +504,27 @@ i2c_man_update_t i2c_man_poll(const ustime_t sys_ustime)
             poll_cmd_rtc_set();
             break;
 
+        case cmd_rtc_set_at:
+            poll_cmd_rtc_set_at();
+            break;
+
+        case cmd_rtc_aging:
+            poll_cmd_rtc_aging();
+            break;
+
+        case cmd_rtc_sqw:
+            poll_cmd_rtc_sqw();
+            break;
+
         case cmd_mem_test:
             poll_cmd_mem_test();
             break;
 
+        case cmd_mem_read:
+        case cmd_mem_write:
+            poll_cmd_mem_rw();
+            break;
+
         case cmd_bh1750_init:
             poll_cmd_bh1750_init();
             break;
@@ -305,6 +534,15 @@ i2c_man_update_t i2c_man_poll(const ustime_t sys_ustime)
             break;
 
         case cmd_no:
+            // Is an aligned RTC set due?
+            if((req_at.cmd != cmd_no)
+                && (get_diff_ustime_signed(rtc_at_ustime, sys_ustime) <= I2C_MAN_RTC_SET_GUARD_US))
+            {
+                copy_req(&req_exe, &req_at);
+                init_req(&req_at, cmd_no, NULL);
+                break;
+            }
+
             // Is there a request to execute?
             if(req_new.cmd != cmd_no)
             {
@@ -314,28 +552,35 @@ i2c_man_update_t i2c_man_poll(const ustime_t sys_ustime)
             }
 
             // Init BH1750 (if not yet initialised)
-            if(!bh1750_init_flag && (bh1750_init_tout == 0))
+            if(!bh1750_init_flag && (sys_ustime >= bh1750_init_ustime))
             {
                 i2c_man_req_bh1750_init(i2c_man_bh1750_init_callback);
-                bh1750_init_tout = I2C_MAN_BH1750_INIT_TOUT;
+                bh1750_init_ustime = sys_ustime + I2C_MAN_BH1750_INIT_TOUT * 1000ULL;
+                break;
+            }
+
+            // Enable the square wave of RTC (second tick)
+            if(rtc_sqw_cfg_needed())
+            {
+                rtc_sqw_cfg_cnt++;
+                init_req(&req_new, cmd_rtc_sqw, NULL);
                 break;
             }
 
             // Read RTC
-            if(rtc_poll_tout == 0)
+            if(rtc_read_request(sys_ustime))
             {
                 TP_TGL(LOG_CH4); //!!! to be deleted
-                i2c_man_req_rtc_read(NULL);
-                rtc_poll_tout = I2C_MAN_RTC_POLL_TOUT;
+                rtc_poll_ustime = sys_ustime + I2C_MAN_RTC_POLL_TOUT * 1000ULL;
                 break;
             }
 
             // Read BH1750 value
-            if(bh1750_read_tout == 0)
+            if(sys_ustime >= bh1750_read_ustime)
             {
                 TP_TGL(LOG_CH5); //!!! to be deleted
                 i2c_man_req_bh1750_read(NULL);
-                bh1750_read_tout = I2C_MAN_BH1750_READ_TOUT;
+                bh1750_read_ustime = sys_ustime + I2C_MAN_BH1750_READ_TOUT * 1000ULL;
                 break;
             }
             break;
@@ -345,75 +590,244 @@ i2c_man_update_t i2c_man_poll(const ustime_t sys_ustime)
             break;
     }
 
-    // Detect 1ms (1000us) and manage timeouts
-    if(get_diff_ustime(sys_ustime, ms1_ustime) > 1000UL)
+    return updated_val;
+}
+
+/***************************************************************************//**
+* @brief Move a deadline earlier
+* @param next_ptr [in/out] deadline
+* @param ustime [in] other deadline
+*******************************************************************************/
+static void next_min(ustime_t * next_ptr, const ustime_t ustime)
+{
+    if(ustime < *next_ptr)
+        *next_ptr = ustime;
+}
+
+/***************************************************************************//**
+* @brief Get the time of the next poll. Between them the manager is run by
+*        the events only: the end of a transfer (sched_ev_i2c), a new request
+*        (sched_ev_i2c) and the square wave edge (sched_ev_sqw)
+* @param sys_ustime [in] system time in us (of the last poll)
+* @return system time in us of the next poll (sys_ustime: poll again now)
+*******************************************************************************/
+ustime_t i2c_man_get_next(const ustime_t sys_ustime)
+{
+    ustime_t next;
+
+    // Request being executed: started in the next poll, after only the
+    // timeout of the transfer must be polled
+    if(req_exe.cmd != cmd_no)
     {
-        ms1_ustime = sys_ustime;
-        if(bh1750_init_tout > 0)
-            bh1750_init_tout--;
-        if(bh1750_read_tout > 0)
-            bh1750_read_tout--;
-        if(rtc_poll_tout > 0)
-            rtc_poll_tout--;
+        if((req_exe.cmd == cmd_rtc_set_at) && (req_exe.idx == 0))
+            return rtc_at_ustime - I2C_RTC_SET_LEAD_US - I2C_MAN_RTC_SET_SPIN_US;
+        if(i2c_drv_get_tout(&next))
+            return next;
+        return sys_ustime;
     }
 
-    return updated_val;
+    // Request waiting to be executed or square wave configuration
+    if((req_new.cmd != cmd_no) || rtc_sqw_cfg_needed())
+        return sys_ustime;
+
+    // RTC read: after every edge of the square wave or cyclically (also
+    // when the square wave is lost)
+    ustime_t edge_ustime;
+    uint32_t edge_cnt = rtc_sqw_get_edge(&edge_ustime);
+    if(rtc_sqw_is_active(sys_ustime))
+    {
+        if(edge_cnt != rtc_edge_cnt)
+            return sys_ustime;
+        next = edge_ustime + RTC_SQW_TOUT_US + 1;
+    }
+    else
+        next = rtc_poll_ustime;
+
+    // Aligned RTC set
+    if(req_at.cmd != cmd_no)
+    {
+        if(get_diff_ustime_signed(rtc_at_ustime, sys_ustime) <= I2C_MAN_RTC_SET_GUARD_US)
+            return sys_ustime;
+        next_min(&next, rtc_at_ustime - I2C_MAN_RTC_SET_GUARD_US);
+    }
+
+    // BH1750 init and read
+    if(!bh1750_init_flag)
+        next_min(&next, bh1750_init_ustime);
+    next_min(&next, bh1750_read_ustime);
+    return next;
 }
 
 /***************************************************************************//**
-* @brief Request to read RTC
+* @brief Request to read RTC (the request is rejected if another request is
+*        waiting to be executed)
 * @param callback [in] function to be called when request finishes
-* @return true
+* @return true if the request is accepted
 *******************************************************************************/
 bool i2c_man_req_rtc_read(i2c_man_callback_t callback)
 {
+    if(req_new.cmd != cmd_no)
+        return false;
+
     init_req(&req_new, cmd_rtc_read, callback);
+    rtc_edge_read = false;
     return true;
 }
 
 /***************************************************************************//**
-* @brief Request to set RTC
+* @brief Get the second tick (square wave edge) of the last RTC read
+* @param edge_ptr [out] system time of the edge: the second read started there
+* @return true if the last read followed a second tick, false if not (output unchanged)
+*******************************************************************************/
+bool i2c_man_get_rtc_edge(ustime_t * edge_ptr)
+{
+    if(rtc_edge_read)
+        *edge_ptr = rtc_edge_ustime;
+    return rtc_edge_read;
+}
+
+/***************************************************************************//**
+* @brief Request to set RTC (the request is rejected if another request is
+*        waiting to be executed)
+* @param datetime_ptr [in] pointer to datetime to set
 * @param callback [in] function to be called when request finishes
-* @return true
+* @return true if the request is accepted
 *******************************************************************************/
 bool i2c_man_req_rtc_set(const datetime_t * datetime_ptr, i2c_man_callback_t callback)
 {
+    if(req_new.cmd != cmd_no)
+        return false;
+
     datetime_copy(&rtc_dt, datetime_ptr);
     init_req(&req_new, cmd_rtc_set, callback);
     return true;
 }
 
 /***************************************************************************//**
-* @brief Memory test request
+* @brief Request to set RTC at an instant: the seconds register is written at
+*        set_ustime (the DS3231 restarts its second there), only the changed
+*        registers are written (the request is rejected if another aligned
+*        set is waiting)
+* @param datetime_ptr [in] pointer to datetime valid at set_ustime
+* @param set_ustime [in] system time of the set (a second edge)
+* @param callback [in] function to be called when request finishes
+* @return true if the request is accepted, false if not
+*******************************************************************************/
+bool i2c_man_req_rtc_set_at(const datetime_t * datetime_ptr, const ustime_t set_ustime, i2c_man_callback_t callback)
+{
+    if((req_at.cmd != cmd_no) || (req_exe.cmd == cmd_rtc_set_at))
+        return false;
+
+    datetime_copy(&rtc_at_dt, datetime_ptr);
+    rtc_at_ustime = set_ustime;
+    init_req(&req_at, cmd_rtc_set_at, callback);
+    return true;
+}
+
+/***************************************************************************//**
+* @brief Request to write the RTC aging offset (the request is rejected if
+*        another request is waiting to be executed)
+* @param aging [in] aging offset to write
+* @param callback [in] function to be called when request finishes
+* @return true if the request is accepted
+*******************************************************************************/
+bool i2c_man_req_rtc_aging(const int8_t aging, i2c_man_callback_t callback)
+{
+    if(req_new.cmd != cmd_no)
+        return false;
+
+    init_req(&req_new, cmd_rtc_aging, callback);
+    req_new.aging = aging;
+    return true;
+}
+
+/***************************************************************************//**
+* @brief Memory test request (the request is rejected if another request is
+*        waiting to be executed)
 * @param req_ptr [in] pointer to request structure
 * @param callback [in] function to be called when request finishes
-* @return true
+* @return true if the request is accepted
 *******************************************************************************/
 bool i2c_man_req_mem_test(const test_mem_req_t * req_ptr, i2c_man_callback_t callback)
 {
+    if(req_new.cmd != cmd_no)
+        return false;
+
     test_mem_req(req_ptr);
     init_req(&req_new, cmd_mem_test, callback);
     return true;
 }
 
 /***************************************************************************//**
-* @brief Request to init BH1750 module
+* @brief Request to read memory (the request is rejected if another request
+*        is waiting to be executed)
+* @param dst_ptr [out] pointer to buffer where the read data is copied
+*        (must be valid until the callback is called)
+* @param src_addr [in] memory address to read from
+* @param len [in] length of data to read
+* @param callback [in] function to be called when request finishes
+* @return true if the request is accepted
+*******************************************************************************/
+bool i2c_man_req_mem_read(uint8_t * dst_ptr, const uint16_t src_addr, int len, i2c_man_callback_t callback)
+{
+    if(req_new.cmd != cmd_no)
+        return false;
+
+    init_req(&req_new, cmd_mem_read, callback);
+    req_new.mem_rd_ptr = dst_ptr;
+    req_new.mem_addr = src_addr;
+    req_new.mem_len = len;
+    return true;
+}
+
+/***************************************************************************//**
+* @brief Request to write memory (the request is rejected if another request
+*        is waiting to be executed)
+* @param dst_addr [in] memory address to write to
+* @param src_ptr [in] pointer to data to write (must be valid until the
+*        callback is called)
+* @param len [in] length of data to write
+* @param callback [in] function to be called when request finishes
+* @return true if the request is accepted
+*******************************************************************************/
+bool i2c_man_req_mem_write(const uint16_t dst_addr, const uint8_t * src_ptr, int len, i2c_man_callback_t callback)
+{
+    if(req_new.cmd != cmd_no)
+        return false;
+
+    init_req(&req_new, cmd_mem_write, callback);
+    req_new.mem_wr_ptr = src_ptr;
+    req_new.mem_addr = dst_addr;
+    req_new.mem_len = len;
+    return true;
+}
+
+/***************************************************************************//**
+* @brief Request to init BH1750 module (the request is rejected if another
+*        request is waiting to be executed)
 * @param callback [in] function to be called when request finishes
-* @return true
+* @return true if the request is accepted
 *******************************************************************************/
 bool i2c_man_req_bh1750_init(i2c_man_callback_t callback)
 {
+    if(req_new.cmd != cmd_no)
+        return false;
+
     init_req(&req_new, cmd_bh1750_init, callback);
     return true;
 }
 
 /***************************************************************************//**
-* @brief Request to read BH1750 value
+* @brief Request to read BH1750 value (the request is rejected if another
+*        request is waiting to be executed)
 * @param callback [in] function to be called when request finishes
-* @return true
+* @return true if the request is accepted
 *******************************************************************************/
 bool i2c_man_req_bh1750_read(i2c_man_callback_t callback)
 {
+    if(req_new.cmd != cmd_no)
+        return false;
+
     init_req(&req_new, cmd_bh1750_read, callback);
     return true;
 }
@@ -48,9 +48,22 @@
 // Timeout for cyclically reading BH1750 value
 #define I2C_MAN_BH1750_READ_TOUT    230
 
-// Timeout to cyclically poll RTC (in ms)
+// Timeout to cyclically poll RTC (in ms), only without the square wave of RTC
 #define I2C_MAN_RTC_POLL_TOUT       100
 
+// Maximal delay of the RTC read after a square wave edge (the read second started at the edge)
+#define I2C_MAN_RTC_EDGE_MAX_US     500000
+
+// Maximal count of square wave configurations (RTC control register)
+#define I2C_MAN_RTC_SQW_CFG_MAX     3
+
+// Aligned RTC set: the request is started I2C_MAN_RTC_SET_GUARD_US before the
+// instant and fired by busy-waiting the last I2C_MAN_RTC_SET_SPIN_US (in us).
+// Fired later than I2C_MAN_RTC_SET_LATE_US, the set is moved to the next second.
+#define I2C_MAN_RTC_SET_GUARD_US    5000
+#define I2C_MAN_RTC_SET_SPIN_US     3000
+#define I2C_MAN_RTC_SET_LATE_US     200
+
 // Pointer to callback function 
 typedef void (*i2c_man_callback_t)(int result);
 
@@ -68,18 +81,38 @@ typedef enum {
 // Init i2c Manager Module. Must be called in main in init phase
 void i2c_man_init(void);
 
-// Poll i2c Manager Module. Must be called every program cycle
+// Poll i2c Manager Module. Must be called at the time returned by
+// i2c_man_get_next and on the events sched_ev_i2c and sched_ev_sqw
 i2c_man_update_t i2c_man_poll(const ustime_t sys_ustime);
 
+// Get the time of the next poll (sys_ustime: poll again now)
+ustime_t i2c_man_get_next(const ustime_t sys_ustime);
+
+// Requests: the request is rejected (false) if another request is waiting
+// to be executed, except for the aligned RTC set (its own slot)
+
 // Request to read RTC
 bool i2c_man_req_rtc_read(i2c_man_callback_t callback);
 
+// Get the second tick (square wave edge) of the last RTC read, false if none
+bool i2c_man_get_rtc_edge(ustime_t * edge_ptr);
+
 // Request to set RTC
 bool i2c_man_req_rtc_set(const datetime_t * datetime_ptr, i2c_man_callback_t callback);
 
+// Request to set RTC at an instant (aligned to the second, only the changed registers)
+bool i2c_man_req_rtc_set_at(const datetime_t * datetime_ptr, const ustime_t set_ustime, i2c_man_callback_t callback);
+
+// Request to write RTC aging offset
+bool i2c_man_req_rtc_aging(const int8_t aging, i2c_man_callback_t callback);
+
 // Request to test memory
 bool i2c_man_req_mem_test(const test_mem_req_t * req_ptr, i2c_man_callback_t callback);
 
+// Request to read/write memory
+bool i2c_man_req_mem_read(uint8_t * dst_ptr, const uint16_t src_addr, int len, i2c_man_callback_t callback);
+bool i2c_man_req_mem_write(const uint16_t dst_addr, const uint8_t * src_ptr, int len, i2c_man_callback_t callback);
+
 // Request to init BH1750 module
 bool i2c_man_req_bh1750_init(i2c_man_callback_t callback);
 
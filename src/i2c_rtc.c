@@ -73,6 +73,12 @@ static uint8_t rtc_tx_raw[1 + 17];  // buffer used to write RTC raw data (1 addr
 
 static datetime_t act_datetime;     // last read datetime
 static uint16_t act_ctrl_st = I2C_RTC_CTL_INVALID;    // last read control/status
+static bool act_aging_valid = false;    // aging offset read (or written)
+static int8_t act_aging = 0;            // last read (or written) aging offset
+static int8_t new_aging = 0;            // aging offset being written
+static uint8_t new_ctrl = 0;            // control register being written
+static ustime_t act_ustime = 0;         // system time of the last read (0: not valid)
+static int rtc_tx_len = 0;              // length of the staged write (address + registers)
 
 /***************************************************************************//**
 * @brief Init i2c RTC Driver. Must be called in main in init phase
@@ -202,6 +208,28 @@ static int rtc_mem_to_ctrl(uint16_t * ptr_ctrl, const uint8_t * mem, int mem_siz
     return 2;
 }
 
+/***************************************************************************//**
+* @brief Extract aging offset from memory
+*
+*       Bit |   7   |   6   |   5   |   4   |   3   |   2   |   1   |   0   |
+*   --------+-------+-------+-------+-------+-------+-------+-------+-------+
+*    Byte 0 |  SIGN |                       Data                            | Aging Offset
+*
+* @param ptr_aging [out] pointer to aging offset (two's complement)
+* @param mem [in] pointer to memory from where to extract the aging offset
+* @param mem_size [in] maximal size of memory in bytes
+* @return Count of extracted bytes or -1 in case of error
+*******************************************************************************/
+static int rtc_mem_to_aging(int8_t * ptr_aging, const uint8_t * mem, int mem_size)
+{
+    if(mem_size < 1)
+        return -1;
+
+    *ptr_aging = (int8_t) mem[0];
+
+    return 1;
+}
+
 /***************************************************************************//**
 * @brief Copy datetime variable to memory (code it in bcd format)
 * @param mem [out] pointer to memory where to copy the time
@@ -277,14 +305,26 @@ static bool rtc_extract_from_mem(const uint8_t * mem, int mem_size)
         return false;
     }
 
+    // Extract Aging Offset
+    int8_t aging;
+    cnt += res;
+    res = rtc_mem_to_aging(&aging, &mem[cnt], mem_size - cnt);
+    if(res < 0)
+    {
+        I2C_RTC_LOG("i2c_rtc_read_poll: cannot read aging\r\n");
+        return false;
+    }
+
     //I2C_RTC_LOG("%2.2i:%2.2i:%2.2i  ", dt.hour, dt.min, dt.sec);
     //I2C_RTC_LOG("%2.2i.%2.2i.%2.2i  ", dt.day, dt.month, dt.year);
     //I2C_RTC_LOG("(%i)\r\n", dt.dotw);
     I2C_RTC_LOG_TIME("", dt, "  ");
     I2C_RTC_LOG_DATE("", dt, "\r\n");
-    I2C_RTC_LOG("ctrl=%04x\r\n", ctrl);
+    I2C_RTC_LOG("ctrl=%04x aging=%i\r\n", ctrl, aging);
     datetime_copy(&act_datetime, &dt);
     act_ctrl_st = ctrl;
+    act_aging = aging;
+    act_aging_valid = true;
     return true;
 }
 
@@ -328,6 +368,7 @@ i2c_err_t i2c_rtc_read_poll(void)
             I2C_RTC_DUMP(rtc_rx_raw, sizeof(rtc_rx_raw), 0UL);
             if(!rtc_extract_from_mem(rtc_rx_raw, sizeof(rtc_rx_raw)))
                 return i2c_err_format;
+            act_ustime = ustime_now();
             return i2c_success;
         }
         // Error, received less data than requested
@@ -373,13 +414,12 @@ i2c_err_t i2c_rtc_read_blocking(void)
 }
 
 /***************************************************************************//**
-* @brief Start write RTC in non blocking mode (the execution of program is 
-*        not blocked and the status of writing must be polled with i2c_rtc_write_poll)
+* @brief Copy datetime and the registers to keep (aging offset) to the write
+*        buffer (all registers, the alarms and control/status are cleared)
 * @param ptr_datetime [in] - pointer to datetime to write
-* @return i2c_success - writing process has started check status with i2c_rtc_read_poll, 
-*         or i2c_err_... in case of error
+* @return length of the write (address + registers) or -1 in case of error
 *******************************************************************************/
-i2c_err_t i2c_rtc_write_start(const datetime_t * ptr_datetime)
+static int rtc_tx_full(const datetime_t * ptr_datetime)
 {
     // Copy time and date to a memory buffer
     memset(rtc_tx_raw, 0, sizeof(rtc_tx_raw));  // idx 0 = register address = 0
@@ -388,18 +428,111 @@ i2c_err_t i2c_rtc_write_start(const datetime_t * ptr_datetime)
     if(cnt < 0)
     {
         I2C_RTC_LOG("error: cannot convert time to memory\r\n");
-        return i2c_err_format;
+        return -1;
     }
 
-    I2C_RTC_DUMP(&rtc_tx_raw[1], sizeof(rtc_tx_raw) - 1, 0UL);
+    // Keep the aging offset (not written if not yet read)
+    int len = sizeof(rtc_tx_raw);
+    if(act_aging_valid)
+        rtc_tx_raw[1 + I2C_RTC_REG_AGING] = (uint8_t) act_aging;
+    else
+        len--;
+
+    return len;
+}
+
+/***************************************************************************//**
+* @brief Count of time registers to write to set the RTC at set_ustime: the
+*        seconds register (restarts the countdown chain) and the registers
+*        which differ from the RTC at that instant. The RTC at set_ustime is
+*        predicted from the last read (up to a second ahead or behind).
+* @param mem [in] time registers to write (7 bytes)
+* @param set_ustime [in] system time of the write
+* @return count of registers to write (1..7) or 0: write all registers (the
+*         RTC was not read recently or its oscillator was stopped)
+*******************************************************************************/
+static int rtc_changed_regs(const uint8_t * mem, const ustime_t set_ustime)
+{
+    if((act_ustime == 0) || (act_ctrl_st == I2C_RTC_CTL_INVALID) || (act_ctrl_st & I2C_RTC_CTL_OSF)
+        || (get_diff_ustime(set_ustime, act_ustime) > I2C_RTC_SET_READ_MAX_US))
+        return 0;
+
+    epoch_t epoch = datetime_to_epoch(&act_datetime) + (epoch_t)(get_diff_ustime(set_ustime, act_ustime) / 1000000ULL);
+    int cnt = 1;
+    for(epoch_t e = epoch - 1; e <= epoch + 1; e++)
+    {
+        datetime_t dt;
+        uint8_t rtc_mem[7];
+        datetime_from_epoch(&dt, e);
+        if(rtc_datetime_to_mem(rtc_mem, sizeof(rtc_mem), &dt) < 0)
+            return 0;
+
+        for(int reg = cnt; reg < 7; reg++)
+        {
+            if(rtc_mem[reg] != mem[reg])
+                cnt = reg + 1;
+        }
+    }
+    return cnt;
+}
+
+/***************************************************************************//**
+* @brief Start write RTC in non blocking mode (the execution of program is 
+*        not blocked and the status of writing must be polled with i2c_rtc_write_poll)
+* @param ptr_datetime [in] - pointer to datetime to write
+* @return i2c_success - writing process has started check status with i2c_rtc_read_poll, 
+*         or i2c_err_... in case of error
+*******************************************************************************/
+i2c_err_t i2c_rtc_write_start(const datetime_t * ptr_datetime)
+{
+    int len = rtc_tx_full(ptr_datetime);
+    if(len < 0)
+        return i2c_err_format;
+
+    rtc_tx_len = len;
+    return i2c_rtc_write_fire();
+}
+
+/***************************************************************************//**
+* @brief Stage a write of the RTC at the instant set_ustime (the transfer is
+*        started with i2c_rtc_write_fire I2C_RTC_SET_LEAD_US before it). Only
+*        the registers which differ from the RTC at that instant are written.
+* @param ptr_datetime [in] - pointer to datetime to write (valid at set_ustime)
+* @param set_ustime [in] - system time when the seconds register is written
+* @return i2c_success - the write is staged,
+*         or i2c_err_... in case of error
+*******************************************************************************/
+i2c_err_t i2c_rtc_write_stage(const datetime_t * ptr_datetime, const ustime_t set_ustime)
+{
+    int len = rtc_tx_full(ptr_datetime);
+    if(len < 0)
+        return i2c_err_format;
+
+    int cnt = rtc_changed_regs(&rtc_tx_raw[1], set_ustime);
+    rtc_tx_len = (cnt > 0) ? (1 + cnt) : len;
+    I2C_RTC_LOG("i2c_rtc_write_stage: %i registers\r\n", rtc_tx_len - 1);
+    return i2c_success;
+}
+
+/***************************************************************************//**
+* @brief Start the staged write of the RTC in non blocking mode (the status of
+*        writing must be polled with i2c_rtc_write_poll)
+* @return i2c_success - writing process has started check status with i2c_rtc_write_poll,
+*         or i2c_err_... in case of error
+*******************************************************************************/
+i2c_err_t i2c_rtc_write_fire(void)
+{
+    I2C_RTC_DUMP(&rtc_tx_raw[1], rtc_tx_len - 1, 0UL);
 
     // Initiate write
-    if(!i2c_drv_transfer_start(I2C_RTC_DEV_ADDR, rtc_tx_raw, sizeof(rtc_tx_raw), 0))
+    if(!i2c_drv_transfer_start(I2C_RTC_DEV_ADDR, rtc_tx_raw, rtc_tx_len, 0))
     {
         I2C_RTC_LOG("i2c_rtc_set: busy\r\n");
         return i2c_err_busy;
     }
 
+    // The last read doesn't predict the RTC anymore
+    act_ustime = 0;
     return i2c_success;
 }
 
@@ -469,3 +602,108 @@ datetime_t * i2c_rtc_get_datetime(void)
 {
     return &act_datetime;
 }
+
+/***************************************************************************//**
+* @brief Start write of the aging offset in non blocking mode (the status of
+*        writing must be polled with i2c_rtc_aging_write_poll). The DS3231
+*        applies the new value at the next temperature conversion (64s).
+* @param aging [in] aging offset, positive: the oscillator slows down
+*        (about 0.1ppm per LSB at 25 C)
+* @return i2c_success - writing process has started check status with i2c_rtc_aging_write_poll,
+*         or i2c_err_... in case of error
+*******************************************************************************/
+i2c_err_t i2c_rtc_aging_write_start(const int8_t aging)
+{
+    rtc_tx_raw[0] = I2C_RTC_REG_AGING;
+    rtc_tx_raw[1] = (uint8_t) aging;
+    new_aging = aging;
+
+    if(!i2c_drv_transfer_start(I2C_RTC_DEV_ADDR, rtc_tx_raw, 2, 0))
+    {
+        I2C_RTC_LOG("i2c_rtc_aging_write: busy\r\n");
+        return i2c_err_busy;
+    }
+
+    return i2c_success;
+}
+
+/***************************************************************************//**
+* @brief Polling the status of aging offset write in non blocking mode (which
+*        has been started with i2c_rtc_aging_write_start function)
+* @return i2c_success - writing process has finished with success,
+*         i2c_err_busy - writing process is still busy, poll it again later,
+*         i2c_err_... in case of error
+*******************************************************************************/
+i2c_err_t i2c_rtc_aging_write_poll(void)
+{
+    i2c_err_t res = i2c_rtc_write_poll();
+    if(res == i2c_success)
+    {
+        act_aging = new_aging;
+        act_aging_valid = true;
+    }
+    return res;
+}
+
+/***************************************************************************//**
+* @brief Return actual aging offset
+* @param aging_ptr [out] pointer to aging offset
+* @return true if the aging offset is valid (was read), false if not
+*******************************************************************************/
+bool i2c_rtc_get_aging(int8_t * aging_ptr)
+{
+    if(act_aging_valid)
+        *aging_ptr = act_aging;
+    return act_aging_valid;
+}
+
+/***************************************************************************//**
+* @brief Return actual control/status registers
+* @return control (high byte) and status (low byte) or I2C_RTC_CTL_INVALID
+*         if not yet read
+*******************************************************************************/
+uint16_t i2c_rtc_get_ctrl(void)
+{
+    return act_ctrl_st;
+}
+
+/***************************************************************************//**
+* @brief Start write of the control register in non blocking mode: the 1Hz
+*        square wave is enabled on INT/SQW (INTCN = 0, RS2 = RS1 = 0) and the
+*        oscillator runs (EOSC = 0), the other bits are kept. The status of
+*        writing must be polled with i2c_rtc_sqw_write_poll.
+* @return i2c_success - writing process has started check status with i2c_rtc_sqw_write_poll,
+*         or i2c_err_... in case of error
+*******************************************************************************/
+i2c_err_t i2c_rtc_sqw_write_start(void)
+{
+    if(act_ctrl_st == I2C_RTC_CTL_INVALID)
+        return i2c_err_format;
+
+    new_ctrl = (uint8_t)((act_ctrl_st & ~(I2C_RTC_CTL_EOSC | I2C_RTC_CTL_CONV | I2C_RTC_CTL_SQW_MASK)) >> 8);
+    rtc_tx_raw[0] = I2C_RTC_REG_CTRL;
+    rtc_tx_raw[1] = new_ctrl;
+
+    if(!i2c_drv_transfer_start(I2C_RTC_DEV_ADDR, rtc_tx_raw, 2, 0))
+    {
+        I2C_RTC_LOG("i2c_rtc_sqw_write: busy\r\n");
+        return i2c_err_busy;
+    }
+
+    return i2c_success;
+}
+
+/***************************************************************************//**
+* @brief Polling the status of control register write in non blocking mode
+*        (which has been started with i2c_rtc_sqw_write_start function)
+* @return i2c_success - writing process has finished with success,
+*         i2c_err_busy - writing process is still busy, poll it again later,
+*         i2c_err_... in case of error
+*******************************************************************************/
+i2c_err_t i2c_rtc_sqw_write_poll(void)
+{
+    i2c_err_t res = i2c_rtc_write_poll();
+    if((res == i2c_success) && (act_ctrl_st != I2C_RTC_CTL_INVALID))
+        act_ctrl_st = (act_ctrl_st & 0x00FF) | ((uint16_t) new_ctrl << 8);
+    return res;
+}
@@ -35,6 +35,16 @@
 // Defines
 //******************************************************************************
 #define I2C_RTC_DEV_ADDR    0x68
+#define I2C_RTC_REG_CTRL    0x0E    // Control register
+#define I2C_RTC_REG_AGING   0x10    // Aging offset register
+
+// Aligned write: the DS3231 restarts its countdown chain at the acknowledge of
+// the seconds register, 3 bytes (device address, register, seconds) after the
+// start condition (~75us after i2c_drv_transfer_start)
+#define I2C_RTC_SET_LEAD_US     (75ul + (3ul * I2C_DRV_UTIME_BYTE))
+
+// Maximal age of the last read to write only the changed time registers
+#define I2C_RTC_SET_READ_MAX_US 1000000ul
 
 #ifdef I2C_RTC_DEBUG
 #define I2C_RTC_LOG(...)                DEBUG_PRINTF(__VA_ARGS__)
@@ -64,6 +74,10 @@
 #define I2C_RTC_CTL_A2F     0x0002
 #define I2C_RTC_CTL_A1F     0x0001
 
+// Square wave on INT/SQW: INTCN = 0 and the rate RS2/RS1 (0: 1Hz)
+#define I2C_RTC_CTL_SQW_MASK    (I2C_RTC_CTL_RS2 | I2C_RTC_CTL_RS1 | I2C_RTC_CTL_INTCN)
+#define I2C_RTC_CTL_SQW_1HZ     0x0000
+
 //******************************************************************************
 // Exported Functions
 //******************************************************************************
@@ -83,6 +97,10 @@ i2c_err_t i2c_rtc_read_blocking(void);
 // Start write RTC in non blocking mode
 i2c_err_t i2c_rtc_write_start(const datetime_t * ptr_datetime);
 
+// Stage/start a write of RTC at an instant (only the changed registers)
+i2c_err_t i2c_rtc_write_stage(const datetime_t * ptr_datetime, const ustime_t set_ustime);
+i2c_err_t i2c_rtc_write_fire(void);
+
 // Polling the status of write RTC in non blocking mode
 i2c_err_t i2c_rtc_write_poll(void);
 
@@ -92,6 +110,20 @@ i2c_err_t i2c_rtc_write_blocking(const datetime_t * ptr_datetime);
 // Return actual datetime
 datetime_t * i2c_rtc_get_datetime(void);
 
+// Start/poll write of the aging offset in non blocking mode
+i2c_err_t i2c_rtc_aging_write_start(const int8_t aging);
+i2c_err_t i2c_rtc_aging_write_poll(void);
+
+// Return actual aging offset (false if not yet read)
+bool i2c_rtc_get_aging(int8_t * aging_ptr);
+
+// Return actual control/status registers (I2C_RTC_CTL_INVALID if not yet read)
+uint16_t i2c_rtc_get_ctrl(void);
+
+// Start/poll write of the control register: 1Hz square wave on INT/SQW
+i2c_err_t i2c_rtc_sqw_write_start(void);
+i2c_err_t i2c_rtc_sqw_write_poll(void);
+
 
 //******************************************************************************
 #endif /* I2C_RTC_H */
@@ -34,6 +34,7 @@
 #include "i2c_bh1750.h"
 #include "i2c_manager.h"
 #include "dcf77.h"
+#include "dcf_pwr.h"
 #include "utils.h"
 #include "test_btn.h"
 #include "cli.h"
@@ -41,6 +42,15 @@
 #include "test_mem.h"
 #include "hardware/watchdog.h"
 #include "rtc_intern.h"
+#include "sched.h"
+#include "dt_arb.h"
+#include "dt_disc.h"
+#include "rtc_trim.h"
+#include "rtc_sqw.h"
+
+#ifdef MULTICORE
+#include "pico/multicore.h"
+#endif
 
 #include DISP_INCLUDE
 
@@ -51,8 +61,23 @@
 #define BOLD_RED_TEXT   "\033[1;31m"
 #define NORMAL_TEXT     "\033[0m"
 
-// Timeout (in seconds) for DCF in-sync flag
-#define DCF_IN_SYNC_TOUT_S  43200UL     // 12 hours = 720 min = 43200 sec
+// Periods [us] of the tasks
+#define MAIN_CLI_PERIOD     50000UL     // CLI (also run by a received line)
+#define MAIN_DCF_PERIOD     10000UL     // DCF77 decoder (also run by a captured edge)
+#define MAIN_DISPLAY_PERIOD 50000UL     // Display data refresh
+#define MAIN_SEC_PERIOD     1000000UL   // System seconds (also run by the DS3231 second tick)
+#define MAIN_SEC_TICK_MARGIN 100000UL   // Fallback of the second tick (missing edge)
+
+#define MAIN_CORE1_READY    0xDCF77001UL    // Sent by core1 (SIO FIFO) when the decoders are initialised
+
+// Time sources (error bounds in ms, see dt_arb)
+#define MAIN_DCF_ERR_MS     10          // DCF77: error of a decoded minute (second-0 tick)
+#define MAIN_RTC_PPM        2           // DS3231: +-2ppm (0..40 C)
+#define MAIN_RTC_INIT_MS    500         // DS3231: assumed error after power-on (running on battery, OSF clear)
+#define MAIN_RTC_SET_MS     1           // DS3231: alignment of the set to the DCF second edge
+#define MAIN_RTC_SET_LEAD_US 10000UL    // DS3231: minimal time to stage the aligned set
+#define MAIN_RTC_RESYNC_MS  100         // DS3231: set from DCF when its error exceeds the limit
+#define MAIN_INT_PPM        30          // RTC-intern: crystal of the RP2040
 
 #ifdef MAIN_DEBUG
 #define MAIN_LOG(...)     DEBUG_PRINTF(__VA_ARGS__)
@@ -68,56 +93,66 @@
 #define MAIN_LOG_DT(prefix,dt,suffix)
 #endif
 
-// Date/Time source
-typedef enum {
-    dt_src_none = 0,
-    dt_src_dcf,
-    dt_src_rtc,
-    dt_src_int
-} dt_src_t;
-
 typedef struct {
     datetime_t dt;      // Date/Time 
     bool received;      // Flag indicates new Date/Time received in this cycle
-    bool in_sync;       // Flag indicates the Date/Time is in sync
+    bool in_sync;       // Flag indicates the Date/Time is trusted (error bound within DT_ARB_TRUST_MS)
     ustime_t ustime;    // System time (useconds) when Date/Time was received 
-    s_time_t s_time;    // System time (seconds) when Date/Time was received 
-    dt_src_t sync_src;  // Synchronization source (which date/time was used to sync)
+    bool tick;          // The Date/Time started at ustime (DS3231 second tick)
+    int arb_id;         // Source id (dt_arb), final Date/Time: the selected source
+    int disc_id;        // Source id (dt_disc), -1: the drift is not estimated
 } dt_t;
 
 //******************************************************************************
+// The variables of this module are used only on core0. In the multicore mode
+// core1 runs the DCF77 decoders and the state is exchanged only through the
+// decoder snapshot (dcf_get_snapshot) and the decoder control functions.
+
 // System time variables
-ustime_t sys_ustime = 0UL;      // System time in us (since the board was powered-on)
-s_time_t sys_s_time = 0UL;      // System time in seconds (since the board was powered-on)
-ustime_t us_s_time_diff = 0UL;  // Variable used to detect 1 second change (since the board was powered-on)
+static ustime_t sys_ustime = 0UL;   // System time in us (since the board was powered-on)
+static s_time_t sys_s_time = 0UL;   // System time in seconds (since the board was powered-on)
+
+// Task ids
+static int task_dt_id = -1;         // Decide the final Date/Time (one-shot, started by the sources)
+static int task_sec_id = -1;        // System seconds (started by the DS3231 second tick)
+static int task_display_id = -1;    // Display data refresh (started by the DS3231 second tick)
+static int task_i2c_id = -1;        // I2C manager (one-shot at its next deadline, run by the I2C events)
+static int task_disp_id = -1;       // Display driver (one-shot at the next refresh, run by the SPI event)
+
+// DCF77 publish counter of the last received datetime (see dcf_snap_t)
+static uint32_t dcf_pub_cnt = 0;
+
+#ifdef MULTICORE
+static volatile uint32_t core1_loops = 0;   // Incremented by core1 in every cycle
+static uint32_t core1_loops_old = 0;
+static bool core1_alive = true;             // core1 cycled in the last second
+#endif
 
 // Display variables
-ustime_t display_ustime = 0UL;  // Display refresh
-int display_intensity = 8;      // Display intensity
+static int display_intensity = 8;   // Display intensity
 
 // Convert lx value to display intensity
 //                      0  1  2   3   4   5   6   7    8    9    10   11   12   13   14   15
-const int lx_table[] = {0, 5, 10, 25, 40, 60, 80, 110, 140, 180, 220, 270, 320, 380, 440, 520};
-const int lx_table_cnt = sizeof(lx_table) / sizeof(int);
+static const int lx_table[] = {0, 5, 10, 25, 40, 60, 80, 110, 140, 180, 220, 270, 320, 380, 440, 520};
+static const int lx_table_cnt = sizeof(lx_table) / sizeof(int);
 int lx_to_display_intensity(int lx_value);
 
 // Current Time/Date variables
-dt_t dcf_dt;
-dt_t rtc_dt;
-dt_t int_dt;
-dt_t fin_dt;
-
-/***************************************************************************//**
-* @brief Get System Time in us
-*        Warning! This is not safe in case of multi-core
-* @return System Time in us
-*******************************************************************************/
-uint32_t get_sys_ustime(void)
-{
-    uint32_t lr = timer_hw->timelr;
-    timer_hw->timehr;
-    return lr;
-}
+static dt_t dcf_dt;
+static dt_t rtc_dt;
+static dt_t int_dt;
+static dt_t fin_dt;
+static uint32_t fin_err_ms = DT_ARB_ERR_UNKNOWN;   // Error bound of the final Date/Time
+
+// Time sources
+static const dt_arb_cfg_t arb_cfg_dcf = { "dcf",    0,              DT_ARB_ERR_UNKNOWN, MAIN_DCF_ERR_MS };
+static const dt_arb_cfg_t arb_cfg_rtc = { "rtc",    MAIN_RTC_PPM,   MAIN_RTC_INIT_MS,   0 };
+static const dt_arb_cfg_t arb_cfg_int = { "rtcint", MAIN_INT_PPM,   DT_ARB_ERR_UNKNOWN, 0 };
+
+// DS3231 set request
+static bool rtc_set_pending = false;        // Waiting for the callback
+static ustime_t rtc_set_ustime = 0;         // System time of the set (DCF second edge)
+static uint32_t rtc_set_err_ms = 0;         // Error bound of the set datetime
 
 /***************************************************************************//**
 * @brief Display function
@@ -186,22 +221,27 @@ void callback_i2c_rtc_set(int result)
     i2c_err_t i2c_err = (i2c_err_t) result;
     if(i2c_err == i2c_success)
     {
-        rtc_dt.in_sync = true;
+        dt_arb_discipline(rtc_dt.arb_id, rtc_set_err_ms, rtc_set_ustime);
+        dt_disc_set(rtc_dt.disc_id);
     }
+    rtc_set_pending = false;
 }
 
 /***************************************************************************//**
 * @brief Clear the dt variable
 * @param dt_ptr [in/out] pointer to dt variable to clear
+* @param arb_id [in] source id (dt_arb)
+* @param disc_id [in] source id (dt_disc), -1: none
 *******************************************************************************/
-void dt_clear(dt_t * dt_ptr)
+void dt_clear(dt_t * dt_ptr, const int arb_id, const int disc_id)
 {
     datetime_clear(&dt_ptr->dt);
     dt_ptr->received = false;
     dt_ptr->in_sync = false;
     dt_ptr->ustime = 0UL;
-    dt_ptr->s_time = 0UL;
-    dt_ptr->sync_src = dt_src_none;
+    dt_ptr->tick = false;
+    dt_ptr->arb_id = arb_id;
+    dt_ptr->disc_id = disc_id;
 }
 
 /***************************************************************************//**
@@ -209,171 +249,318 @@ void dt_clear(dt_t * dt_ptr)
 * @param datetime_ptr [in] pointer to received Date/Time data
 * @param dt_ptr [out] pointer to dt variable to set
 *******************************************************************************/
-void dt_set_received(dt_t * dt_ptr, const datetime_t * datetime_ptr, dt_src_t sync_src)
+void dt_set_received(dt_t * dt_ptr, const datetime_t * datetime_ptr)
 {
     if(datetime_ptr)
     {
         datetime_copy(&dt_ptr->dt, datetime_ptr);
         dt_ptr->ustime = sys_ustime;
-        dt_ptr->s_time = sys_s_time;
+        dt_ptr->tick = false;
         dt_ptr->received = true;
-        dt_ptr->sync_src = sync_src;
     }
 }
 
 /***************************************************************************//**
-* @brief Check if the difference in seconds between two datetime variables 
-*        is more than sec parameter
-* @param dt1_ptr [in] pointer to datetime variable 1
-* @param dt2_ptr [in] pointer to datetime variable 2
-* @return true if the difference in seconds between two datetime variables 
-*         is more than sec parameter or false if not
+* @brief Update the final Date/Time: the source with the smallest error bound
+*        (dt_arb) extrapolated to the actual system time
 *******************************************************************************/
-bool dt_diff_flag(const dt_t * dt1_ptr, const dt_t * dt2_ptr, int sec)
+void dt_final(void)
 {
-    int sec_diff = datetime_time_diff(&dt1_ptr->dt, &dt2_ptr->dt);
-    return ((sec_diff > sec) || (sec_diff < -sec) 
-        || (datetime_date_compare(&dt1_ptr->dt, &dt2_ptr->dt) != 0));
+    int id = dt_arb_select(sys_ustime, &fin_err_ms);
+    if(id < 0)
+    {
+        fin_dt.in_sync = false;
+        return;
+    }
+
+    if(id != fin_dt.arb_id)
+    {
+        MAIN_LOG("Main: final source: %s (%lums)\r\n", dt_arb_get_src(id)->cfg->name, (unsigned long) fin_err_ms);
+    }
+
+    dt_arb_get_dt(id, sys_ustime, &fin_dt.dt);
+    fin_dt.ustime = sys_ustime;
+    fin_dt.arb_id = id;
+    fin_dt.in_sync = (fin_err_ms <= DT_ARB_TRUST_MS);
+
+    dcf_dt.in_sync = dt_arb_is_trusted(dcf_dt.arb_id, sys_ustime);
+    rtc_dt.in_sync = dt_arb_is_trusted(rtc_dt.arb_id, sys_ustime);
+    int_dt.in_sync = dt_arb_is_trusted(int_dt.arb_id, sys_ustime);
 }
 
 /***************************************************************************//**
-* @brief Decide the final Date/Time
+* @brief Report the received Date/Time to the arbitration (dt_arb), update
+*        the final Date/Time and discipline the clocks
 *
-*   DCF has the top priority. If DCF received, use it as final date/time 
-*   and check if RTC must be synchronized.
+*   A DCF minute is accepted if it doesn't contradict a trusted source (or
+*   after two consecutive consistent minutes). An accepted minute sets the
+*   RTC if the error bound of the RTC exceeds MAIN_RTC_RESYNC_MS (drift since
+*   the last set or the RTC contradicted DCF). The RTC is set exactly at the
+*   next second edge of DCF (the I2C manager aligns the write).
 *
-*   RTC has the second priority but is our main source in case there is no DCF.
-*   Use RTC to set final date/time when there is no DCF.
+*   The RTC in sync is the reference used by DCF to verify single telegrams.
 *
-*   Internal RTC is the last chance. Re-synchronize it if there is a valid 
-*   date/time from DCF or RTC.
+*   The internal RTC is set from a trusted final Date/Time if they differ.
 *******************************************************************************/
 void dt_poll(void)
 {
-    bool fin_set_flag = false;
-
     // DCF
     if(dcf_dt.received)
     {
         MAIN_LOG_DT("Main: DCF: ",(dcf_dt.dt), "\r\n");
+        MAIN_LOG("Main: DCF edge latency: %luus\r\n", (unsigned long) get_diff_ustime(sys_ustime, dcf_dt.ustime));
 
-        // Use DCF as Final time
-        dt_set_received(&fin_dt, &dcf_dt.dt, dt_src_dcf);
-        fin_set_flag = true;
-
-        // Check if RTC must be set (if more than 1 sec difference with DCF)
-        if(dt_diff_flag(&dcf_dt, &rtc_dt, 1))
+        if(!dt_arb_report(dcf_dt.arb_id, &dcf_dt.dt, dcf_dt.ustime))
         {
-            MAIN_LOG("Main: set RTC (DCF diff: %is)\r\n", datetime_time_diff(&dcf_dt.dt, &rtc_dt.dt));
-            i2c_man_req_rtc_set(&dcf_dt.dt, callback_i2c_rtc_set);
-            rtc_dt.in_sync = false;
+            MAIN_LOG("Main: DCF rejected (contradicts a trusted source)\r\n");
         }
+        else {
+            // Offsets of the RTCs against the accepted minute (drift estimation)
+            dt_disc_reference(&dcf_dt.dt, dcf_dt.ustime);
 
-        dcf_dt.in_sync = true;
+            if(!rtc_set_pending && (dt_arb_get_err(rtc_dt.arb_id, sys_ustime) > MAIN_RTC_RESYNC_MS))
+            {
+                // Set the RTC exactly at the next second edge of DCF
+                uint32_t sec = (uint32_t)(get_diff_ustime(sys_ustime + MAIN_RTC_SET_LEAD_US, dcf_dt.ustime) / 1000000UL) + 1;
+                datetime_t dt;
+                datetime_from_epoch(&dt, datetime_to_epoch(&dcf_dt.dt) + sec);
+                rtc_set_ustime = dcf_dt.ustime + (sec * 1000000ULL);
+                rtc_set_err_ms = dt_arb_get_err(dcf_dt.arb_id, rtc_set_ustime) + MAIN_RTC_SET_MS;
+                rtc_set_pending = i2c_man_req_rtc_set_at(&dt, rtc_set_ustime, callback_i2c_rtc_set);
+                MAIN_LOG("Main: set RTC in %luus (error %lums)\r\n",
+                    (unsigned long) get_diff_ustime(rtc_set_ustime, sys_ustime), (unsigned long) rtc_set_err_ms);
+            }
+        }
         dcf_dt.received = false;
     }
 
     // RTC
     if(rtc_dt.received)
     {
-        if(!rtc_dt.in_sync)
+        // Oscillator stopped (OSF, e.g. battery empty): the time of the RTC is
+        // not usable until it is set (a full set clears OSF)
+        uint16_t rtc_ctrl = i2c_rtc_get_ctrl();
+        if((rtc_ctrl != I2C_RTC_CTL_INVALID) && (rtc_ctrl & I2C_RTC_CTL_OSF)
+            && (dt_arb_get_src(rtc_dt.arb_id)->disc_err_ms != DT_ARB_ERR_UNKNOWN))
         {
-            // If RTC received but not in sync and DCF also not in sync
-            // then RTC is our only time source now, mark it as "in sync"
-            if(!dcf_dt.in_sync)
-                rtc_dt.in_sync = true;
+            MAIN_LOG("Main: RTC oscillator stopped (OSF)\r\n");
+            dt_arb_discipline(rtc_dt.arb_id, DT_ARB_ERR_UNKNOWN, rtc_dt.ustime);
         }
-        else if(!fin_set_flag)
+
+        if(rtc_dt.tick)
+            dt_disc_tick(rtc_dt.disc_id, &rtc_dt.dt, rtc_dt.ustime);
+        else
+            dt_disc_report(rtc_dt.disc_id, &rtc_dt.dt, rtc_dt.ustime);
+        if(!dt_arb_report(rtc_dt.arb_id, &rtc_dt.dt, rtc_dt.ustime))
         {
-            // If RTC in sync, use it as Final time
-            dt_set_received(&fin_dt, &rtc_dt.dt, dt_src_rtc);
-            fin_set_flag = true;
+            MAIN_LOG("Main: RTC rejected (contradicts a trusted source)\r\n");
         }
 
+        dcf_set_reference((dt_arb_is_trusted(rtc_dt.arb_id, sys_ustime) ? &rtc_dt.dt : NULL), rtc_dt.ustime);
         rtc_dt.received = false;
     }
 
     // RTC-intern
     if(int_dt.received)
     {
-        // If we have a valid Final time (not from internal RTC) use it to check 
-        // if the internal RTC must be set (in case > 1 sec difference)
-        if((fin_dt.in_sync || fin_set_flag) && (fin_dt.sync_src != dt_src_int))
+        dt_disc_report(int_dt.disc_id, &int_dt.dt, int_dt.ustime);
+        dt_arb_report(int_dt.arb_id, &int_dt.dt, int_dt.ustime);
+        int_dt.received = false;
+    }
+
+    dt_final();
+
+    // Set the RTC-intern from a trusted final Date/Time (not from itself) if
+    // it was never set, it contradicted a better source or it drifted away
+    const dt_arb_src_t * int_src = dt_arb_get_src(int_dt.arb_id);
+    if(fin_dt.in_sync && (fin_dt.arb_id != int_dt.arb_id) && (int_src != NULL)
+        && ((int_src->disc_err_ms == DT_ARB_ERR_UNKNOWN)
+            || (int_src->valid && !dt_arb_is_trusted(int_dt.arb_id, sys_ustime))))
+    {
+        MAIN_LOG_DT("Main: set RTC-intern: ", (fin_dt.dt), "\r\n");
+        if(rtc_int_set(&fin_dt.dt))
         {
-            if(dt_diff_flag(&int_dt, &fin_dt, 1))
-            {
-                MAIN_LOG_DT("Main: set RTC-intern: ", (fin_dt.dt), "\r\n");
-                int_dt.in_sync = rtc_int_set(&fin_dt.dt);
-            }
+            dt_arb_discipline(int_dt.arb_id, fin_err_ms, sys_ustime);
+            dt_disc_set(int_dt.disc_id);
         }
-
-        int_dt.received = false;
     }
+}
 
-    if(fin_set_flag)
-        fin_dt.in_sync = true;
+/***************************************************************************//**
+* @brief Task: CLI
+* @param sys_ustime [in] system time in us
+*******************************************************************************/
+void task_cli(const ustime_t sys_ustime)
+{
+    cli_poll();
 }
 
 /***************************************************************************//**
-* @brief Date/Time timeout (called every second)
-*   Check if a date/time was not updated a period of time and set it as "not in sync".
-*   If the final date/time was not updated more than 1 second from DCF or RTC,
-*   use the internal RTC to update the final date/time.
+* @brief Task: I2C RTC, BH1750, memory and the display intensity
+* @param sys_ustime [in] system time in us
 *******************************************************************************/
-void dt_s_tout(void)
+void task_i2c(const ustime_t sys_ustime)
 {
-    // Mark DCF not in sync if not received more than DCF_IN_SYNC_TOUT_S seconds
-    if(dcf_dt.in_sync)
+    i2c_man_update_t updated_val = i2c_man_poll(sys_ustime);
+    if(updated_val == i2c_man_update_rtc)
     {
-        if(get_diff_s_time(sys_s_time, dcf_dt.s_time) > DCF_IN_SYNC_TOUT_S)
-        {
-            MAIN_LOG("Main: DCF not in sync\r\n");
-            dcf_dt.in_sync = false;
-        }
-    }
+        dt_set_received(&rtc_dt, i2c_rtc_get_datetime());
 
-    // Mark RTC not in sync if not received > 1 sec
-    if(rtc_dt.in_sync)
-    {
-        if(get_diff_s_time(sys_s_time, rtc_dt.s_time) > 1)
+        // Read after the second tick: the Date/Time started at the edge, the
+        // system second and the display follow the tick
+        ustime_t edge_ustime;
+        if(i2c_man_get_rtc_edge(&edge_ustime))
         {
-            MAIN_LOG("Main: RTC not in sync\r\n");
-            rtc_dt.in_sync = false;
+            rtc_dt.ustime = edge_ustime;
+            rtc_dt.tick = true;
+            sched_start(task_sec_id, sys_ustime, 0);
+            sched_start(task_display_id, sys_ustime, 0);
         }
+        sched_start(task_dt_id, sys_ustime, 0);
     }
 
-    // Mark RTC-intern not in sync if not received > 1 sec
-    if(int_dt.in_sync)
+    // Display intensity (only if intensity override is not active)
+    if((updated_val == i2c_man_update_bh1750) && (cli_intens == -1))
     {
-        if(get_diff_s_time(sys_s_time, int_dt.s_time) > 1)
+        int lx_new = i2c_bh1750_get_val();
+        int disp_intens_new = lx_to_display_intensity(lx_new);
+        if(disp_intens_new != display_intensity)
         {
-            MAIN_LOG("Main: RTC-intern not in sync\r\n");
-            int_dt.in_sync = false;
+            if(disp_intens_new > display_intensity)
+                display_intensity++;
+            else
+                display_intensity--;
+            DISP_INTENS(display_intensity);
         }
     }
 
-    // Check if final time is in sync
-    // if not, use the internal RTC as final datetime
-    if(fin_dt.in_sync)
+    sched_start_at(task_i2c_id, i2c_man_get_next(sys_ustime));
+}
+
+/***************************************************************************//**
+* @brief Task: DCF77 decoder (multicore: only the result of core1)
+* @param sys_ustime [in] system time in us
+*******************************************************************************/
+void task_dcf(const ustime_t sys_ustime)
+{
+#ifndef MULTICORE
+    dcf_poll(sys_ustime);
+#endif
+
+    dcf_snap_t snap;
+    dcf_get_snapshot(&snap);
+    if((snap.pub_cnt != dcf_pub_cnt) && snap.valid)
     {
-        if(get_diff_s_time(sys_s_time, fin_dt.s_time) > 1)
-        {
-            MAIN_LOG("Main: Final Time not in sync\r\n");
-            fin_dt.in_sync = false;
-        }
+        // Published at the second-0 edge, use the edge time
+        dt_set_received(&dcf_dt, &snap.dt);
+        dcf_dt.ustime = snap.ustime;
+        dcf_pwr_received(sys_s_time);
+        sched_start(task_dt_id, sys_ustime, 0);
     }
-    if(!fin_dt.in_sync)
+    dcf_pub_cnt = snap.pub_cnt;
+}
+
+/***************************************************************************//**
+* @brief Task: RTC intern
+* @param sys_ustime [in] system time in us
+*******************************************************************************/
+void task_rtc_int(const ustime_t sys_ustime)
+{
+    if(rtc_int_poll(sys_ustime))
     {
-        // If final datetime not in sync, use the internal RTC (our last option)
-        // consider final datetime in-sync only when the internal RTC is in sync
-        dt_set_received(&fin_dt, &int_dt.dt, dt_src_int);
-        fin_dt.in_sync = int_dt.in_sync;
+        dt_set_received(&int_dt, rtc_int_get_datetime());
+        sched_start(task_dt_id, sys_ustime, 0);
     }
 }
 
+/***************************************************************************//**
+* @brief Task: decide the final Date/Time (after a source was received)
+* @param sys_ustime [in] system time in us
+*******************************************************************************/
+void task_dt(const ustime_t sys_ustime)
+{
+    dt_poll();
+}
+
+/***************************************************************************//**
+* @brief Task: system seconds, Date/Time error bounds, RTC trim and DCF receiver duty-cycle
+* @param sys_ustime [in] system time in us
+*******************************************************************************/
+void task_sec(const ustime_t sys_ustime)
+{
+    sys_s_time++;
+
+    // Started by the second tick, the period is the fallback without it
+    if(rtc_sqw_is_active(sys_ustime))
+        sched_start(task_sec_id, sys_ustime, MAIN_SEC_PERIOD + MAIN_SEC_TICK_MARGIN);
+
+    dt_final();
+    dt_disc_poll();
+    rtc_trim_poll(sys_ustime);
+
+#ifdef MULTICORE
+    // core1 cycles at least every MAIN_DCF_PERIOD
+    uint32_t loops = core1_loops;
+    core1_alive = (loops != core1_loops_old);
+    core1_loops_old = loops;
+#endif
+
+    // Duty-cycle the DCF receiver (by the local time of day and the holdover
+    // error of the RTC since the last decoded minute, from its measured drift)
+    uint32_t hold_s = (uint32_t)(get_diff_ustime(sys_ustime, dcf_dt.ustime) / 1000000ULL);
+    dcf_pwr_poll((fin_dt.in_sync ? &fin_dt.dt : NULL), dcf_get_quality(),
+        dt_disc_get_holdover(rtc_dt.disc_id, hold_s), sys_s_time, sys_ustime);
+}
+
+/***************************************************************************//**
+* @brief Task: refresh display data
+* @param sys_ustime [in] system time in us
+*******************************************************************************/
+void task_display(const ustime_t sys_ustime)
+{
+    dt_final();
+    display();
+}
+
+/***************************************************************************//**
+* @brief Task: display driver
+* @param sys_ustime [in] system time in us
+*******************************************************************************/
+void task_disp(const ustime_t sys_ustime)
+{
+    sched_start_at(task_disp_id, DISP_POLL(sys_ustime));
+}
+
 /***************************************************************************//**
 * @brief Main function
 *******************************************************************************/
+#ifdef MULTICORE
+/***************************************************************************//**
+* @brief core1: captures and decodes the DCF77 signal. The capture interrupt
+*        is registered on this core (dcf_init), a long job on core0 (CLI,
+*        memory dump/test) doesn't delay the decoding. core0 is notified by
+*        the sched_ev_dcf event and reads the result (dcf_get_snapshot).
+*******************************************************************************/
+void core1_main(void)
+{
+    dcf_init();
+    multicore_fifo_push_blocking(MAIN_CORE1_READY);
+
+    ustime_t next_ustime = ustime_now();
+    while (1)
+    {
+        ustime_t core1_ustime = ustime_now();
+        if(dcf_poll(core1_ustime))
+            sched_post(sched_ev_dcf);
+        core1_loops++;
+
+        // Sleep until the next poll or a captured edge
+        ustime_period(core1_ustime, &next_ustime, MAIN_DCF_PERIOD);
+        best_effort_wfe_or_timeout(from_us_since_boot(next_ustime));
+    }
+}
+#endif
+
 int main()
 {
     gpio_drv_init();
@@ -381,7 +568,7 @@ int main()
     spi_drv_init();
     DISP_INIT();
     i2c_drv_init();
-    i2c_drv_set_utime_func(get_sys_ustime);
+    i2c_drv_set_utime_func(ustime_now);
 
     test_mem_init();
 
@@ -393,7 +580,15 @@ int main()
     i2c_rtc_init();
     i2c_bh1750_init();
     i2c_man_init();
+    rtc_sqw_init();
+#ifdef MULTICORE
+    multicore_launch_core1(core1_main);
+    while(multicore_fifo_pop_blocking() != MAIN_CORE1_READY)
+        ;
+#else
     dcf_init();
+#endif
+    dcf_pwr_init();
     
     rtc_int_init();
 
@@ -401,80 +596,48 @@ int main()
         io_puts(BOLD_RED_TEXT "Rebooted by watchdog" NORMAL_TEXT "\r\n");
     watchdog_enable(100, 1);
 
-    dt_clear(&dcf_dt);
-    dt_clear(&rtc_dt);
-    dt_clear(&int_dt);
-    dt_clear(&fin_dt);
+    dt_arb_init();
+    dt_disc_init();
+    dt_clear(&dcf_dt, dt_arb_add(&arb_cfg_dcf), -1);
+    dt_clear(&rtc_dt, dt_arb_add(&arb_cfg_rtc), dt_disc_add(arb_cfg_rtc.name));
+    dt_clear(&int_dt, dt_arb_add(&arb_cfg_int), dt_disc_add(arb_cfg_int.name));
+    dt_clear(&fin_dt, -1, -1);
+    rtc_trim_init(rtc_dt.disc_id);
+
+    // Tasks (run in this order when due at the same time)
+    sched_init();
+    sched_start(sched_add("cli", task_cli, MAIN_CLI_PERIOD, SCHED_EV(sched_ev_cli)), 0, MAIN_CLI_PERIOD);
+    task_i2c_id = sched_add("i2c", task_i2c, SCHED_ONE_SHOT, SCHED_EV(sched_ev_i2c) | SCHED_EV(sched_ev_sqw));
+    sched_start(task_i2c_id, 0, 0);
+    sched_start(sched_add("dcf", task_dcf, MAIN_DCF_PERIOD, SCHED_EV(sched_ev_dcf)), 0, 0);
+    sched_start(sched_add("rtc_int", task_rtc_int, RTC_INT_POLL_PERIOD, SCHED_NO_EVENT), 0, 0);
+    task_dt_id = sched_add("dt", task_dt, SCHED_ONE_SHOT, SCHED_NO_EVENT);
+    task_sec_id = sched_add("sec", task_sec, MAIN_SEC_PERIOD, SCHED_NO_EVENT);
+    sched_start(task_sec_id, 0, MAIN_SEC_PERIOD);
+    task_display_id = sched_add("display", task_display, MAIN_DISPLAY_PERIOD, SCHED_NO_EVENT);
+    sched_start(task_display_id, 0, 0);
+    task_disp_id = sched_add("disp", task_disp, SCHED_ONE_SHOT, SCHED_EV(sched_ev_spi));
+    sched_start(task_disp_id, 0, 0);
 
     while (1)
     {
-        sys_ustime = get_sys_ustime();
-
-        // Detect 1 second change (1.000.000 us)
-        bool second_changed = false;
-        if(get_diff_ustime(sys_ustime, us_s_time_diff) >= 1000000)
-        {   
-            us_s_time_diff = sys_ustime;
-            sys_s_time++;
-            second_changed = true;
-        }
+        sys_ustime = ustime_now();
 
         TP_TGL(LOG_CH2);
 
-        cli_poll();
-
-        // I2C RTC, BH1750, memory poll
-        i2c_man_update_t updated_val = i2c_man_poll(sys_ustime);
-        if(updated_val == i2c_man_update_rtc)
-        {
-            dt_set_received(&rtc_dt, i2c_rtc_get_datetime(), dt_src_rtc);
-        }
-
-        // DCF poll
-        if(dcf_poll(sys_ustime))
-        {
-            dt_set_received(&dcf_dt, dcf_get_datetime(), dt_src_dcf);
-        }
-
-        // RTC Intern poll
-        if(rtc_int_poll(sys_ustime))
-        {
-            dt_set_received(&int_dt, rtc_int_get_datetime(), dt_src_int);
-        }
-
-        // Decide the final Date/Time
-        dt_poll();
-        if(second_changed)
-        {
-            dt_s_tout();
-        }
-
-        // Display intensity (only if intensity override is not active)
-        if((updated_val == i2c_man_update_bh1750) && (cli_intens == -1))
-        {
-            int lx_new = i2c_bh1750_get_val();
-            int disp_intens_new = lx_to_display_intensity(lx_new);
-            if(disp_intens_new != display_intensity)
-            {
-                if(disp_intens_new > display_intensity)
-                    display_intensity++;
-                else
-                    display_intensity--;
-                DISP_INTENS(display_intensity);
-            }
-        }
-        // Refresh display data
-        else if(get_diff_ustime(sys_ustime, display_ustime) >= 50000)
-        {   
-            display_ustime = sys_ustime;
-            display();
-        }
-        DISP_POLL(sys_ustime);
+        sched_run(sys_ustime);
 
+#ifdef MULTICORE
+        if((cli_test_val1 == 0) && core1_alive)
+#else
         if(cli_test_val1 == 0)
+#endif
         {
             watchdog_update();
         }
+
+        // Sleep until the next deadline or interrupt
+        sched_sleep();
     }
 }
 
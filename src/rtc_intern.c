@@ -42,7 +42,7 @@
 
 static datetime_t act_datetime; // last read datetime
 
-static ustime_t refresh_ustime; // Timer used to refresh (update) time and date
+static ustime_t refresh_ustime; // Time of the next refresh (update) of time and date
 
 static datetime_t int_datetime; // Read date/time
 
@@ -70,14 +70,14 @@ void rtc_int_init(void)
 }
 
 /***************************************************************************//**
-* @brief RTC intern module polling function. Must be called every program cycle
+* @brief RTC intern module polling function. Must be called every
+*        RTC_INT_POLL_PERIOD (or more often)
 * @param sys_ustime [in] System time in us
 *******************************************************************************/
 bool rtc_int_poll(const ustime_t sys_ustime)
 {
-    if(get_diff_ustime(sys_ustime, refresh_ustime) >= 130000)
-    {   
-        refresh_ustime = sys_ustime;
+    if(ustime_period(sys_ustime, &refresh_ustime, RTC_INT_POLL_PERIOD))
+    {
 
         if(rtc_get_datetime(&int_datetime))
         {
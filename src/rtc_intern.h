@@ -39,6 +39,8 @@
 #define RTC_INT_LOG(...)    
 #endif
 
+#define RTC_INT_POLL_PERIOD 130000UL    // Period [us] of the date/time read
+
 //******************************************************************************
 // Exported Functions
 //******************************************************************************
@@ -46,7 +48,7 @@
 // Init RTC intern module
 void rtc_int_init(void);
 
-// RTC intern module polling function. Must be called every program cycle
+// RTC intern module polling function. Must be called every RTC_INT_POLL_PERIOD (or more often)
 bool rtc_int_poll(const ustime_t sys_ustime);
 
 // Set time and date to RTC intern module
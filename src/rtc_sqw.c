@@ -0,0 +1,128 @@
+/*******************************************************************************
+ * This file is part of the MstHora distribution.
+ * Copyright (c) 2024 Igor Marinescu (igor.marinescu@gmail.com).
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, version 3.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see <http://www.gnu.org/licenses/>.
+ ******************************************************************************/
+/*******************************************************************************
+ * rtc_sqw - second tick of the DS3231 (1Hz square wave, falling edge).
+ *
+ *      Producer (interrupt)        Consumer (i2c_manager, main)
+ *      rtc_sqw_irq()               rtc_sqw_get_edge()
+ *          sqw_ustime  ------->        (cnt, ustime) read until cnt is stable
+ *          sqw_cnt++
+ ******************************************************************************/
+
+//******************************************************************************
+// Includes
+//******************************************************************************
+#include <stdint.h>
+
+#include "pico/stdlib.h"
+
+#include "rtc_sqw.h"
+#include "gpio_drv.h"
+#include "sched.h"
+
+//******************************************************************************
+// Function Prototypes
+//******************************************************************************
+static void rtc_sqw_irq(unsigned int gpio, uint32_t events);
+
+//******************************************************************************
+// Global Variables
+//******************************************************************************
+static volatile uint32_t sqw_cnt = 0;       // Count of edges
+static volatile ustime_t sqw_ustime = 0;    // System time of the last edge
+static volatile uint32_t sqw_run = 0;       // Count of consecutive edges (interval < RTC_SQW_TOUT_US)
+static volatile uint32_t sqw_glitches = 0;  // Count of rejected edges
+
+/***************************************************************************//**
+* @brief Init the input pin of the square wave (open drain, pull-up) and
+*        enable the interrupt on the falling edge
+*******************************************************************************/
+void rtc_sqw_init(void)
+{
+    sqw_cnt = 0;
+    sqw_run = 0;
+    sqw_glitches = 0;
+
+    gpio_init(RTC_SQW_PIN);
+    gpio_set_dir(RTC_SQW_PIN, GPIO_IN);
+    gpio_set_pulls(RTC_SQW_PIN, /*pull-up*/ true, /*pull-down*/ false);
+
+    gpio_drv_set_irq(RTC_SQW_PIN, GPIO_IRQ_EDGE_FALL, rtc_sqw_irq);
+}
+
+/***************************************************************************//**
+* @brief GPIO interrupt callback: timestamp the edge (the seconds register of
+*        the DS3231 has incremented). An edge shorter than RTC_SQW_MIN_US
+*        after the last one is a glitch.
+* @param gpio [in] pin which triggered the interrupt
+* @param events [in] mask of the events which triggered the interrupt
+*******************************************************************************/
+static void rtc_sqw_irq(unsigned int gpio, uint32_t events)
+{
+    ustime_t ustime = ustime_now();
+    ustime_t interval = get_diff_ustime(ustime, sqw_ustime);
+    if((sqw_cnt > 0) && (interval < RTC_SQW_MIN_US))
+    {
+        sqw_glitches++;
+        return;
+    }
+
+    sqw_run = ((sqw_cnt > 0) && (interval <= RTC_SQW_TOUT_US)) ? (sqw_run + 1) : 1;
+    sqw_ustime = ustime;
+
+    // Make sure the time is stored before the edge is published
+    __compiler_memory_barrier();
+    sqw_cnt++;
+    sched_post(sched_ev_sqw);
+}
+
+/***************************************************************************//**
+* @brief Get the count of edges and the system time of the last one
+* @param ustime_ptr [out] system time of the last edge
+* @return count of edges (changes with every edge)
+*******************************************************************************/
+uint32_t rtc_sqw_get_edge(ustime_t * ustime_ptr)
+{
+    uint32_t cnt;
+    do {
+        cnt = sqw_cnt;
+        *ustime_ptr = sqw_ustime;
+    } while(cnt != sqw_cnt);
+    return cnt;
+}
+
+/***************************************************************************//**
+* @brief Check if the square wave is active: at least two consecutive edges
+*        and the last one not longer than RTC_SQW_TOUT_US ago
+* @param sys_ustime [in] system time in us
+* @return true if active
+*******************************************************************************/
+bool rtc_sqw_is_active(const ustime_t sys_ustime)
+{
+    ustime_t ustime;
+    rtc_sqw_get_edge(&ustime);
+    return (sqw_run >= 2) && (get_diff_ustime(sys_ustime, ustime) <= RTC_SQW_TOUT_US);
+}
+
+/***************************************************************************//**
+* @brief Get the count of rejected edges (glitches)
+* @return count of glitches
+*******************************************************************************/
+uint32_t rtc_sqw_get_glitches(void)
+{
+    return sqw_glitches;
+}
@@ -0,0 +1,55 @@
+/*******************************************************************************
+ * This file is part of the MstHora distribution.
+ * Copyright (c) 2024 Igor Marinescu (igor.marinescu@gmail.com).
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, version 3.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see <http://www.gnu.org/licenses/>.
+ ******************************************************************************/
+/*******************************************************************************
+ * rtc_sqw - second tick of the DS3231. The 1Hz square-wave output (INT/SQW,
+ * open drain) falls when the seconds register increments. The falling edge
+ * is timestamped in the GPIO interrupt and posts the sched_ev_sqw event.
+ ******************************************************************************/
+#ifndef RTC_SQW_H
+#define RTC_SQW_H
+
+//******************************************************************************
+// Includes
+//******************************************************************************
+#include "pico/types.h"
+#include "ustime.h"
+
+//******************************************************************************
+// Defines
+//******************************************************************************
+#define RTC_SQW_PIN         GPIO_P_SQW  // Input pin (internal pull-up)
+#define RTC_SQW_MIN_US      900000      // Minimal interval of two edges (shorter: glitch)
+#define RTC_SQW_TOUT_US     1200000     // Maximal interval of two edges (longer: square wave lost)
+
+//******************************************************************************
+// Exported Functions
+//******************************************************************************
+
+// Init the input pin and its interrupt (on the calling core)
+void rtc_sqw_init(void);
+
+// Get the count of edges and the system time of the last one
+uint32_t rtc_sqw_get_edge(ustime_t * ustime_ptr);
+
+// Check if the square wave is active (consecutive edges every second)
+bool rtc_sqw_is_active(const ustime_t sys_ustime);
+
+// Get the count of rejected edges (glitches)
+uint32_t rtc_sqw_get_glitches(void);
+
+//******************************************************************************
+#endif /* RTC_SQW_H */
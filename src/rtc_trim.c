@@ -0,0 +1,310 @@
+/*******************************************************************************
+ * This file is part of the MstHora distribution.
+ * Copyright (c) 2024 Igor Marinescu (igor.marinescu@gmail.com).
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, version 3.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see <http://www.gnu.org/licenses/>.
+ ******************************************************************************/
+/*******************************************************************************
+ * rtc_trim - trims the frequency of the DS3231.
+ *
+ * The aging offset register adds (positive) or removes (negative) load
+ * capacitance, about RTC_TRIM_PPB_LSB per LSB at 25 C: a positive value
+ * slows the clock down. The register is battery backed.
+ *
+ *  - idle: the drift (dt_disc) is known within RTC_TRIM_SIGMA_MAX, larger
+ *    than 3 sigma and RTC_TRIM_INTERVAL_S passed since power-on or the last
+ *    trim: the aging offset is changed by round(drift / RTC_TRIM_PPB_LSB)
+ *    (at most RTC_TRIM_STEP_MAX, within +-RTC_TRIM_RANGE). The DS3231
+ *    applies it at its next temperature conversion: RTC_TRIM_CONV_S after
+ *    the write the estimate of dt_disc is moved by the expected change and
+ *    its fit restarts,
+ *  - eval: RTC_TRIM_INTERVAL_S after the trim the drift is measured again on
+ *    the fit since the conversion alone (the moved estimate would confirm
+ *    the expected change). If it is not smaller the old aging offset is
+ *    written back (rollback) and the estimate moved back, no trim for
+ *    RTC_TRIM_HOLD_S. After RTC_TRIM_ROLLBACK_MAX consecutive rollbacks the
+ *    trimming is disabled.
+ *
+ * A write without a result within RTC_TRIM_WRITE_TOUT_S counts as failed.
+ ******************************************************************************/
+
+//******************************************************************************
+// Includes
+//******************************************************************************
+#include <stdint.h>
+#include <string.h>
+
+#include "rtc_trim.h"
+#include "dt_disc.h"
+#include "i2c_drv.h"
+#include "i2c_rtc.h"
+#include "i2c_manager.h"
+
+//******************************************************************************
+// Global Variables
+//******************************************************************************
+static int trim_disc_id = -1;           // DS3231 source in dt_disc
+static bool trim_enabled = true;
+static rtc_trim_state_t trim_state = rtc_trim_idle;
+static ustime_t trim_ustime = 0;        // System time of the last trim/rollback (0: power-on)
+static int rollback_run = 0;            // Count of consecutive rollbacks
+
+static bool write_rollback = false;     // The write is a rollback
+static ustime_t write_ustime = 0;       // System time of the write request
+static bool conv_pending = false;       // Written, waiting for the conversion of the DS3231
+static int32_t conv_delta_ppb = 0;      // Expected change of the drift by the write
+
+static rtc_trim_hist_t trim_hist[RTC_TRIM_HIST_CNT];
+static int hist_cnt = 0;                // Count of trims in the history
+static int hist_last = 0;               // Index of the last trim
+
+/***************************************************************************//**
+* @brief Add a trim to the history (the oldest one is overwritten)
+* @return pointer to the new trim
+*******************************************************************************/
+static rtc_trim_hist_t * hist_add(void)
+{
+    hist_last = (hist_last + 1) % RTC_TRIM_HIST_CNT;
+    if(hist_cnt < RTC_TRIM_HIST_CNT)
+        hist_cnt++;
+    rtc_trim_hist_t * hist = &trim_hist[hist_last];
+    memset(hist, 0, sizeof(rtc_trim_hist_t));
+    return hist;
+}
+
+/***************************************************************************//**
+* @brief Get the state after a trim is finished (idle or off)
+* @return state
+*******************************************************************************/
+static rtc_trim_state_t trim_state_ready(void)
+{
+    return (trim_enabled ? rtc_trim_idle : rtc_trim_off);
+}
+
+/***************************************************************************//**
+* @brief The aging offset could not be written: a trim is retried after the
+*        interval, a rollback is evaluated (and written) again
+*******************************************************************************/
+static void trim_write_failed(void)
+{
+    if(!write_rollback)
+    {
+        trim_hist[hist_last].res = rtc_trim_res_failed;
+        trim_ustime = write_ustime;
+        trim_state = trim_state_ready();
+    }
+    else {
+        trim_state = rtc_trim_eval;
+    }
+}
+
+/***************************************************************************//**
+* @brief Callback when the aging offset is written
+* @param result [in] write result (i2c_err_t converted to int)
+*******************************************************************************/
+static void trim_write_callback(int result)
+{
+    // Late result of a write which timed out
+    if(trim_state != rtc_trim_write)
+        return;
+
+    rtc_trim_hist_t * hist = &trim_hist[hist_last];
+    if(((i2c_err_t) result) != i2c_success)
+    {
+        RTC_TRIM_LOG("rtc_trim: write failed (%i)\r\n", result);
+        trim_write_failed();
+        return;
+    }
+
+    trim_ustime = write_ustime;
+    conv_pending = true;
+    conv_delta_ppb = ((int32_t) hist->aging_new - hist->aging_old) * RTC_TRIM_PPB_LSB;
+    if(!write_rollback)
+    {
+        conv_delta_ppb = -conv_delta_ppb;
+        trim_state = rtc_trim_eval;
+        RTC_TRIM_LOG("rtc_trim: aging %i -> %i (%lippb)\r\n", hist->aging_old, hist->aging_new, (long) hist->ppb_before);
+    }
+    else {
+        hist->res = rtc_trim_res_rollback;
+        trim_state = rtc_trim_hold;
+        if(++rollback_run >= RTC_TRIM_ROLLBACK_MAX)
+        {
+            trim_enabled = false;
+            trim_state = rtc_trim_off;
+        }
+        RTC_TRIM_LOG("rtc_trim: rollback to aging %i (%lippb)\r\n", hist->aging_old, (long) hist->ppb_after);
+    }
+}
+
+/***************************************************************************//**
+* @brief Request to write the aging offset
+* @param aging [in] aging offset
+* @param rollback [in] true: the write is a rollback
+* @param sys_ustime [in] system time in us
+* @return true if the request is accepted
+*******************************************************************************/
+static bool trim_write(const int8_t aging, const bool rollback, const ustime_t sys_ustime)
+{
+    if(!i2c_man_req_rtc_aging(aging, trim_write_callback))
+        return false;
+
+    write_rollback = rollback;
+    write_ustime = sys_ustime;
+    trim_state = rtc_trim_write;
+    return true;
+}
+
+/***************************************************************************//**
+* @brief Init the module
+* @param disc_id [in] source id of the DS3231 in dt_disc
+*******************************************************************************/
+void rtc_trim_init(const int disc_id)
+{
+    trim_disc_id = disc_id;
+    trim_state = trim_state_ready();
+    trim_ustime = 0;
+    conv_pending = false;
+    rollback_run = 0;
+    hist_cnt = 0;
+    hist_last = 0;
+}
+
+/***************************************************************************//**
+* @brief Poll the module. Must be called every second.
+* @param sys_ustime [in] system time in us
+*******************************************************************************/
+void rtc_trim_poll(const ustime_t sys_ustime)
+{
+    // The new frequency: move the estimate, its fit restarts
+    if(conv_pending && (get_diff_ustime(sys_ustime, trim_ustime) >= (RTC_TRIM_CONV_S * 1000000ULL)))
+    {
+        conv_pending = false;
+        dt_disc_trim(trim_disc_id, conv_delta_ppb);
+    }
+
+    // The write has no result: failed
+    if((trim_state == rtc_trim_write)
+        && (get_diff_ustime(sys_ustime, write_ustime) >= (RTC_TRIM_WRITE_TOUT_S * 1000000ULL)))
+    {
+        RTC_TRIM_LOG("rtc_trim: write timeout\r\n");
+        trim_write_failed();
+    }
+
+    if((trim_state == rtc_trim_off) || (trim_state == rtc_trim_write))
+        return;
+
+    bool wait = (get_diff_ustime(sys_ustime, trim_ustime) < (RTC_TRIM_INTERVAL_S * 1000000ULL));
+    if(trim_state == rtc_trim_hold)
+    {
+        if(get_diff_ustime(sys_ustime, trim_ustime) >= (RTC_TRIM_HOLD_S * 1000000ULL))
+            trim_state = trim_state_ready();
+        return;
+    }
+
+    int32_t ppb;
+    uint32_t sigma;
+    if(wait || conv_pending)
+        return;
+
+    // Evaluate the last trim on the fit of the new frequency alone
+    if(trim_state == rtc_trim_eval)
+    {
+        if(!dt_disc_get_fit_ppb(trim_disc_id, &ppb, &sigma) || (sigma > RTC_TRIM_SIGMA_MAX))
+            return;
+
+        rtc_trim_hist_t * hist = &trim_hist[hist_last];
+        hist->ppb_after = ppb;
+        int32_t abs_before = (hist->ppb_before < 0) ? -hist->ppb_before : hist->ppb_before;
+        int32_t abs_after = (ppb < 0) ? -ppb : ppb;
+        if(abs_after < abs_before)
+        {
+            hist->res = rtc_trim_res_kept;
+            rollback_run = 0;
+            trim_state = trim_state_ready();
+            RTC_TRIM_LOG("rtc_trim: kept aging %i (%lippb)\r\n", hist->aging_new, (long) ppb);
+        }
+        else {
+            trim_write(hist->aging_old, true, sys_ustime);
+        }
+        return;
+    }
+
+    int8_t aging;
+    if(!dt_disc_get_ppb(trim_disc_id, &ppb, &sigma) || (sigma > RTC_TRIM_SIGMA_MAX)
+        || !i2c_rtc_get_aging(&aging))
+        return;
+
+    // Trim: positive drift (fast clock) needs a larger aging offset
+    int32_t abs_ppb = (ppb < 0) ? -ppb : ppb;
+    if(abs_ppb <= (int32_t)(3 * sigma))
+        return;
+
+    int32_t step = (abs_ppb + (RTC_TRIM_PPB_LSB / 2)) / RTC_TRIM_PPB_LSB;
+    if(step > RTC_TRIM_STEP_MAX)
+        step = RTC_TRIM_STEP_MAX;
+    int32_t aging_new = aging + ((ppb < 0) ? -step : step);
+    if(aging_new > RTC_TRIM_RANGE)
+        aging_new = RTC_TRIM_RANGE;
+    if(aging_new < -RTC_TRIM_RANGE)
+        aging_new = -RTC_TRIM_RANGE;
+    if(aging_new == aging)
+        return;
+
+    if(trim_write((int8_t) aging_new, false, sys_ustime))
+    {
+        rtc_trim_hist_t * hist = hist_add();
+        hist->ustime = sys_ustime;
+        hist->aging_old = aging;
+        hist->aging_new = (int8_t) aging_new;
+        hist->ppb_before = ppb;
+        hist->res = rtc_trim_res_pending;
+    }
+}
+
+/***************************************************************************//**
+* @brief Enable/disable trimming (a trim already written is still evaluated
+*        and rolled back if needed)
+* @param enabled [in] true: enabled
+*******************************************************************************/
+void rtc_trim_set_enabled(const bool enabled)
+{
+    trim_enabled = enabled;
+    if(enabled)
+        rollback_run = 0;
+    if(!enabled && (trim_state == rtc_trim_idle))
+        trim_state = rtc_trim_off;
+    else if(enabled && (trim_state == rtc_trim_off))
+        trim_state = rtc_trim_idle;
+}
+
+/***************************************************************************//**
+* @brief Get the state
+* @return state
+*******************************************************************************/
+rtc_trim_state_t rtc_trim_get_state(void)
+{
+    return trim_state;
+}
+
+/***************************************************************************//**
+* @brief Get a trim of the history
+* @param idx [in] index, 0: the last trim
+* @return pointer to trim or NULL if there is no trim with this index
+*******************************************************************************/
+const rtc_trim_hist_t * rtc_trim_get_hist(const int idx)
+{
+    if((idx < 0) || (idx >= hist_cnt))
+        return NULL;
+    return &trim_hist[(hist_last + RTC_TRIM_HIST_CNT - idx) % RTC_TRIM_HIST_CNT];
+}
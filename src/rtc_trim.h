@@ -0,0 +1,107 @@
+/*******************************************************************************
+ * This file is part of the MstHora distribution.
+ * Copyright (c) 2024 Igor Marinescu (igor.marinescu@gmail.com).
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, version 3.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see <http://www.gnu.org/licenses/>.
+ ******************************************************************************/
+/*******************************************************************************
+ * rtc_trim - trims the frequency of the DS3231 (aging offset register) using
+ * the drift measured against DCF77 (dt_disc). A trim is rate limited and
+ * rolled back if the drift measured after it is not smaller.
+ ******************************************************************************/
+#ifndef RTC_TRIM_H
+#define RTC_TRIM_H
+
+//******************************************************************************
+// Includes
+//******************************************************************************
+#include "pico/types.h"
+#include "ustime.h"
+
+#ifdef RTC_TRIM_DEBUG
+#include DEBUG_INCLUDE
+#endif
+
+//******************************************************************************
+// Defines
+//******************************************************************************
+#ifdef RTC_TRIM_DEBUG
+#define RTC_TRIM_LOG(...)   DEBUG_PRINTF(__VA_ARGS__)
+#else
+#define RTC_TRIM_LOG(...)
+#endif
+
+#define RTC_TRIM_PPB_LSB    100         // Frequency change [ppb] per LSB of the aging offset (25 C)
+#define RTC_TRIM_STEP_MAX   3           // Maximal change of the aging offset per trim
+#define RTC_TRIM_RANGE      30          // Maximal aging offset (+-)
+#define RTC_TRIM_SIGMA_MAX  50          // Maximal uncertainty [ppb] of the drift to trim/evaluate
+#define RTC_TRIM_INTERVAL_S 172800      // Minimal interval [s] between power-on/trims/evaluation (2 days)
+#define RTC_TRIM_CONV_S     66          // The DS3231 applies the aging offset at its next temperature
+                                        //   conversion (every 64s) [s], the new frequency is fitted after it
+#define RTC_TRIM_HOLD_S     604800      // No trim after a rollback [s] (7 days)
+#define RTC_TRIM_ROLLBACK_MAX 2         // Consecutive rollbacks disable the trimming
+#define RTC_TRIM_HIST_CNT   8           // Count of trims in the history
+#define RTC_TRIM_WRITE_TOUT_S 10        // The write of the aging offset fails without a result [s]
+
+//******************************************************************************
+// Typedefs
+//******************************************************************************
+
+// State
+typedef enum {
+    rtc_trim_off = 0,           // Trimming disabled
+    rtc_trim_idle,              // Waiting for a drift to trim
+    rtc_trim_write,             // Writing the aging offset
+    rtc_trim_eval,              // Waiting to evaluate the trim
+    rtc_trim_hold               // Rolled back, waiting RTC_TRIM_HOLD_S
+} rtc_trim_state_t;
+
+// Result of a trim
+typedef enum {
+    rtc_trim_res_pending = 0,   // Not yet evaluated
+    rtc_trim_res_kept,          // The drift is smaller, kept
+    rtc_trim_res_rollback,      // The drift is not smaller, rolled back
+    rtc_trim_res_failed         // The aging offset could not be written
+} rtc_trim_res_t;
+
+// Trim (history)
+typedef struct {
+    ustime_t ustime;            // System time of the trim
+    int8_t aging_old;           // Aging offset before/after the trim
+    int8_t aging_new;
+    int32_t ppb_before;         // Drift [ppb] before the trim
+    int32_t ppb_after;          // Drift [ppb] measured after the trim (evaluated)
+    rtc_trim_res_t res;
+} rtc_trim_hist_t;
+
+//******************************************************************************
+// Exported Functions
+//******************************************************************************
+
+// Init the module, disc_id: the DS3231 source in dt_disc
+void rtc_trim_init(const int disc_id);
+
+// Poll the module (every second)
+void rtc_trim_poll(const ustime_t sys_ustime);
+
+// Enable/disable trimming (a running trim is evaluated)
+void rtc_trim_set_enabled(const bool enabled);
+
+// Get the state
+rtc_trim_state_t rtc_trim_get_state(void);
+
+// Get a trim of the history, idx 0: the last one (NULL if none)
+const rtc_trim_hist_t * rtc_trim_get_hist(const int idx);
+
+//******************************************************************************
+#endif /* RTC_TRIM_H */
@@ -0,0 +1,283 @@
+/*******************************************************************************
+ * This file is part of the MstHora distribution.
+ * Copyright (c) 2024 Igor Marinescu (igor.marinescu@gmail.com).
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, version 3.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see <http://www.gnu.org/licenses/>.
+ ******************************************************************************/
+/*******************************************************************************
+ * sched - tickless deadline scheduler.
+ *
+ * The tasks are kept in a small table (SCHED_TASK_CNT), the next deadline is
+ * found by a linear scan (cheaper than a heap or a timer wheel for a handful
+ * of tasks). A periodic task keeps its phase (the deadline is advanced by the
+ * period, not restarted from the run time), a one-shot task is stopped after
+ * it run. An interrupt posts an event by setting one flag (a single byte
+ * store, no locking needed), every task with the event in its mask is run
+ * in the next sched_run().
+ *
+ *      main loop:  sched_run(now) -> watchdog -> sched_sleep()
+ *
+ * The clock and the sleep of the core are in sched_port (the module has no
+ * other hardware dependency and builds on the host with a virtual clock).
+ ******************************************************************************/
+
+//******************************************************************************
+// Includes
+//******************************************************************************
+#include <stdint.h>
+#include <string.h>
+
+#include "sched.h"
+#include "sched_port.h"
+
+//******************************************************************************
+// Global Variables
+//******************************************************************************
+static sched_task_t tasks[SCHED_TASK_CNT];
+static int task_cnt = 0;
+
+static volatile bool ev_pending[sched_ev_cnt];  // Set by the interrupts
+
+static ustime_t idle_us = 0;            // Time spent in sched_sleep
+static ustime_t stats_ustime = 0;       // Start of the statistics
+
+/***************************************************************************//**
+* @brief Init the scheduler (no tasks)
+*******************************************************************************/
+void sched_init(void)
+{
+    memset(tasks, 0, sizeof(tasks));
+    task_cnt = 0;
+    for(int ev = 0; ev < sched_ev_cnt; ev++)
+        ev_pending[ev] = false;
+    sched_clear_stats();
+}
+
+/***************************************************************************//**
+* @brief Add a task (stopped, see sched_start)
+* @param name [in] name of the task (statistics)
+* @param func [in] task function
+* @param period [in] period in us or SCHED_ONE_SHOT
+* @param events [in] events which run the task (SCHED_EV(...)) or SCHED_NO_EVENT
+* @return task id or -1 if there is no free slot
+*******************************************************************************/
+int sched_add(const char * name, sched_func_t func, const uint32_t period, const uint32_t events)
+{
+    if((task_cnt >= SCHED_TASK_CNT) || (func == NULL))
+        return -1;
+
+    sched_task_t * task = &tasks[task_cnt];
+    memset(task, 0, sizeof(sched_task_t));
+    task->name = name;
+    task->func = func;
+    task->period = period;
+    task->events = events;
+    return task_cnt++;
+}
+
+/***************************************************************************//**
+* @brief Start a task: the first (or the only) run is delay us after sys_ustime
+* @param id [in] task id
+* @param sys_ustime [in] system time in us
+* @param delay [in] delay in us (0: run in the actual sched_run)
+*******************************************************************************/
+void sched_start(const int id, const ustime_t sys_ustime, const uint32_t delay)
+{
+    if((id < 0) || (id >= task_cnt))
+        return;
+
+    tasks[id].next = sys_ustime + delay;
+    tasks[id].active = true;
+}
+
+/***************************************************************************//**
+* @brief Start a task at a deadline (run in the actual sched_run if it is over)
+* @param id [in] task id
+* @param next [in] deadline, system time in us
+*******************************************************************************/
+void sched_start_at(const int id, const ustime_t next)
+{
+    if((id < 0) || (id >= task_cnt))
+        return;
+
+    tasks[id].next = next;
+    tasks[id].active = true;
+}
+
+/***************************************************************************//**
+* @brief Stop the deadline of a task (the events still run it)
+* @param id [in] task id
+*******************************************************************************/
+void sched_stop(const int id)
+{
+    if((id < 0) || (id >= task_cnt))
+        return;
+
+    tasks[id].active = false;
+}
+
+/***************************************************************************//**
+* @brief Post an event, the tasks waiting for it run in the next sched_run
+*        (safe in interrupts and on the other core)
+* @param ev [in] event
+*******************************************************************************/
+void sched_post(const sched_ev_t ev)
+{
+    if(ev < sched_ev_cnt)
+    {
+        ev_pending[ev] = true;
+        sched_port_wake();  // Wake the core (if posted from the other core)
+    }
+}
+
+/***************************************************************************//**
+* @brief Run a task and account its run time
+* @param task [in/out] task
+* @param sys_ustime [in] system time in us
+*******************************************************************************/
+static void sched_exec(sched_task_t * task, const ustime_t sys_ustime)
+{
+    ustime_t start = sched_port_now();
+    task->func(sys_ustime);
+    ustime_t run = get_diff_ustime(sched_port_now(), start);
+    uint32_t run_us = (run < UINT32_MAX) ? (uint32_t) run : UINT32_MAX;
+
+    task->run_cnt++;
+    task->run_us += run_us;
+    if(run_us > task->run_max_us)
+        task->run_max_us = run_us;
+}
+
+/***************************************************************************//**
+* @brief Run the tasks which are due at sys_ustime or have a pending event
+*        (in the order they were added)
+* @param sys_ustime [in] system time in us
+*******************************************************************************/
+void sched_run(const ustime_t sys_ustime)
+{
+    // Collect (and clear) the posted events
+    uint32_t events = 0;
+    for(int ev = 0; ev < sched_ev_cnt; ev++)
+    {
+        if(ev_pending[ev])
+        {
+            ev_pending[ev] = false;
+            events |= SCHED_EV(ev);
+        }
+    }
+
+    for(int id = 0; id < task_cnt; id++)
+    {
+        sched_task_t * task = &tasks[id];
+        bool due = task->active && (sys_ustime >= task->next);
+        if(!due && !(task->events & events))
+            continue;
+
+        if(due)
+        {
+            ustime_t late = get_diff_ustime(sys_ustime, task->next);
+            uint32_t late_us = (late < UINT32_MAX) ? (uint32_t) late : UINT32_MAX;
+            if(late_us > task->late_max_us)
+                task->late_max_us = late_us;
+
+            if(task->period == SCHED_ONE_SHOT)
+                task->active = false;
+            else
+                ustime_period(sys_ustime, &task->next, task->period);
+        }
+
+        sched_exec(task, sys_ustime);
+    }
+}
+
+/***************************************************************************//**
+* @brief Get the next deadline of all tasks
+* @param next_ptr [out] the earliest deadline
+* @return true if there is a deadline or false if no task is active
+*******************************************************************************/
+bool sched_get_next(ustime_t * next_ptr)
+{
+    bool found = false;
+    for(int id = 0; id < task_cnt; id++)
+    {
+        if(tasks[id].active && (!found || (tasks[id].next < *next_ptr)))
+        {
+            *next_ptr = tasks[id].next;
+            found = true;
+        }
+    }
+    return found;
+}
+
+/***************************************************************************//**
+* @brief Sleep until the next deadline or an interrupt (returns immediately
+*        if an event is pending or a deadline is already over)
+*******************************************************************************/
+void sched_sleep(void)
+{
+    ustime_t start = sched_port_now();
+
+    for(int ev = 0; ev < sched_ev_cnt; ev++)
+    {
+        if(ev_pending[ev])
+            return;
+    }
+
+    ustime_t next;
+    if(!sched_get_next(&next))
+        sched_port_sleep(false, 0);
+    else if(next > start)
+        sched_port_sleep(true, next);
+
+    idle_us += get_diff_ustime(sched_port_now(), start);
+}
+
+/***************************************************************************//**
+* @brief Get a task (statistics)
+* @param id [in] task id
+* @return pointer to task or NULL if the id is not used
+*******************************************************************************/
+const sched_task_t * sched_get_task(const int id)
+{
+    if((id < 0) || (id >= task_cnt))
+        return NULL;
+    return &tasks[id];
+}
+
+/***************************************************************************//**
+* @brief Get the time spent sleeping since the statistics were cleared
+* @param total_ptr [out] time since the statistics were cleared (NULL: not used)
+* @return idle time in us
+*******************************************************************************/
+ustime_t sched_get_idle(ustime_t * total_ptr)
+{
+    if(total_ptr != NULL)
+        *total_ptr = get_diff_ustime(sched_port_now(), stats_ustime);
+    return idle_us;
+}
+
+/***************************************************************************//**
+* @brief Clear the statistics of all tasks and the idle time
+*******************************************************************************/
+void sched_clear_stats(void)
+{
+    for(int id = 0; id < task_cnt; id++)
+    {
+        tasks[id].run_cnt = 0;
+        tasks[id].run_us = 0;
+        tasks[id].run_max_us = 0;
+        tasks[id].late_max_us = 0;
+    }
+    idle_us = 0;
+    stats_ustime = sched_port_now();
+}
@@ -0,0 +1,111 @@
+/*******************************************************************************
+ * This file is part of the MstHora distribution.
+ * Copyright (c) 2024 Igor Marinescu (igor.marinescu@gmail.com).
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, version 3.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see <http://www.gnu.org/licenses/>.
+ ******************************************************************************/
+/*******************************************************************************
+ * sched - tickless deadline scheduler. The modules are run as tasks, either
+ * periodically (without drift), once at a deadline or when an interrupt
+ * posts one of their events. Between the tasks the core sleeps (WFE) until
+ * the next deadline or the next interrupt.
+ *
+ * The scheduler gets the time from its caller, the clock for the statistics
+ * and the sleep of the core are behind sched_port (sched_port.c for the
+ * RP2040). A host build links its own sched_port with a virtual clock.
+ ******************************************************************************/
+#ifndef SCHED_H
+#define SCHED_H
+
+//******************************************************************************
+// Includes
+//******************************************************************************
+#include "pico/types.h"
+#include "ustime.h"
+
+//******************************************************************************
+// Defines
+//******************************************************************************
+#define SCHED_TASK_CNT      10          // Maximal count of tasks
+#define SCHED_ONE_SHOT      0           // Period of a one-shot task
+#define SCHED_NO_EVENT      0           // Events of a task which isn't run by events
+
+//******************************************************************************
+// Typedefs
+//******************************************************************************
+
+// Events posted by the interrupts (bit mask of a task)
+typedef enum {
+    sched_ev_cli = 0,           // UART received a character
+    sched_ev_i2c,               // I2C transfer state changed
+    sched_ev_dcf,               // DCF77 edge captured (multicore: datetime published by core1)
+    sched_ev_sqw,               // DS3231 square-wave edge (second tick)
+    sched_ev_spi,               // SPI transfer finished or display data prepared
+    sched_ev_cnt
+} sched_ev_t;
+
+#define SCHED_EV(ev)        (1UL << (ev))
+
+// Task function, sys_ustime: time of the scheduler run
+typedef void (*sched_func_t)(const ustime_t sys_ustime);
+
+// Task
+typedef struct {
+    const char * name;
+    sched_func_t func;
+    uint32_t period;            // Period in us, SCHED_ONE_SHOT: run once at next
+    uint32_t events;            // Events (SCHED_EV(...)) which run the task
+    bool active;                // The deadline is active
+    ustime_t next;              // Deadline
+
+    // Accounting
+    uint32_t run_cnt;           // Count of runs
+    uint64_t run_us;            // Total run time [us]
+    uint32_t run_max_us;        // Maximal run time [us]
+    uint32_t late_max_us;       // Maximal latency [us] of a deadline
+} sched_task_t;
+
+//******************************************************************************
+// Exported Functions
+//******************************************************************************
+
+// Init the scheduler (no tasks)
+void sched_init(void);
+
+// Add a task, returns the task id or -1 if there is no free slot
+int sched_add(const char * name, sched_func_t func, const uint32_t period, const uint32_t events);
+
+// Start a task delay us after sys_ustime or at the deadline next, stop it
+void sched_start(const int id, const ustime_t sys_ustime, const uint32_t delay);
+void sched_start_at(const int id, const ustime_t next);
+void sched_stop(const int id);
+
+// Post an event (safe in interrupts and on the other core)
+void sched_post(const sched_ev_t ev);
+
+// Run the tasks which are due at sys_ustime or have a pending event
+void sched_run(const ustime_t sys_ustime);
+
+// Get the next deadline, false if there is none
+bool sched_get_next(ustime_t * next_ptr);
+
+// Sleep until the next deadline or an interrupt
+void sched_sleep(void);
+
+// Accounting: get a task (NULL if not used), the idle time, clear the statistics
+const sched_task_t * sched_get_task(const int id);
+ustime_t sched_get_idle(ustime_t * total_ptr);
+void sched_clear_stats(void);
+
+//******************************************************************************
+#endif /* SCHED_H */
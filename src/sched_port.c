@@ -0,0 +1,62 @@
+/*******************************************************************************
+ * This file is part of the MstHora distribution.
+ * Copyright (c) 2024 Igor Marinescu (igor.marinescu@gmail.com).
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, version 3.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see <http://www.gnu.org/licenses/>.
+ ******************************************************************************/
+/*******************************************************************************
+ * sched_port - the hardware used by the scheduler (RP2040).
+ *
+ * The sleep uses WFE: an interrupt (or a SEV of the other core) between the
+ * check of the pending events in sched_sleep() and the WFE sets the event
+ * register, the WFE returns immediately and no event is lost.
+ ******************************************************************************/
+
+//******************************************************************************
+// Includes
+//******************************************************************************
+#include "pico/stdlib.h"
+#include "hardware/sync.h"
+
+#include "sched_port.h"
+
+/***************************************************************************//**
+* @brief Get the time in us
+* @return system time in us since power-on
+*******************************************************************************/
+ustime_t sched_port_now(void)
+{
+    return ustime_now();
+}
+
+/***************************************************************************//**
+* @brief Sleep until the deadline or an interrupt
+* @param timeout [in] true: wake at the deadline, false: only an interrupt wakes
+* @param deadline [in] system time in us to wake
+*******************************************************************************/
+void sched_port_sleep(const bool timeout, const ustime_t deadline)
+{
+    if(!timeout)
+        __wfe();
+    else
+        best_effort_wfe_or_timeout(from_us_since_boot(deadline));
+}
+
+/***************************************************************************//**
+* @brief Wake the core sleeping in sched_port_sleep (an event was posted,
+*        also from the other core)
+*******************************************************************************/
+void sched_port_wake(void)
+{
+    __sev();
+}
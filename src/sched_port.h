@@ -0,0 +1,45 @@
+/*******************************************************************************
+ * This file is part of the MstHora distribution.
+ * Copyright (c) 2024 Igor Marinescu (igor.marinescu@gmail.com).
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, version 3.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see <http://www.gnu.org/licenses/>.
+ ******************************************************************************/
+/*******************************************************************************
+ * sched_port - the hardware used by the scheduler: the clock and the sleep
+ * of the core (RP2040). sched.c calls only these functions, a host build
+ * links its own implementation (virtual clock) instead of sched_port.c.
+ ******************************************************************************/
+#ifndef SCHED_PORT_H
+#define SCHED_PORT_H
+
+//******************************************************************************
+// Includes
+//******************************************************************************
+#include "pico/types.h"
+#include "ustime.h"
+
+//******************************************************************************
+// Exported Functions
+//******************************************************************************
+
+// Get the time in us
+ustime_t sched_port_now(void);
+
+// Sleep until the deadline or an interrupt (timeout false: only an interrupt wakes)
+void sched_port_sleep(const bool timeout, const ustime_t deadline);
+
+// Wake the core sleeping in sched_port_sleep (also from the other core)
+void sched_port_wake(void);
+
+//******************************************************************************
+#endif /* SCHED_PORT_H */
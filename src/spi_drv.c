@@ -31,6 +31,7 @@
 #include "hardware/irq.h"
 #include "spi_drv.h"
 #include "gpio_drv.h"
+#include "sched.h"
 
 //******************************************************************************
 // Function Prototypes
@@ -121,6 +122,7 @@ void spi_drv_irq()
         spi_get_hw(SPI_DRV_ID)->imsc = 0;
         SPI_DRV_CS_CLR();
         spi_drv_busy_flag = false;
+        sched_post(sched_ev_spi);
     }
 
     // Don't leave overrun & timeout flags set
@@ -29,8 +29,12 @@
 #include "pico/stdlib.h"
 #include "hardware/uart.h"
 #include "hardware/irq.h"
+#ifdef MULTICORE
+#include "hardware/sync.h"
+#endif
 #include "uart_drv.h"
 #include "gpio_drv.h"
+#include "sched.h"
 
 
 //******************************************************************************
@@ -65,6 +69,9 @@ static char tx_buffer[UART_TX_BUFF];
 static volatile int tx_wr_idx = 0;
 static volatile int tx_rd_idx = 0;
 static volatile bool send_semaphore = false;
+#ifdef MULTICORE
+static spin_lock_t * tx_lock;   // tx_buffer: writers on both cores (core1: DCF77 log) and the interrupt
+#endif
 
 // rx_buffer:
 static char rx_buffer[UART_RX_BUFF];
@@ -81,6 +88,10 @@ uint16_t uart_dbg_idx;
 *******************************************************************************/
 void uart_drv_init()
 {
+#ifdef MULTICORE
+    tx_lock = spin_lock_init(spin_lock_claim_unused(true));
+#endif
+
     // Set up our UART with a basic baud rate.
     uart_init(UART_ID, 2400);
 
@@ -156,6 +167,7 @@ void uart_drv_irq()
                 }
                 rx_len = rx_idx;
                 rx_idx = 0;
+                sched_post(sched_ev_cli);
             }
         }
         else if(rx_idx < UART_RX_BUFF)
@@ -164,6 +176,9 @@ void uart_drv_irq()
         }
         send_echo = true;
     }
+#ifdef MULTICORE
+    uint32_t irq_save = spin_lock_blocking(tx_lock);
+#endif
     while(uart_is_writable(UART_ID)){
         // Is the interrupt called while in send function?
         if(send_semaphore)
@@ -171,7 +186,7 @@ void uart_drv_irq()
             // In this case send a dummy character 
             // (do not modify tx_rd_idx to avoid corrupted index)
             uart_get_hw(UART_ID)->dr = (uint8_t) '\0'; //'.';
-            return;
+            break;
         }
         // Nothing to send?
         if(tx_wr_idx == tx_rd_idx)
@@ -192,6 +207,9 @@ void uart_drv_irq()
             }
         }
     }
+#ifdef MULTICORE
+    spin_unlock(tx_lock, irq_save);
+#endif
 }
 
 /***************************************************************************//**
@@ -211,6 +229,10 @@ void uart_drv_puts(const char * txt)
     if(tx_len > UART_TX_BUFF)
         tx_len = UART_TX_BUFF;
 
+#ifdef MULTICORE
+    // Both cores write (the interrupts of this core are disabled meanwhile)
+    uint32_t irq_save = spin_lock_blocking(tx_lock);
+#endif
     send_semaphore = true;
 
     int tx_wr_idx_old = tx_wr_idx;
@@ -249,6 +271,9 @@ void uart_drv_puts(const char * txt)
     send_semaphore = false;
 
     uart_set_irq_enables(UART_ID, true, true);
+#ifdef MULTICORE
+    spin_unlock(tx_lock, irq_save);
+#endif
 }
 
 /***************************************************************************//**
@@ -15,7 +15,8 @@
  * along with this program. If not, see <http://www.gnu.org/licenses/>.
  ******************************************************************************/
 /*******************************************************************************
- * ustime - calculates the difference between two ustime_t/s_time_t data.
+ * ustime - the 64-bit monotonic system time (us since power-on, never wraps)
+ * and the helpers to measure intervals, periods and timeouts.
  ******************************************************************************/
 
 //******************************************************************************
@@ -36,29 +37,87 @@
 //******************************************************************************
 
 /***************************************************************************//**
-* @brief Get the difference (always positive) between two ustime_t variables
+* @brief Get the system time in us. The raw 64-bit timer is read (not the
+*        latched timelr/timehr pair), safe in interrupts and on both cores.
+* @return system time in us since power-on
+*******************************************************************************/
+ustime_t ustime_now(void)
+{
+    return (ustime_t) time_us_64();
+}
+
+/***************************************************************************//**
+* @brief Get the time elapsed between two ustime_t variables
 * @param end_ustime [in] end ustime_t variable
 * @param start_ustime [in] start ustime_t variable
-* @return difference: end_ustime - start_ustime
+* @return difference: end_ustime - start_ustime, 0 if end_ustime is earlier
 *******************************************************************************/
 ustime_t get_diff_ustime(const ustime_t end_ustime, const ustime_t start_ustime)
 {
-    int32_t diff = ((int32_t) end_ustime) - ((int32_t) start_ustime);
-    if(diff < 0)
-        return (ustime_t)(-diff);
-    return (ustime_t)(diff);
+    if(end_ustime < start_ustime)
+        return 0;
+    return (end_ustime - start_ustime);
+}
+
+/***************************************************************************//**
+* @brief Get the signed difference between two ustime_t variables
+* @param end_ustime [in] end ustime_t variable
+* @param start_ustime [in] start ustime_t variable
+* @return difference: end_ustime - start_ustime saturated to INT32_MIN..INT32_MAX
+*******************************************************************************/
+int32_t get_diff_ustime_signed(const ustime_t end_ustime, const ustime_t start_ustime)
+{
+    int64_t diff = (int64_t)(end_ustime - start_ustime);
+    if(diff > INT32_MAX)
+        return INT32_MAX;
+    if(diff < INT32_MIN)
+        return INT32_MIN;
+    return (int32_t) diff;
+}
+
+/***************************************************************************//**
+* @brief Check if a timeout elapsed
+* @param sys_ustime [in] system time in us
+* @param start_ustime [in] time in us when the timeout started
+* @param tout [in] timeout in us
+* @return true if at least tout us elapsed since start_ustime
+*******************************************************************************/
+bool ustime_timeout(const ustime_t sys_ustime, const ustime_t start_ustime, const ustime_t tout)
+{
+    return (get_diff_ustime(sys_ustime, start_ustime) >= tout);
+}
+
+/***************************************************************************//**
+* @brief Periodic event without drift: the time of the next event is advanced
+*        by the period (not set to the actual time), the delay of the caller
+*        is not accumulated. If the caller is late by a whole period or more
+*        (or *next_ptr is not initialised), the next event is re-aligned to
+*        the actual time.
+* @param sys_ustime [in] system time in us
+* @param next_ptr [in/out] pointer to the time in us of the next event
+* @param period [in] period in us
+* @return true if the event is due
+*******************************************************************************/
+bool ustime_period(const ustime_t sys_ustime, ustime_t * next_ptr, const ustime_t period)
+{
+    if(sys_ustime < *next_ptr)
+        return false;
+
+    *next_ptr += period;
+    if(*next_ptr <= sys_ustime)
+        *next_ptr = sys_ustime + period;
+    return true;
 }
 
 /***************************************************************************//**
-* @brief Get the difference (always positive) between two s_time_t variables
+* @brief Get the time elapsed between two s_time_t variables
 * @param end_time [in] end s_time_t variable
 * @param start_time [in] start s_time_t variable
-* @return difference: end_time - start_time
+* @return difference: end_time - start_time, 0 if end_time is earlier
 *******************************************************************************/
 s_time_t get_diff_s_time(const s_time_t end_time, const s_time_t start_time)
 {
-    int32_t diff = ((int32_t) end_time) - ((int32_t) start_time);
-    if(diff < 0)
-        return (s_time_t)(-diff);
-    return (s_time_t)(diff);
+    if(end_time < start_time)
+        return 0;
+    return (end_time - start_time);
 }
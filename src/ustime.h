@@ -15,7 +15,8 @@
  * along with this program. If not, see <http://www.gnu.org/licenses/>.
  ******************************************************************************/
 /*******************************************************************************
- * ustime - calculates the difference between two ustime_t/s_time_t data.
+ * ustime - the 64-bit monotonic system time (us since power-on, never wraps)
+ * and the helpers to measure intervals, periods and timeouts.
  ******************************************************************************/
 #ifndef USTIME_H
 #define USTIME_H
@@ -23,6 +24,7 @@
 //******************************************************************************
 // Includes
 //******************************************************************************
+#include "pico/types.h"
 
 //******************************************************************************
 // Defines
@@ -32,8 +34,8 @@
 // Typedefs
 //******************************************************************************
 
-// System time in micro-seconds
-typedef uint32_t ustime_t;
+// System time in micro-seconds since power-on (64-bit: wraps after 584942 years)
+typedef uint64_t ustime_t;
 
 // System time in seconds
 typedef uint32_t s_time_t;
@@ -42,10 +44,22 @@ typedef uint32_t s_time_t;
 // Exported Functions
 //******************************************************************************
 
-// Get the difference (always positive) between two ustime_t variables
+// Get the system time in us (safe in interrupts and on both cores)
+ustime_t ustime_now(void);
+
+// Get the time elapsed from start_time until end_time (0 if end_time is earlier)
 ustime_t get_diff_ustime(const ustime_t end_time, const ustime_t start_time);
 
-// Get the difference (always positive) between two s_time_t variables
+// Get the signed difference end_time - start_time, saturated to the int32_t range
+int32_t get_diff_ustime_signed(const ustime_t end_time, const ustime_t start_time);
+
+// Check if the timeout tout elapsed since start_time
+bool ustime_timeout(const ustime_t sys_ustime, const ustime_t start_time, const ustime_t tout);
+
+// Periodic event without drift: true every period, *next_ptr is advanced by period
+bool ustime_period(const ustime_t sys_ustime, ustime_t * next_ptr, const ustime_t period);
+
+// Get the time elapsed from start_time until end_time (0 if end_time is earlier)
 s_time_t get_diff_s_time(const s_time_t end_time, const s_time_t start_time);
 
 //******************************************************************************
@@ -368,6 +368,7 @@ void m_filter_int_init(m_filter_int_t * filter, int * buff, unsigned int size)
     filter->buff = buff;
     filter->size = size;
     filter->sum = 0;
+    filter->idx = 0;
     filter->init_flag = false;
 }
 
@@ -389,21 +390,61 @@ int m_filter_int_add_val(m_filter_int_t * filter, int val)
 
         filter->init_flag = true;
         filter->sum = (long)filter->size * (long)val;
+        filter->idx = 0;
         return val;
     }
 
-    filter->sum -= (long)filter->buff[0];
-
-    //!!! TODO: Improvement idea: the below cycle is not required, we can use 
-    // an index of the last written element. And every cycle:
-    //      f_idx++;
-    //      filter->sum -= (long) filter->buff[f_idx];
-    //      filter->buff[f_idx] = val
-    for(i = 0; i < (filter->size - 1); i++)
-        filter->buff[i] = filter->buff[i + 1]; 
-
-    filter->buff[i] = val; 
+    // Replace the oldest element (ring buffer)
+    filter->sum -= (long)filter->buff[filter->idx];
+    filter->buff[filter->idx] = val; 
     filter->sum += val;
+    if(++filter->idx >= filter->size)
+        filter->idx = 0;
 
     return (int)(filter->sum / (long)filter->size);
 }
+
+/***************************************************************************//**
+* @brief Init exponential moving average
+* @param ema [out] pointer to average structure
+* @param shift [in] smoothing factor: every new value changes the average by
+*        1/2^shift of the difference (time constant ~2^shift values)
+*******************************************************************************/
+void ema_int_init(ema_int_t * ema, unsigned int shift)
+{
+    ema->val = 0;
+    ema->shift = shift;
+    ema->init_flag = false;
+}
+
+/***************************************************************************//**
+* @brief Add val to exponential moving average (the first value initialises
+*        the average)
+* @param ema [in/out] pointer to average structure
+* @param val [in] new value
+* @return the average
+*******************************************************************************/
+int ema_int_add_val(ema_int_t * ema, int val)
+{
+    long val_frac = (long) val << EMA_INT_FRAC;
+
+    if(!ema->init_flag)
+    {
+        ema->val = val_frac;
+        ema->init_flag = true;
+    }
+    else {
+        ema->val += (val_frac - ema->val) / (1L << ema->shift);
+    }
+    return ema_int_get(ema);
+}
+
+/***************************************************************************//**
+* @brief Get the exponential moving average
+* @param ema [in] pointer to average structure
+* @return the average (rounded)
+*******************************************************************************/
+int ema_int_get(const ema_int_t * ema)
+{
+    return (int)((ema->val + (1L << (EMA_INT_FRAC - 1))) >> EMA_INT_FRAC);
+}
@@ -39,9 +39,19 @@ typedef struct {
     int * buff;     // Pointer to data buffer containing data
     unsigned int size;  // Size of the data buffer in elements
     long sum;       // Sum of all elements in data buffer
+    unsigned int idx;   // Index of the oldest element
     bool init_flag;     // Flag inidcates the buffer contain valid data
 } m_filter_int_t;
 
+// Exponential moving average: val += (new - val) / 2^shift
+#define EMA_INT_FRAC    8       // Fraction bits of the average
+
+typedef struct {
+    long val;           // Average (EMA_INT_FRAC fraction bits)
+    unsigned int shift; // Smoothing factor 1/2^shift
+    bool init_flag;     // Flag indicates the average is initialised
+} ema_int_t;
+
 //******************************************************************************
 // Exported Functions
 //******************************************************************************
@@ -79,5 +89,14 @@ void m_filter_int_init(m_filter_int_t * filter, int * buff, unsigned int size);
 // Add val to filter and calculate filtered value
 int m_filter_int_add_val(m_filter_int_t * filter, int val);
 
+// Init exponential moving average
+void ema_int_init(ema_int_t * ema, unsigned int shift);
+
+// Add val to exponential moving average and return the average
+int ema_int_add_val(ema_int_t * ema, int val);
+
+// Get the exponential moving average
+int ema_int_get(const ema_int_t * ema);
+
 //******************************************************************************
 #endif /* UTILS_H */
@@ -0,0 +1,204 @@
+/*******************************************************************************
+ * This file is part of the MstHora distribution.
+ * Copyright (c) 2024 Igor Marinescu (igor.marinescu@gmail.com).
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, version 3.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see <http://www.gnu.org/licenses/>.
+ ******************************************************************************/
+/*******************************************************************************
+ * dcf_replay - host replay of the DCF77 edges recorded on the target
+ * ('dcf77 rec dump', lines '<ustime> <level>') through the decoder: the
+ * edges are loaded into dcf_rec and replayed with dcf_poll every
+ * REPLAY_POLL_US on the virtual clock. Prints the decoded datetimes, the
+ * time to the first one, the decoder statistics and the host CPU time per
+ * minute.
+ *
+ *      dcf_replay [-m <min>] <dump>    replay, fail if less than <min> minutes decoded
+ *      dcf_replay -g <scenario> <dump> write the edges of a dcf_gen scenario as a dump
+ ******************************************************************************/
+
+//******************************************************************************
+// Includes
+//******************************************************************************
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "host.h"
+#include "dcf77.h"
+#include "dcf_gen.h"
+#include "dcf_rec.h"
+
+//******************************************************************************
+// Defines
+//******************************************************************************
+#define REPLAY_POLL_US      10000ULL    // Poll period of the decoder (MAIN_DCF_PERIOD)
+#define REPLAY_LINE_LEN     64
+
+/***************************************************************************//**
+* @brief Get the CPU time of the process
+* @return CPU time in ns
+*******************************************************************************/
+static uint64_t replay_cpu_ns(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_PROCESS_CPUTIME_ID, &ts);
+    return (uint64_t) ts.tv_sec * 1000000000ULL + (uint64_t) ts.tv_nsec;
+}
+
+/***************************************************************************//**
+* @brief Write the edges of a dcf_gen scenario in the format of dcf_rec_dump
+* @param name [in] scenario name
+* @param path [in] dump file
+* @return 0 if written
+*******************************************************************************/
+static int replay_gen(const char * name, const char * path)
+{
+    static dcf_gen_t gen;
+    const dcf_gen_cfg_t * cfg_ptr = dcf_gen_find(name);
+    if(cfg_ptr == NULL)
+    {
+        printf("dcf_replay: scenario %s not found\n", name);
+        return 1;
+    }
+
+    FILE * file = fopen(path, "w");
+    if(file == NULL)
+    {
+        printf("dcf_replay: %s not writable\n", path);
+        return 1;
+    }
+
+    // The dump of dcf_rec: 32-bit timestamps, bit 0 replaced by the level
+    uint32_t cnt = 0;
+    dcf_edge_t edge;
+    dcf_gen_start(&gen, cfg_ptr, 0, 0, 0);
+    fprintf(file, "dcf77 rec: generated %s\r\n", name);
+    for(ustime_t ustime = 0; dcf_gen_is_running(&gen); ustime += REPLAY_POLL_US)
+    {
+        while(dcf_gen_get(&gen, &edge, ustime))
+        {
+            fprintf(file, "%lu %u\r\n", (unsigned long)((uint32_t) edge.ustime & ~1UL), edge.level ? 1u : 0u);
+            cnt++;
+        }
+    }
+    fclose(file);
+    printf("dcf_replay: %lu edges of %s written to %s\n", (unsigned long) cnt, name, path);
+    return 0;
+}
+
+/***************************************************************************//**
+* @brief Load a dump into the recorder (lines which are not an edge are skipped)
+* @param path [in] dump file
+* @return count of loaded edges, -1 if the file is not readable
+*******************************************************************************/
+static int replay_load(const char * path)
+{
+    FILE * file = fopen(path, "r");
+    if(file == NULL)
+        return -1;
+
+    char line[REPLAY_LINE_LEN];
+    int cnt = 0;
+    dcf_rec_start();
+    while(fgets(line, sizeof(line), file) != NULL)
+    {
+        unsigned long ustime;
+        unsigned int level;
+        if(sscanf(line, "%lu %u", &ustime, &level) != 2)
+            continue;
+
+        dcf_edge_t edge = { .ustime = ustime, .level = (level != 0) };
+        dcf_rec_add(&edge);
+        cnt++;
+    }
+    dcf_rec_stop();
+    fclose(file);
+    return cnt;
+}
+
+/***************************************************************************//**
+* @brief Replay a dump through the decoder
+* @param path [in] dump file
+* @param min_ok [in] minimal count of decoded minutes
+* @return 0 if at least min_ok minutes were decoded
+*******************************************************************************/
+static int replay_run(const char * path, const uint32_t min_ok)
+{
+    int cnt = replay_load(path);
+    if(cnt <= 0)
+    {
+        printf("dcf_replay: no edges in %s\n", path);
+        return 1;
+    }
+    if(cnt > DCF_REC_BUFF)
+        printf("dcf_replay: %d edges, the last %d replayed\n", cnt, DCF_REC_BUFF);
+
+    dcf_init();
+    ustime_t start = host_us;
+    ustime_t last = 0;
+    ustime_t first = 0;
+    uint32_t decoded = 0;
+    uint64_t cpu_ns = 0;
+    dcf_replay_start(start);
+    while(dcf_rec_is_replaying())
+    {
+        host_us += REPLAY_POLL_US;
+        uint64_t cpu_start = replay_cpu_ns();
+        dcf_poll(host_us);
+        cpu_ns += replay_cpu_ns() - cpu_start;
+
+        // The replayed datetimes are not published: new decoded datetime?
+        const datetime_t * dt = dcf_get_datetime();
+        if((dt == NULL) || (dcf_get_ustime() == last))
+            continue;
+        last = dcf_get_ustime();
+
+        if(first == 0)
+            first = host_us;
+        decoded++;
+        printf("%6lus ", (unsigned long)((host_us - start) / 1000000ULL));
+        DATETIME_PRINTF_TIME(printf, "", (*dt), "  ");
+        DATETIME_PRINTF_DATE(printf, "", (*dt), "\n");
+    }
+
+    dcf_stats_t st;
+    dcf_get_stats(0, &st);
+    double minutes = (double)(host_us - start) / 60e6;
+    printf("%s: %d edges, %.1f min, decoded %lu, first after %lds\n", path, cnt, minutes,
+        (unsigned long) decoded, first ? (long)((first - start) / 1000000ULL) : -1L);
+    printf("minutes %lu, confident %lu, predicted %lu, bit errors %lu/%lu, glitches %lu, sync loss %lu\n",
+        (unsigned long) st.minutes, (unsigned long) st.dec_conf, (unsigned long) st.dec_pred,
+        (unsigned long) st.ber_err, (unsigned long) st.ber_bits, (unsigned long) st.glitch,
+        (unsigned long) st.sync_loss);
+    printf("host cpu %.1f us per minute\n", (cpu_ns / 1000.0) / minutes);
+    return (decoded >= min_ok) ? 0 : 1;
+}
+
+/***************************************************************************//**
+* @brief Replay a dump or write the dump of a scenario
+*******************************************************************************/
+int main(int argc, char ** argv)
+{
+    if((argc == 4) && !strcmp(argv[1], "-g"))
+        return replay_gen(argv[2], argv[3]);
+    if((argc == 4) && !strcmp(argv[1], "-m"))
+        return replay_run(argv[3], (uint32_t) strtoul(argv[2], NULL, 10));
+    if(argc == 2)
+        return replay_run(argv[1], 0);
+
+    printf("usage: dcf_replay [-m <min>] <dump>\n"
+           "       dcf_replay -g <scenario> <dump>\n");
+    return 1;
+}
@@ -0,0 +1,112 @@
+/*******************************************************************************
+ * This file is part of the MstHora distribution.
+ * Copyright (c) 2024 Igor Marinescu (igor.marinescu@gmail.com).
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, version 3.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see <http://www.gnu.org/licenses/>.
+ ******************************************************************************/
+/*******************************************************************************
+ * host - runs the hardware independent modules of src on the host (Linux):
+ * virtual clock, stubs of the Pico SDK and of the output, checks of the tests.
+ ******************************************************************************/
+
+//******************************************************************************
+// Includes
+//******************************************************************************
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdarg.h>
+
+#include "host.h"
+#include "in_out.h"
+
+//******************************************************************************
+// Global Variables
+//******************************************************************************
+ustime_t host_us = 0;
+
+static int check_cnt = 0;           // Count of checks
+static int check_fail = 0;          // Count of failed checks
+
+/***************************************************************************//**
+* @brief Count a check of a test and print it if it failed
+* @param ok [in] result of the check
+* @param file [in] source file of the check
+* @param line [in] line of the check
+* @param expr [in] checked expression
+* @return ok
+*******************************************************************************/
+bool host_check(const bool ok, const char * file, const int line, const char * expr)
+{
+    check_cnt++;
+    if(!ok)
+    {
+        check_fail++;
+        printf("%s:%i: check failed: %s\n", file, line, expr);
+    }
+    return ok;
+}
+
+/***************************************************************************//**
+* @brief Print the result of a test
+* @param name [in] name of the test
+* @return exit code: 0 if all checks passed, 1 if not
+*******************************************************************************/
+int host_result(const char * name)
+{
+    printf("%s: %i checks, %i failed\n", name, check_cnt, check_fail);
+    return ((check_fail == 0) && (check_cnt > 0)) ? 0 : 1;
+}
+
+//******************************************************************************
+// Pico SDK: the virtual clock, no GPIO, single core
+//******************************************************************************
+uint64_t time_us_64(void) { return host_us; }
+uint32_t time_us_32(void) { return (uint32_t) host_us; }
+
+void gpio_init(uint gpio) {}
+void gpio_set_dir(uint gpio, bool out) {}
+void gpio_set_pulls(uint gpio, bool up, bool down) {}
+bool gpio_get(uint gpio) { return true; }
+void gpio_put(uint gpio, bool value) {}
+
+void irq_set_exclusive_handler(uint num, irq_handler_t handler) {}
+void irq_set_enabled(uint num, bool enabled) {}
+void irq_set_priority(uint num, uint8_t priority) {}
+
+void tight_loop_contents(void) {}
+void __compiler_memory_barrier(void) {}
+void __dmb(void) {}
+void __sev(void) {}
+
+//******************************************************************************
+// in_out: printed only with HOST_VERBOSE
+//******************************************************************************
+void io_puts(const char * txt)
+{
+    if(getenv("HOST_VERBOSE"))
+        fputs(txt, stdout);
+}
+
+int io_printf(const char * format, ...)
+{
+    if(!getenv("HOST_VERBOSE"))
+        return 0;
+
+    va_list argp;
+    va_start(argp, format);
+    int res = vprintf(format, argp);
+    va_end(argp);
+    return res;
+}
+
+void io_dump(const void * ptr_buffer, int len, unsigned long addr) {}
@@ -0,0 +1,61 @@
+/*******************************************************************************
+ * This file is part of the MstHora distribution.
+ * Copyright (c) 2024 Igor Marinescu (igor.marinescu@gmail.com).
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, version 3.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see <http://www.gnu.org/licenses/>.
+ ******************************************************************************/
+/*******************************************************************************
+ * host - runs the hardware independent modules of src on the host (Linux):
+ * virtual clock, stubs of the Pico SDK and of the output, checks of the tests.
+ *
+ * The virtual clock (time_us_64) only moves when a test sets it, so every
+ * scenario runs as fast as the host can compute it. The output of the
+ * modules (io_printf) is printed only if the environment variable
+ * HOST_VERBOSE is set.
+ ******************************************************************************/
+#ifndef HOST_H
+#define HOST_H
+
+//******************************************************************************
+// Includes
+//******************************************************************************
+#include <stdio.h>
+#include "pico/stdlib.h"
+#include "ustime.h"
+
+//******************************************************************************
+// Defines
+//******************************************************************************
+
+// Check a condition of a test, print it if it fails
+#define HOST_CHECK(cond)    host_check((cond), __FILE__, __LINE__, #cond)
+
+//******************************************************************************
+// Global Variables
+//******************************************************************************
+
+// Virtual clock in us (time_us_64)
+extern ustime_t host_us;
+
+//******************************************************************************
+// Exported Functions
+//******************************************************************************
+
+// Count a check, print it if it failed, returns ok
+bool host_check(const bool ok, const char * file, const int line, const char * expr);
+
+// Print the count of checks and failures, returns the exit code of the test
+int host_result(const char * name);
+
+//******************************************************************************
+#endif /* HOST_H */
@@ -0,0 +1,31 @@
+/*******************************************************************************
+ * This file is part of the MstHora distribution.
+ * Copyright (c) 2024 Igor Marinescu (igor.marinescu@gmail.com).
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, version 3.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see <http://www.gnu.org/licenses/>.
+ ******************************************************************************/
+/*******************************************************************************
+ * host_cap - dcf_cap backend of the host: no input pin, no captured edges.
+ * The decoders get their edges from dcf_gen or dcf_rec (replay).
+ ******************************************************************************/
+
+//******************************************************************************
+// Includes
+//******************************************************************************
+#include "pico/stdlib.h"
+#include "dcf_cap.h"
+
+void dcf_cap_init(unsigned int ch, unsigned int pin) {}
+bool dcf_cap_get_edge(unsigned int ch, dcf_edge_t * edge_ptr) { return false; }
+bool dcf_cap_get_level(unsigned int ch) { return true; }
+uint32_t dcf_cap_get_lost(unsigned int ch) { return 0; }
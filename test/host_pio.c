@@ -0,0 +1,271 @@
+/*******************************************************************************
+ * This file is part of the MstHora distribution.
+ * Copyright (c) 2024 Igor Marinescu (igor.marinescu@gmail.com).
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, version 3.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see <http://www.gnu.org/licenses/>.
+ ******************************************************************************/
+/*******************************************************************************
+ * host_pio - host model of the PIO state machines and the DMA channels used
+ * by dcf_cap_pio.c: host_pio_input() changes the level of an input pin, the
+ * state machine measuring the pin pushes the word of the finished phase
+ * (format of dcf_cap.pio, DCF_CAP_PIO_EXTRA_US included) and its DMA channel
+ * writes it into the ring buffer and decrements its transfer counter.
+ ******************************************************************************/
+
+//******************************************************************************
+// Includes
+//******************************************************************************
+#include <string.h>
+
+#include "pico/stdlib.h"
+#include "hardware/pio.h"
+#include "hardware/dma.h"
+#include "hardware/clocks.h"
+
+#include "host.h"
+#include "host_pio.h"
+
+//******************************************************************************
+// Defines
+//******************************************************************************
+#define HOST_PIO_SM_CNT     4           // State machines of a PIO
+#define HOST_DMA_CNT        12          // DMA channels
+#define HOST_PIO_EXTRA_US   3           // Cycles of a phase outside the loop (dcf_cap.pio)
+#define HOST_SYS_HZ         125000000UL // System clock
+
+//******************************************************************************
+// Typedefs
+//******************************************************************************
+
+// State machine measuring a pin
+typedef struct {
+    bool claimed;
+    bool enabled;
+    uint pin;                   // Jump pin
+    bool level;                 // Level of the measured phase
+    ustime_t start;             // Start of the measured phase
+} host_sm_t;
+
+// DMA channel: RX FIFO of a state machine -> ring buffer
+typedef struct {
+    bool claimed;
+    bool ring;                  // Address wrapping of the write address
+    uint ring_bits;
+    volatile uint32_t * base;   // Write address
+    uint32_t wr_cnt;            // Count of written words
+    int sm;                     // State machine (DREQ), -1: none
+    dma_channel_hw_t hw;
+} host_dma_t;
+
+//******************************************************************************
+// Global Variables
+//******************************************************************************
+static pio_hw_t host_pio_hw;
+pio_hw_t * pio0 = &host_pio_hw;
+
+static host_sm_t host_sm[HOST_PIO_SM_CNT];
+static host_dma_t host_dma[HOST_DMA_CNT];
+static bool host_prog_loaded = false;
+
+/***************************************************************************//**
+* @brief Store a word pushed by a state machine into the ring buffer of its
+*        DMA channel
+* @param sm [in] state machine
+* @param word [in] pushed word
+*******************************************************************************/
+static void host_dma_push(const uint sm, const uint32_t word)
+{
+    for(int ch = 0; ch < HOST_DMA_CNT; ch++)
+    {
+        host_dma_t * dma = &host_dma[ch];
+        if(!dma->claimed || (dma->sm != (int) sm) || (dma->hw.transfer_count == 0))
+            continue;
+
+        uint32_t idx = dma->wr_cnt;
+        if(dma->ring)
+            idx &= ((1UL << dma->ring_bits) / sizeof(uint32_t)) - 1;
+        dma->base[idx] = word;
+        dma->wr_cnt++;
+        dma->hw.transfer_count--;
+        return;
+    }
+}
+
+/***************************************************************************//**
+* @brief Change the level of an input pin at ustime: the state machine
+*        measuring the pin pushes the finished phase
+* @param pin [in] input pin
+* @param level [in] new level
+* @param ustime [in] time in us of the edge
+*******************************************************************************/
+void host_pio_input(const uint pin, const bool level, const ustime_t ustime)
+{
+    for(uint sm = 0; sm < HOST_PIO_SM_CNT; sm++)
+    {
+        host_sm_t * sm_ptr = &host_sm[sm];
+        if(!sm_ptr->enabled || (sm_ptr->pin != pin) || (sm_ptr->level == level))
+            continue;
+
+        // The counter of the state machine holds 31 bits (~35 min)
+        ustime_t len = ustime - sm_ptr->start;
+        HOST_CHECK(len < 0x7FFFFFFFULL);
+        uint32_t loops = (len > HOST_PIO_EXTRA_US) ? (uint32_t)(len - HOST_PIO_EXTRA_US) : 0;
+        uint32_t word = ((0x7FFFFFFFUL - loops) << 1) | (sm_ptr->level ? 0UL : 1UL);
+        host_dma_push(sm, word);
+
+        sm_ptr->level = level;
+        sm_ptr->start = ustime;
+    }
+}
+
+//******************************************************************************
+// Pico SDK (hardware/pio.h, hardware/dma.h, hardware/clocks.h)
+//******************************************************************************
+
+uint32_t clock_get_hz(enum clock_index clk_index)
+{
+    return HOST_SYS_HZ;
+}
+
+uint pio_add_program(PIO pio, const pio_program_t * program)
+{
+    HOST_CHECK(!host_prog_loaded);  // Loaded once for all channels
+    host_prog_loaded = true;
+    return 0;
+}
+
+int pio_claim_unused_sm(PIO pio, bool required)
+{
+    for(int sm = 0; sm < HOST_PIO_SM_CNT; sm++)
+    {
+        if(!host_sm[sm].claimed)
+        {
+            memset(&host_sm[sm], 0, sizeof(host_sm_t));
+            host_sm[sm].claimed = true;
+            return sm;
+        }
+    }
+    HOST_CHECK(!required);
+    return -1;
+}
+
+void sm_config_set_in_pins(pio_sm_config * c, uint in_base) {}
+
+void sm_config_set_jmp_pin(pio_sm_config * c, uint pin)
+{
+    c->execctrl = pin;
+}
+
+void sm_config_set_in_shift(pio_sm_config * c, bool shift_right, bool autopush, uint push_threshold)
+{
+    HOST_CHECK(!shift_right && autopush && (push_threshold == 32));
+}
+
+void sm_config_set_clkdiv(pio_sm_config * c, float div)
+{
+    c->clkdiv = (uint32_t)(div * 256.0f);   // 16.8 fixed point
+}
+
+void sm_config_set_fifo_join(pio_sm_config * c, int join) {}
+
+void pio_sm_init(PIO pio, uint sm, uint initial_pc, const pio_sm_config * config)
+{
+    HOST_CHECK((uint64_t) config->clkdiv * 2000000ULL == (uint64_t) HOST_SYS_HZ * 256);  // 1 loop = 1us
+    host_sm[sm].pin = config->execctrl;
+    host_sm[sm].enabled = false;
+}
+
+void pio_sm_set_enabled(PIO pio, uint sm, bool enabled)
+{
+    host_sm[sm].enabled = enabled;
+    host_sm[sm].level = gpio_get(host_sm[sm].pin);
+    host_sm[sm].start = host_us;
+}
+
+void pio_sm_set_consecutive_pindirs(PIO pio, uint sm, uint pin_base, uint pin_count, bool is_out) {}
+void pio_sm_clear_fifos(PIO pio, uint sm) {}
+
+uint pio_get_dreq(PIO pio, uint sm, bool is_tx)
+{
+    return sm;
+}
+
+int dma_claim_unused_channel(bool required)
+{
+    for(int ch = 0; ch < HOST_DMA_CNT; ch++)
+    {
+        if(!host_dma[ch].claimed)
+        {
+            memset(&host_dma[ch], 0, sizeof(host_dma_t));
+            host_dma[ch].claimed = true;
+            host_dma[ch].sm = -1;
+            return ch;
+        }
+    }
+    HOST_CHECK(!required);
+    return -1;
+}
+
+dma_channel_config dma_channel_get_default_config(uint channel)
+{
+    dma_channel_config c = { 0 };
+    return c;
+}
+
+void channel_config_set_transfer_data_size(dma_channel_config * c, enum dma_channel_transfer_size size)
+{
+    HOST_CHECK(size == DMA_SIZE_32);
+}
+
+void channel_config_set_read_increment(dma_channel_config * c, bool incr)
+{
+    HOST_CHECK(!incr);
+}
+
+void channel_config_set_write_increment(dma_channel_config * c, bool incr)
+{
+    HOST_CHECK(incr);
+}
+
+void channel_config_set_dreq(dma_channel_config * c, uint dreq)
+{
+    c->ctrl = (c->ctrl & 0xFFFF) | ((dreq + 1) << 16);
+}
+
+void channel_config_set_ring(dma_channel_config * c, bool write, uint size_bits)
+{
+    HOST_CHECK(write);
+    c->ctrl = (c->ctrl & ~0xFFFFUL) | 0x100 | size_bits;
+}
+
+void dma_channel_configure(uint channel, const dma_channel_config * config, volatile void * write_addr,
+    const volatile void * read_addr, uint transfer_count, bool trigger)
+{
+    host_dma_t * dma = &host_dma[channel];
+    dma->ring = ((config->ctrl & 0x100) != 0);
+    dma->ring_bits = config->ctrl & 0xFF;
+    dma->base = (volatile uint32_t *) write_addr;
+    dma->wr_cnt = 0;
+    dma->sm = (int)(config->ctrl >> 16) - 1;
+    dma->hw.transfer_count = transfer_count;
+
+    // The buffer must be aligned to the ring size
+    HOST_CHECK(!dma->ring || ((((uintptr_t) write_addr) & ((1UL << dma->ring_bits) - 1)) == 0));
+    HOST_CHECK((dma->sm >= 0) && (read_addr == &pio0->rxf[dma->sm]));
+    HOST_CHECK(trigger);
+}
+
+dma_channel_hw_t * dma_channel_hw_addr(uint channel)
+{
+    return &host_dma[channel].hw;
+}
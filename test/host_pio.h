@@ -0,0 +1,38 @@
+/*******************************************************************************
+ * This file is part of the MstHora distribution.
+ * Copyright (c) 2024 Igor Marinescu (igor.marinescu@gmail.com).
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, version 3.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see <http://www.gnu.org/licenses/>.
+ ******************************************************************************/
+/*******************************************************************************
+ * host_pio - host model of the PIO state machines and the DMA channels used
+ * by dcf_cap_pio.c (see host_pio.c).
+ ******************************************************************************/
+#ifndef HOST_PIO_H
+#define HOST_PIO_H
+
+//******************************************************************************
+// Includes
+//******************************************************************************
+#include "pico/types.h"
+#include "ustime.h"
+
+//******************************************************************************
+// Exported Functions
+//******************************************************************************
+
+// Change the level of an input pin measured by a state machine
+void host_pio_input(const uint pin, const bool level, const ustime_t ustime);
+
+//******************************************************************************
+#endif /* HOST_PIO_H */
@@ -0,0 +1,29 @@
+// Host stub of the header generated by pioasm from dcf_cap.pio (see host_pio.c)
+#pragma once
+#include "hardware/pio.h"
+
+static const uint16_t dcf_cap_program_instructions[] = { 0 };
+
+static const pio_program_t dcf_cap_program = {
+    .instructions = dcf_cap_program_instructions,
+    .length = 1,
+    .origin = -1,
+};
+
+static inline pio_sm_config dcf_cap_program_get_default_config(uint offset)
+{
+    pio_sm_config c = { 0 };
+    return c;
+}
+
+// Same as the c-sdk block of dcf_cap.pio
+static inline void dcf_cap_program_init(PIO pio, uint sm, uint offset, uint pin, float div)
+{
+    pio_sm_config c = dcf_cap_program_get_default_config(offset);
+    sm_config_set_jmp_pin(&c, pin);
+    sm_config_set_in_shift(&c, /*shift_right*/ false, /*autopush*/ true, 32);
+    sm_config_set_fifo_join(&c, PIO_FIFO_JOIN_RX);
+    sm_config_set_clkdiv(&c, div);
+    pio_sm_set_consecutive_pindirs(pio, sm, pin, 1, /*is_out*/ false);
+    pio_sm_init(pio, sm, offset, &c);
+}
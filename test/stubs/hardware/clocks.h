@@ -0,0 +1,7 @@
+// Host stub of the Pico SDK (clocks)
+#pragma once
+#include "pico/stdlib.h"
+
+enum clock_index { clk_ref = 4, clk_sys = 5 };
+
+uint32_t clock_get_hz(enum clock_index clk_index);
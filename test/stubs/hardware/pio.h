@@ -0,0 +1,43 @@
+// Host stub of the Pico SDK (PIO)
+#pragma once
+#include "pico/stdlib.h"
+
+typedef struct {
+    io_rw_32 ctrl;
+    io_ro_32 fstat;
+    io_rw_32 fdebug;
+    io_ro_32 flevel;
+    io_rw_32 txf[4];
+    io_ro_32 rxf[4];
+} pio_hw_t;
+
+typedef pio_hw_t * PIO;
+extern pio_hw_t * pio0;
+
+typedef struct {
+    uint32_t clkdiv;
+    uint32_t execctrl;
+    uint32_t shiftctrl;
+    uint32_t pinctrl;
+} pio_sm_config;
+
+typedef struct {
+    const uint16_t * instructions;
+    uint8_t length;
+    int8_t origin;
+} pio_program_t;
+
+#define PIO_FIFO_JOIN_RX    2
+
+uint pio_add_program(PIO pio, const pio_program_t * program);
+int pio_claim_unused_sm(PIO pio, bool required);
+void sm_config_set_in_pins(pio_sm_config * c, uint in_base);
+void sm_config_set_jmp_pin(pio_sm_config * c, uint pin);
+void sm_config_set_in_shift(pio_sm_config * c, bool shift_right, bool autopush, uint push_threshold);
+void sm_config_set_clkdiv(pio_sm_config * c, float div);
+void sm_config_set_fifo_join(pio_sm_config * c, int join);
+void pio_sm_init(PIO pio, uint sm, uint initial_pc, const pio_sm_config * config);
+void pio_sm_set_enabled(PIO pio, uint sm, bool enabled);
+void pio_sm_set_consecutive_pindirs(PIO pio, uint sm, uint pin_base, uint pin_count, bool is_out);
+void pio_sm_clear_fifos(PIO pio, uint sm);
+uint pio_get_dreq(PIO pio, uint sm, bool is_tx);
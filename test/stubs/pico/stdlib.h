@@ -0,0 +1,43 @@
+// Host stub of the Pico SDK (functions used by the modules, see host.c)
+#pragma once
+#include "pico/types.h"
+
+#define __not_in_flash_func(f)  f
+#define __unused                __attribute__((unused))
+
+#define GPIO_IN             0
+#define GPIO_OUT            1
+#define GPIO_IRQ_LEVEL_LOW  1u
+#define GPIO_IRQ_LEVEL_HIGH 2u
+#define GPIO_IRQ_EDGE_FALL  4u
+#define GPIO_IRQ_EDGE_RISE  8u
+
+#define PICO_HIGHEST_IRQ_PRIORITY   0
+#define PICO_DEFAULT_IRQ_PRIORITY   0x80
+#define PICO_LOWEST_IRQ_PRIORITY    0xc0
+#define DMA_IRQ_0           11
+#define IO_IRQ_BANK0        13
+
+typedef volatile uint32_t io_rw_32;
+typedef volatile uint32_t io_ro_32;
+typedef void (*irq_handler_t)(void);
+typedef void (*gpio_irq_callback_t)(uint gpio, uint32_t event_mask);
+
+uint64_t time_us_64(void);
+uint32_t time_us_32(void);
+static inline absolute_time_t from_us_since_boot(uint64_t us) { return us; }
+
+void gpio_init(uint gpio);
+void gpio_set_dir(uint gpio, bool out);
+void gpio_set_pulls(uint gpio, bool up, bool down);
+bool gpio_get(uint gpio);
+void gpio_put(uint gpio, bool value);
+
+void irq_set_exclusive_handler(uint num, irq_handler_t handler);
+void irq_set_enabled(uint num, bool enabled);
+void irq_set_priority(uint num, uint8_t priority);
+
+void tight_loop_contents(void);
+void __compiler_memory_barrier(void);
+void __dmb(void);
+void __sev(void);
@@ -0,0 +1,124 @@
+/*******************************************************************************
+ * This file is part of the MstHora distribution.
+ * Copyright (c) 2024 Igor Marinescu (igor.marinescu@gmail.com).
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, version 3.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see <http://www.gnu.org/licenses/>.
+ ******************************************************************************/
+/*******************************************************************************
+ * test_datetime - checks the epoch conversion of datetime_utils against the
+ * libc (timegm, gmtime_r): every day from 1970 to 2200 at a random time of
+ * the day and every second around the leap days and the 2038/2100 boundaries.
+ ******************************************************************************/
+
+//******************************************************************************
+// Includes
+//******************************************************************************
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+
+#include "host.h"
+#include "datetime_utils.h"
+
+//******************************************************************************
+// Defines
+//******************************************************************************
+#define TEST_DT_YEAR_END    2200        // Last year of the daily check
+#define TEST_DT_SPAN_S      (2 * 86400) // Seconds checked around a boundary
+#define TEST_DT_SEED        1           // Seed of the random time of the day
+
+//******************************************************************************
+// Global Variables
+//******************************************************************************
+
+// Boundaries (epoch seconds, checked from TEST_DT_SPAN_S before to after)
+static const epoch_t boundary[] = {
+    0LL,            // 01.01.1970
+    68169600LL,     // 29.02.1972, first leap day
+    951782400LL,    // 29.02.2000, leap year (divisible by 400)
+    2147483647LL,   // 19.01.2038 03:14:07, end of the 32-bit time_t
+    4102444800LL,   // 01.01.2100
+    4107542400LL,   // 01.03.2100, 2100 is not a leap year
+    7258118400LL,   // 01.01.2200
+};
+
+/***************************************************************************//**
+* @brief Check the conversion of an epoch in both directions and the date
+*        arithmetic from it
+* @param epoch [in] epoch seconds
+* @param add [in] seconds for datetime_add_sec
+* @return true if all checks passed
+*******************************************************************************/
+static bool test_epoch(const epoch_t epoch, const int add)
+{
+    time_t t = (time_t) epoch;
+    struct tm tm;
+    datetime_t dt;
+
+    gmtime_r(&t, &tm);
+    datetime_from_epoch(&dt, epoch);
+
+    bool ok = HOST_CHECK((dt.year == tm.tm_year + 1900) && (dt.month == tm.tm_mon + 1) &&
+        (dt.day == tm.tm_mday) && (dt.dotw == tm.tm_wday) &&
+        (dt.hour == tm.tm_hour) && (dt.min == tm.tm_min) && (dt.sec == tm.tm_sec));
+    ok &= HOST_CHECK(datetime_to_epoch(&dt) == (epoch_t) timegm(&tm));
+    ok &= HOST_CHECK(datetime_is_valid(&dt));
+    ok &= HOST_CHECK(datetime_days_in_month(dt.year, dt.month) >= dt.day);
+
+    datetime_t sum = dt;
+    datetime_t ref;
+    datetime_add_sec(&sum, add);
+    datetime_from_epoch(&ref, epoch + add);
+    ok &= HOST_CHECK(datetime_is_equal(&sum, &ref));
+    ok &= HOST_CHECK(datetime_diff(&sum, &dt) == add);
+    ok &= HOST_CHECK(datetime_compare(&sum, &dt) == ((add > 0) - (add < 0)));
+
+    if(!ok)
+        printf("epoch %lld add %d failed\n", (long long) epoch, add);
+    return ok;
+}
+
+/***************************************************************************//**
+* @brief Run the checks
+*******************************************************************************/
+int main(void)
+{
+    srand(TEST_DT_SEED);
+    int32_t day_end = datetime_days_from_civil(TEST_DT_YEAR_END, 12, 31);
+    for(int32_t day = 0; day <= day_end; day++)
+    {
+        epoch_t epoch = (epoch_t) day * 86400 + (rand() % 86400);
+        if(!test_epoch(epoch, (rand() % 400000) - 200000))
+            break;
+    }
+
+    for(int i = 0; i < (int)(sizeof(boundary) / sizeof(boundary[0])); i++)
+    {
+        for(epoch_t epoch = boundary[i] - TEST_DT_SPAN_S; epoch <= boundary[i] + TEST_DT_SPAN_S; epoch++)
+        {
+            if(!test_epoch(epoch, (int)(epoch % 7200) - 3600))
+                break;
+        }
+    }
+
+    // 29.02 only in leap years
+    datetime_t dt = { .year = 2100, .month = 2, .day = 29, .hour = 0, .min = 0, .sec = 0 };
+    HOST_CHECK(!datetime_is_valid_date(&dt));
+    dt.year = 2000;
+    HOST_CHECK(datetime_is_valid_date(&dt));
+    HOST_CHECK(datetime_days_in_month(2100, 2) == 28);
+    HOST_CHECK(datetime_days_in_month(2096, 2) == 29);
+
+    return host_result("test_datetime");
+}
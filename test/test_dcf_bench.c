@@ -0,0 +1,124 @@
+/*******************************************************************************
+ * This file is part of the MstHora distribution.
+ * Copyright (c) 2024 Igor Marinescu (igor.marinescu@gmail.com).
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, version 3.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see <http://www.gnu.org/licenses/>.
+ ******************************************************************************/
+/*******************************************************************************
+ * test_dcf_bench - runs every dcf_gen scenario through the DCF77 decoder on
+ * the virtual clock (dcf_poll every DCF_BENCH_POLL_US, as the dcf task) and
+ * checks the decoded minutes against the generated ones: no false decode and
+ * at least the expected count of correct minutes.
+ *
+ * Prints per scenario: correct/false minutes, time to the first correct
+ * minute, bit errors and how much faster than real time the scenario ran.
+ ******************************************************************************/
+
+//******************************************************************************
+// Includes
+//******************************************************************************
+#include <stdio.h>
+#include <string.h>
+#include <time.h>
+
+#include "host.h"
+#include "dcf77.h"
+#include "dcf_gen.h"
+
+//******************************************************************************
+// Defines
+//******************************************************************************
+#define DCF_BENCH_POLL_US   10000ULL    // Poll period of the decoder (MAIN_DCF_PERIOD)
+#define DCF_BENCH_MINUTES   32          // Simulated minutes per scenario
+
+//******************************************************************************
+// Typedefs
+//******************************************************************************
+
+// Scenario and the minimal count of correct minutes
+typedef struct {
+    const char * name;
+    uint32_t ok_min;
+} bench_t;
+
+//******************************************************************************
+// Global Variables
+//******************************************************************************
+static const bench_t bench[] = {
+    { "clean",    26 },
+    { "jitter",   24 },
+    { "drop",     13 },
+    { "spike",    25 },
+    { "fade",      0 },
+    { "midnight", 26 },
+    { "dst",      26 },
+    { "dst_back", 26 },
+    { "leap",     26 },
+    { "glitch",   25 },
+};
+
+/***************************************************************************//**
+* @brief Run a scenario
+* @param bench_ptr [in] scenario and its expected result
+*******************************************************************************/
+static void bench_run(const bench_t * bench_ptr)
+{
+    const dcf_gen_cfg_t * cfg_ptr = dcf_gen_find(bench_ptr->name);
+    if(!HOST_CHECK(cfg_ptr != NULL))
+        return;
+
+    clock_t cpu_start = clock();
+    ustime_t start = host_us;
+    ustime_t end = start + (DCF_BENCH_MINUTES * 60000000ULL);
+    ustime_t first_ok = 0;
+    dcf_stats_t st;
+
+    dcf_sim_start(cfg_ptr, 0, start);
+    for(; host_us < end; host_us += DCF_BENCH_POLL_US)
+    {
+        dcf_poll(host_us);
+        if(first_ok == 0)
+        {
+            dcf_get_stats(0, &st);
+            if(st.check_ok > 0)
+                first_ok = host_us;
+        }
+    }
+    dcf_get_stats(0, &st);
+
+    double cpu_s = (double)(clock() - cpu_start) / CLOCKS_PER_SEC;
+    double speed = (cpu_s > 0.0) ? ((DCF_BENCH_MINUTES * 60.0) / cpu_s) : 0.0;
+    printf("%-9s ok=%2lu false=%lu first_ok=%4lis ber=%lu/%lu realign=%lu speed=%.0fx\n", bench_ptr->name,
+        (unsigned long) st.check_ok, (unsigned long) st.check_false,
+        (long)(first_ok ? ((first_ok - start) / 1000000ULL) : -1),
+        (unsigned long) st.ber_err, (unsigned long) st.ber_bits, (unsigned long) st.realign, speed);
+
+    HOST_CHECK(st.check_false == 0);
+    HOST_CHECK(st.check_ok >= bench_ptr->ok_min);
+    HOST_CHECK(speed > 1.0);
+}
+
+/***************************************************************************//**
+* @brief Run all scenarios, or the scenario given as the first argument
+*******************************************************************************/
+int main(int argc, char ** argv)
+{
+    dcf_init();
+    for(int i = 0; i < (int)(sizeof(bench) / sizeof(bench[0])); i++)
+    {
+        if((argc > 1) && strcmp(argv[1], bench[i].name))
+            continue;
+        bench_run(&bench[i]);
+    }
+    return host_result("test_dcf_bench");
+}
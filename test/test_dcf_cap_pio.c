@@ -0,0 +1,187 @@
+/*******************************************************************************
+ * This file is part of the MstHora distribution.
+ * Copyright (c) 2024 Igor Marinescu (igor.marinescu@gmail.com).
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, version 3.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see <http://www.gnu.org/licenses/>.
+ ******************************************************************************/
+/*******************************************************************************
+ * test_dcf_cap_pio - runs the PIO/DMA capture (dcf_cap_pio.c) on the host
+ * model of the state machine and the DMA ring buffer (host_pio.c):
+ *  - the edges reconstructed from the measured phases are exact (1us),
+ *  - a full ring buffer is read back without loss, an overwritten one
+ *    counts the lost edges and continues,
+ *  - the decoder (dcf77.c) fed by the capture decodes the dcf_gen
+ *    scenarios as with the edges of the generator.
+ ******************************************************************************/
+
+//******************************************************************************
+// Includes
+//******************************************************************************
+#include <stdio.h>
+#include <stdlib.h>
+
+#include "host.h"
+#include "host_pio.h"
+#include "dcf_cap.h"
+#include "dcf_gen.h"
+#include "dcf77.h"
+
+//******************************************************************************
+// Defines
+//******************************************************************************
+#define TEST_PIO_CH         1           // Capture channel of the edge checks
+#define TEST_PIO_PIN        20          // Its input pin
+#define TEST_PIO_EDGES      100000      // Edges with random phase lengths
+#define TEST_PIO_MAX_US     2000000     // Maximal phase length
+#define TEST_PIO_POLL_US    10000ULL    // Poll period of the decoder
+#define TEST_PIO_MINUTES    32          // Simulated minutes per scenario
+
+//******************************************************************************
+// Typedefs
+//******************************************************************************
+
+// Scenario and the minimal count of correct minutes (as test_dcf_bench)
+typedef struct {
+    const char * name;
+    uint32_t ok_min;
+} test_pio_dec_t;
+
+//******************************************************************************
+// Global Variables
+//******************************************************************************
+static const test_pio_dec_t test_dec[] = {
+    { "clean",  26 },
+    { "jitter", 24 },
+    { "spike",  25 },
+    { "glitch", 25 },
+};
+
+static bool pin_level = true;           // Level of TEST_PIO_PIN
+
+/***************************************************************************//**
+* @brief Generate an edge of TEST_PIO_PIN after a phase
+* @param len [in] length of the phase in us
+* @return time of the edge
+*******************************************************************************/
+static ustime_t test_edge(const ustime_t len)
+{
+    host_us += len;
+    pin_level = !pin_level;
+    host_pio_input(TEST_PIO_PIN, pin_level, host_us);
+    return host_us;
+}
+
+/***************************************************************************//**
+* @brief Edges read one by one and a full ring buffer at once
+*******************************************************************************/
+static void test_exact(void)
+{
+    dcf_edge_t edge;
+    HOST_CHECK(!dcf_cap_get_edge(TEST_PIO_CH, &edge));
+
+    bool ok = true;
+    for(int i = 0; (i < TEST_PIO_EDGES) && ok; i++)
+    {
+        ustime_t ustime = test_edge(1 + (rand() % TEST_PIO_MAX_US));
+        ok = HOST_CHECK(dcf_cap_get_edge(TEST_PIO_CH, &edge));
+        ok = ok && HOST_CHECK((edge.ustime == ustime) && (edge.level == pin_level));
+        ok = ok && HOST_CHECK(!dcf_cap_get_edge(TEST_PIO_CH, &edge));
+    }
+
+    ustime_t ustime[DCF_CAP_BUFF];
+    for(int i = 0; i < DCF_CAP_BUFF; i++)
+        ustime[i] = test_edge(50000 + (rand() % 200000));
+    for(int i = 0; i < DCF_CAP_BUFF; i++)
+        HOST_CHECK(dcf_cap_get_edge(TEST_PIO_CH, &edge) && (edge.ustime == ustime[i]));
+    HOST_CHECK(!dcf_cap_get_edge(TEST_PIO_CH, &edge));
+    HOST_CHECK(dcf_cap_get_lost(TEST_PIO_CH) == 0);
+}
+
+/***************************************************************************//**
+* @brief Ring buffer overwritten: lost edges counted, the next edges exact
+*******************************************************************************/
+static void test_overflow(void)
+{
+    dcf_edge_t edge;
+    for(int i = 0; i < DCF_CAP_BUFF + 5; i++)
+        test_edge(100000);
+
+    int cnt = 0;
+    while(dcf_cap_get_edge(TEST_PIO_CH, &edge))
+        cnt++;
+    HOST_CHECK(cnt == DCF_CAP_BUFF);
+    HOST_CHECK(dcf_cap_get_lost(TEST_PIO_CH) == 5);
+
+    // The timestamps are re-synced at the overflow, the next edges are exact
+    // relative to the last edge read
+    ustime_t last = edge.ustime;
+    test_edge(123456);
+    HOST_CHECK(dcf_cap_get_edge(TEST_PIO_CH, &edge) && (edge.ustime == last + 123456));
+}
+
+/***************************************************************************//**
+* @brief Decode a scenario captured by the model
+* @param dec_ptr [in] scenario and its expected result
+*******************************************************************************/
+static void test_decode(const test_pio_dec_t * dec_ptr)
+{
+    static dcf_gen_t gen;
+    const dcf_gen_cfg_t * cfg_ptr = dcf_gen_find(dec_ptr->name);
+    if(!HOST_CHECK(cfg_ptr != NULL))
+        return;
+
+    ustime_t end = host_us + (TEST_PIO_MINUTES * 60000000ULL);
+    uint32_t ok = 0;
+    uint32_t false_cnt = 0;
+    dcf_edge_t edge;
+
+    dcf_gen_start(&gen, cfg_ptr, 0, 0, host_us);
+    for(; host_us < end; host_us += TEST_PIO_POLL_US)
+    {
+        while(dcf_gen_get(&gen, &edge, host_us))
+            host_pio_input(DCF_IN_PIN, edge.level, edge.ustime);
+        // Checked while the generator runs (the bench checks the same minutes)
+        if(dcf_poll(host_us) && dcf_gen_is_running(&gen))
+        {
+            if(datetime_is_equal(dcf_get_datetime(), dcf_gen_get_datetime(&gen)))
+                ok++;
+            else
+                false_cnt++;
+        }
+    }
+
+    printf("%-7s ok=%2lu false=%lu lost=%lu\n", dec_ptr->name,
+        (unsigned long) ok, (unsigned long) false_cnt, (unsigned long) dcf_cap_get_lost(0));
+    HOST_CHECK(false_cnt == 0);
+    HOST_CHECK(ok >= dec_ptr->ok_min);
+    HOST_CHECK(dcf_cap_get_lost(0) == 0);
+}
+
+/***************************************************************************//**
+* @brief Run the checks
+*******************************************************************************/
+int main(void)
+{
+    srand(1);
+    host_us = 1000;
+    dcf_init();
+    for(int i = 0; i < (int)(sizeof(test_dec) / sizeof(test_dec[0])); i++)
+        test_decode(&test_dec[i]);
+
+    // Started after the decoder: the first phase must be shorter than 31 bits
+    dcf_cap_init(TEST_PIO_CH, TEST_PIO_PIN);
+    test_exact();
+    test_overflow();
+
+    return host_result("test_dcf_cap_pio");
+}
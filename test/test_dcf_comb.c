@@ -0,0 +1,193 @@
+/*******************************************************************************
+ * This file is part of the MstHora distribution.
+ * Copyright (c) 2024 Igor Marinescu (igor.marinescu@gmail.com).
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, version 3.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see <http://www.gnu.org/licenses/>.
+ ******************************************************************************/
+/*******************************************************************************
+ * test_dcf_comb - runs the dcf_gen scenarios through two decoders (DCF_DUAL)
+ * fed by two independent synthetic streams (same telegrams, own noise).
+ * Every scenario runs twice on the same streams: receiver 0 alone (no peer,
+ * the single receiver baseline) and combined with receiver 1.
+ *
+ * Checks: the two streams carry the same telegrams with independent
+ * impairments (hardly any common edge), no false minute on any receiver, the
+ * soft values of the peer were combined and receiver 0 decodes at least the
+ * expected count of correct minutes, not less than alone.
+ ******************************************************************************/
+
+//******************************************************************************
+// Includes
+//******************************************************************************
+#include <stdio.h>
+
+#include "host.h"
+#include "dcf77.h"
+#include "dcf_gen.h"
+#include "datetime_utils.h"
+
+#ifndef DCF_DUAL
+#error "test_dcf_comb needs DCF_DUAL"
+#endif
+
+//******************************************************************************
+// Defines
+//******************************************************************************
+#define TEST_COMB_POLL_US   10000ULL    // Poll period of the decoders (MAIN_DCF_PERIOD)
+#define TEST_COMB_MINUTES   32          // Simulated minutes per scenario
+#define TEST_COMB_GEN_MIN   10          // Generated minutes of the stream check
+#define TEST_COMB_EDGES     4096        // Maximal count of edges of a stream
+#define TEST_COMB_COMMON    10          // Maximal common edges [%] of the streams
+
+//******************************************************************************
+// Typedefs
+//******************************************************************************
+
+// Scenario and the minimal correct minutes of two receivers
+typedef struct {
+    const char * name;
+    uint32_t ok_min;
+} test_comb_t;
+
+//******************************************************************************
+// Global Variables
+//******************************************************************************
+static const test_comb_t test_comb[] = {
+    { "clean",    27 },
+    { "jitter",   26 },
+    { "drop",     17 },
+    { "spike",    27 },
+    { "fade",      0 },
+    { "midnight", 27 },
+    { "dst",      27 },
+    { "dst_back", 27 },
+    { "leap",     27 },
+    { "glitch",   27 },
+};
+
+static dcf_edge_t test_edges[2][TEST_COMB_EDGES];   // Generated edges of both streams
+
+/***************************************************************************//**
+* @brief Check that the two streams of a scenario carry the same telegrams
+*        with independent impairments (noise, drops, spikes, glitches)
+* @param cfg_ptr [in] scenario
+* @return percentage of the edges common to both streams
+*******************************************************************************/
+static int test_streams(const dcf_gen_cfg_t * cfg_ptr)
+{
+    static dcf_gen_t gen[2];
+    int cnt[2] = { 0, 0 };
+    uint32_t dt_diff = 0;
+
+    ustime_t t = host_us;
+    ustime_t end = t + (TEST_COMB_GEN_MIN * 60000000ULL) + DCF_GEN_START_DELAY;
+    for(int i = 0; i < 2; i++)
+        dcf_gen_start(&gen[i], cfg_ptr, TEST_COMB_GEN_MIN, i, t);
+    for(; t < end; t += TEST_COMB_POLL_US)
+    {
+        for(int i = 0; i < 2; i++)
+        {
+            dcf_edge_t edge;
+            while(dcf_gen_get(&gen[i], &edge, t))
+            {
+                if(HOST_CHECK(cnt[i] < TEST_COMB_EDGES))
+                    test_edges[i][cnt[i]++] = edge;
+            }
+        }
+        // The same minute in the middle of the minute (generated a second ahead)
+        if((((t - host_us) % 60000000ULL) == 30000000ULL)
+            && (datetime_to_epoch(dcf_gen_get_datetime(&gen[0])) != datetime_to_epoch(dcf_gen_get_datetime(&gen[1]))))
+            dt_diff++;
+    }
+
+    // Edges at the same time with the same level (both lists are sorted by time)
+    int common = 0;
+    for(int i = 0, j = 0; (i < cnt[0]) && (j < cnt[1]); )
+    {
+        if(test_edges[0][i].ustime < test_edges[1][j].ustime)
+            i++;
+        else if(test_edges[0][i].ustime > test_edges[1][j].ustime)
+            j++;
+        else {
+            if(test_edges[0][i].level == test_edges[1][j].level)
+                common++;
+            i++;
+            j++;
+        }
+    }
+
+    int edges = (cnt[0] < cnt[1]) ? cnt[0] : cnt[1];
+    HOST_CHECK((dt_diff == 0) && (edges > 0));
+    return (edges > 0) ? ((common * 100) / edges) : 100;
+}
+
+/***************************************************************************//**
+* @brief Run a scenario through the decoders
+* @param cfg_ptr [in] scenario
+* @param peer [in] combine the minutes of receiver 1 with receiver 0
+* @param st0_ptr [out] statistics of receiver 0
+* @param st1_ptr [out] statistics of receiver 1
+*******************************************************************************/
+static void test_decode(const dcf_gen_cfg_t * cfg_ptr, const bool peer, dcf_stats_t * st0_ptr, dcf_stats_t * st1_ptr)
+{
+    dcf_ctx_set_peer(dcf_get_ctx(0), (peer ? dcf_get_ctx(1) : NULL));
+
+    ustime_t end = host_us + (TEST_COMB_MINUTES * 60000000ULL);
+    dcf_sim_start(cfg_ptr, 0, host_us);
+    for(; host_us < end; host_us += TEST_COMB_POLL_US)
+        dcf_poll(host_us);
+
+    dcf_get_stats(0, st0_ptr);
+    dcf_get_stats(1, st1_ptr);
+}
+
+/***************************************************************************//**
+* @brief Run a scenario with a single receiver and with two
+* @param comb_ptr [in] scenario and its expected result
+*******************************************************************************/
+static void test_run(const test_comb_t * comb_ptr)
+{
+    const dcf_gen_cfg_t * cfg_ptr = dcf_gen_find(comb_ptr->name);
+    if(!HOST_CHECK(cfg_ptr != NULL))
+        return;
+
+    int common = test_streams(cfg_ptr);
+
+    dcf_stats_t single;
+    dcf_stats_t st0;
+    dcf_stats_t st1;
+    test_decode(cfg_ptr, false, &single, &st1);
+    HOST_CHECK((single.check_false == 0) && (single.comb_minutes == 0));
+    test_decode(cfg_ptr, true, &st0, &st1);
+
+    printf("%-9s ok single %2lu -> dual %2lu (rx1 %2lu), false %lu/%lu, combined %lu, common edges %d%%\n",
+        comb_ptr->name, (unsigned long) single.check_ok, (unsigned long) st0.check_ok, (unsigned long) st1.check_ok,
+        (unsigned long) st0.check_false, (unsigned long) st1.check_false, (unsigned long) st0.comb_minutes, common);
+
+    HOST_CHECK(common <= TEST_COMB_COMMON);
+    HOST_CHECK((st0.check_false == 0) && (st1.check_false == 0));
+    HOST_CHECK(st0.check_ok >= comb_ptr->ok_min);
+    HOST_CHECK(st0.check_ok >= single.check_ok);
+    HOST_CHECK((comb_ptr->ok_min == 0) || (st0.comb_minutes > 0));
+}
+
+/***************************************************************************//**
+* @brief Run all scenarios
+*******************************************************************************/
+int main(void)
+{
+    dcf_init();
+    for(int i = 0; i < (int)(sizeof(test_comb) / sizeof(test_comb[0])); i++)
+        test_run(&test_comb[i]);
+    return host_result("test_dcf_comb");
+}
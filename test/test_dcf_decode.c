@@ -0,0 +1,287 @@
+/*******************************************************************************
+ * This file is part of the MstHora distribution.
+ * Copyright (c) 2024 Igor Marinescu (igor.marinescu@gmail.com).
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, version 3.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see <http://www.gnu.org/licenses/>.
+ ******************************************************************************/
+/*******************************************************************************
+ * test_dcf_decode - micro-benchmark of the extraction of time and date from
+ * the combined DCF77 telegram: the bit-packed telegram with the field tables
+ * (dcf77.c, included to reach its static functions) against the previous
+ * implementation (int8_t array, bit by bit extraction and parity, copied
+ * below as the reference).
+ *
+ * Both implementations must give the same result for random telegrams with
+ * flipped and undefined bits, then both decode one telegram TEST_DEC_LOOPS
+ * times and the time per decode is printed.
+ ******************************************************************************/
+
+//******************************************************************************
+// Includes
+//******************************************************************************
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+
+#include "host.h"
+#include "dcf77.c"
+
+//******************************************************************************
+// Defines
+//******************************************************************************
+#define TEST_DEC_TELEGRAMS  200000      // Random telegrams compared
+#define TEST_DEC_LOOPS      5000000     // Decodes of the benchmark
+
+//******************************************************************************
+// Global Variables
+//******************************************************************************
+static int8_t ref_bits_val[60];         // Telegram of the reference (dcf_bitval_t)
+static dcf_ctx_t * test_ctx;
+
+//******************************************************************************
+// Reference: the previous implementation (without the logging)
+//******************************************************************************
+
+static bool ref_bits_to_uint8(uint8_t * ptr_out, int start_idx, int end_idx)
+{
+    if((start_idx < 0) || (end_idx >= sizeof(ref_bits_val)))
+        return false;
+
+    uint8_t val = 0;
+    uint8_t mask = 1;
+    while(start_idx <= end_idx)
+    {
+        if(ref_bits_val[start_idx] == dcf_bitval_none)
+            return false;
+        if(ref_bits_val[start_idx] == dcf_bitval_true)
+            val |= mask;
+
+        mask <<= 1;
+        start_idx++;
+    }
+    *ptr_out = val;
+    return true;
+}
+
+static int ref_calc_parity(int par_sum, uint8_t val)
+{
+    while(val > 0)
+    {
+        if((val & 1) != 0)
+            par_sum++;
+        val >>= 1;
+    }
+    return par_sum;
+}
+
+static bool ref_check_parity(int par_sum, dcf_bitval_t parity)
+{
+    if((parity == dcf_bitval_true) && (par_sum & 1))
+        return true;
+    if((parity == dcf_bitval_false) && !(par_sum & 1))
+        return true;
+
+    return false;
+}
+
+static bool ref_extract_time(datetime_t * ptr_datetime)
+{
+    uint8_t val;
+    datetime_t dt;
+    dt.sec = 0;
+
+    if(ref_bits_val[28] == dcf_bitval_none)
+        return false;
+    if(!ref_bits_to_uint8(&val, 21, 27))
+        return false;
+    if(!ref_check_parity(ref_calc_parity(0, val), ref_bits_val[28]))
+        return false;
+    dt.min = bcd_to_int8(val);
+
+    if(ref_bits_val[35] == dcf_bitval_none)
+        return false;
+    if(!ref_bits_to_uint8(&val, 29, 34))
+        return false;
+    if(!ref_check_parity(ref_calc_parity(0, val), ref_bits_val[35]))
+        return false;
+    dt.hour = bcd_to_int8(val);
+
+    if(!datetime_is_valid_time(&dt))
+        return false;
+
+    datetime_copy_time(ptr_datetime, &dt);
+    return true;
+}
+
+static bool ref_extract_date(datetime_t * ptr_datetime)
+{
+    int parity = 0;
+    uint8_t val;
+    datetime_t dt;
+
+    if(ref_bits_val[58] == dcf_bitval_none)
+        return false;
+
+    if(!ref_bits_to_uint8(&val, 36, 41))
+        return false;
+    dt.day = bcd_to_int8(val);
+    parity = ref_calc_parity(parity, val);
+
+    if(!ref_bits_to_uint8(&val, 42, 44))
+        return false;
+    dt.dotw = bcd_to_int8(val);
+    if(dt.dotw == 7)
+        dt.dotw = 0;
+    parity = ref_calc_parity(parity, val);
+
+    if(!ref_bits_to_uint8(&val, 45, 49))
+        return false;
+    dt.month = bcd_to_int8(val);
+    parity = ref_calc_parity(parity, val);
+
+    if(!ref_bits_to_uint8(&val, 50, 57))
+        return false;
+    dt.year = (int16_t) bcd_to_int8(val);
+    dt.year += 2000;
+    parity = ref_calc_parity(parity, val);
+
+    if(!ref_check_parity(parity, ref_bits_val[58]))
+        return false;
+
+    if(!datetime_is_valid_date(&dt))
+        return false;
+
+    datetime_copy_date(ptr_datetime, &dt);
+    return true;
+}
+
+//******************************************************************************
+// Test
+//******************************************************************************
+
+/***************************************************************************//**
+* @brief Set a BCD field of a telegram
+* @param val_ptr [in/out] bit values
+* @param val [in] value of the field
+* @param start [in] index of the first bit
+* @param cnt [in] count of bits
+* @return count of ones (parity)
+*******************************************************************************/
+static int test_set_bcd(uint64_t * val_ptr, const int val, const int start, const int cnt)
+{
+    uint64_t bits = int8_to_bcd((uint8_t) val) & ((1U << cnt) - 1U);
+    *val_ptr |= bits << start;
+    return __builtin_popcountll(bits);
+}
+
+/***************************************************************************//**
+* @brief Set the telegram of a datetime in both implementations
+* @param dt [in] datetime
+* @param flip [in] bit to invert (-1: none)
+* @param undef [in] bit to set undefined (-1: none)
+*******************************************************************************/
+static void test_set(const datetime_t * dt, const int flip, const int undef)
+{
+    uint64_t val = (1ULL << 20) | (1ULL << 17);     // Start of time, CEST
+    val |= (uint64_t)(test_set_bcd(&val, dt->min, 21, 7) & 1) << 28;
+    val |= (uint64_t)(test_set_bcd(&val, dt->hour, 29, 6) & 1) << 35;
+    int par = test_set_bcd(&val, dt->day, 36, 6);
+    par += test_set_bcd(&val, dt->dotw ? dt->dotw : 7, 42, 3);
+    par += test_set_bcd(&val, dt->month, 45, 5);
+    par += test_set_bcd(&val, dt->year - 2000, 50, 8);
+    val |= (uint64_t)(par & 1) << 58;
+
+    uint64_t def = (1ULL << 59) - 1;
+    if(flip >= 0)
+        val ^= 1ULL << flip;
+    if(undef >= 0)
+        def &= ~(1ULL << undef);
+
+    test_ctx->rx_tg_val = val & def;
+    test_ctx->rx_tg_def = def;
+    for(int i = 0; i < 60; i++)
+    {
+        if(!((def >> i) & 1))
+            ref_bits_val[i] = dcf_bitval_none;
+        else
+            ref_bits_val[i] = ((val >> i) & 1) ? dcf_bitval_true : dcf_bitval_false;
+    }
+}
+
+/***************************************************************************//**
+* @brief Get the time in ns
+* @return monotonic time in ns
+*******************************************************************************/
+static uint64_t test_ns(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t) ts.tv_sec * 1000000000ULL + (uint64_t) ts.tv_nsec;
+}
+
+/***************************************************************************//**
+* @brief Run the checks and the benchmark
+*******************************************************************************/
+int main(void)
+{
+    srand(1);
+    test_ctx = &dcf_rx[0];
+
+    // Random datetimes 2000..2099 with a flipped and/or an undefined bit
+    uint32_t ok_cnt = 0;
+    for(int i = 0; i < TEST_DEC_TELEGRAMS; i++)
+    {
+        time_t t = (time_t)(946684800LL + ((int64_t) rand() % 3155760000LL));
+        struct tm tm;
+        gmtime_r(&t, &tm);
+        datetime_t dt = { .year = (int16_t)(tm.tm_year + 1900), .month = (int8_t)(tm.tm_mon + 1),
+            .day = (int8_t) tm.tm_mday, .dotw = (int8_t) tm.tm_wday, .hour = (int8_t) tm.tm_hour,
+            .min = (int8_t) tm.tm_min, .sec = 0 };
+        int mode = i % 4;
+        test_set(&dt, (mode & 1) ? (rand() % 59) : -1, (mode & 2) ? (rand() % 59) : -1);
+
+        datetime_t dt_new = dt;
+        datetime_t dt_ref = dt;
+        bool res_new = rx_bits_extract_time(test_ctx, &dt_new) && rx_bits_extract_date(test_ctx, &dt_new);
+        bool res_ref = ref_extract_time(&dt_ref) && ref_extract_date(&dt_ref);
+        if(!HOST_CHECK((res_new == res_ref) && datetime_is_equal(&dt_new, &dt_ref)))
+            break;
+        if((mode == 0) && !HOST_CHECK(res_new && datetime_is_equal(&dt_new, &dt)))
+            break;
+        ok_cnt += res_new ? 1 : 0;
+    }
+    printf("%d telegrams, %lu decoded by both, same results\n", TEST_DEC_TELEGRAMS, (unsigned long) ok_cnt);
+
+    // Benchmark: 10:01 14.05.2024
+    datetime_t dt = { .year = 2024, .month = 5, .day = 14, .dotw = 2, .hour = 10, .min = 1, .sec = 0 };
+    volatile int res = 0;
+    datetime_t out;
+    test_set(&dt, -1, -1);
+
+    uint64_t start = test_ns();
+    for(int i = 0; i < TEST_DEC_LOOPS; i++)
+        res += rx_bits_extract_time(test_ctx, &out) && rx_bits_extract_date(test_ctx, &out);
+    uint64_t new_ns = test_ns() - start;
+
+    start = test_ns();
+    for(int i = 0; i < TEST_DEC_LOOPS; i++)
+        res += ref_extract_time(&out) && ref_extract_date(&out);
+    uint64_t ref_ns = test_ns() - start;
+
+    HOST_CHECK(res == 2 * TEST_DEC_LOOPS);
+    printf("decode: bit-packed %.1f ns, array %.1f ns\n",
+        (double) new_ns / TEST_DEC_LOOPS, (double) ref_ns / TEST_DEC_LOOPS);
+
+    return host_result("test_dcf_decode");
+}
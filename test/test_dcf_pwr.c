@@ -0,0 +1,250 @@
+/*******************************************************************************
+ * This file is part of the MstHora distribution.
+ * Copyright (c) 2024 Igor Marinescu (igor.marinescu@gmail.com).
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, version 3.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see <http://www.gnu.org/licenses/>.
+ ******************************************************************************/
+/*******************************************************************************
+ * test_dcf_pwr - simulates the duty-cycling of the DCF77 receiver for
+ * TEST_PWR_DAYS days on a virtual clock (dcf_pwr_poll every second) with a
+ * site receiving well at night (0-5h), moderately in the evening (20-24h)
+ * and not at all during the day. The EEPROM is modelled in memory, the board
+ * is restarted on day TEST_PWR_REBOOT_DAY (the profile is read back, the
+ * first read requests are rejected as by a busy I2C manager). From day
+ * TEST_PWR_EST_DAY the caller passes a holdover error estimated from a
+ * measured drift of TEST_PWR_EST_PPB, before that none (DCF_PWR_DRIFT_PPM).
+ *
+ * Checks: always on while learning, then on in the good hours, in the probe
+ * hour and while the holdover error exceeds its limit only (with the fixed
+ * drift the evening misses push it over the limit, with the smaller measured
+ * drift never), the decoder gets
+ * the system time of the poll, the profile survives the restart and the
+ * forced modes.
+ ******************************************************************************/
+
+//******************************************************************************
+// Includes
+//******************************************************************************
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "host.h"
+#include "dcf_pwr.h"
+#include "i2c_drv.h"
+#include "i2c_manager.h"
+
+//******************************************************************************
+// Defines
+//******************************************************************************
+#define TEST_PWR_DAYS       14          // Simulated days
+#define TEST_PWR_REBOOT_DAY 7           // Day of the restart
+#define TEST_PWR_EPOCH      1714521600LL    // 01.05.2024 00:00 (local time)
+#define TEST_PWR_DUTY_MAX   45          // Maximal duty cycle [%] after learning
+#define TEST_PWR_EST_DAY    10          // First day with an estimated holdover error
+#define TEST_PWR_EST_PPB    500         // Measured drift (|ppb| + 3 sigma)
+
+//******************************************************************************
+// Global Variables
+//******************************************************************************
+static bool dec_enabled = true;         // State of the decoder (dcf_set_enabled)
+static uint32_t dec_switch_cnt = 0;
+static uint32_t dec_time_err = 0;       // dcf_set_enabled not called with the poll time
+
+static uint8_t mem[sizeof(dcf_pwr_prof_t)];     // EEPROM page of the profile
+static bool mem_valid = false;
+static int mem_read_busy = 0;           // Count of read requests to reject
+static uint32_t mem_write_cnt = 0;
+
+//******************************************************************************
+// Stubs of dcf77 and i2c_manager
+//******************************************************************************
+
+void dcf_set_enabled(const bool enabled, const ustime_t sys_ustime)
+{
+    dec_enabled = enabled;
+    dec_switch_cnt++;
+    if(sys_ustime != host_us)
+        dec_time_err++;
+}
+
+bool i2c_man_req_mem_read(uint8_t * dst_ptr, const uint16_t src_addr, int len, i2c_man_callback_t callback)
+{
+    HOST_CHECK((src_addr == DCF_PWR_MEM_ADDR) && (len == sizeof(mem)));
+    if(mem_read_busy > 0)
+    {
+        mem_read_busy--;
+        return false;
+    }
+    if(mem_valid)
+        memcpy(dst_ptr, mem, sizeof(mem));
+    callback(mem_valid ? i2c_success : i2c_err_unknown);
+    return true;
+}
+
+bool i2c_man_req_mem_write(const uint16_t dst_addr, const uint8_t * src_ptr, int len, i2c_man_callback_t callback)
+{
+    HOST_CHECK((dst_addr == DCF_PWR_MEM_ADDR) && (len == sizeof(mem)));
+    memcpy(mem, src_ptr, sizeof(mem));
+    mem_valid = true;
+    mem_write_cnt++;
+    callback(i2c_success);
+    return true;
+}
+
+//******************************************************************************
+// Simulation
+//******************************************************************************
+
+/***************************************************************************//**
+* @brief Reception of the site
+* @param hour [in] hour of the day
+* @param quality_ptr [out] signal quality 0..100%
+* @return probability [%] of a decoded minute
+*******************************************************************************/
+static int test_site(const int hour, int * quality_ptr)
+{
+    if(hour < 5)
+    {
+        *quality_ptr = 90;
+        return 90;
+    }
+    if(hour >= 20)
+    {
+        *quality_ptr = 50;
+        return 30;
+    }
+    *quality_ptr = 10;
+    return 0;
+}
+
+/***************************************************************************//**
+* @brief Run the simulation and the checks
+*******************************************************************************/
+int main(void)
+{
+    srand(1);
+    dcf_pwr_init();
+    HOST_CHECK(dcf_pwr_get_reason() == dcf_pwr_learn);
+
+    s_time_t s_time = 0;
+    s_time_t rx_s_time = -1;                // Last decoded minute
+    int32_t hold_max = 0;
+    uint32_t hold_err = 0;                  // Off with the holdover error over the limit
+    uint32_t hold_on_fix = 0;               // On for the holdover, fixed drift
+    uint32_t hold_on_est = 0;               // On for the holdover, estimated drift
+    for(int day = 0; day < TEST_PWR_DAYS; day++)
+    {
+        char hours[25] = { 0 };
+        uint32_t on_s = 0;
+        uint32_t on_bad_s = 0;      // On in a bad hour (not the probe)
+
+        if(day == TEST_PWR_REBOOT_DAY)
+        {
+            mem_read_busy = 3;
+            dcf_pwr_init();
+            HOST_CHECK(dcf_pwr_get_profile()->days == 0);       // Not loaded yet
+        }
+
+        for(int sec = 0; sec < 86400; sec++, s_time++, host_us += 1000000ULL)
+        {
+            datetime_t dt;
+            datetime_from_epoch(&dt, TEST_PWR_EPOCH + s_time);
+
+            int quality;
+            int prob = test_site(dt.hour, &quality);
+            int32_t hold_ms = -1;
+            if((day >= TEST_PWR_EST_DAY) && (rx_s_time >= 0))
+                hold_ms = (int32_t)(((s_time - rx_s_time) * TEST_PWR_EST_PPB) / 1000000LL);
+            bool on = dcf_pwr_poll(&dt, (dec_enabled ? quality : 0), hold_ms, s_time, host_us);
+            HOST_CHECK(on == dec_enabled);
+            if((day == TEST_PWR_REBOOT_DAY) && (sec == 2))
+                HOST_CHECK((mem_read_busy == 0) && (dcf_pwr_get_profile()->days >= DCF_PWR_LEARN_DAYS));
+
+            dcf_pwr_reason_t reason = dcf_pwr_get_reason();
+            if(on)
+            {
+                on_s++;
+                hours[dt.hour] = "0FLTHWP"[reason];
+                if((prob == 0) && (reason != dcf_pwr_probe) && (reason != dcf_pwr_holdover) && (day >= DCF_PWR_LEARN_DAYS))
+                    on_bad_s++;
+                if((reason == dcf_pwr_holdover) && (day >= DCF_PWR_LEARN_DAYS))
+                {
+                    if(day >= TEST_PWR_EST_DAY)
+                        hold_on_est++;
+                    else
+                        hold_on_fix++;
+                }
+            }
+            else if(!hours[dt.hour]) {
+                hours[dt.hour] = '.';
+            }
+
+            if(on && (dt.sec == 0) && ((rand() % 100) < prob))
+            {
+                dcf_pwr_received(s_time);
+                rx_s_time = s_time;
+            }
+
+            int32_t hold = dcf_pwr_get_holdover();
+            if((day >= DCF_PWR_LEARN_DAYS) && (hold > hold_max))
+                hold_max = hold;
+            if(hold > DCF_PWR_HOLD_MAX_MS)
+                hold_err += on ? 0 : 1;
+        }
+
+        int duty = (int)((on_s * 100UL) / 86400UL);
+        printf("day %2d duty %3d%% %s\n", day, duty, hours);
+        if(day < DCF_PWR_LEARN_DAYS)
+            HOST_CHECK(duty == 100);
+        else
+            HOST_CHECK((duty <= TEST_PWR_DUTY_MAX) && (on_bad_s == 0));
+    }
+
+    const dcf_pwr_prof_t * prof = dcf_pwr_get_profile();
+    printf("total duty %d%%, max. holdover after learning %ld ms, holdover on %lu s (fixed) %lu s (estimated), "
+        "%lu switches, %lu saves\nscore:", dcf_pwr_get_duty(), (long) hold_max, (unsigned long) hold_on_fix,
+        (unsigned long) hold_on_est, (unsigned long) dec_switch_cnt, (unsigned long) mem_write_cnt);
+    for(int h = 0; h < 24; h++)
+        printf(" %u", prof->score[h]);
+    printf("\n");
+
+    // The good hours have the best scores
+    for(int h = 0; h < 5; h++)
+    {
+        for(int g = 5; g < 20; g++)
+            HOST_CHECK(prof->score[h] > prof->score[g]);
+    }
+    HOST_CHECK(hold_err == 0);
+    HOST_CHECK((hold_on_fix > 0) && (hold_on_est == 0));
+    HOST_CHECK(dec_time_err == 0);
+
+    // Saved once a day, the saved page is valid
+    uint8_t sum = 0;
+    for(unsigned i = 0; i < sizeof(mem); i++)
+        sum += mem[i];
+    HOST_CHECK(mem_write_cnt >= TEST_PWR_DAYS - 1);
+    HOST_CHECK((((const dcf_pwr_prof_t *) mem)->magic == DCF_PWR_MAGIC) && (sum == 0));
+
+    // Forced modes (noon, a bad hour)
+    datetime_t dt;
+    datetime_from_epoch(&dt, TEST_PWR_EPOCH + 12 * 3600);
+    dcf_pwr_set_mode(dcf_pwr_mode_on);
+    HOST_CHECK(dcf_pwr_poll(&dt, 0, -1, s_time, host_us) && (dcf_pwr_get_reason() == dcf_pwr_forced));
+    dcf_pwr_set_mode(dcf_pwr_mode_off);
+    HOST_CHECK(!dcf_pwr_poll(&dt, 0, -1, s_time, host_us) && !dec_enabled);
+    dcf_pwr_set_mode(dcf_pwr_mode_auto);
+    HOST_CHECK(dcf_pwr_poll(NULL, 0, -1, s_time, host_us) && (dcf_pwr_get_reason() == dcf_pwr_no_time));
+
+    return host_result("test_dcf_pwr");
+}
@@ -0,0 +1,184 @@
+/*******************************************************************************
+ * This file is part of the MstHora distribution.
+ * Copyright (c) 2024 Igor Marinescu (igor.marinescu@gmail.com).
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, version 3.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see <http://www.gnu.org/licenses/>.
+ ******************************************************************************/
+/*******************************************************************************
+ * test_dt_arb - checks the time source arbitration with a DCF77 reference
+ * (10 ms per report), a DS3231 (2 ppm, 500 ms until set) and an internal
+ * clock (50 ppm, not usable until set):
+ *  - a single bad DCF77 minute is rejected, two consecutive consistent
+ *    reports (a real time step) are accepted,
+ *  - a source contradicting a better source loses its discipline, a source
+ *    contradicting a worse one keeps it,
+ *  - a source without an error bound (DT_ARB_ERR_UNKNOWN) is compared with
+ *    the error 0 (only the 1 s tolerance),
+ *  - the DS3231 is selected after the loss of DCF77 and stays trusted 48 h,
+ *  - a DS3231 with a stopped oscillator (OSF, disciplined with
+ *    DT_ARB_ERR_UNKNOWN as main does) is not used until it is set.
+ ******************************************************************************/
+
+//******************************************************************************
+// Includes
+//******************************************************************************
+#include <stdio.h>
+
+#include "host.h"
+#include "dt_arb.h"
+
+//******************************************************************************
+// Defines
+//******************************************************************************
+#define TEST_ARB_T0         1700000000LL            // Epoch at TEST_ARB_US0
+#define TEST_ARB_US0        1000000ULL              // System time of the first report
+#define TEST_ARB_SEC        1000000ULL
+#define TEST_ARB_MIN        (60 * TEST_ARB_SEC)
+#define TEST_ARB_HOUR       (3600 * TEST_ARB_SEC)
+#define TEST_ARB_RTC_SET_MS 20                      // Error bound of the DS3231 after it was set
+#define TEST_ARB_OSF_EPOCH  946684800LL             // DS3231 after its oscillator stopped (01.01.2000)
+
+//******************************************************************************
+// Global Variables
+//******************************************************************************
+static const dt_arb_cfg_t cfg_dcf = { "dcf", 0,  DT_ARB_ERR_UNKNOWN, 10 };
+static const dt_arb_cfg_t cfg_rtc = { "rtc", 2,  500,                0  };
+static const dt_arb_cfg_t cfg_int = { "int", 50, DT_ARB_ERR_UNKNOWN, 0  };
+
+static int dcf_id;
+static int rtc_id;
+static int int_id;
+
+/***************************************************************************//**
+* @brief Report an epoch
+* @param id [in] source id
+* @param epoch [in] epoch seconds
+* @param ustime [in] system time in us
+* @return true if accepted
+*******************************************************************************/
+static bool test_report(const int id, const epoch_t epoch, const ustime_t ustime)
+{
+    datetime_t dt;
+    datetime_from_epoch(&dt, epoch);
+    return dt_arb_report(id, &dt, ustime);
+}
+
+/***************************************************************************//**
+* @brief Get the epoch of the time (in us since TEST_ARB_US0)
+* @param ustime [in] system time in us
+* @return epoch seconds
+*******************************************************************************/
+static epoch_t test_epoch(const ustime_t ustime)
+{
+    return TEST_ARB_T0 + (epoch_t)((ustime - TEST_ARB_US0) / TEST_ARB_SEC);
+}
+
+/***************************************************************************//**
+* @brief Run the checks
+*******************************************************************************/
+int main(void)
+{
+    dt_arb_init();
+    dcf_id = dt_arb_add(&cfg_dcf);
+    rtc_id = dt_arb_add(&cfg_rtc);
+    int_id = dt_arb_add(&cfg_int);
+    HOST_CHECK((dcf_id >= 0) && (rtc_id >= 0) && (int_id >= 0));
+
+    // Power-on: the DS3231 (not set) is the only usable source
+    ustime_t t = TEST_ARB_US0;
+    uint32_t err;
+    HOST_CHECK(dt_arb_select(t, &err) == -1);
+    HOST_CHECK(test_report(rtc_id, test_epoch(t), t));
+    HOST_CHECK((dt_arb_select(t, &err) == rtc_id) && (err == 500));
+    HOST_CHECK(dt_arb_is_trusted(rtc_id, t));
+
+    // The internal clock (error unknown -> 0): only 1s tolerance to the DS3231
+    HOST_CHECK(!test_report(int_id, test_epoch(t) + 2, t));
+    HOST_CHECK(dt_arb_get_src(int_id)->disc_err_ms == DT_ARB_ERR_UNKNOWN);
+    HOST_CHECK(test_report(int_id, test_epoch(t) + 1, t));
+    HOST_CHECK(dt_arb_get_err(int_id, t) == DT_ARB_ERR_UNKNOWN);
+
+    // First DCF77 minute, the DS3231 is set from it
+    t += TEST_ARB_MIN;
+    HOST_CHECK(test_report(dcf_id, test_epoch(t), t));
+    HOST_CHECK((dt_arb_select(t, &err) == dcf_id) && (err == 10));
+    dt_arb_discipline(rtc_id, TEST_ARB_RTC_SET_MS, t);
+    HOST_CHECK(dt_arb_get_err(rtc_id, t) == DT_ARB_ERR_UNKNOWN);    // Until the next report
+    for(int s = 1; s < 600; s++)
+        HOST_CHECK(test_report(rtc_id, test_epoch(t + s * TEST_ARB_SEC), t + s * TEST_ARB_SEC));
+    t += 10 * TEST_ARB_MIN;
+
+    // A single bad minute (+1h) is rejected, the next good one is accepted
+    HOST_CHECK(!test_report(dcf_id, test_epoch(t) + 3600, t));
+    HOST_CHECK(dt_arb_get_src(dcf_id)->rejected == 1);
+    t += TEST_ARB_MIN;
+    HOST_CHECK(test_report(dcf_id, test_epoch(t), t));
+
+    // A real step (+2h): two consecutive consistent minutes
+    t += TEST_ARB_MIN;
+    HOST_CHECK(!test_report(dcf_id, test_epoch(t) + 7200, t));
+    t += TEST_ARB_MIN;
+    HOST_CHECK(test_report(dcf_id, test_epoch(t) + 7200, t));
+    HOST_CHECK(dt_arb_get_src(dcf_id)->rejected == 2);
+
+    // The DS3231 (worse than DCF77) contradicts the step: discipline lost
+    t += TEST_ARB_SEC;
+    HOST_CHECK(!test_report(rtc_id, test_epoch(t), t));
+    HOST_CHECK(dt_arb_get_err(rtc_id, t) == DT_ARB_ERR_UNKNOWN);
+    HOST_CHECK(dt_arb_select(t, NULL) == dcf_id);
+
+    // The internal clock set better than DCF77 contradicts it: discipline kept
+    dt_arb_discipline(int_id, 5, t);
+    HOST_CHECK(!test_report(int_id, test_epoch(t), t));
+    HOST_CHECK(dt_arb_get_src(int_id)->disc_err_ms == 5);
+    dt_arb_discipline(int_id, DT_ARB_ERR_UNKNOWN, t);
+
+    // The DS3231 set again, DCF77 lost: hold-over of the DS3231
+    t += TEST_ARB_SEC;
+    dt_arb_discipline(rtc_id, TEST_ARB_RTC_SET_MS, t);
+    ustime_t set_ustime = t;
+    for(int h = 0; h <= 48; h++)
+    {
+        t = set_ustime + h * TEST_ARB_HOUR;
+        HOST_CHECK(test_report(rtc_id, test_epoch(t) + 7200, t));
+        int sel = dt_arb_select(t + TEST_ARB_SEC / 2, &err);
+        if((h % 12) == 0)
+            printf("h=%2d sel=%s err=%lums dcf err=%lums\n", h, dt_arb_get_src(sel)->cfg->name,
+                (unsigned long) err, (unsigned long) dt_arb_get_err(dcf_id, t));
+        if(h >= 1)
+            HOST_CHECK(sel == rtc_id);
+        HOST_CHECK(err <= DT_ARB_TRUST_MS);
+    }
+    HOST_CHECK(!dt_arb_is_trusted(dcf_id, t));
+
+    // Power-on with OSF: the DS3231 shows 01.01.2000, not usable until it is set
+    dt_arb_init();
+    dcf_id = dt_arb_add(&cfg_dcf);
+    rtc_id = dt_arb_add(&cfg_rtc);
+    t = TEST_ARB_US0;
+    dt_arb_discipline(rtc_id, DT_ARB_ERR_UNKNOWN, t);
+    HOST_CHECK(test_report(rtc_id, TEST_ARB_OSF_EPOCH, t));
+    HOST_CHECK((dt_arb_select(t, &err) == -1) && !dt_arb_is_trusted(rtc_id, t));
+    t += TEST_ARB_MIN;
+    HOST_CHECK(test_report(dcf_id, test_epoch(t), t));
+    HOST_CHECK(!test_report(rtc_id, TEST_ARB_OSF_EPOCH + 60, t));
+    HOST_CHECK(dt_arb_select(t, NULL) == dcf_id);
+
+    // Set from DCF77 (OSF cleared): trusted again
+    dt_arb_discipline(rtc_id, TEST_ARB_RTC_SET_MS, t);
+    t += TEST_ARB_SEC;
+    HOST_CHECK(test_report(rtc_id, test_epoch(t), t));
+    HOST_CHECK(dt_arb_is_trusted(rtc_id, t) && (dt_arb_get_err(rtc_id, t) == TEST_ARB_RTC_SET_MS));
+
+    return host_result("test_dt_arb");
+}
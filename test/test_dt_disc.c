@@ -0,0 +1,244 @@
+/*******************************************************************************
+ * This file is part of the MstHora distribution.
+ * Copyright (c) 2024 Igor Marinescu (igor.marinescu@gmail.com).
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, version 3.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see <http://www.gnu.org/licenses/>.
+ ******************************************************************************/
+/*******************************************************************************
+ * test_dt_disc - simulates the DS3231 and the internal RTC against DCF77 for
+ * TEST_DISC_DAYS days on a virtual clock and checks the drift estimates of
+ * dt_disc. The clocks run with a constant frequency error, are read every
+ * 100 ms / 130 ms (plus a random delay) and set (as main does) when their
+ * offset exceeds 100 ms / 1 s. DCF77 gives a reference every minute with
+ * +-5 ms jitter. The EEPROM is modelled in memory.
+ *
+ * Checks: the final estimate is within 3 sigma (+10 ppb) of the true drift,
+ * the estimates are saved and read back after a restart.
+ ******************************************************************************/
+
+//******************************************************************************
+// Includes
+//******************************************************************************
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "host.h"
+#include "dt_disc.h"
+#include "i2c_drv.h"
+#include "i2c_manager.h"
+
+//******************************************************************************
+// Defines
+//******************************************************************************
+#define TEST_DISC_DAYS      7
+#define TEST_DISC_T0        1700000000LL    // Epoch at the system time 0
+#define TEST_DISC_MIN_US    60000000ULL
+#define TEST_DISC_DAY_US    86400000000ULL
+#define TEST_DISC_DCF_US    5000            // Jitter of the DCF77 reference (+-)
+
+//******************************************************************************
+// Typedefs
+//******************************************************************************
+
+// Simulated clock
+typedef struct {
+    const char * name;
+    double ppb;                 // Frequency error
+    double off_us;              // Offset at the system time 0
+    uint32_t read_us;           // Read period
+    uint32_t jitter_us;         // Random delay of a read
+    double set_us;              // The clock is set when its offset exceeds this value
+    int id;
+    ustime_t next;              // Time of the next read
+    uint32_t sets;
+} test_clk_t;
+
+// Scenario: the true drift of both clocks and the read jitter
+typedef struct {
+    double ppb_rtc;
+    double ppb_int;
+    uint32_t jitter_us;
+} test_disc_t;
+
+//******************************************************************************
+// Global Variables
+//******************************************************************************
+static const test_disc_t test_disc[] = {
+    {  1700.0, -23000.0,  3000 },
+    {  -400.0,  12500.0,  3000 },
+    {  1700.0, -23000.0, 50000 },
+};
+
+static uint8_t mem[sizeof(dt_disc_mem_t)];      // EEPROM page of the estimates
+static bool mem_valid = false;
+static uint32_t mem_write_cnt = 0;
+
+//******************************************************************************
+// Stubs of i2c_manager (EEPROM)
+//******************************************************************************
+
+bool i2c_man_req_mem_read(uint8_t * dst_ptr, const uint16_t src_addr, int len, i2c_man_callback_t callback)
+{
+    HOST_CHECK((src_addr == DT_DISC_MEM_ADDR) && (len == sizeof(mem)));
+    if(mem_valid)
+        memcpy(dst_ptr, mem, sizeof(mem));
+    callback(mem_valid ? i2c_success : i2c_err_unknown);
+    return true;
+}
+
+bool i2c_man_req_mem_write(const uint16_t dst_addr, const uint8_t * src_ptr, int len, i2c_man_callback_t callback)
+{
+    HOST_CHECK((dst_addr == DT_DISC_MEM_ADDR) && (len == sizeof(mem)));
+    memcpy(mem, src_ptr, sizeof(mem));
+    mem_valid = true;
+    mem_write_cnt++;
+    callback(i2c_success);
+    return true;
+}
+
+//******************************************************************************
+// Simulation
+//******************************************************************************
+
+/***************************************************************************//**
+* @brief Get a random value 0..1
+*******************************************************************************/
+static double test_rnd(void)
+{
+    return rand() / (double) RAND_MAX;
+}
+
+/***************************************************************************//**
+* @brief Get the offset of a clock
+* @param clk [in] clock
+* @param ustime [in] system (true) time in us
+* @return offset in us, positive: the clock is ahead
+*******************************************************************************/
+static double test_offset(const test_clk_t * clk, const ustime_t ustime)
+{
+    return (double) ustime * clk->ppb * 1e-9 + clk->off_us;
+}
+
+/***************************************************************************//**
+* @brief Read a clock
+* @param clk [in] clock
+* @param ustime [in] system (true) time in us
+* @param dt_ptr [out] datetime shown by the clock
+*******************************************************************************/
+static void test_read(const test_clk_t * clk, const ustime_t ustime, datetime_t * dt_ptr)
+{
+    double s = ((double) ustime + test_offset(clk, ustime)) / 1e6;
+    epoch_t epoch = TEST_DISC_T0 + (epoch_t)((s >= 0.0) ? s : (s - 1.0));
+    datetime_from_epoch(dt_ptr, epoch);
+}
+
+/***************************************************************************//**
+* @brief Run a scenario
+* @param disc_ptr [in] scenario
+*******************************************************************************/
+static void test_run(const test_disc_t * disc_ptr)
+{
+    test_clk_t clk[2] = {
+        { "rtc",    disc_ptr->ppb_rtc, 300000.0, 100000, disc_ptr->jitter_us, 100000.0,  0, 0, 0 },
+        { "rtcint", disc_ptr->ppb_int, 700000.0, 130000, disc_ptr->jitter_us, 1000000.0, 0, 0, 0 },
+    };
+
+    mem_valid = false;
+    dt_disc_init();
+    for(int i = 0; i < 2; i++)
+        clk[i].id = dt_disc_add(clk[i].name);
+
+    const ustime_t end = TEST_DISC_DAYS * TEST_DISC_DAY_US;
+    ustime_t t = 1000;
+    while(t < end)
+    {
+        // Next event: a read or the next minute
+        ustime_t minute = ((t / TEST_DISC_MIN_US) + 1) * TEST_DISC_MIN_US;
+        ustime_t next = minute;
+        for(int i = 0; i < 2; i++)
+        {
+            if(clk[i].next < next)
+                next = clk[i].next;
+        }
+        t = next;
+        host_us = t;
+
+        for(int i = 0; i < 2; i++)
+        {
+            if(clk[i].next != t)
+                continue;
+            datetime_t dt;
+            test_read(&clk[i], t, &dt);
+            dt_disc_report(clk[i].id, &dt, t);
+            clk[i].next = t + clk[i].read_us + (ustime_t)(test_rnd() * clk[i].jitter_us);
+        }
+
+        if(t != minute)
+            continue;
+
+        datetime_t dt;
+        datetime_from_epoch(&dt, TEST_DISC_T0 + (epoch_t)(t / 1000000ULL));
+        dt_disc_reference(&dt, t + (ustime_t)(test_rnd() * 2 * TEST_DISC_DCF_US) - TEST_DISC_DCF_US);
+
+        // Set the clocks as main does
+        for(int i = 0; i < 2; i++)
+        {
+            double off = test_offset(&clk[i], t);
+            if((off > clk[i].set_us) || (off < -clk[i].set_us))
+            {
+                clk[i].off_us = -(double) t * clk[i].ppb * 1e-9 + (i ? (test_rnd() * 900000.0) : 5000.0);
+                dt_disc_set(clk[i].id);
+                clk[i].sets++;
+            }
+        }
+        dt_disc_poll();
+    }
+
+    dt_disc_est_t est[2];
+    for(int i = 0; i < 2; i++)
+    {
+        int32_t ppb = 0;
+        uint32_t sigma = 0;
+        bool ok = dt_disc_get_ppb(clk[i].id, &ppb, &sigma);
+        est[i] = dt_disc_get_src(clk[i].id)->est;
+        printf("%-6s true %+6.0f ppb, jitter %2lu ms: est %+6ld +-%3lu ppb, %u fits, %lu sets, holdover 24h %ld ms\n",
+            clk[i].name, clk[i].ppb, (unsigned long)(disc_ptr->jitter_us / 1000), (long) ppb, (unsigned long) sigma,
+            est[i].fits, (unsigned long) clk[i].sets, (long) dt_disc_get_holdover(clk[i].id, 86400));
+
+        double err = (double) ppb - clk[i].ppb;
+        HOST_CHECK(ok && (est[i].fits > 0));
+        HOST_CHECK((err <= 3.0 * sigma + 10.0) && (err >= -3.0 * sigma - 10.0));
+        HOST_CHECK(dt_disc_get_holdover(clk[i].id, 86400) > 0);
+    }
+
+    // Restart: the estimates are read back
+    HOST_CHECK(mem_write_cnt > 0);
+    dt_disc_init();
+    for(int i = 0; i < 2; i++)
+        dt_disc_add(clk[i].name);
+    dt_disc_poll();
+    for(int i = 0; i < 2; i++)
+        HOST_CHECK(memcmp(&dt_disc_get_src(clk[i].id)->est, &est[i], sizeof(dt_disc_est_t)) == 0);
+}
+
+/***************************************************************************//**
+* @brief Run all scenarios
+*******************************************************************************/
+int main(void)
+{
+    srand(1);
+    for(int i = 0; i < (int)(sizeof(test_disc) / sizeof(test_disc[0])); i++)
+        test_run(&test_disc[i]);
+    return host_result("test_dt_disc");
+}
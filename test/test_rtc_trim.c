@@ -0,0 +1,276 @@
+/*******************************************************************************
+ * This file is part of the MstHora distribution.
+ * Copyright (c) 2024 Igor Marinescu (igor.marinescu@gmail.com).
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, version 3.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see <http://www.gnu.org/licenses/>.
+ ******************************************************************************/
+/*******************************************************************************
+ * test_rtc_trim - simulates the DS3231 aging offset trimming against DCF77 on
+ * a virtual clock. The DS3231 drifts by base - sens * 100 ppb * aging, is read
+ * every 100 ms, set when its offset exceeds 100 ms and compared with a DCF77
+ * reference every minute (+-5 ms jitter). A written aging offset is applied at
+ * the next minute (the DS3231 applies it at its next temperature conversion).
+ *
+ * Scenarios: an effective register (the drift is trimmed to less than 1 LSB),
+ * an ineffective one (the trims are rolled back and the trimming ends), a
+ * failed write, a write without a result (timeout).
+ ******************************************************************************/
+
+//******************************************************************************
+// Includes
+//******************************************************************************
+#include <stdio.h>
+#include <stdlib.h>
+
+#include "host.h"
+#include "dt_disc.h"
+#include "rtc_trim.h"
+#include "i2c_drv.h"
+#include "i2c_rtc.h"
+#include "i2c_manager.h"
+
+//******************************************************************************
+// Defines
+//******************************************************************************
+#define TEST_TRIM_T0        1700000000LL    // Epoch at the system time 0
+#define TEST_TRIM_MIN_US    60000000ULL
+#define TEST_TRIM_DAY_US    86400000000ULL
+#define TEST_TRIM_READ_US   100000          // Read period of the DS3231
+#define TEST_TRIM_JITTER_US 3000            // Random delay of a read
+#define TEST_TRIM_DCF_US    5000            // Jitter of the DCF77 reference (+-)
+#define TEST_TRIM_SET_US    100000.0        // The DS3231 is set when its offset exceeds this value
+
+//******************************************************************************
+// Typedefs
+//******************************************************************************
+
+// Scenario
+typedef struct {
+    const char * name;
+    double base_ppb;            // Drift with the aging offset 0
+    double sens;                // Effect of the aging offset, 1.0: RTC_TRIM_PPB_LSB per LSB
+    int days;
+    bool fail_first;            // The first write of the aging offset fails
+    bool lose_first;            // The first write of the aging offset has no result
+} test_trim_t;
+
+//******************************************************************************
+// Global Variables
+//******************************************************************************
+static const test_trim_t test_trim[] = {
+    { "effective",   1700.0, 1.0, 40, false, false },
+    { "ineffective", 1700.0, 0.0, 40, false, false },
+    { "write fail",  -900.0, 1.0, 30, true,  false },
+    { "write lost",  -900.0, 1.0, 30, false, true  },
+};
+
+static const test_trim_t * trim_ptr;
+static int8_t aging;                        // Aging offset of the DS3231
+static int8_t aging_req;                    // Requested aging offset
+static i2c_man_callback_t aging_cb = NULL;  // Pending write
+static bool aging_fail;                     // The next write fails
+static bool aging_lose;                     // The next write has no result
+static double clk_ppb;                      // Drift of the DS3231
+static double clk_off_us;                   // Offset of the DS3231 at clk_ustime
+static ustime_t clk_ustime;
+
+//******************************************************************************
+// Stubs of i2c_manager (EEPROM, aging offset) and i2c_rtc
+//******************************************************************************
+
+bool i2c_man_req_mem_read(uint8_t * dst_ptr, const uint16_t src_addr, int len, i2c_man_callback_t callback)
+{
+    callback(i2c_err_unknown);
+    return true;
+}
+
+bool i2c_man_req_mem_write(const uint16_t dst_addr, const uint8_t * src_ptr, int len, i2c_man_callback_t callback)
+{
+    callback(i2c_success);
+    return true;
+}
+
+bool i2c_man_req_rtc_aging(const int8_t aging, i2c_man_callback_t callback)
+{
+    if(aging_cb != NULL)
+        return false;
+    aging_req = aging;
+    aging_cb = callback;
+    return true;
+}
+
+bool i2c_rtc_get_aging(int8_t * aging_ptr)
+{
+    *aging_ptr = aging;
+    return true;
+}
+
+//******************************************************************************
+// Simulation
+//******************************************************************************
+
+/***************************************************************************//**
+* @brief Get a random value 0..1
+*******************************************************************************/
+static double test_rnd(void)
+{
+    return rand() / (double) RAND_MAX;
+}
+
+/***************************************************************************//**
+* @brief Get the offset of the DS3231
+* @param ustime [in] system (true) time in us
+* @return offset in us, positive: the DS3231 is ahead
+*******************************************************************************/
+static double test_offset(const ustime_t ustime)
+{
+    return clk_off_us + ((double) ustime - (double) clk_ustime) * clk_ppb * 1e-9;
+}
+
+/***************************************************************************//**
+* @brief Change the offset and the drift of the DS3231
+* @param ustime [in] system (true) time in us
+* @param off_us [in] new offset in us
+* @param ppb [in] new drift
+*******************************************************************************/
+static void test_clk_set(const ustime_t ustime, const double off_us, const double ppb)
+{
+    clk_off_us = off_us;
+    clk_ustime = ustime;
+    clk_ppb = ppb;
+}
+
+/***************************************************************************//**
+* @brief Complete a pending write of the aging offset
+* @param ustime [in] system (true) time in us
+*******************************************************************************/
+static void test_aging_write(const ustime_t ustime)
+{
+    if(aging_cb == NULL)
+        return;
+
+    i2c_man_callback_t callback = aging_cb;
+    aging_cb = NULL;
+    if(aging_lose)
+    {
+        aging_lose = false;
+        return;
+    }
+    if(aging_fail)
+    {
+        aging_fail = false;
+        callback(i2c_err_unknown);
+        return;
+    }
+    aging = aging_req;
+    test_clk_set(ustime, test_offset(ustime), trim_ptr->base_ppb - trim_ptr->sens * RTC_TRIM_PPB_LSB * aging);
+    callback(i2c_success);
+}
+
+/***************************************************************************//**
+* @brief Run a scenario
+* @param sc_ptr [in] scenario
+*******************************************************************************/
+static void test_run(const test_trim_t * sc_ptr)
+{
+    trim_ptr = sc_ptr;
+    aging = 0;
+    aging_cb = NULL;
+    aging_fail = sc_ptr->fail_first;
+    aging_lose = sc_ptr->lose_first;
+    test_clk_set(0, 300000.0, sc_ptr->base_ppb);
+
+    dt_disc_init();
+    int id = dt_disc_add("rtc");
+    rtc_trim_init(id);
+    rtc_trim_set_enabled(true);     // Ended by the rollbacks of a previous scenario
+
+    const ustime_t end = (ustime_t) sc_ptr->days * TEST_TRIM_DAY_US;
+    ustime_t next = 0;
+    ustime_t t = 1000;
+    while(t < end)
+    {
+        ustime_t minute = ((t / TEST_TRIM_MIN_US) + 1) * TEST_TRIM_MIN_US;
+        t = (next < minute) ? next : minute;
+        host_us = t;
+
+        if(t == next)
+        {
+            double s = ((double) t + test_offset(t)) / 1e6;
+            datetime_t dt;
+            datetime_from_epoch(&dt, TEST_TRIM_T0 + (epoch_t) s);
+            dt_disc_report(id, &dt, t);
+            next = t + TEST_TRIM_READ_US + (ustime_t)(test_rnd() * TEST_TRIM_JITTER_US);
+        }
+        if(t != minute)
+            continue;
+
+        datetime_t dt;
+        datetime_from_epoch(&dt, TEST_TRIM_T0 + (epoch_t)(t / 1000000ULL));
+        dt_disc_reference(&dt, t + (ustime_t)(test_rnd() * 2 * TEST_TRIM_DCF_US) - TEST_TRIM_DCF_US);
+
+        double off = test_offset(t);
+        if((off > TEST_TRIM_SET_US) || (off < -TEST_TRIM_SET_US))
+        {
+            test_clk_set(t, 5000.0, clk_ppb);
+            dt_disc_set(id);
+        }
+        test_aging_write(t);
+        rtc_trim_poll(t);
+        dt_disc_poll();
+    }
+
+    int32_t ppb = 0;
+    uint32_t sigma = 0;
+    dt_disc_get_ppb(id, &ppb, &sigma);
+    int kept = 0;
+    int rollback = 0;
+    int failed = 0;
+    const rtc_trim_hist_t * hist_ptr;
+    for(int i = 0; (hist_ptr = rtc_trim_get_hist(i)) != NULL; i++)
+    {
+        kept += (hist_ptr->res == rtc_trim_res_kept);
+        rollback += (hist_ptr->res == rtc_trim_res_rollback);
+        failed += (hist_ptr->res == rtc_trim_res_failed);
+    }
+    printf("%-11s %2d days: drift %+5.0f -> %+5.0f ppb, est %+5ld +-%2lu ppb, aging %+d, kept %d, rollback %d, failed %d, state %d\n",
+        sc_ptr->name, sc_ptr->days, sc_ptr->base_ppb, clk_ppb, (long) ppb, (unsigned long) sigma, aging,
+        kept, rollback, failed, rtc_trim_get_state());
+
+    // The estimate follows the true drift in every scenario
+    HOST_CHECK((ppb - clk_ppb <= 3.0 * sigma + 10.0) && (ppb - clk_ppb >= -3.0 * sigma - 10.0));
+    HOST_CHECK((aging >= -RTC_TRIM_RANGE) && (aging <= RTC_TRIM_RANGE));
+    if(sc_ptr->sens > 0.0)
+    {
+        // Trimmed to less than 1 LSB, no rollback
+        HOST_CHECK((clk_ppb < RTC_TRIM_PPB_LSB) && (clk_ppb > -RTC_TRIM_PPB_LSB));
+        HOST_CHECK((kept > 0) && (rollback == 0));
+    }
+    else
+    {
+        // No trim improves the drift: rolled back until the trimming ends
+        HOST_CHECK((rollback >= RTC_TRIM_ROLLBACK_MAX) && (rtc_trim_get_state() == rtc_trim_off));
+    }
+    HOST_CHECK(failed == ((sc_ptr->fail_first || sc_ptr->lose_first) ? 1 : 0));
+}
+
+/***************************************************************************//**
+* @brief Run all scenarios
+*******************************************************************************/
+int main(void)
+{
+    srand(1);
+    for(int i = 0; i < (int)(sizeof(test_trim) / sizeof(test_trim[0])); i++)
+        test_run(&test_trim[i]);
+    return host_result("test_rtc_trim");
+}
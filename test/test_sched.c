@@ -0,0 +1,227 @@
+/*******************************************************************************
+ * This file is part of the MstHora distribution.
+ * Copyright (c) 2024 Igor Marinescu (igor.marinescu@gmail.com).
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, version 3.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see <http://www.gnu.org/licenses/>.
+ ******************************************************************************/
+/*******************************************************************************
+ * test_sched - runs the scheduler for one hour on the virtual clock with a
+ * host sched_port: the sleep advances the clock to the deadline or to the
+ * next (pseudo random) interrupt, which posts sched_ev_dcf. The tasks
+ * consume time by advancing the clock.
+ *
+ * Checks: a periodic task keeps its phase (no drift, never late without
+ * load), a one-shot task runs once per start, an event runs a stopped task
+ * and wakes the sleep, no active task sleeps until an interrupt and the idle
+ * time is the total time without the run time of the tasks.
+ ******************************************************************************/
+
+//******************************************************************************
+// Includes
+//******************************************************************************
+#include <stdio.h>
+#include <stdlib.h>
+
+#include "host.h"
+#include "sched.h"
+#include "sched_port.h"
+
+//******************************************************************************
+// Defines
+//******************************************************************************
+#define TEST_SCHED_TIME_US  (3600ULL * 1000000ULL)  // Simulated time
+#define TEST_SCHED_SEC_US   1000000     // Period of the "sec" task
+#define TEST_SCHED_FAST_US  1000        // Period of the "fast" task
+#define TEST_SCHED_IRQ_US   777777      // Mean period of the interrupt
+#define TEST_SCHED_IRQ_RND  1000        // Random part of the interrupt period
+#define TEST_SCHED_FAST_RUN 30          // Run time of the tasks in us
+#define TEST_SCHED_SEC_RUN  200
+#define TEST_SCHED_EV_RUN   50
+
+//******************************************************************************
+// Global Variables
+//******************************************************************************
+static ustime_t irq_ustime = 0;         // Time of the next interrupt
+static ustime_t irq_last = 0;           // Time of the last interrupt
+static uint32_t irq_cnt = 0;
+static uint32_t wake_cnt = 0;           // sched_port_wake calls
+
+static uint32_t fast_cnt = 0;
+static uint32_t sec_cnt = 0;
+static uint32_t one_cnt = 0;
+static uint32_t ev_cnt = 0;
+static ustime_t sec_next = TEST_SCHED_SEC_US;
+static ustime_t sec_err_max = 0;        // Max. delay of the "sec" task
+static ustime_t ev_late_max = 0;        // Max. delay of the event task
+static int one_id = -1;
+static int ev_id = -1;
+
+//******************************************************************************
+// sched_port on the virtual clock
+//******************************************************************************
+
+/***************************************************************************//**
+* @brief Get the time in us
+* @return virtual time in us
+*******************************************************************************/
+ustime_t sched_port_now(void)
+{
+    return host_us;
+}
+
+/***************************************************************************//**
+* @brief Sleep until the deadline or the next interrupt
+* @param timeout [in] true: wake at the deadline, false: only an interrupt wakes
+* @param deadline [in] virtual time in us to wake
+*******************************************************************************/
+void sched_port_sleep(const bool timeout, const ustime_t deadline)
+{
+    if(timeout && (deadline < irq_ustime))
+    {
+        host_us = deadline;
+        return;
+    }
+
+    if(irq_ustime > host_us)
+        host_us = irq_ustime;
+    irq_last = irq_ustime;
+    irq_ustime += TEST_SCHED_IRQ_US + (rand() % TEST_SCHED_IRQ_RND);
+    irq_cnt++;
+    sched_post(sched_ev_dcf);
+}
+
+/***************************************************************************//**
+* @brief Wake the core (counted only)
+*******************************************************************************/
+void sched_port_wake(void)
+{
+    wake_cnt++;
+}
+
+//******************************************************************************
+// Tasks
+//******************************************************************************
+
+static void task_fast(const ustime_t sys_ustime)
+{
+    fast_cnt++;
+    host_us += TEST_SCHED_FAST_RUN;
+}
+
+static void task_sec(const ustime_t sys_ustime)
+{
+    ustime_t err = sys_ustime - sec_next;
+    if(err > sec_err_max)
+        sec_err_max = err;
+    sec_next += TEST_SCHED_SEC_US;
+    sec_cnt++;
+    sched_start(one_id, sys_ustime, 0);
+    host_us += TEST_SCHED_SEC_RUN;
+}
+
+static void task_one(const ustime_t sys_ustime)
+{
+    one_cnt++;
+}
+
+static void task_ev(const ustime_t sys_ustime)
+{
+    ustime_t late = sys_ustime - irq_last;
+    if(late > ev_late_max)
+        ev_late_max = late;
+    ev_cnt++;
+    host_us += TEST_SCHED_EV_RUN;
+}
+
+/***************************************************************************//**
+* @brief Run the main loop (as main.c) until the end time
+* @param end [in] virtual time in us
+*******************************************************************************/
+static void test_loop(const ustime_t end)
+{
+    while(host_us < end)
+    {
+        sched_run(sched_port_now());
+        sched_sleep();
+    }
+}
+
+/***************************************************************************//**
+* @brief Run the checks
+*******************************************************************************/
+int main(void)
+{
+    srand(1);
+    sched_init();
+
+    // Event task first: run in the first sched_run after the interrupt
+    ev_id = sched_add("ev", task_ev, SCHED_ONE_SHOT, SCHED_EV(sched_ev_dcf));
+    int fast_id = sched_add("fast", task_fast, TEST_SCHED_FAST_US, SCHED_NO_EVENT);
+    int sec_id = sched_add("sec", task_sec, TEST_SCHED_SEC_US, SCHED_NO_EVENT);
+    one_id = sched_add("one", task_one, SCHED_ONE_SHOT, SCHED_NO_EVENT);
+    HOST_CHECK((ev_id >= 0) && (fast_id >= 0) && (sec_id >= 0) && (one_id >= 0));
+
+    // Table full
+    for(int i = 4; i < SCHED_TASK_CNT; i++)
+        HOST_CHECK(sched_add("fill", task_one, SCHED_ONE_SHOT, SCHED_NO_EVENT) >= 0);
+    HOST_CHECK(sched_add("full", task_one, SCHED_ONE_SHOT, SCHED_NO_EVENT) == -1);
+
+    // No active task: sleep until the interrupt, the event runs the stopped task
+    irq_ustime = 5000;
+    sched_sleep();
+    HOST_CHECK((host_us == 5000) && (irq_cnt == 1) && (wake_cnt == 1));
+    sched_run(sched_port_now());
+    HOST_CHECK((ev_cnt == 1) && (fast_cnt == 0) && (one_cnt == 0));
+
+    // Deadline over: run in the next sched_run
+    sched_start_at(one_id, 1000);
+    sched_run(sched_port_now());
+    HOST_CHECK(one_cnt == 1);
+    sched_run(sched_port_now());
+    HOST_CHECK(one_cnt == 1);
+
+    // One hour with load
+    host_us = 0;
+    irq_ustime = 123456;
+    irq_cnt = 0;
+    ev_cnt = 0;
+    one_cnt = 0;
+    sched_clear_stats();
+    sched_start(fast_id, 0, 0);
+    sched_start(sec_id, 0, TEST_SCHED_SEC_US);
+    test_loop(TEST_SCHED_TIME_US);
+
+    ustime_t total;
+    ustime_t idle = sched_get_idle(&total);
+    ustime_t run = 0;
+    for(int id = 0; id < 4; id++)
+        run += sched_get_task(id)->run_us;
+
+    printf("1h: fast=%lu sec=%lu one=%lu ev=%lu/%lu idle=%.2f%% sec late=%luus ev late=%luus\n",
+        (unsigned long) fast_cnt, (unsigned long) sec_cnt, (unsigned long) one_cnt,
+        (unsigned long) ev_cnt, (unsigned long) irq_cnt, (100.0 * idle) / total,
+        (unsigned long) sec_err_max, (unsigned long) ev_late_max);
+
+    // fast is late only by the run time of sec/ev and keeps its phase
+    HOST_CHECK(fast_cnt == TEST_SCHED_TIME_US / TEST_SCHED_FAST_US);
+    HOST_CHECK(sec_cnt == TEST_SCHED_TIME_US / TEST_SCHED_SEC_US - 1);
+    HOST_CHECK(sec_err_max <= TEST_SCHED_FAST_RUN + TEST_SCHED_EV_RUN);
+    HOST_CHECK(one_cnt == sec_cnt);
+    HOST_CHECK(ev_cnt == irq_cnt);
+    HOST_CHECK(ev_late_max <= TEST_SCHED_FAST_RUN + TEST_SCHED_SEC_RUN + TEST_SCHED_EV_RUN);
+    HOST_CHECK(sched_get_task(sec_id)->late_max_us == sec_err_max);
+    HOST_CHECK(sched_get_task(ev_id)->late_max_us == 0);    // Never due, only events
+    HOST_CHECK(idle + run == total);
+
+    return host_result("test_sched");
+}